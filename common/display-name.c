@@ -2563,39 +2563,88 @@ static const struct Vendor vendors[] =
     { "???", "Unknown" },
 };
 
+/* a PNP id is three letters 'A' to 'Z', five bits each */
+#define PNP_CODE_BITS 15
+
+/* index + 1 into vendors for every packed code, 0 if not listed */
+static guint16 vendor_index[1 << PNP_CODE_BITS];
+static gboolean vendor_index_ready = FALSE;
+
+/* names read from the system pnp.ids, they take precedence */
 static GHashTable *pnp_ids = NULL;
 
+static gint
+pack_pnp_code (const char *code)
+{
+    gint packed = 0;
+    gint i;
+
+    for (i = 0; i < 3; i++)
+    {
+        if (code[i] < 'A' || code[i] > 'Z')
+            return -1;
+        packed = (packed << 5) | (code[i] - 'A' + 1);
+    }
+
+    return code[3] == '\0' ? packed : -1;
+}
+
+static void
+build_vendor_index (void)
+{
+    guint i;
+    gint packed;
+
+    if (vendor_index_ready)
+        return;
+
+    for (i = 0; i < G_N_ELEMENTS (vendors); ++i)
+    {
+        packed = pack_pnp_code (vendors[i].vendor_id);
+        if (packed >= 0)
+            vendor_index[packed] = i + 1;
+    }
+
+    vendor_index_ready = TRUE;
+}
+
 static void
 read_pnp_ids (void)
 {
-    gchar *contents;
-    gchar **lines;
-    gchar *line;
-    gchar *code, *name;
-    gint i;
+    GMappedFile *pnp_ids_file;
+    const gchar *contents, *line, *end, *eol;
+    gint packed;
 
     if (pnp_ids)
         return;
 
-    pnp_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    pnp_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 
-    if (g_file_get_contents (PNP_IDS, &contents, NULL, NULL))
+    /* mapped, only the names are copied */
+    pnp_ids_file = g_mapped_file_new (PNP_IDS, FALSE, NULL);
+    if (pnp_ids_file == NULL)
+        return;
+
+    contents = g_mapped_file_get_contents (pnp_ids_file);
+    end = contents + g_mapped_file_get_length (pnp_ids_file);
+    for (line = contents; line < end; line = eol + 1)
     {
-        lines = g_strsplit (contents, "\n", -1);
-        for (i = 0; lines[i]; i++)
+        eol = memchr (line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+
+        if (eol - line > 4 && line[3] == '\t')
         {
-             line = lines[i];
-             if (line[3] == '\t')
-             {
-                 code = line;
-                 line[3] = '\0';
-                 name = line + 4;
-                 g_hash_table_insert (pnp_ids, code, name);
-             }
+            gchar code[4] = { line[0], line[1], line[2], '\0' };
+
+            packed = pack_pnp_code (code);
+            if (packed >= 0)
+                g_hash_table_insert (pnp_ids, GINT_TO_POINTER (packed),
+                                     g_strndup (line + 4, eol - line - 4));
         }
-        g_free (lines);
-        g_free (contents);
     }
+
+    g_mapped_file_unref (pnp_ids_file);
 }
 
 
@@ -2604,15 +2653,25 @@ find_vendor (const char *code)
 {
     const char *vendor_name;
     unsigned int i;
+    gint packed;
 
-    read_pnp_ids ();
+    packed = pack_pnp_code (code);
+    if (packed >= 0)
+    {
+        read_pnp_ids ();
+        vendor_name = g_hash_table_lookup (pnp_ids, GINT_TO_POINTER (packed));
+        if (vendor_name)
+            return vendor_name;
 
-    vendor_name = g_hash_table_lookup (pnp_ids, code);
+        build_vendor_index ();
+        if (vendor_index[packed] != 0)
+            return vendors[vendor_index[packed] - 1].vendor_name;
 
-    if (vendor_name)
-        return vendor_name;
+        return code;
+    }
 
-    for (i = 0; i < sizeof (vendors) / sizeof (vendors[0]); ++i)
+    /* not three letters, like "???" */
+    for (i = 0; i < G_N_ELEMENTS (vendors); ++i)
     {
         const Vendor *v = &(vendors[i]);
 
@@ -2673,3 +2732,31 @@ make_display_name (const MonitorInfo *info, guint output)
     else
         return g_strdup_printf ("%s ", vendor);
 }
+
+/* the name shown for an output, name is the RandR output name */
+char *
+make_output_name (const char *name, const MonitorInfo *info, guint output)
+{
+    /* special case, a laptop */
+    if (g_str_has_prefix (name, "LVDS")
+        || g_str_has_prefix (name, "eDP")
+        || strcmp (name, "PANEL") == 0)
+        return g_strdup (_("Laptop"));
+    else if (info)
+        return make_display_name (info, output);
+
+    /* last attempt to return a better name */
+    if (g_str_has_prefix (name, "VGA")
+             || g_str_has_prefix (name, "Analog"))
+        return g_strdup (_("Monitor"));
+    else if (g_str_has_prefix (name, "TV")
+             || strcmp (name, "S-video") == 0)
+        return g_strdup (_("Television"));
+    else if (g_str_has_prefix (name, "TMDS")
+             || g_str_has_prefix (name, "DVI")
+             || g_str_has_prefix (name, "Digital"))
+        return g_strdup (_("Digital display"));
+
+    /* everything failed, fallback */
+    return g_strdup (name);
+}
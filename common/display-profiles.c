@@ -77,17 +77,102 @@ display_settings_profile_name_exists (XfconfChannel *channel, const gchar *new_p
     return TRUE;
 }
 
+static guint
+display_settings_profile_match (GHashTable   *props,
+                                const gchar  *profile_name,
+                                gchar       **display_infos,
+                                guint        *monitors)
+{
+    GHashTableIter  iter;
+    gpointer        key, value;
+    GValue         *edid;
+    gchar          *property;
+    guint           m, profile_match = 0;
+
+    *monitors = 0;
+
+    /* check if every EDID referenced in the profile is also currently available */
+    g_hash_table_iter_init (&iter, props);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        gchar **property_elements = g_strsplit (key, "/", -1);
+
+        if (get_size (property_elements) == 3)
+        {
+            (*monitors)++;
+
+            property = g_strdup_printf ("%s/EDID", (gchar *) key);
+            edid = g_hash_table_lookup (props, property);
+            if (edid != NULL && G_VALUE_HOLDS_STRING (edid))
+            {
+                for (m = 0; display_infos[m] != NULL; ++m)
+                {
+                    if (g_strcmp0 (display_infos[m], g_value_get_string (edid)) == 0)
+                        profile_match++;
+                }
+            }
+            g_free (property);
+        }
+
+        g_strfreev (property_elements);
+    }
+
+    return profile_match;
+}
+
+static GHashTable *
+display_settings_profile_subset (GHashTable  *properties,
+                                 const gchar *profile_name)
+{
+    GHashTable     *props;
+    GHashTableIter  iter;
+    gpointer        key, value;
+    gchar          *base;
+    gsize           len;
+
+    /* what xfconf_channel_get_properties would return for "/<profile>",
+     * the values are borrowed from properties */
+    props = g_hash_table_new (g_str_hash, g_str_equal);
+    base = g_strdup_printf ("/%s", profile_name);
+    len = strlen (base);
+
+    g_hash_table_iter_init (&iter, properties);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        if (strncmp (key, base, len) == 0
+            && (((gchar *) key)[len] == '\0' || ((gchar *) key)[len] == '/'))
+            g_hash_table_insert (props, key, value);
+    }
+    g_free (base);
+
+    return props;
+}
+
 GList*
 display_settings_get_profiles (gchar **display_infos, XfconfChannel *channel)
 {
     GHashTable *properties;
+    GList      *profiles;
+
+    properties = xfconf_channel_get_properties (channel, NULL);
+    if (properties == NULL)
+        return NULL;
+
+    profiles = display_settings_get_profiles_from_properties (display_infos, properties);
+    g_hash_table_destroy (properties);
+
+    return profiles;
+}
+
+GList*
+display_settings_get_profiles_from_properties (gchar      **display_infos,
+                                               GHashTable  *properties)
+{
     GList      *channel_contents;
     GList      *profiles = NULL;
     GList      *current;
-    guint       m;
     guint       noutput;
 
-    properties = xfconf_channel_get_properties (channel, NULL);
     channel_contents = g_hash_table_get_keys (properties);
     noutput = g_strv_length (display_infos);
 
@@ -96,9 +181,6 @@ display_settings_get_profiles (gchar **display_infos, XfconfChannel *channel)
     while (current)
     {
         GHashTable     *props;
-        gchar          *property_profile;
-        GHashTableIter  iter;
-        gpointer        key, value;
         guint           profile_match = 0;
         guint           monitors = 0;
         gchar         **current_elements = g_strsplit (current->data, "/", -1);
@@ -117,40 +199,9 @@ display_settings_get_profiles (gchar **display_infos, XfconfChannel *channel)
         profile_name = g_strdup_printf ("%s", *(current_elements + 1));
         g_strfreev (current_elements);
 
-        /* Walk through the profile and check if every EDID referenced there is also currently available */
-        property_profile = g_strdup_printf ("/%s", profile_name);
-        props = xfconf_channel_get_properties (channel, property_profile);
-        g_hash_table_iter_init (&iter, props);
-
-        while (g_hash_table_iter_next (&iter, &key, &value))
-        {
-            gchar *property;
-            gchar *current_edid;
-
-            gchar ** property_elements = g_strsplit (key, "/", -1);
-            if (get_size (property_elements) == 3) {
-                monitors++;
-
-                property = g_strdup_printf ("%s/EDID", (gchar*)key);
-                current_edid = xfconf_channel_get_string (channel, property, NULL);
-
-                if (current_edid) {
-
-                    for (m = 0; m < noutput; ++m)
-                    {
-                        if (g_strcmp0 (display_infos[m], current_edid) == 0)
-                        {
-                            profile_match ++;
-                        }
-                    }
-                }
-                g_free (property);
-                g_free (current_edid);
-            }
-
-            g_strfreev (property_elements);
-        }
-        g_free (property_profile);
+        /* the outputs of the profile are in properties already */
+        props = display_settings_profile_subset (properties, profile_name);
+        profile_match = display_settings_profile_match (props, profile_name, display_infos, &monitors);
         g_hash_table_destroy (props);
 
         /* filter the content of the combobox to only matching profiles and exclude "Notify", "Default" and "Schemes" */
@@ -169,7 +220,6 @@ display_settings_get_profiles (gchar **display_infos, XfconfChannel *channel)
     }
 
     g_list_free (channel_contents);
-    g_hash_table_destroy (properties);
 
     return profiles;
 }
@@ -21,8 +21,10 @@
 
 #include "xfce-randr.h"
 
-
 gboolean display_settings_profile_name_exists   (XfconfChannel  *channel,
                                                  const gchar    *new_profile_name);
 GList*   display_settings_get_profiles          (gchar         **display_infos,
                                                  XfconfChannel  *channel);
+/* the same from a table of all the channel's properties, no xfconf call */
+GList*   display_settings_get_profiles_from_properties (gchar      **display_infos,
+                                                        GHashTable  *properties);
@@ -518,27 +518,183 @@ decode_check_sum (const uchar *edid,
     info->checksum = check;
 }
 
-MonitorInfo *
-decode_edid (const uchar *edid)
+static void
+decode_cea_extension (const uchar *block, EdidExtensions *ext)
 {
-    MonitorInfo *info = g_new0 (MonitorInfo, 1);
+    int d, idx;
+
+    ext->cea_revision = block[0x01];
+
+    if (block[0x01] >= 2)
+    {
+        ext->cea_underscan = get_bit (block[0x03], 7);
+        ext->cea_basic_audio = get_bit (block[0x03], 6);
+        ext->cea_ycbcr444 = get_bit (block[0x03], 5);
+        ext->cea_ycbcr422 = get_bit (block[0x03], 4);
+        ext->cea_native_formats = get_bits (block[0x03], 0, 3);
+    }
+
+    /* detailed timings follow the data blocks, up to the checksum */
+    d = block[0x02];
+    if (d < 4 || ext->has_preferred)
+        return;
+
+    for (idx = d; idx + 18 <= 127; idx += 18)
+    {
+        if (block[idx] == 0x00 && block[idx + 1] == 0x00)
+            break;
+
+        decode_detailed_timing (block + idx, &ext->preferred);
+        ext->has_preferred = TRUE;
+
+        if (ext->width_mm == 0 && ext->preferred.width_mm > 0 && ext->preferred.height_mm > 0)
+        {
+            ext->width_mm = ext->preferred.width_mm;
+            ext->height_mm = ext->preferred.height_mm;
+        }
+        break;
+    }
+}
+
+static void
+decode_displayid_extension (const uchar *block, EdidExtensions *ext)
+{
+    const uchar *section = block + 1;
+    int          end, idx, n;
+
+    ext->displayid_version = section[0x00];
+
+    /* data blocks start after the 4 bytes section header */
+    end = MIN (4 + section[0x01], 126);
+    for (idx = 4; idx + 3 <= end; idx += 3 + section[idx + 2])
+    {
+        const uchar *data = section + idx + 3;
+
+        /* display parameters, the image size in 0.1 mm */
+        if (section[idx] == 0x01 && section[idx + 2] >= 4 && idx + 3 + 4 <= end)
+        {
+            ext->width_mm = (data[0x00] | data[0x01] << 8) / 10;
+            ext->height_mm = (data[0x02] | data[0x03] << 8) / 10;
+            continue;
+        }
+
+        /* type I detailed timings, 20 bytes each */
+        if (section[idx] != 0x03 || ext->has_preferred)
+            continue;
+
+        for (n = 0; n + 20 <= section[idx + 2] && idx + 3 + n + 20 <= end; n += 20)
+        {
+            const uchar *t = data + n;
+
+            if (n > 0 && !get_bit (t[0x03], 7))
+                continue;
+
+            memset (&ext->preferred, 0, sizeof (ext->preferred));
+            ext->preferred.pixel_clock = ((t[0x00] | t[0x01] << 8 | t[0x02] << 16) + 1) * 10000;
+            ext->preferred.h_addr = (t[0x04] | t[0x05] << 8) + 1;
+            ext->preferred.h_blank = (t[0x06] | t[0x07] << 8) + 1;
+            ext->preferred.h_front_porch = ((t[0x08] | (t[0x09] & 0x7f) << 8)) + 1;
+            ext->preferred.h_sync = (t[0x0a] | t[0x0b] << 8) + 1;
+            ext->preferred.v_addr = (t[0x0c] | t[0x0d] << 8) + 1;
+            ext->preferred.v_blank = (t[0x0e] | t[0x0f] << 8) + 1;
+            ext->preferred.v_front_porch = ((t[0x10] | (t[0x11] & 0x7f) << 8)) + 1;
+            ext->preferred.v_sync = (t[0x12] | t[0x13] << 8) + 1;
+            ext->preferred.interlaced = get_bit (t[0x03], 4);
+            ext->has_preferred = TRUE;
+
+            if (get_bit (t[0x03], 7))
+                break;
+        }
+    }
+}
+
+int
+decode_edid_extensions (const uchar *edid, int length, EdidExtensions *ext)
+{
+    int i;
+
+    memset (ext, 0, sizeof (EdidExtensions));
+
+    if (length < 128)
+        return FALSE;
+
+    /* the base block announces the number of extensions */
+    ext->n_blocks = MIN (edid[0x7e], length / 128 - 1);
+
+    for (i = 0; i < ext->n_blocks; ++i)
+    {
+        const uchar *block = edid + (i + 1) * 128;
+
+        if (i < (int) G_N_ELEMENTS (ext->tags))
+            ext->tags[i] = block[0x00];
+
+        switch (block[0x00])
+        {
+            case 0x02:
+                decode_cea_extension (block, ext);
+                break;
+
+            case 0x70:
+                decode_displayid_extension (block, ext);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return TRUE;
+}
+
+int
+decode_edid_into (const uchar *edid, int length, MonitorInfo *info, EdidExtensions *ext)
+{
+    memset (info, 0, sizeof (MonitorInfo));
+
+    if (length < 128)
+        return FALSE;
 
     decode_check_sum (edid, info);
 
-    if (decode_header (edid)
-    && decode_vendor_and_product_identification (edid, info)
-    && decode_edid_version (edid, info)
-    && decode_display_parameters (edid, info)
-    && decode_color_characteristics (edid, info)
-    && decode_established_timings (edid, info)
-    && decode_standard_timings (edid, info)
-    && decode_descriptors (edid, info))
+    if (!decode_header (edid)
+        || !decode_vendor_and_product_identification (edid, info)
+        || !decode_edid_version (edid, info)
+        || !decode_display_parameters (edid, info)
+        || !decode_color_characteristics (edid, info)
+        || !decode_established_timings (edid, info)
+        || !decode_standard_timings (edid, info)
+        || !decode_descriptors (edid, info))
+        return FALSE;
+
+    if (ext == NULL)
+        return TRUE;
+
+    /* fill what the base block left out from the extensions */
+    decode_edid_extensions (edid, length, ext);
+
+    if ((info->width_mm == -1 || info->height_mm == -1) && ext->width_mm > 0)
     {
-        return info;
+        info->width_mm = ext->width_mm;
+        info->height_mm = ext->height_mm;
     }
-    else
+
+    if (info->n_detailed_timings == 0 && ext->has_preferred)
     {
-        g_free (info);
-        return NULL;
+        info->detailed_timings[0] = ext->preferred;
+        info->n_detailed_timings = 1;
     }
+
+    return TRUE;
+}
+
+MonitorInfo *
+decode_edid (const uchar *edid)
+{
+    MonitorInfo *info = g_new0 (MonitorInfo, 1);
+
+    if (decode_edid_into (edid, 128, info, NULL))
+        return info;
+
+    g_free (info);
+    return NULL;
 }
@@ -192,7 +192,36 @@ struct MonitorInfo
     char        dsc_string[14];     /* Unspecified ASCII data */
 };
 
+/* Extension blocks following the base block (CEA-861, DisplayID) */
+typedef struct EdidExtensions EdidExtensions;
+
+struct EdidExtensions
+{
+    int         n_blocks;           /* extension blocks present */
+    uchar       tags[8];            /* tags of the first blocks */
+
+    int         cea_revision;       /* 0 if no CEA-861 block */
+    int         cea_native_formats;
+    int         cea_underscan;
+    int         cea_basic_audio;
+    int         cea_ycbcr444;
+    int         cea_ycbcr422;
+
+    int         displayid_version;  /* 0 if no DisplayID block */
+
+    int         width_mm;           /* image size from the blocks, */
+    int         height_mm;          /* 0 if none announces one     */
+
+    int         has_preferred;      /* first detailed timing found in */
+    DetailedTiming  preferred;      /* a CEA-861 or DisplayID block   */
+};
+
 MonitorInfo *decode_edid (const uchar *data);
+/* decodes into info without allocating, with ext the extension blocks
+ * are decoded too and complete the size and timings of the base block */
+int decode_edid_into (const uchar *data, int length, MonitorInfo *info, EdidExtensions *ext);
+int decode_edid_extensions (const uchar *data, int length, EdidExtensions *ext);
 char *make_display_name (const MonitorInfo *info, guint output);
+char *make_output_name (const char *name, const MonitorInfo *info, guint output);
 
 #endif
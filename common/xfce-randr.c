@@ -37,9 +37,28 @@
 #include "xfce-randr.h"
 #include "edid.h"
 
+/* output names are used in xfconf property paths */
+#define XFCE_RANDR_NAME_CHARS "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_<>"
 
 
 
+typedef struct _XfceRandrOutputInfo XfceRandrOutputInfo;
+
+/* what is kept of an output, copied from XRRGetOutputInfo or filled
+ * from the snapshot of xfsettingsd */
+struct _XfceRandrOutputInfo
+{
+    gchar    *name;
+    RRCrtc    crtc;
+    gint      ncrtc;
+    RRCrtc   *crtcs;
+    gint      nmode;
+    gint      npreferred;
+    RRMode   *modes;
+    gulong    mm_width;
+    gulong    mm_height;
+};
+
 struct _XfceRandrPrivate
 {
     /* xrandr 1.3 capable */
@@ -48,19 +67,80 @@ struct _XfceRandrPrivate
     GdkDisplay          *display;
     XRRScreenResources  *resources;
 
+    /* configuration and probe time of what the slots hold, a screen
+     * change carrying the same stamps has already been applied */
+    Time                 timestamp;
+    Time                 config_timestamp;
+
+    /* xid of the output in each slot */
+    RROutput            *outputs;
+
 
     /* cache for the output/mode info */
-    XRROutputInfo      **output_info;
+    XfceRandrOutputInfo **output_info;
     XfceRRMode         **modes;
+
+    /* every mode of the resources, the mode id -> index + 1 table
+     * and per connected output a bitset of the indices it supports */
+    XfceRRMode          *catalogue;
+    GHashTable          *mode_index;
+    guint                mode_words;
+    guint32            **mode_sets;
     /* SHA-1 checksum of the EDID */
     gchar              **edid;
+
+    /* xfsettingsd without the ApplyScheme method */
+    guint                no_apply_method : 1;
+
+    /* pending ApplyScheme calls, cancelled when the structure goes */
+    GCancellable        *apply_cancellable;
+
+    /* write-behind of the saved outputs: what xfconfd has and
+     * what still has to be written, property -> GValue */
+    XfconfChannel       *channel;
+    gulong               channel_handler;
+    GHashTable          *saved;
+    GHashTable          *pending;
+    guint                flush_id;
 };
 
 
 
 static gchar *xfce_randr_friendly_name (XfceRandr *randr,
                                         guint      output,
-                                        guint      output_rr_id);
+                                        RROutput   output_rr_id);
+
+
+
+static XfceRandrOutputInfo *
+xfce_randr_output_info_copy (const XRROutputInfo *info)
+{
+    XfceRandrOutputInfo *output_info;
+
+    output_info = g_slice_new0 (XfceRandrOutputInfo);
+    output_info->name = g_strndup (info->name, info->nameLen);
+    output_info->crtc = info->crtc;
+    output_info->ncrtc = info->ncrtc;
+    output_info->crtcs = g_memdup (info->crtcs, info->ncrtc * sizeof (RRCrtc));
+    output_info->nmode = info->nmode;
+    output_info->npreferred = info->npreferred;
+    output_info->modes = g_memdup (info->modes, info->nmode * sizeof (RRMode));
+    output_info->mm_width = info->mm_width;
+    output_info->mm_height = info->mm_height;
+
+    return output_info;
+}
+
+
+
+static void
+xfce_randr_output_info_free (XfceRandrOutputInfo *output_info)
+{
+    g_free (output_info->name);
+    g_free (output_info->crtcs);
+    g_free (output_info->modes);
+    g_slice_free (XfceRandrOutputInfo, output_info);
+}
 
 
 
@@ -90,41 +170,76 @@ xfce_randr_get_safe_rotations (XfceRandr *randr,
 
 
 
-static XfceRRMode *
-xfce_randr_list_supported_modes (XRRScreenResources *resources,
-                                XRROutputInfo       *output_info)
+static void
+xfce_randr_build_catalogue (XfceRandr *randr)
 {
-    XfceRRMode *modes;
-    gint m, n;
+    XRRScreenResources *resources = randr->priv->resources;
+    XRRModeInfo        *info;
+    gint                n;
+
+    randr->priv->catalogue = g_new0 (XfceRRMode, MAX (resources->nmode, 1));
+    randr->priv->mode_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+    randr->priv->mode_words = (resources->nmode + 31) / 32;
+
+    for (n = 0; n < resources->nmode; ++n)
+    {
+        info = &resources->modes[n];
+        randr->priv->catalogue[n].id = info->id;
+        randr->priv->catalogue[n].width = info->width;
+        randr->priv->catalogue[n].height = info->height;
+        randr->priv->catalogue[n].rate = (gdouble) info->dotClock /
+                                         ((gdouble) info->hTotal * (gdouble) info->vTotal);
+
+        g_hash_table_insert (randr->priv->mode_index,
+                             GUINT_TO_POINTER (info->id),
+                             GINT_TO_POINTER (n + 1));
+    }
+}
 
-    g_return_val_if_fail (resources != NULL, NULL);
-    g_return_val_if_fail (output_info != NULL, NULL);
 
-    if (output_info->nmode == 0)
-        return NULL;
 
-    modes = g_new0 (XfceRRMode, output_info->nmode);
+static gint
+xfce_randr_mode_index (XfceRandr *randr,
+                       RRMode     id)
+{
+    /* -1 for a mode the resources do not know */
+    return GPOINTER_TO_INT (g_hash_table_lookup (randr->priv->mode_index,
+                                                 GUINT_TO_POINTER (id))) - 1;
+}
+
+
+
+static void
+xfce_randr_list_supported_modes (XfceRandr *randr,
+                                 guint      m)
+{
+    XfceRandrOutputInfo *output_info = randr->priv->output_info[m];
+    XfceRRMode          *modes = NULL;
+    guint32             *set;
+    gint                 n, idx;
+
+    set = g_new0 (guint32, MAX (randr->priv->mode_words, 1));
+
+    if (output_info->nmode > 0)
+        modes = g_new0 (XfceRRMode, output_info->nmode);
 
     for (n = 0; n < output_info->nmode; ++n)
     {
-        modes[n].id = output_info->modes[n];
-
-        /* we need to walk yet another list to get the mode info */
-        for (m = 0; m < resources->nmode; ++m)
+        idx = xfce_randr_mode_index (randr, output_info->modes[n]);
+        if (idx < 0)
         {
-            if (output_info->modes[n] == resources->modes[m].id)
-            {
-                modes[n].width = resources->modes[m].width;
-                modes[n].height = resources->modes[m].height;
-                modes[n].rate = (gdouble) resources->modes[m].dotClock /
-                                ((gdouble) resources->modes[m].hTotal * (gdouble) resources->modes[m].vTotal);
-
-                break;
-            }
+            modes[n].id = output_info->modes[n];
+            continue;
         }
+
+        modes[n] = randr->priv->catalogue[idx];
+        set[idx / 32] |= 1u << (idx % 32);
     }
 
-    return modes;
+    g_free (randr->priv->modes[m]);
+    randr->priv->modes[m] = modes;
+    g_free (randr->priv->mode_sets[m]);
+    randr->priv->mode_sets[m] = set;
 }
 
 
@@ -157,6 +272,87 @@ xfce_randr_guess_relations (XfceRandr *randr)
 }
 
 
+static void
+xfce_randr_update_crtc (XfceRandr *randr,
+                        Display   *xdisplay,
+                        guint      m)
+{
+    XRRCrtcInfo                *crtc_info;
+    XRRCrtcTransformAttributes *attr;
+
+    if (randr->priv->output_info[m]->crtc != None)
+    {
+        crtc_info = XRRGetCrtcInfo (xdisplay, randr->priv->resources,
+                                    randr->priv->output_info[m]->crtc);
+        randr->mode[m] = crtc_info->mode;
+        randr->rotation[m] = crtc_info->rotation;
+        randr->rotations[m] = crtc_info->rotations;
+        randr->position[m].x = crtc_info->x;
+        randr->position[m].y = crtc_info->y;
+        XRRFreeCrtcInfo (crtc_info);
+        if (XRRGetCrtcTransform (xdisplay, randr->priv->output_info[m]->crtc, &attr) && attr)
+        {
+          randr->scalex[m] = XFixedToDouble (attr->currentTransform.matrix[0][0]);
+          randr->scaley[m] = XFixedToDouble (attr->currentTransform.matrix[1][1]);
+          XFree (attr);
+        }
+    }
+    else
+    {
+        /* output disabled */
+        randr->mode[m] = None;
+        randr->rotation[m] = RR_Rotate_0;
+        randr->rotations[m] = xfce_randr_get_safe_rotations (randr, xdisplay, m);
+    }
+}
+
+
+
+static void
+xfce_randr_update_primary (XfceRandr *randr,
+                           Display   *xdisplay,
+                           GdkWindow *root_window)
+{
+    RROutput primary = None;
+    guint    m;
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    /* find the primary screen if supported */
+    if (randr->priv->has_1_3)
+        primary = XRRGetOutputPrimary (xdisplay, GDK_WINDOW_XID (root_window));
+#endif
+
+    for (m = 0; m < randr->noutput; ++m)
+    {
+        if (primary != None && primary == randr->priv->outputs[m])
+            randr->status[m] = XFCE_OUTPUT_STATUS_PRIMARY;
+        else
+            randr->status[m] = XFCE_OUTPUT_STATUS_SECONDARY;
+    }
+}
+
+
+
+static void
+xfce_randr_allocate (XfceRandr *randr)
+{
+    /* allocate final space for the settings */
+    randr->mode = g_new0 (RRMode, randr->noutput);
+    randr->priv->modes = g_new0 (XfceRRMode *, randr->noutput);
+    randr->priv->mode_sets = g_new0 (guint32 *, randr->noutput);
+    randr->priv->edid = g_new0 (gchar *, randr->noutput);
+    randr->position = g_new0 (XfceOutputPosition, randr->noutput);
+    randr->scalex = g_new0 (gdouble, randr->noutput);
+    randr->scaley = g_new0 (gdouble, randr->noutput);
+    randr->rotation = g_new0 (Rotation, randr->noutput);
+    randr->rotations = g_new0 (Rotation, randr->noutput);
+    randr->mirrored = g_new0 (gboolean, randr->noutput);
+    randr->status = g_new0 (XfceOutputStatus, randr->noutput);
+    randr->friendly_name = g_new0 (gchar *, randr->noutput);
+}
+
+
+
 static void
 xfce_randr_populate (XfceRandr *randr,
                      Display   *xdisplay,
@@ -164,20 +360,19 @@ xfce_randr_populate (XfceRandr *randr,
 {
     GPtrArray      *outputs;
     XRROutputInfo  *output_info;
-    XRRCrtcInfo    *crtc_info;
     gint            n;
     guint           m, connected;
-    guint          *output_ids = NULL;
-
-    XfconfChannel *display_channel = xfconf_channel_new ("displays");
 
     g_return_if_fail (randr != NULL);
     g_return_if_fail (randr->priv != NULL);
     g_return_if_fail (randr->priv->resources != NULL);
 
+    /* one lookup table for the modes of all outputs */
+    xfce_randr_build_catalogue (randr);
+
     /* prepare the temporary cache */
     outputs = g_ptr_array_new ();
-    output_ids = g_malloc0 (randr->priv->resources->noutput * sizeof (guint));
+    randr->priv->outputs = g_new0 (RROutput, randr->priv->resources->noutput);
 
     /* walk the outputs */
     connected = 0;
@@ -195,85 +390,224 @@ xfce_randr_populate (XfceRandr *randr,
         }
         else
         {
-            output_ids[connected] = n;
+            randr->priv->outputs[connected] = randr->priv->resources->outputs[n];
             connected++;
         }
 
         /* cache it */
-        g_ptr_array_add (outputs, output_info);
+        g_ptr_array_add (outputs, xfce_randr_output_info_copy (output_info));
+        XRRFreeOutputInfo (output_info);
     }
 
     /* migrate the temporary cache */
     randr->noutput = outputs->len;
-    randr->priv->output_info = (XRROutputInfo **) g_ptr_array_free (outputs, FALSE);
+    randr->priv->output_info = (XfceRandrOutputInfo **) g_ptr_array_free (outputs, FALSE);
+    randr->priv->timestamp = randr->priv->resources->timestamp;
+    randr->priv->config_timestamp = randr->priv->resources->configTimestamp;
 
-    /* allocate final space for the settings */
-    randr->mode = g_new0 (RRMode, randr->noutput);
-    randr->priv->modes = g_new0 (XfceRRMode *, randr->noutput);
-    randr->priv->edid = g_new0 (gchar *, randr->noutput);
-    randr->position = g_new0 (XfceOutputPosition, randr->noutput);
-    randr->scalex = g_new0 (gdouble, randr->noutput);
-    randr->scaley = g_new0 (gdouble, randr->noutput);
-    randr->rotation = g_new0 (Rotation, randr->noutput);
-    randr->rotations = g_new0 (Rotation, randr->noutput);
-    randr->mirrored = g_new0 (gboolean, randr->noutput);
-    randr->status = g_new0 (XfceOutputStatus, randr->noutput);
-    randr->friendly_name = g_new0 (gchar *, randr->noutput);
+    xfce_randr_allocate (randr);
 
     /* walk the connected outputs */
     for (m = 0; m < randr->noutput; ++m)
     {
         /* fill in supported modes */
-        randr->priv->modes[m] = xfce_randr_list_supported_modes (randr->priv->resources, randr->priv->output_info[m]);
+        xfce_randr_list_supported_modes (randr, m);
 
-#ifdef HAS_RANDR_ONE_POINT_THREE
-        /* find the primary screen if supported */
-        if (randr->priv->has_1_3 && XRRGetOutputPrimary (xdisplay, GDK_WINDOW_XID (root_window)) == randr->priv->resources->outputs[output_ids[m]])
-            randr->status[m] = XFCE_OUTPUT_STATUS_PRIMARY;
-        else
-#endif
-            randr->status[m] = XFCE_OUTPUT_STATUS_SECONDARY;
+        /* fill in the current crtc settings */
+        xfce_randr_update_crtc (randr, xdisplay, m);
 
-        if (randr->priv->output_info[m]->crtc != None)
-        {
-            XRRCrtcTransformAttributes  *attr;
-            crtc_info = XRRGetCrtcInfo (xdisplay, randr->priv->resources,
-                                        randr->priv->output_info[m]->crtc);
-            randr->mode[m] = crtc_info->mode;
-            randr->rotation[m] = crtc_info->rotation;
-            randr->rotations[m] = crtc_info->rotations;
-            randr->position[m].x = crtc_info->x;
-            randr->position[m].y = crtc_info->y;
-            XRRFreeCrtcInfo (crtc_info);
-            if (XRRGetCrtcTransform (xdisplay, randr->priv->output_info[m]->crtc, &attr) && attr)
-            {
-              randr->scalex[m] = XFixedToDouble (attr->currentTransform.matrix[0][0]);
-              randr->scaley[m] = XFixedToDouble (attr->currentTransform.matrix[1][1]);
-              XFree (attr);
-            }
+        /* fill in the name used by the UI */
+        randr->friendly_name[m] = xfce_randr_friendly_name (randr, m, randr->priv->outputs[m]);
 
-        }
-        else
+        /* Replace spaces with underscore in name for xfconf compatibility */
+        g_strcanon(randr->priv->output_info[m]->name, XFCE_RANDR_NAME_CHARS, '_');
+    }
+
+    /* a single round trip for the primary output */
+    xfce_randr_update_primary (randr, xdisplay, root_window);
+
+    /* populate mirrored details */
+    xfce_randr_guess_relations (randr);
+}
+
+
+
+static GVariant *
+xfce_randr_get_snapshot (void)
+{
+    GDBusConnection *connection;
+    GVariant        *result, *snapshot = NULL;
+    GError          *error = NULL;
+    guint            version;
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    if (connection == NULL)
+        return NULL;
+
+    result = g_dbus_connection_call_sync (connection,
+                                          "org.xfce.SettingsDaemon",
+                                          "/org/xfce/SettingsDaemon",
+                                          "org.xfce.SettingsDaemon",
+                                          "GetRandrSnapshot",
+                                          NULL,
+                                          G_VARIANT_TYPE ("(uv)"),
+                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                          1000, NULL, &error);
+    g_object_unref (connection);
+
+    if (result == NULL)
+    {
+        g_debug ("No RandR snapshot: %s", error->message);
+        g_error_free (error);
+        return NULL;
+    }
+
+    g_variant_get (result, "(uv)", &version, &snapshot);
+    g_variant_unref (result);
+
+    /* another daemon version, query the server instead */
+    if (version != XFCE_RANDR_SNAPSHOT_VERSION
+        || !g_variant_is_of_type (snapshot, G_VARIANT_TYPE (XFCE_RANDR_SNAPSHOT_TYPE)))
+    {
+        g_debug ("Ignoring RandR snapshot version %u", version);
+        g_variant_unref (snapshot);
+        return NULL;
+    }
+
+    return snapshot;
+}
+
+
+
+static XfceRandrOutputInfo *
+xfce_randr_output_info_new (const gchar *name,
+                            GVariant    *crtcs,
+                            GVariant    *modes)
+{
+    XfceRandrOutputInfo *output_info;
+    const guint64       *crtc_ids, *mode_ids;
+    gsize                ncrtc, nmode, n;
+
+    crtc_ids = g_variant_get_fixed_array (crtcs, &ncrtc, sizeof (guint64));
+    mode_ids = g_variant_get_fixed_array (modes, &nmode, sizeof (guint64));
+
+    output_info = g_slice_new0 (XfceRandrOutputInfo);
+    output_info->name = g_strdup (name);
+    output_info->ncrtc = ncrtc;
+    output_info->crtcs = g_new (RRCrtc, ncrtc);
+    output_info->nmode = nmode;
+    output_info->modes = g_new (RRMode, nmode);
+
+    /* the same names as xfce_randr_populate */
+    g_strcanon (output_info->name, XFCE_RANDR_NAME_CHARS, '_');
+
+    for (n = 0; n < ncrtc; ++n)
+        output_info->crtcs[n] = crtc_ids[n];
+    for (n = 0; n < nmode; ++n)
+        output_info->modes[n] = mode_ids[n];
+
+    return output_info;
+}
+
+
+
+static gboolean
+xfce_randr_populate_from_snapshot (XfceRandr *randr,
+                                   Display   *xdisplay,
+                                   GdkWindow *root_window,
+                                   GVariant  *snapshot)
+{
+    GVariant      *outputs, *output, *crtcs, *modes;
+    guint64        timestamp, config_timestamp, id, crtc, mode;
+    const guint64 *mode_ids;
+    const gchar   *name, *edid, *friendly_name;
+    guint32        mm_width, mm_height;
+    guint16        rotation, rotations;
+    gint           npreferred, x, y;
+    gdouble        scalex, scaley;
+    gsize          nmode, n;
+    guint          m;
+
+    g_variant_get (snapshot, "(tt@a(tsuutatatitqqiiddss))",
+                   &timestamp, &config_timestamp, &outputs);
+
+    /* the daemon has not caught up with the server yet */
+    if (timestamp != randr->priv->resources->timestamp
+        || config_timestamp != randr->priv->resources->configTimestamp)
+    {
+        g_variant_unref (outputs);
+        return FALSE;
+    }
+
+    xfce_randr_build_catalogue (randr);
+
+    /* every mode has to be in these resources */
+    for (m = 0; m < g_variant_n_children (outputs); ++m)
+    {
+        output = g_variant_get_child_value (outputs, m);
+        modes = g_variant_get_child_value (output, 6);
+        mode_ids = g_variant_get_fixed_array (modes, &nmode, sizeof (guint64));
+        for (n = 0; n < nmode; ++n)
+            if (xfce_randr_mode_index (randr, mode_ids[n]) < 0)
+                break;
+        g_variant_unref (modes);
+        g_variant_unref (output);
+
+        if (n < nmode)
         {
-            /* output disabled */
-            randr->mode[m] = None;
-            randr->rotation[m] = RR_Rotate_0;
-            randr->rotations[m] = xfce_randr_get_safe_rotations (randr, xdisplay, m);
+            g_free (randr->priv->catalogue);
+            randr->priv->catalogue = NULL;
+            g_hash_table_destroy (randr->priv->mode_index);
+            randr->priv->mode_index = NULL;
+            g_variant_unref (outputs);
+            return FALSE;
         }
+    }
 
-        /* fill in the name used by the UI */
-        randr->friendly_name[m] = xfce_randr_friendly_name (randr, m, output_ids[m]);
+    randr->noutput = g_variant_n_children (outputs);
 
-        /* Update display info, primary display may have changed. */
-        xfce_randr_save_output (randr, "Default", display_channel, m);
+    randr->priv->output_info = g_new0 (XfceRandrOutputInfo *, randr->noutput);
+    randr->priv->outputs = g_new0 (RROutput, randr->noutput);
+    randr->priv->timestamp = timestamp;
+    randr->priv->config_timestamp = config_timestamp;
+    xfce_randr_allocate (randr);
 
-        /* Replace spaces with underscore in name for xfconf compatibility */
-        g_strcanon(randr->priv->output_info[m]->name, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_<>", '_');
+    for (m = 0; m < randr->noutput; ++m)
+    {
+        g_variant_get_child (outputs, m, "(t&suut@at@atitqqiidd&s&s)", &id, &name,
+                             &mm_width, &mm_height, &crtc, &crtcs, &modes, &npreferred,
+                             &mode, &rotation, &rotations, &x, &y, &scalex, &scaley,
+                             &edid, &friendly_name);
+
+        randr->priv->outputs[m] = id;
+        randr->priv->output_info[m] = xfce_randr_output_info_new (name, crtcs, modes);
+        randr->priv->output_info[m]->crtc = crtc;
+        randr->priv->output_info[m]->mm_width = mm_width;
+        randr->priv->output_info[m]->mm_height = mm_height;
+        randr->priv->output_info[m]->npreferred = npreferred;
+        g_variant_unref (crtcs);
+        g_variant_unref (modes);
+
+        xfce_randr_list_supported_modes (randr, m);
+
+        randr->mode[m] = mode;
+        randr->rotation[m] = rotation;
+        randr->rotations[m] = rotations;
+        randr->position[m].x = x;
+        randr->position[m].y = y;
+        randr->scalex[m] = scalex;
+        randr->scaley[m] = scaley;
+        randr->priv->edid[m] = *edid != '\0' ? g_strdup (edid) : NULL;
+        randr->friendly_name[m] = g_strdup (friendly_name);
     }
-    /* populate mirrored details */
+
+    g_variant_unref (outputs);
+
+    /* not part of the resources timestamp, ask the server */
+    xfce_randr_update_primary (randr, xdisplay, root_window);
     xfce_randr_guess_relations (randr);
 
-    g_free (output_ids);
+    return TRUE;
 }
 
 
@@ -285,6 +619,7 @@ xfce_randr_new (GdkDisplay  *display,
     XfceRandr *randr;
     Display   *xdisplay;
     GdkWindow *root_window;
+    GVariant  *snapshot;
     gint       major, minor;
 
     g_return_val_if_fail (GDK_IS_DISPLAY (display), NULL);
@@ -321,10 +656,29 @@ xfce_randr_new (GdkDisplay  *display,
     /* get the root window */
     root_window = gdk_get_default_root_window ();
 
-    /* get the screen resource */
-    randr->priv->resources = XRRGetScreenResources (xdisplay, GDK_WINDOW_XID (root_window));
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    /* xfsettingsd already queried the outputs, use its copy as long
+     * as the server configuration did not change since */
+    if (randr->priv->has_1_3 && (snapshot = xfce_randr_get_snapshot ()) != NULL)
+    {
+        randr->priv->resources = XRRGetScreenResourcesCurrent (xdisplay, GDK_WINDOW_XID (root_window));
+        if (!xfce_randr_populate_from_snapshot (randr, xdisplay, root_window, snapshot))
+        {
+            g_debug ("The RandR snapshot is out of date");
+            XRRFreeScreenResources (randr->priv->resources);
+            randr->priv->resources = NULL;
+        }
+        g_variant_unref (snapshot);
+    }
+#endif
 
-    xfce_randr_populate (randr, xdisplay, root_window);
+    if (randr->priv->resources == NULL)
+    {
+        /* get the screen resource */
+        randr->priv->resources = XRRGetScreenResources (xdisplay, GDK_WINDOW_XID (root_window));
+
+        xfce_randr_populate (randr, xdisplay, root_window);
+    }
 
     return randr;
 }
@@ -340,9 +694,10 @@ xfce_randr_cleanup (XfceRandr *randr)
     for (n = 0; n < randr->noutput; ++n)
     {
         if (G_LIKELY (randr->priv->output_info[n]))
-            XRRFreeOutputInfo (randr->priv->output_info[n]);
+            xfce_randr_output_info_free (randr->priv->output_info[n]);
         if (G_LIKELY (randr->priv->modes[n]))
             g_free (randr->priv->modes[n]);
+        g_free (randr->priv->mode_sets[n]);
         if (G_LIKELY (randr->priv->edid[n]))
             g_free (randr->priv->edid[n]);
         if (G_LIKELY (randr->friendly_name[n]))
@@ -356,6 +711,9 @@ xfce_randr_cleanup (XfceRandr *randr)
     g_free (randr->friendly_name);
     g_free (randr->mode);
     g_free (randr->priv->modes);
+    g_free (randr->priv->mode_sets);
+    g_free (randr->priv->catalogue);
+    g_hash_table_destroy (randr->priv->mode_index);
     g_free (randr->priv->edid);
     g_free (randr->scalex);
     g_free (randr->scaley);
@@ -365,6 +723,7 @@ xfce_randr_cleanup (XfceRandr *randr)
     g_free (randr->position);
     g_free (randr->mirrored);
     g_free (randr->priv->output_info);
+    g_free (randr->priv->outputs);
 }
 
 
@@ -372,6 +731,23 @@ xfce_randr_cleanup (XfceRandr *randr)
 void
 xfce_randr_free (XfceRandr *randr)
 {
+    /* the replies of pending applies must not see the structure */
+    if (randr->priv->apply_cancellable != NULL)
+    {
+        g_cancellable_cancel (randr->priv->apply_cancellable);
+        g_object_unref (randr->priv->apply_cancellable);
+    }
+
+    /* write what is left */
+    xfce_randr_flush (randr);
+    if (randr->priv->channel != NULL)
+    {
+        g_signal_handler_disconnect (randr->priv->channel, randr->priv->channel_handler);
+        g_object_unref (randr->priv->channel);
+        g_hash_table_destroy (randr->priv->saved);
+        g_hash_table_destroy (randr->priv->pending);
+    }
+
     xfce_randr_cleanup (randr);
 
     /* free the structure */
@@ -412,6 +788,443 @@ xfce_randr_reload (XfceRandr *randr)
 
 
 
+static gint
+xfce_randr_find_output (XfceRandr *randr,
+                        RROutput   output)
+{
+    guint m;
+
+    for (m = 0; m < randr->noutput; ++m)
+        if (randr->priv->outputs[m] == output)
+            return m;
+
+    return -1;
+}
+
+
+
+static gboolean
+xfce_randr_has_modes (XfceRandr     *randr,
+                      XRROutputInfo *output_info)
+{
+    gint n;
+
+    /* modes the cached resources do not know need a full reload */
+    for (n = 0; n < output_info->nmode; ++n)
+        if (xfce_randr_mode_index (randr, output_info->modes[n]) < 0)
+            return FALSE;
+
+    return TRUE;
+}
+
+
+
+static void
+xfce_randr_update_relations (XfceRandr *randr)
+{
+    guint m;
+
+    for (m = 0; m < randr->noutput; ++m)
+        randr->mirrored[m] = FALSE;
+
+    xfce_randr_guess_relations (randr);
+}
+
+
+
+static XfceRandrChange
+xfce_randr_output_changed (XfceRandr                  *randr,
+                           Display                    *xdisplay,
+                           XRROutputChangeNotifyEvent *event)
+{
+    XRROutputInfo *output_info;
+    gint           m;
+
+    m = xfce_randr_find_output (randr, event->output);
+
+    /* the number of connected outputs changed */
+    if ((m < 0) != (event->connection != RR_Connected)
+        || event->config_timestamp != randr->priv->config_timestamp)
+        return XFCE_RANDR_CHANGE_RELOAD;
+
+    /* a disconnected output we do not track */
+    if (m < 0)
+        return XFCE_RANDR_CHANGE_NONE;
+
+    output_info = XRRGetOutputInfo (xdisplay, randr->priv->resources, event->output);
+    if (output_info == NULL
+        || output_info->connection != RR_Connected
+        || !xfce_randr_has_modes (randr, output_info))
+    {
+        if (output_info != NULL)
+            XRRFreeOutputInfo (output_info);
+        return XFCE_RANDR_CHANGE_RELOAD;
+    }
+
+    /* swap the slot's output info and modes */
+    xfce_randr_output_info_free (randr->priv->output_info[m]);
+    randr->priv->output_info[m] = xfce_randr_output_info_copy (output_info);
+    XRRFreeOutputInfo (output_info);
+    g_strcanon (randr->priv->output_info[m]->name, XFCE_RANDR_NAME_CHARS, '_');
+    xfce_randr_list_supported_modes (randr, m);
+
+    xfce_randr_update_crtc (randr, xdisplay, m);
+
+    /* the primary output is announced as an output change too */
+    xfce_randr_update_primary (randr, xdisplay, gdk_get_default_root_window ());
+
+    return XFCE_RANDR_CHANGE_OUTPUT;
+}
+
+
+
+static XfceRandrChange
+xfce_randr_crtc_changed (XfceRandr                *randr,
+                         Display                  *xdisplay,
+                         XRRCrtcChangeNotifyEvent *event)
+{
+    XfceRandrChange change = XFCE_RANDR_CHANGE_NONE;
+    guint           m;
+
+    for (m = 0; m < randr->noutput; ++m)
+    {
+        if (randr->priv->output_info[m]->crtc != event->crtc)
+            continue;
+
+        /* the output leaves the crtc, its output change follows */
+        if (event->mode == None)
+            randr->priv->output_info[m]->crtc = None;
+
+        xfce_randr_update_crtc (randr, xdisplay, m);
+        change = XFCE_RANDR_CHANGE_OUTPUT;
+    }
+
+    return change;
+}
+
+
+
+static XfceRandrChange
+xfce_randr_output_property_changed (XfceRandr                     *randr,
+                                    Display                       *xdisplay,
+                                    XRROutputPropertyNotifyEvent  *event)
+{
+    Atom edid_atom;
+    gint m;
+
+    m = xfce_randr_find_output (randr, event->output);
+    if (m < 0)
+        return XFCE_RANDR_CHANGE_NONE;
+
+    edid_atom = XInternAtom (xdisplay, RR_PROPERTY_RANDR_EDID, FALSE);
+    if (event->property != edid_atom)
+        return XFCE_RANDR_CHANGE_NONE;
+
+    /* only the name and checksum depend on the edid */
+    g_free (randr->priv->edid[m]);
+    randr->priv->edid[m] = NULL;
+    g_free (randr->friendly_name[m]);
+    randr->friendly_name[m] = xfce_randr_friendly_name (randr, m, event->output);
+
+    return XFCE_RANDR_CHANGE_OUTPUT;
+}
+
+
+
+XfceRandrChange
+xfce_randr_handle_event (XfceRandr *randr,
+                         XEvent    *event,
+                         gint       event_base)
+{
+    XRRScreenChangeNotifyEvent *screen_event;
+    XfceRandrChange             change = XFCE_RANDR_CHANGE_NONE;
+    Display                    *xdisplay;
+
+    g_return_val_if_fail (randr != NULL, XFCE_RANDR_CHANGE_NONE);
+    g_return_val_if_fail (event != NULL, XFCE_RANDR_CHANGE_NONE);
+
+    xdisplay = gdk_x11_display_get_xdisplay (randr->priv->display);
+
+    if (event->type - event_base == RRScreenChangeNotify)
+    {
+        /* the notify events before this one already updated the slots,
+         * only a configuration we have not seen needs the full walk */
+        screen_event = (XRRScreenChangeNotifyEvent *) event;
+        if (screen_event->timestamp != randr->priv->timestamp
+            || screen_event->config_timestamp != randr->priv->config_timestamp)
+            change = XFCE_RANDR_CHANGE_RELOAD;
+    }
+    else if (event->type - event_base == RRNotify)
+    {
+        switch (((XRRNotifyEvent *) event)->subtype)
+        {
+            case RRNotify_OutputChange:
+                change = xfce_randr_output_changed (randr, xdisplay, (XRROutputChangeNotifyEvent *) event);
+                if (change == XFCE_RANDR_CHANGE_OUTPUT)
+                    randr->priv->timestamp = ((XRROutputChangeNotifyEvent *) event)->timestamp;
+                break;
+
+            case RRNotify_CrtcChange:
+                change = xfce_randr_crtc_changed (randr, xdisplay, (XRRCrtcChangeNotifyEvent *) event);
+                if (change == XFCE_RANDR_CHANGE_OUTPUT)
+                    randr->priv->timestamp = ((XRRCrtcChangeNotifyEvent *) event)->timestamp;
+                break;
+
+            case RRNotify_OutputProperty:
+                change = xfce_randr_output_property_changed (randr, xdisplay, (XRROutputPropertyNotifyEvent *) event);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (change == XFCE_RANDR_CHANGE_RELOAD)
+        xfce_randr_reload (randr);
+    else if (change == XFCE_RANDR_CHANGE_OUTPUT)
+        xfce_randr_update_relations (randr);
+
+    return change;
+}
+
+
+
+static void
+xfce_randr_value_free (gpointer data)
+{
+    GValue *value = data;
+
+    g_value_unset (value);
+    g_free (value);
+}
+
+
+
+static GValue *
+xfce_randr_value_dup (const GValue *value)
+{
+    GValue *copy;
+
+    copy = g_new0 (GValue, 1);
+    g_value_init (copy, G_VALUE_TYPE (value));
+    g_value_copy (value, copy);
+
+    return copy;
+}
+
+
+
+static gboolean
+xfce_randr_value_equal (const GValue *a,
+                        const GValue *b)
+{
+    if (a == NULL || b == NULL || G_VALUE_TYPE (a) != G_VALUE_TYPE (b))
+        return FALSE;
+
+    switch (G_VALUE_TYPE (a))
+    {
+        case G_TYPE_STRING:
+            return g_strcmp0 (g_value_get_string (a), g_value_get_string (b)) == 0;
+        case G_TYPE_BOOLEAN:
+            return g_value_get_boolean (a) == g_value_get_boolean (b);
+        case G_TYPE_INT:
+            return g_value_get_int (a) == g_value_get_int (b);
+        case G_TYPE_DOUBLE:
+            return g_value_get_double (a) == g_value_get_double (b);
+        default:
+            return FALSE;
+    }
+}
+
+
+
+static void
+xfce_randr_channel_property_changed (XfconfChannel *channel,
+                                     const gchar   *property,
+                                     const GValue  *value,
+                                     XfceRandr     *randr)
+{
+    /* keep the snapshot in sync with changes from elsewhere */
+    if (value == NULL || G_VALUE_TYPE (value) == G_TYPE_INVALID)
+        g_hash_table_remove (randr->priv->saved, property);
+    else
+        g_hash_table_replace (randr->priv->saved, g_strdup (property),
+                              xfce_randr_value_dup (value));
+}
+
+
+
+static gboolean
+xfce_randr_flush_idle (gpointer data)
+{
+    XfceRandr *randr = data;
+
+    randr->priv->flush_id = 0;
+    xfce_randr_flush (randr);
+
+    return FALSE;
+}
+
+
+
+static void
+xfce_randr_queue (XfceRandr     *randr,
+                  XfconfChannel *channel,
+                  const gchar   *property,
+                  const GValue  *value)
+{
+    const GValue *current;
+    GHashTable   *properties;
+
+    if (randr->priv->channel != channel)
+    {
+        /* another channel, start over from what it contains */
+        xfce_randr_flush (randr);
+        if (randr->priv->channel != NULL)
+        {
+            g_signal_handler_disconnect (randr->priv->channel, randr->priv->channel_handler);
+            g_object_unref (randr->priv->channel);
+            g_hash_table_destroy (randr->priv->saved);
+            g_hash_table_destroy (randr->priv->pending);
+        }
+
+        randr->priv->channel = g_object_ref (channel);
+        randr->priv->pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                      g_free, xfce_randr_value_free);
+        randr->priv->saved = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    g_free, xfce_randr_value_free);
+
+        properties = xfconf_channel_get_properties (channel, NULL);
+        if (properties != NULL)
+        {
+            GHashTableIter  iter;
+            gpointer        key, val;
+
+            g_hash_table_iter_init (&iter, properties);
+            while (g_hash_table_iter_next (&iter, &key, &val))
+                g_hash_table_insert (randr->priv->saved, g_strdup (key),
+                                     xfce_randr_value_dup (val));
+            g_hash_table_destroy (properties);
+        }
+
+        randr->priv->channel_handler =
+            g_signal_connect (G_OBJECT (channel), "property-changed",
+                              G_CALLBACK (xfce_randr_channel_property_changed), randr);
+    }
+
+    current = g_hash_table_lookup (randr->priv->pending, property);
+    if (current == NULL)
+        current = g_hash_table_lookup (randr->priv->saved, property);
+
+    /* nothing new */
+    if (xfce_randr_value_equal (current, value))
+        return;
+
+    if (xfce_randr_value_equal (g_hash_table_lookup (randr->priv->saved, property), value))
+        g_hash_table_remove (randr->priv->pending, property);
+    else
+        g_hash_table_replace (randr->priv->pending, g_strdup (property),
+                              xfce_randr_value_dup (value));
+
+    if (randr->priv->flush_id == 0)
+        randr->priv->flush_id = g_idle_add (xfce_randr_flush_idle, randr);
+}
+
+
+
+static void
+xfce_randr_queue_string (XfceRandr     *randr,
+                         XfconfChannel *channel,
+                         const gchar   *property,
+                         const gchar   *str)
+{
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, G_TYPE_STRING);
+    g_value_set_static_string (&value, str);
+    xfce_randr_queue (randr, channel, property, &value);
+    g_value_unset (&value);
+}
+
+
+
+static void
+xfce_randr_queue_bool (XfceRandr     *randr,
+                       XfconfChannel *channel,
+                       const gchar   *property,
+                       gboolean       b)
+{
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, G_TYPE_BOOLEAN);
+    g_value_set_boolean (&value, b);
+    xfce_randr_queue (randr, channel, property, &value);
+    g_value_unset (&value);
+}
+
+
+
+static void
+xfce_randr_queue_int (XfceRandr     *randr,
+                      XfconfChannel *channel,
+                      const gchar   *property,
+                      gint           i)
+{
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, G_TYPE_INT);
+    g_value_set_int (&value, i);
+    xfce_randr_queue (randr, channel, property, &value);
+    g_value_unset (&value);
+}
+
+
+
+static void
+xfce_randr_queue_double (XfceRandr     *randr,
+                         XfconfChannel *channel,
+                         const gchar   *property,
+                         gdouble        d)
+{
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, G_TYPE_DOUBLE);
+    g_value_set_double (&value, d);
+    xfce_randr_queue (randr, channel, property, &value);
+    g_value_unset (&value);
+}
+
+
+
+void
+xfce_randr_flush (XfceRandr *randr)
+{
+    GHashTableIter  iter;
+    gpointer        key, value;
+
+    g_return_if_fail (randr != NULL);
+
+    if (randr->priv->flush_id != 0)
+    {
+        g_source_remove (randr->priv->flush_id);
+        randr->priv->flush_id = 0;
+    }
+
+    if (randr->priv->pending == NULL || g_hash_table_size (randr->priv->pending) == 0)
+        return;
+
+    /* the changed keys only, in one go */
+    g_hash_table_iter_init (&iter, randr->priv->pending);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        xfconf_channel_set_property (randr->priv->channel, key, value);
+        g_hash_table_iter_steal (&iter);
+        g_hash_table_replace (randr->priv->saved, key, value);
+    }
+}
+
+
+
 void
 xfce_randr_save_output (XfceRandr     *randr,
                         const gchar   *scheme,
@@ -430,7 +1243,7 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* save the device name */
     g_snprintf (property, sizeof (property), "/%s/%s", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_string (channel, property, randr->friendly_name[output]);
+    xfce_randr_queue_string (randr, channel, property, randr->friendly_name[output]);
 
     /* find the resolution and refresh rate */
     mode = xfce_randr_find_mode_by_id (randr, output, randr->mode[output]);
@@ -438,11 +1251,11 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* if no resolution was found, mark it as inactive and stop */
     g_snprintf (property, sizeof (property), "/%s/%s/Active", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_bool (channel, property, mode != NULL);
+    xfce_randr_queue_bool (randr, channel, property, mode != NULL);
 
     g_snprintf (property, sizeof (property), "/%s/%s/EDID", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_string (channel, property, randr->priv->edid[output]);
+    xfce_randr_queue_string (randr, channel, property, randr->priv->edid[output]);
 
     if (mode == NULL)
         return;
@@ -451,13 +1264,13 @@ xfce_randr_save_output (XfceRandr     *randr,
     str_value = g_strdup_printf ("%dx%d", mode->width, mode->height);
     g_snprintf (property, sizeof (property), "/%s/%s/Resolution", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_string (channel, property, str_value);
+    xfce_randr_queue_string (randr, channel, property, str_value);
     g_free (str_value);
 
     /* save the refresh rate */
     g_snprintf (property, sizeof (property), "/%s/%s/RefreshRate", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_double (channel, property, mode->rate);
+    xfce_randr_queue_double (randr, channel, property, mode->rate);
 
     /* convert the rotation into degrees */
     switch (randr->rotation[output] & XFCE_RANDR_ROTATIONS_MASK)
@@ -471,7 +1284,7 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* save the rotation in degrees */
     g_snprintf (property, sizeof (property), "/%s/%s/Rotation", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_int (channel, property, degrees);
+    xfce_randr_queue_int (randr, channel, property, degrees);
 
     /* convert the reflection into a string */
     switch (randr->rotation[output] & XFCE_RANDR_REFLECTIONS_MASK)
@@ -485,45 +1298,169 @@ xfce_randr_save_output (XfceRandr     *randr,
     /* save the reflection string */
     g_snprintf (property, sizeof (property), "/%s/%s/Reflection", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_string (channel, property, str_value);
+    xfce_randr_queue_string (randr, channel, property, str_value);
 
 #ifdef HAS_RANDR_ONE_POINT_THREE
     /* is it the primary output? */
     g_snprintf (property, sizeof (property), "/%s/%s/Primary", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_bool (channel, property,
+    xfce_randr_queue_bool (randr, channel, property,
                              randr->status[output] == XFCE_OUTPUT_STATUS_PRIMARY);
 
     /* save the scale */
     g_snprintf (property, sizeof (property), "/%s/%s/Scale/X", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_double (channel, property, roundf (randr->scalex[output] * 10) / 10);
+    xfce_randr_queue_double (randr, channel, property, roundf (randr->scalex[output] * 10) / 10);
     g_snprintf (property, sizeof (property), "/%s/%s/Scale/Y", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_double (channel, property, roundf (randr->scaley[output] * 10) / 10);
+    xfce_randr_queue_double (randr, channel, property, roundf (randr->scaley[output] * 10) / 10);
 #endif
 
     /* save the position */
     g_snprintf (property, sizeof (property), "/%s/%s/Position/X", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_int (channel, property, MAX (randr->position[output].x, 0));
+    xfce_randr_queue_int (randr, channel, property, MAX (randr->position[output].x, 0));
     g_snprintf (property, sizeof (property), "/%s/%s/Position/Y", scheme,
                 randr->priv->output_info[output]->name);
-    xfconf_channel_set_int (channel, property, MAX (randr->position[output].y, 0));
+    xfce_randr_queue_int (randr, channel, property, MAX (randr->position[output].y, 0));
+}
+
+
+
+typedef struct
+{
+    XfceRandr          *randr;
+    gchar              *scheme;
+    XfconfChannel      *channel;
+    XfceRandrApplyFunc  func;
+    gpointer            user_data;
+}
+XfceRandrApplyData;
+
+
+
+static void
+xfce_randr_apply_finish (XfceRandrApplyData *data,
+                         gboolean            fallback)
+{
+    /* tell the helper to apply this theme */
+    if (fallback)
+        xfconf_channel_set_string (data->channel, "/Schemes/Apply", data->scheme);
+
+    if (data->func != NULL)
+        (*data->func) (data->randr, data->user_data);
+
+    g_object_unref (data->channel);
+    g_free (data->scheme);
+    g_slice_free (XfceRandrApplyData, data);
+}
+
+
+
+static void
+xfce_randr_apply_done (GObject      *source_object,
+                       GAsyncResult *res,
+                       gpointer      user_data)
+{
+    XfceRandrApplyData *data = user_data;
+    GVariant           *result;
+    GError             *error = NULL;
+    const gchar        *status;
+    gint64              duration;
+    guint               n_changed;
+
+    result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+    if (result != NULL)
+    {
+        g_variant_get (result, "(&sxu)", &status, &duration, &n_changed);
+        if (g_strcmp0 (status, "ok") != 0)
+            g_warning ("Failed to apply the display scheme %s: %s", data->scheme, status);
+        g_variant_unref (result);
+
+        xfce_randr_apply_finish (data, FALSE);
+        return;
+    }
+
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        /* the randr structure is gone */
+        data->func = NULL;
+        xfce_randr_apply_finish (data, FALSE);
+    }
+    else if (!g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN)
+             && !g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER)
+             && !g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)
+             && !g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED))
+    {
+        /* e.g. a timeout, the daemon may still be applying it and
+         * the channel would make it apply the scheme twice */
+        g_warning ("Failed to apply the display scheme %s: %s", data->scheme, error->message);
+        xfce_randr_apply_finish (data, FALSE);
+    }
+    else
+    {
+        /* an older daemon: use the channel from now on; not running
+         * or without RandR: use it this time */
+        g_debug ("ApplyScheme is not available: %s", error->message);
+        if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD))
+            data->randr->priv->no_apply_method = TRUE;
+        xfce_randr_apply_finish (data, TRUE);
+    }
+
+    g_error_free (error);
 }
 
 
 
 void
-xfce_randr_apply (XfceRandr     *randr,
-                  const gchar   *scheme,
-                  XfconfChannel *channel)
+xfce_randr_apply (XfceRandr          *randr,
+                  const gchar        *scheme,
+                  XfconfChannel      *channel,
+                  XfceRandrApplyFunc  func,
+                  gpointer            user_data)
 {
+    XfceRandrApplyData *data;
+    GDBusConnection    *connection = NULL;
+
     g_return_if_fail (randr != NULL && scheme != NULL);
     g_return_if_fail (XFCONF_IS_CHANNEL (channel));
 
-    /* tell the helper to apply this theme */
-    xfconf_channel_set_string (channel, "/Schemes/Apply", scheme);
+    /* the helper reads the scheme from xfconfd */
+    xfce_randr_flush (randr);
+
+    data = g_slice_new0 (XfceRandrApplyData);
+    data->randr = randr;
+    data->scheme = g_strdup (scheme);
+    data->channel = g_object_ref (channel);
+    data->func = func;
+    data->user_data = user_data;
+
+    if (!randr->priv->no_apply_method)
+        connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+
+    if (connection == NULL)
+    {
+        xfce_randr_apply_finish (data, TRUE);
+        return;
+    }
+
+    if (randr->priv->apply_cancellable == NULL)
+        randr->priv->apply_cancellable = g_cancellable_new ();
+
+    /* ask the helper directly, it replies once the layout is applied;
+     * the dialog keeps running in the meantime */
+    g_dbus_connection_call (connection,
+                            "org.xfce.SettingsDaemon",
+                            "/org/xfce/SettingsDaemon",
+                            "org.xfce.SettingsDaemon",
+                            "ApplyScheme",
+                            g_variant_new ("(s)", scheme),
+                            G_VARIANT_TYPE ("(sxu)"),
+                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                            10000, randr->priv->apply_cancellable,
+                            xfce_randr_apply_done, data);
+
+    g_object_unref (connection);
 }
 
 
@@ -540,7 +1477,8 @@ xfce_randr_load (XfceRandr     *randr,
 
 guint8 *
 xfce_randr_read_edid_data (Display  *xdisplay,
-                           RROutput  output)
+                           RROutput  output,
+                           gsize    *length)
 {
     unsigned char *prop;
     int            actual_format;
@@ -549,17 +1487,26 @@ xfce_randr_read_edid_data (Display  *xdisplay,
     Atom           edid_atom;
     guint8        *result = NULL;
 
+    g_return_val_if_fail (length != NULL, NULL);
+
+    *length = 0;
     edid_atom = gdk_x11_get_xatom_by_name (RR_PROPERTY_RANDR_EDID);
 
     if (edid_atom != None)
     {
-        if (XRRGetOutputProperty (xdisplay, output, edid_atom, 0, 100,
+        /* the base block and all its extensions, like xfsettingsd */
+        if (XRRGetOutputProperty (xdisplay, output, edid_atom, 0, 256 * 128 / 4,
                                   False, False, AnyPropertyType,
                                   &actual_type, &actual_format, &nitems,
                                   &bytes_after, &prop) == Success)
         {
-            if (actual_type == XA_INTEGER && actual_format == 8)
+            if (actual_type == XA_INTEGER && actual_format == 8 && nitems >= 128)
+            {
+                /* drop trailing garbage some drivers leave after the last block */
+                nitems = MIN (nitems, (prop[0x7e] + 1) * 128UL);
                 result = g_memdup (prop, nitems);
+                *length = nitems;
+            }
         }
 
         XFree (prop);
@@ -573,51 +1520,32 @@ xfce_randr_read_edid_data (Display  *xdisplay,
 static gchar *
 xfce_randr_friendly_name (XfceRandr *randr,
                           guint      output,
-                          guint      output_rr_id)
+                          RROutput   output_rr_id)
 {
     Display        *xdisplay;
-    MonitorInfo    *info = NULL;
+    MonitorInfo     info;
+    EdidExtensions  ext;
+    gboolean        has_info = FALSE;
     guint8         *edid_data;
+    gsize           edid_length;
     gchar          *friendly_name = NULL;
     const gchar *name = randr->priv->output_info[output]->name;
 
     /* get the vendor & size */
     xdisplay = gdk_x11_display_get_xdisplay (randr->priv->display);
-    edid_data = xfce_randr_read_edid_data (xdisplay, randr->priv->resources->outputs[output_rr_id]);
+    edid_data = xfce_randr_read_edid_data (xdisplay, output_rr_id, &edid_length);
 
     if (edid_data) {
-        info = decode_edid (edid_data);
+        /* with the extensions, for the same names as xfsettingsd */
+        has_info = decode_edid_into (edid_data, edid_length, &info, &ext);
         randr->priv->edid[output] = g_compute_checksum_for_data (G_CHECKSUM_SHA1 , edid_data, 128);
     }
 
-    /* special case, a laptop */
-    if (g_str_has_prefix (name, "LVDS")
-        || g_str_has_prefix (name, "eDP")
-        || strcmp (name, "PANEL") == 0)
-        friendly_name = g_strdup (_("Laptop"));
-    else if (info)
-        friendly_name = make_display_name (info, output);
+    friendly_name = make_output_name (name, has_info ? &info : NULL, output);
 
-    g_free (info);
     g_free (edid_data);
 
-    if (friendly_name)
-        return friendly_name;
-
-    /* last attempt to return a better name */
-    if (g_str_has_prefix (name, "VGA")
-             || g_str_has_prefix (name, "Analog"))
-        return g_strdup (_("Monitor"));
-    else if (g_str_has_prefix (name, "TV")
-             || strcmp (name, "S-video") == 0)
-        return g_strdup (_("Television"));
-    else if (g_str_has_prefix (name, "TMDS")
-             || g_str_has_prefix (name, "DVI")
-             || g_str_has_prefix (name, "Digital"))
-        return g_strdup (_("Digital display"));
-
-    /* everything failed, fallback */
-    return g_strdup (name);
+    return friendly_name;
 }
 
 
@@ -627,7 +1555,7 @@ xfce_randr_find_mode_by_id (XfceRandr *randr,
                             guint      output,
                             RRMode     id)
 {
-    gint n;
+    gint idx;
 
     g_return_val_if_fail (randr != NULL, NULL);
     g_return_val_if_fail (output < randr->noutput, NULL);
@@ -635,13 +1563,11 @@ xfce_randr_find_mode_by_id (XfceRandr *randr,
     if (id == None)
         return NULL;
 
-    for (n = 0; n < randr->priv->output_info[output]->nmode; ++n)
-    {
-        if (randr->priv->modes[output][n].id == id)
-            return &randr->priv->modes[output][n];
-    }
+    idx = xfce_randr_mode_index (randr, id);
+    if (idx < 0 || (randr->priv->mode_sets[output][idx / 32] & (1u << (idx % 32))) == 0)
+        return NULL;
 
-    return NULL;
+    return &randr->priv->catalogue[idx];
 }
 
 
@@ -691,36 +1617,27 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 RRMode
 xfce_randr_clonable_mode (XfceRandr *randr)
 {
-    gint  l, n, candidate, found;
-    guint m;
+    guint32 word;
+    guint   m, w;
+    gint    bit;
 
     g_return_val_if_fail (randr != NULL, None);
 
-    /* walk all available modes */
-    for (n = 0; n < randr->priv->resources->nmode; ++n)
+    /* the first mode, in resources order, all outputs support */
+    for (w = 0; w < randr->priv->mode_words; ++w)
     {
-        candidate = TRUE;
-        /* walk all connected outputs */
-        for (m = 0; m < randr->noutput; ++m)
-        {
-            found = FALSE;
-            /* walk supported modes from this output */
-            for (l = 0; l < randr->priv->output_info[m]->nmode; ++l)
-            {
-                if (randr->priv->resources->modes[n].id == randr->priv->output_info[m]->modes[l])
-                {
-                    found = TRUE;
-                    break;
-                }
-            }
+        word = ~0u;
+        if (w == randr->priv->mode_words - 1 && randr->priv->resources->nmode % 32 != 0)
+            word = (1u << (randr->priv->resources->nmode % 32)) - 1;
 
-            /* if it is not present in one output, forget it */
-            candidate &= found;
-        }
+        for (m = 0; m < randr->noutput && word != 0; ++m)
+            word &= randr->priv->mode_sets[m][w];
 
-        /* common to all outputs, can be used for clone mode */
-        if (candidate)
-            return randr->priv->resources->modes[n].id;
+        if (word != 0)
+        {
+            bit = g_bit_nth_lsf (word, -1);
+            return randr->priv->catalogue[w * 32 + bit].id;
+        }
     }
 
     return None;
@@ -34,19 +34,38 @@
 #undef HAS_RANDR_ONE_POINT_THREE
 #endif
 
+/* the outputs xfsettingsd publishes with GetRandrSnapshot, the reply is
+ * (uv): the version and a variant of the matching type; the screen
+ * resources timestamps and per connected output its id, name, mm size,
+ * crtc, possible crtcs, modes, number of preferred modes, crtc mode,
+ * rotation, rotations, position, scale, EDID checksum and UI name */
+#define XFCE_RANDR_SNAPSHOT_VERSION           1
+#define XFCE_RANDR_SNAPSHOT_TYPE              "(tta(tsuutatatitqqiiddss))"
+
 typedef struct _XfceRandr          XfceRandr;
 typedef struct _XfceRandrPrivate   XfceRandrPrivate;
 typedef struct _XfceRRMode         XfceRRMode;
 typedef struct _XfceOutputInfo     XfceOutputInfo;
 typedef enum   _XfceOutputStatus   XfceOutputStatus;
+typedef enum   _XfceRandrChange    XfceRandrChange;
 typedef struct _XfceOutputPosition XfceOutputPosition;
 
+typedef void (*XfceRandrApplyFunc) (XfceRandr *randr,
+                                    gpointer   user_data);
+
 enum _XfceOutputStatus
 {
     XFCE_OUTPUT_STATUS_PRIMARY,
     XFCE_OUTPUT_STATUS_SECONDARY
 };
 
+enum _XfceRandrChange
+{
+    XFCE_RANDR_CHANGE_NONE,   /* nothing the structure holds changed */
+    XFCE_RANDR_CHANGE_OUTPUT, /* slots were updated in place */
+    XFCE_RANDR_CHANGE_RELOAD  /* outputs were reloaded, indices may differ */
+};
+
 struct _XfceRRMode
 {
     RRMode  id;
@@ -119,21 +138,38 @@ void              xfce_randr_free            (XfceRandr        *randr);
 
 void              xfce_randr_reload          (XfceRandr        *randr);
 
+/* updates the affected outputs for a randr event, falls back to a
+ * reload for a configuration the notify events did not announce */
+XfceRandrChange   xfce_randr_handle_event    (XfceRandr        *randr,
+                                              XEvent           *event,
+                                              gint              event_base);
+
 void              xfce_randr_save_output     (XfceRandr        *randr,
                                               const gchar      *scheme,
                                               XfconfChannel    *channel,
                                               guint             output);
 
-void              xfce_randr_apply           (XfceRandr        *randr,
-                                              const gchar      *scheme,
-                                              XfconfChannel    *channel);
+/* writes the properties xfce_randr_save_output changed since the
+ * last flush, this also happens when idle and before applying */
+void              xfce_randr_flush           (XfceRandr        *randr);
+
+/* applies the scheme through xfsettingsd without blocking, func is
+ * called once it is done or the fallback through the channel was
+ * written; it is not called if the structure is freed before */
+void              xfce_randr_apply           (XfceRandr          *randr,
+                                              const gchar        *scheme,
+                                              XfconfChannel      *channel,
+                                              XfceRandrApplyFunc  func,
+                                              gpointer            user_data);
 
 void              xfce_randr_load            (XfceRandr        *randr,
                                               const gchar      *scheme,
                                               XfconfChannel    *channel);
 
+/* the EDID and its extension blocks, length is set to their size */
 guint8 *          xfce_randr_read_edid_data  (Display          *xdisplay,
-                                              RROutput          output);
+                                              RROutput          output,
+                                              gsize            *length);
 
 const XfceRRMode *xfce_randr_find_mode_by_id (XfceRandr        *randr,
                                               guint             output,
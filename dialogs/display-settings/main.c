@@ -220,6 +220,10 @@ static gboolean display_setting_primary_toggled              (GtkWidget       *w
                                                               gboolean         primary,
                                                               GtkBuilder      *builder);
 
+static gboolean display_setting_output_toggled               (GtkSwitch       *widget,
+                                                              gboolean         output_on,
+                                                              GtkBuilder      *builder);
+
 static void display_setting_mirror_displays_populate         (GtkBuilder *builder);
 
 static void display_settings_profile_apply                   (GtkWidget       *widget,
@@ -402,7 +406,7 @@ display_setting_ask_fallback (GtkBuilder *builder)
     else
     {
         /* Recover to Fallback (will as well overwrite default xfconf settings) */
-        xfce_randr_apply (xfce_randr, "Fallback", display_channel);
+        xfce_randr_apply (xfce_randr, "Fallback", display_channel, NULL, NULL);
         foo_scroll_area_invalidate (FOO_SCROLL_AREA (randr_gui_area));
         return FALSE;
     }
@@ -1393,7 +1397,7 @@ display_setting_primary_toggled (GtkWidget *widget,
     }
 
     /* Apply the changes */
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
+    xfce_randr_apply (xfce_randr, "Default", display_channel, NULL, NULL);
     gtk_switch_set_state (GTK_SWITCH (widget), primary);
 
     return TRUE;
@@ -1440,6 +1444,27 @@ display_setting_primary_populate (GtkBuilder *builder)
                                        builder);
 }
 
+static void
+display_setting_output_applied (XfceRandr *randr,
+                                gpointer   user_data)
+{
+    GtkBuilder *builder = user_data;
+    GObject    *check;
+    gboolean    output_on;
+
+    check = gtk_builder_get_object (builder, "output-on");
+    output_on = gtk_switch_get_active (GTK_SWITCH (check));
+
+    /* back to the old state if the change was reverted */
+    if (!display_setting_ask_fallback (builder))
+        output_on = !output_on;
+
+    g_signal_handlers_block_by_func (check, display_setting_output_toggled, builder);
+    gtk_switch_set_active (GTK_SWITCH (check), output_on);
+    gtk_switch_set_state (GTK_SWITCH (check), output_on);
+    g_signal_handlers_unblock_by_func (check, display_setting_output_toggled, builder);
+}
+
 static gboolean
 display_setting_output_toggled (GtkSwitch       *widget,
                                 gboolean         output_on,
@@ -1467,13 +1492,14 @@ display_setting_output_toggled (GtkSwitch       *widget,
         xfce_randr->mode[active_output] = None;
     }
 
-    /* Apply the changes */
+    /* Apply the changes, the state follows once it is confirmed */
     xfce_randr_save_output (xfce_randr, "Default", display_channel, active_output);
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
+    xfce_randr_apply (xfce_randr, "Default", display_channel,
+                      display_setting_output_applied, builder);
 
     foo_scroll_area_invalidate (FOO_SCROLL_AREA (randr_gui_area));
 
-    return display_setting_ask_fallback (builder);
+    return TRUE;
 }
 
 static void
@@ -1911,6 +1937,13 @@ on_identify_displays_toggled (GtkWidget *widget,
     return TRUE;
 }
 
+static void
+display_setting_applied (XfceRandr *randr,
+                         gpointer   user_data)
+{
+    display_setting_ask_fallback (GTK_BUILDER (user_data));
+}
+
 static void
 display_setting_apply (GtkWidget *widget, GtkBuilder *builder)
 {
@@ -1918,9 +1951,8 @@ display_setting_apply (GtkWidget *widget, GtkBuilder *builder)
 
     for (i=0; i < xfce_randr->noutput; i++)
         xfce_randr_save_output (xfce_randr, "Default", display_channel, i);
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
-
-    display_setting_ask_fallback (builder);
+    xfce_randr_apply (xfce_randr, "Default", display_channel,
+                      display_setting_applied, builder);
 
     gtk_widget_set_sensitive(widget, FALSE);
 }
@@ -1949,7 +1981,7 @@ display_settings_minimal_profile_apply (GtkToggleButton *widget, GtkBuilder *bui
     gchar  *profile_hash;
 
     profile_hash = (gchar *) g_object_get_data (G_OBJECT (widget), "profile");
-    xfce_randr_apply (xfce_randr, profile_hash, display_channel);
+    xfce_randr_apply (xfce_randr, profile_hash, display_channel, NULL, NULL);
 }
 
 static void
@@ -1975,6 +2007,7 @@ display_settings_profile_save (GtkWidget *widget, GtkBuilder *builder)
 
         for (i = 0; i < xfce_randr->noutput; i++)
             xfce_randr_save_output (xfce_randr, profile_hash, display_channel, i);
+        xfce_randr_flush (xfce_randr);
 
         /* save the human-readable name of the profile as string value */
         xfconf_channel_set_string (display_channel, property, profile_name);
@@ -2041,6 +2074,7 @@ display_settings_profile_create_cb (GtkWidget *widget, GtkBuilder *builder)
         property = g_strdup_printf ("/%s", profile_hash);
         for (i = 0; i < xfce_randr->noutput; i++)
             xfce_randr_save_output (xfce_randr, profile_hash, display_channel, i);
+        xfce_randr_flush (xfce_randr);
 
         /* save the human-readable name of the profile as string value */
         xfconf_channel_set_string (display_channel, property, profile_name);
@@ -2074,6 +2108,32 @@ display_settings_profile_create (GtkWidget *widget, GtkBuilder *builder)
     g_signal_connect (button, "clicked", G_CALLBACK (display_settings_profile_create_cb), builder);
 }
 
+typedef struct
+{
+    GtkBuilder *builder;
+    gchar      *old_profile_hash;
+}
+ProfileApply;
+
+static void
+display_settings_profile_applied (XfceRandr *randr,
+                                  gpointer   user_data)
+{
+    ProfileApply *apply = user_data;
+
+    if (!display_setting_timed_confirmation (apply->builder))
+    {
+        xfce_randr_apply (xfce_randr, apply->old_profile_hash, display_channel, NULL, NULL);
+        xfconf_channel_set_string (display_channel, "/ActiveProfile", apply->old_profile_hash);
+
+        foo_scroll_area_invalidate (FOO_SCROLL_AREA (randr_gui_area));
+    }
+    display_settings_profile_list_populate (apply->builder);
+
+    g_free (apply->old_profile_hash);
+    g_slice_free (ProfileApply, apply);
+}
+
 static void
 display_settings_profile_apply (GtkWidget *widget, GtkBuilder *builder)
 {
@@ -2087,23 +2147,19 @@ display_settings_profile_apply (GtkWidget *widget, GtkBuilder *builder)
 
     if (gtk_tree_selection_get_selected (selection, &model, &iter))
     {
-        gchar *profile_hash;
-        gchar *old_profile_hash;
+        gchar        *profile_hash;
+        ProfileApply *apply;
+
+        /* confirmed or reverted once the daemon applied it */
+        apply = g_slice_new0 (ProfileApply);
+        apply->builder = builder;
+        apply->old_profile_hash = xfconf_channel_get_string (display_channel, "/ActiveProfile", "Default");
 
-        old_profile_hash = xfconf_channel_get_string (display_channel, "/ActiveProfile", "Default");
         gtk_tree_model_get (model, &iter, COLUMN_HASH, &profile_hash, -1);
-        xfce_randr_apply (xfce_randr, profile_hash, display_channel);
+        xfce_randr_apply (xfce_randr, profile_hash, display_channel,
+                          display_settings_profile_applied, apply);
         xfconf_channel_set_string (display_channel, "/ActiveProfile", profile_hash);
 
-        if (!display_setting_timed_confirmation (builder))
-        {
-            xfce_randr_apply (xfce_randr, old_profile_hash, display_channel);
-            xfconf_channel_set_string (display_channel, "/ActiveProfile", old_profile_hash);
-
-            foo_scroll_area_invalidate (FOO_SCROLL_AREA (randr_gui_area));
-        }
-        display_settings_profile_list_populate (builder);
-
         g_free (profile_hash);
     }
 }
@@ -2427,7 +2483,7 @@ display_settings_minimal_only_display1_toggled (GtkToggleButton *button,
     /* Apply the changes */
     xfce_randr_save_output (xfce_randr, "Default", display_channel, 0);
     xfce_randr_save_output (xfce_randr, "Default", display_channel, 1);
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
+    xfce_randr_apply (xfce_randr, "Default", display_channel, NULL, NULL);
 
     gtk_widget_set_sensitive (GTK_WIDGET(buttons), TRUE);
 }
@@ -2457,7 +2513,7 @@ display_settings_minimal_only_display2_toggled (GtkToggleButton *button,
     /* Apply the changes */
     xfce_randr_save_output (xfce_randr, "Default", display_channel, 0);
     xfce_randr_save_output (xfce_randr, "Default", display_channel, 1);
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
+    xfce_randr_apply (xfce_randr, "Default", display_channel, NULL, NULL);
 
     gtk_widget_set_sensitive (GTK_WIDGET(buttons), TRUE);
 }
@@ -2500,7 +2556,7 @@ display_settings_minimal_mirror_displays_toggled (GtkToggleButton *button,
     }
 
     /* Apply all changes */
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
+    xfce_randr_apply (xfce_randr, "Default", display_channel, NULL, NULL);
 
     gtk_widget_set_sensitive (GTK_WIDGET(buttons), TRUE);
 }
@@ -2548,7 +2604,7 @@ display_settings_minimal_extend_right_toggled (GtkToggleButton *button,
     xfce_randr_save_output (xfce_randr, "Default", display_channel, 1);
 
     /* Apply all changes */
-    xfce_randr_apply (xfce_randr, "Default", display_channel);
+    xfce_randr_apply (xfce_randr, "Default", display_channel, NULL, NULL);
 
     gtk_widget_set_sensitive (GTK_WIDGET (buttons), TRUE);
 }
@@ -2558,28 +2614,33 @@ screen_on_event (GdkXEvent *xevent,
                  GdkEvent  *event,
                  gpointer   data)
 {
-    GtkBuilder *builder = data;
-    XEvent     *e = xevent;
-    gint        event_num;
+    GtkBuilder      *builder = data;
+    XEvent          *e = xevent;
+    XfceRandrChange  change;
+    guint            m;
 
     if (!e)
         return GDK_FILTER_CONTINUE;
 
-    event_num = e->type - randr_event_base;
+    change = xfce_randr_handle_event (xfce_randr, e, randr_event_base);
+    if (change == XFCE_RANDR_CHANGE_NONE)
+        return GDK_FILTER_CONTINUE;
 
-    if (event_num == RRScreenChangeNotify)
-    {
-        xfce_randr_reload (xfce_randr);
-        display_settings_combobox_populate (builder);
-        display_settings_profile_list_populate (builder);
+    /* primary display may have changed, only the changes are written */
+    for (m = 0; m < xfce_randr->noutput; m++)
+        xfce_randr_save_output (xfce_randr, "Default", display_channel, m);
 
-        /* recreate the identify display popups */
-        g_hash_table_destroy (display_popups);
-        g_hash_table_destroy (display_ratio);
-        display_setting_identity_popups_populate ();
-        display_settings_aspect_ratios_populate ();
-        set_display_popups_visible(show_popups);
-    }
+    /* only the X queries are incremental, modes, rotations and names
+     * can change in place so the widgets are always refreshed */
+    display_settings_combobox_populate (builder);
+    display_settings_profile_list_populate (builder);
+
+    /* recreate the identify display popups */
+    g_hash_table_destroy (display_popups);
+    g_hash_table_destroy (display_ratio);
+    display_setting_identity_popups_populate ();
+    display_settings_aspect_ratios_populate ();
+    set_display_popups_visible(show_popups);
 
     initialize_connected_outputs();
     foo_scroll_area_invalidate (FOO_SCROLL_AREA (randr_gui_area));
@@ -3895,7 +3956,10 @@ display_settings_show_main_dialog (GdkDisplay *display)
         /* Set up notifications */
         XRRSelectInput (gdk_x11_display_get_xdisplay (display),
                         GDK_WINDOW_XID (gdk_get_default_root_window ()),
-                        RRScreenChangeNotifyMask);
+                        RRScreenChangeNotifyMask
+                        | RRCrtcChangeNotifyMask
+                        | RROutputChangeNotifyMask
+                        | RROutputPropertyNotifyMask);
         gdk_x11_register_standard_event_type (display,
                                               randr_event_base,
                                               RRNotify + 1);
@@ -4356,9 +4420,13 @@ main (gint argc, gchar **argv)
             goto cleanup;
         }
 
-        /* Store a Fallback of the current settings */
+        /* Update display info, primary display may have changed, and
+         * store a Fallback of the current settings */
         for (i = 0; i < xfce_randr->noutput; i++)
+        {
+            xfce_randr_save_output (xfce_randr, "Default", display_channel, i);
             xfce_randr_save_output (xfce_randr, "Fallback", display_channel, i);
+        }
 
         if (xfce_randr->noutput <= 1 || !minimal)
             display_settings_show_main_dialog (display);
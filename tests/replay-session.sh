@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+#  Copyright (c) 2020 The Xfce development team
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Library General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License along
+#  with this program; if not, write to the Free Software Foundation, Inc.,
+#  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+#
+# Replays the recordings in replay/ with the xfsettingsd of the build
+# tree, on its own Xvfb server, session bus and xfconf directories.
+# The counts of each report must match the .expected file next to the
+# recording, the timings are printed for comparison.
+#
+
+srcdir=${srcdir:-.}
+top_builddir=${top_builddir:-..}
+xfsettingsd=$top_builddir/xfsettingsd/xfsettingsd
+
+# automake's exit code for a skipped test
+for prog in Xvfb dbus-run-session; do
+    if ! command -v $prog >/dev/null 2>&1; then
+        echo "$prog not found, skipping"
+        exit 77
+    fi
+done
+
+tmpdir=$(mktemp -d "${TMPDIR:-/tmp}/xfsettingsd-replay.XXXXXX") || exit 1
+xvfb_pid=
+
+cleanup ()
+{
+    test -n "$xvfb_pid" && kill $xvfb_pid 2>/dev/null
+    rm -rf "$tmpdir"
+}
+trap cleanup EXIT
+
+Xvfb -displayfd 3 -screen 0 1280x1024x24 -nolisten tcp 3>"$tmpdir/display" 2>/dev/null &
+xvfb_pid=$!
+
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    test -s "$tmpdir/display" && break
+    sleep 1
+done
+if ! test -s "$tmpdir/display"; then
+    echo "Xvfb did not start"
+    exit 99
+fi
+
+# never touch the settings of the user running the tests
+DISPLAY=:$(cat "$tmpdir/display")
+XDG_CONFIG_HOME=$tmpdir/config
+XDG_CACHE_HOME=$tmpdir/cache
+XDG_DATA_HOME=$tmpdir/data
+XFSETTINGSD_MODULE_PATH=$top_builddir/xfsettingsd/.libs
+XFSETTINGSD_NO_CLIPBOARD=1
+XFSETTINGSD_REPLAY_PRIVATE_BUS=1
+export DISPLAY XDG_CONFIG_HOME XDG_CACHE_HOME XDG_DATA_HOME
+export XFSETTINGSD_MODULE_PATH XFSETTINGSD_NO_CLIPBOARD XFSETTINGSD_REPLAY_PRIVATE_BUS
+
+status=0
+
+for recording in "$srcdir"/replay/*.rec; do
+    name=$(basename "$recording" .rec)
+    expected=$srcdir/replay/$name.expected
+
+    dbus-run-session -- "$xfsettingsd" --disable-wm-check --replay "$recording" \
+        >"$tmpdir/$name.out" 2>"$tmpdir/$name.err"
+
+    cat "$tmpdir/$name.out"
+
+    if ! head -n 1 "$tmpdir/$name.out" | cmp -s - "$expected"; then
+        echo "FAIL: $name: expected \"$(cat "$expected")\""
+        cat "$tmpdir/$name.err"
+        status=1
+    elif ! sed -n 2p "$tmpdir/$name.out" | grep -q "^$name.rec: wall [0-9.]* ms, main loop busy [0-9.]* ms, "; then
+        echo "FAIL: $name: no timing report"
+        cat "$tmpdir/$name.err"
+        status=1
+    fi
+done
+
+exit $status
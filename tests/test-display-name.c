@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The vendor names of the display names: a name from pnp.ids wins over
+ * the built-in one, codes that are not three capital letters are shown
+ * as they are. Built with PNP_IDS pointing to pnp/pnp.ids.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include "common/edid.h"
+
+static const struct
+{
+    const gchar *code;
+    const gchar *name;
+}
+vendors[] =
+{
+    /* in both lists, pnp.ids first */
+    { "DEL", "Dell Inc." },
+    /* only built-in */
+    { "SAM", "Samsung" },
+    { "???", "Unknown" },
+    /* only in pnp.ids, the last line has no newline */
+    { "XQX", "Example Displays Ltd" },
+    { "QQA", "No Newline Corp" },
+    /* nowhere */
+    { "JJJ", "JJJ" },
+    /* not a PNP id, the pnp.ids lines are ignored too */
+    { "abc", "abc" },
+    { "dEL", "dEL" },
+    { "A1B", "A1B" },
+    { "AB", "AB" },
+    { "", "" },
+};
+
+
+
+static gchar *
+display_name (const gchar *code,
+              gint         width_mm,
+              gint         height_mm)
+{
+    MonitorInfo info;
+
+    memset (&info, 0, sizeof (info));
+    g_strlcpy (info.manufacturer_code, code, sizeof (info.manufacturer_code));
+    info.width_mm = width_mm;
+    info.height_mm = height_mm;
+
+    return make_display_name (&info, 0);
+}
+
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+    gchar *name, *expected;
+    guint  i;
+
+    for (i = 0; i < G_N_ELEMENTS (vendors); ++i)
+    {
+        name = display_name (vendors[i].code, -1, -1);
+        expected = g_strdup_printf ("%s ", vendors[i].name);
+        g_assert_cmpstr (name, ==, expected);
+        g_free (expected);
+        g_free (name);
+    }
+
+    /* asked again, from the loaded tables */
+    name = display_name ("DEL", 600, 340);
+    g_assert_cmpstr (name, ==, "Dell Inc. 27\"");
+    g_free (name);
+
+    name = display_name ("SAM", 600, 340);
+    g_assert_cmpstr (name, ==, "Samsung 27\"");
+    g_free (name);
+
+    return 0;
+}
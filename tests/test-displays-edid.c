@@ -0,0 +1,248 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The EDID cache of the displays helper against the fake RandR screen:
+ * a monitor swapped on the same connector must not keep the EDID of
+ * the previous one, and the fake must behave like the server after an
+ * apply and an unplug.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "xfsettingsd/displays-backend.h"
+#include "xfsettingsd/displays-edid.h"
+#include "xfsettingsd/metrics.h"
+
+#define FAKE_SCREEN \
+    "[Screen]\n" \
+    "Outputs=2\n" \
+    "Names=eDP-1;DP-1\n" \
+    "Steps=100:swap:DP-1;300:unplug:DP-1\n"
+
+#define OUTPUT_INTERNAL 0x800
+#define OUTPUT_EXTERNAL 0x801
+
+
+
+typedef struct
+{
+    XfceDisplaysBackend   *backend;
+    XfceDisplaysEdidCache *edids;
+    guint                  n_changed;
+    guint                  n_edid_changed;
+}
+Fixture;
+
+
+
+/* the daemon's metrics are not linked in */
+void
+xfsettings_metrics_count (XfsdDebugDomain  domain,
+                          const gchar     *name,
+                          guint64          value)
+{
+}
+
+
+
+void
+xfsettings_metrics_time (XfsdDebugDomain  domain,
+                         const gchar     *name,
+                         gint64           duration)
+{
+}
+
+
+
+static void
+changed (gpointer user_data)
+{
+    Fixture *fixture = user_data;
+
+    fixture->n_changed++;
+}
+
+
+
+static void
+edid_changed (RROutput output,
+              gpointer user_data)
+{
+    Fixture *fixture = user_data;
+
+    /* what the displays helper does */
+    xfce_displays_edid_cache_invalidate (fixture->edids, output);
+    fixture->n_edid_changed++;
+}
+
+
+
+static gboolean
+timeout (gpointer user_data)
+{
+    g_error ("The fake screen did not reach the expected state in time");
+
+    return FALSE;
+}
+
+
+
+static void
+wait_for (guint *counter,
+          guint  value)
+{
+    guint id;
+
+    id = g_timeout_add_seconds (5, timeout, NULL);
+    while (*counter < value)
+        g_main_context_iteration (NULL, TRUE);
+    g_source_remove (id);
+}
+
+
+
+static void
+test_swap (Fixture *fixture)
+{
+    const XfceDisplaysEdid *edid;
+    gchar                  *internal_hash;
+    gchar                  *external_hash;
+    guint                   epoch;
+
+    edid = xfce_displays_edid_cache_lookup (fixture->edids, OUTPUT_INTERNAL);
+    internal_hash = g_strdup (edid->hash);
+
+    edid = xfce_displays_edid_cache_lookup (fixture->edids, OUTPUT_EXTERNAL);
+    g_assert (edid->info != NULL);
+    g_assert_cmpuint (strlen (edid->hash), ==, 40);
+    external_hash = g_strdup (edid->hash);
+    epoch = edid->epoch;
+
+    /* cached until something happens */
+    edid = xfce_displays_edid_cache_lookup (fixture->edids, OUTPUT_EXTERNAL);
+    g_assert_cmpuint (edid->epoch, ==, epoch);
+    g_assert_cmpstr (edid->hash, ==, external_hash);
+
+    /* another monitor on DP-1, still connected for the reload */
+    wait_for (&fixture->n_edid_changed, 1);
+    xfce_displays_edid_cache_set_connected (fixture->edids, OUTPUT_EXTERNAL, TRUE);
+
+    edid = xfce_displays_edid_cache_lookup (fixture->edids, OUTPUT_EXTERNAL);
+    g_assert_cmpuint (edid->epoch, >, epoch);
+    g_assert_cmpstr (edid->hash, !=, external_hash);
+    g_assert (edid->info != NULL);
+
+    /* the other output was not touched */
+    edid = xfce_displays_edid_cache_lookup (fixture->edids, OUTPUT_INTERNAL);
+    g_assert_cmpstr (edid->hash, ==, internal_hash);
+
+    g_free (internal_hash);
+    g_free (external_hash);
+}
+
+
+
+static void
+test_apply_and_unplug (Fixture *fixture)
+{
+    XfceDisplaysBackend *backend = fixture->backend;
+    XRRScreenResources  *resources;
+    XRROutputInfo       *info;
+    XRRCrtcInfo         *crtc_info;
+    RROutput             output = OUTPUT_EXTERNAL;
+    RRCrtc               crtc;
+    guint                n_changed;
+
+    resources = backend->get_screen_resources (backend, TRUE);
+    info = backend->get_output_info (backend, resources, output);
+    g_assert (info != NULL && info->nmode > 0);
+    crtc = resources->crtcs[1];
+
+    /* the server reports the new configuration after an apply */
+    n_changed = fixture->n_changed;
+    g_assert_cmpint (backend->set_crtc_config (backend, resources, crtc, 0, 0, info->modes[0],
+                                               RR_Rotate_0, &output, 1), ==, RRSetConfigSuccess);
+    wait_for (&fixture->n_changed, n_changed + 1);
+
+    backend->free_output_info (backend, info);
+    backend->free_screen_resources (backend, resources);
+
+    /* an unplugged output leaves its CRTC disabled, not driving nothing */
+    n_changed = fixture->n_changed;
+    wait_for (&fixture->n_changed, n_changed + 1);
+
+    resources = backend->get_screen_resources (backend, TRUE);
+    crtc_info = backend->get_crtc_info (backend, resources, crtc);
+    g_assert (crtc_info != NULL);
+    g_assert_cmpuint (crtc_info->mode, ==, None);
+    g_assert_cmpint (crtc_info->noutput, ==, 0);
+    backend->free_crtc_info (backend, crtc_info);
+    backend->free_screen_resources (backend, resources);
+}
+
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+    Fixture  fixture = { 0, };
+    GError  *error = NULL;
+    gchar   *filename;
+    gint     fd;
+
+    fd = g_file_open_tmp ("fake-screen-XXXXXX.ini", &filename, &error);
+    g_assert_no_error (error);
+    close (fd);
+    g_file_set_contents (filename, FAKE_SCREEN, -1, &error);
+    g_assert_no_error (error);
+
+    fixture.backend = xfce_displays_backend_fake_new (filename, &error);
+    g_assert_no_error (error);
+    g_unlink (filename);
+    g_free (filename);
+
+    fixture.edids = xfce_displays_edid_cache_new (fixture.backend);
+    xfce_displays_edid_cache_set_connected (fixture.edids, OUTPUT_INTERNAL, TRUE);
+    xfce_displays_edid_cache_set_connected (fixture.edids, OUTPUT_EXTERNAL, TRUE);
+
+    /* starts the steps of the fake screen */
+    fixture.backend->watch (fixture.backend, changed, edid_changed, &fixture);
+
+    test_swap (&fixture);
+    test_apply_and_unplug (&fixture);
+
+    fixture.backend->unwatch (fixture.backend);
+    xfce_displays_edid_cache_free (fixture.edids);
+    (*fixture.backend->free) (fixture.backend);
+
+    return 0;
+}
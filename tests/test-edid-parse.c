@@ -0,0 +1,249 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The EDIDs in edid/ through decode_edid_into: a base block alone, a
+ * CEA-861 and a DisplayID extension completing a base block without
+ * size and timings, truncated data and a wrong checksum.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "common/edid.h"
+
+
+
+static guchar *
+load_edid (const gchar *name,
+           gint        *length)
+{
+    gchar  *filename, *contents;
+    gsize   size;
+    GError *error = NULL;
+
+    filename = g_build_filename (TEST_EDID_DIR, name, NULL);
+    g_file_get_contents (filename, &contents, &size, &error);
+    g_assert_no_error (error);
+    g_free (filename);
+
+    *length = size;
+    return (guchar *) contents;
+}
+
+
+
+static void
+test_base_only (void)
+{
+    MonitorInfo     info;
+    EdidExtensions  ext;
+    guchar         *edid;
+    gint            length;
+
+    edid = load_edid ("base-only.bin", &length);
+    g_assert_true (decode_edid_into (edid, length, &info, &ext));
+
+    g_assert_cmpint (info.checksum, ==, 0);
+    g_assert_cmpstr (info.manufacturer_code, ==, "DEL");
+    g_assert_cmpint (info.product_code, ==, 0x4321);
+    g_assert_cmpuint (info.serial_number, ==, 0x01020304);
+    g_assert_cmpint (info.production_week, ==, 10);
+    g_assert_cmpint (info.production_year, ==, 2019);
+    g_assert_cmpint (info.major_version, ==, 1);
+    g_assert_cmpint (info.minor_version, ==, 4);
+    g_assert_true (info.is_digital);
+    g_assert_cmpint (info.connector.digital.interface, ==, DISPLAY_PORT);
+    g_assert_cmpint (info.width_mm, ==, 600);
+    g_assert_cmpint (info.height_mm, ==, 340);
+    g_assert_cmpstr (info.dsc_product_name, ==, "DELL TEST");
+    g_assert_cmpstr (info.dsc_serial_number, ==, "ABC123");
+
+    g_assert_cmpint (info.n_detailed_timings, ==, 1);
+    g_assert_cmpint (info.detailed_timings[0].pixel_clock, ==, 148500000);
+    g_assert_cmpint (info.detailed_timings[0].h_addr, ==, 1920);
+    g_assert_cmpint (info.detailed_timings[0].h_blank, ==, 280);
+    g_assert_cmpint (info.detailed_timings[0].v_addr, ==, 1080);
+    g_assert_cmpint (info.detailed_timings[0].v_blank, ==, 45);
+    g_assert_cmpint (info.detailed_timings[0].width_mm, ==, 600);
+    g_assert_cmpint (info.detailed_timings[0].height_mm, ==, 340);
+
+    g_assert_cmpint (ext.n_blocks, ==, 0);
+    g_assert_cmpint (ext.cea_revision, ==, 0);
+    g_assert_cmpint (ext.displayid_version, ==, 0);
+    g_assert_false (ext.has_preferred);
+
+    g_free (edid);
+}
+
+
+
+static void
+test_cea (void)
+{
+    MonitorInfo     info;
+    EdidExtensions  ext;
+    guchar         *edid;
+    gint            length;
+
+    edid = load_edid ("cea.bin", &length);
+    g_assert_cmpint (length, ==, 256);
+
+    /* the base block alone has neither a size nor a timing */
+    g_assert_true (decode_edid_into (edid, length, &info, NULL));
+    g_assert_cmpint (info.width_mm, ==, -1);
+    g_assert_cmpint (info.n_detailed_timings, ==, 0);
+
+    g_assert_true (decode_edid_into (edid, length, &info, &ext));
+    g_assert_cmpint (info.checksum, ==, 0);
+    g_assert_cmpstr (info.manufacturer_code, ==, "SAM");
+    g_assert_cmpstr (info.dsc_product_name, ==, "SAMSUNG TV");
+
+    g_assert_cmpint (ext.n_blocks, ==, 1);
+    g_assert_cmpuint (ext.tags[0], ==, 0x02);
+    g_assert_cmpint (ext.cea_revision, ==, 3);
+    g_assert_true (ext.cea_underscan);
+    g_assert_true (ext.cea_basic_audio);
+    g_assert_true (ext.cea_ycbcr444);
+    g_assert_true (ext.cea_ycbcr422);
+    g_assert_cmpint (ext.cea_native_formats, ==, 1);
+    g_assert_cmpint (ext.displayid_version, ==, 0);
+    g_assert_true (ext.has_preferred);
+
+    /* completed from the extension */
+    g_assert_cmpint (info.width_mm, ==, 1210);
+    g_assert_cmpint (info.height_mm, ==, 680);
+    g_assert_cmpint (info.n_detailed_timings, ==, 1);
+    g_assert_cmpint (info.detailed_timings[0].pixel_clock, ==, 297000000);
+    g_assert_cmpint (info.detailed_timings[0].h_addr, ==, 3840);
+    g_assert_cmpint (info.detailed_timings[0].h_blank, ==, 560);
+    g_assert_cmpint (info.detailed_timings[0].v_addr, ==, 2160);
+    g_assert_cmpint (info.detailed_timings[0].v_blank, ==, 90);
+
+    g_free (edid);
+}
+
+
+
+static void
+test_displayid (void)
+{
+    MonitorInfo     info;
+    EdidExtensions  ext;
+    guchar         *edid;
+    gint            length;
+
+    edid = load_edid ("displayid.bin", &length);
+    g_assert_true (decode_edid_into (edid, length, &info, &ext));
+
+    g_assert_cmpint (info.checksum, ==, 0);
+    g_assert_cmpstr (info.manufacturer_code, ==, "XQX");
+
+    g_assert_cmpint (ext.n_blocks, ==, 1);
+    g_assert_cmpuint (ext.tags[0], ==, 0x70);
+    g_assert_cmpint (ext.cea_revision, ==, 0);
+    g_assert_cmpint (ext.displayid_version, ==, 0x12);
+    g_assert_true (ext.has_preferred);
+
+    /* the display parameters block is in 0.1 mm */
+    g_assert_cmpint (info.width_mm, ==, 527);
+    g_assert_cmpint (info.height_mm, ==, 296);
+    g_assert_cmpint (info.n_detailed_timings, ==, 1);
+    g_assert_cmpint (info.detailed_timings[0].pixel_clock, ==, 533250000);
+    g_assert_cmpint (info.detailed_timings[0].h_addr, ==, 2560);
+    g_assert_cmpint (info.detailed_timings[0].h_blank, ==, 160);
+    g_assert_cmpint (info.detailed_timings[0].h_front_porch, ==, 48);
+    g_assert_cmpint (info.detailed_timings[0].h_sync, ==, 32);
+    g_assert_cmpint (info.detailed_timings[0].v_addr, ==, 1440);
+    g_assert_cmpint (info.detailed_timings[0].v_blank, ==, 41);
+    g_assert_cmpint (info.detailed_timings[0].v_front_porch, ==, 3);
+    g_assert_cmpint (info.detailed_timings[0].v_sync, ==, 5);
+    g_assert_false (info.detailed_timings[0].interlaced);
+
+    g_free (edid);
+}
+
+
+
+static void
+test_truncated (void)
+{
+    MonitorInfo     info;
+    EdidExtensions  ext;
+    guchar         *edid;
+    gint            length;
+
+    /* less than a base block */
+    edid = load_edid ("truncated.bin", &length);
+    g_assert_cmpint (length, <, 128);
+    g_assert_false (decode_edid_into (edid, length, &info, &ext));
+    g_assert_false (decode_edid_extensions (edid, length, &ext));
+    g_free (edid);
+
+    /* an extension is announced but cut off, only the base is used */
+    edid = load_edid ("cea-truncated.bin", &length);
+    g_assert_cmpint (edid[0x7e], ==, 1);
+    g_assert_true (decode_edid_into (edid, length, &info, &ext));
+    g_assert_cmpint (ext.n_blocks, ==, 0);
+    g_assert_cmpint (ext.cea_revision, ==, 0);
+    g_assert_false (ext.has_preferred);
+    g_assert_cmpint (info.width_mm, ==, -1);
+    g_assert_cmpint (info.n_detailed_timings, ==, 0);
+    g_free (edid);
+}
+
+
+
+static void
+test_bad_checksum (void)
+{
+    MonitorInfo     info;
+    EdidExtensions  ext;
+    guchar         *edid;
+    gint            length;
+
+    /* still decoded, the checksum is left for the callers to check */
+    edid = load_edid ("bad-checksum.bin", &length);
+    g_assert_true (decode_edid_into (edid, length, &info, &ext));
+    g_assert_cmpint (info.checksum, !=, 0);
+    g_assert_cmpstr (info.manufacturer_code, ==, "DEL");
+    g_assert_cmpuint (info.serial_number, !=, 0x01020304);
+
+    /* and a broken header is refused */
+    edid[1] = 0x00;
+    g_assert_false (decode_edid_into (edid, length, &info, &ext));
+    g_free (edid);
+}
+
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+    test_base_only ();
+    test_cea ();
+    test_displayid ();
+    test_truncated ();
+    test_bad_checksum ();
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The mode catalogue of XfceRandr against the linear searches it
+ * replaced: the clonable mode and the mode lookup of an output must
+ * not change for any set of outputs and mode lists. The structure is
+ * filled without a server, so the implementation is included here to
+ * reach its private part.
+ */
+
+#include "common/xfce-randr.c"
+
+#define N_ROUNDS 2000
+
+
+
+static RRMode
+baseline_clonable_mode (XRRScreenResources   *resources,
+                        XfceRandrOutputInfo **output_info,
+                        guint                 noutput)
+{
+    gint  l, n, candidate, found;
+    guint m;
+
+    /* walk all available modes */
+    for (n = 0; n < resources->nmode; ++n)
+    {
+        candidate = TRUE;
+        /* walk all connected outputs */
+        for (m = 0; m < noutput; ++m)
+        {
+            found = FALSE;
+            /* walk supported modes from this output */
+            for (l = 0; l < output_info[m]->nmode; ++l)
+            {
+                if (resources->modes[n].id == output_info[m]->modes[l])
+                {
+                    found = TRUE;
+                    break;
+                }
+            }
+            /* if it is not present in one output, forget it */
+            candidate &= found;
+        }
+        /* common to all outputs, can be used for clone mode */
+        if (candidate)
+            return resources->modes[n].id;
+    }
+
+    return None;
+}
+
+
+
+static const XRRModeInfo *
+baseline_find_mode (XRRScreenResources  *resources,
+                    XfceRandrOutputInfo *output_info,
+                    RRMode               id)
+{
+    gint n, m;
+
+    for (n = 0; n < output_info->nmode; ++n)
+    {
+        if (output_info->modes[n] != id)
+            continue;
+
+        for (m = 0; m < resources->nmode; ++m)
+            if (resources->modes[m].id == id)
+                return &resources->modes[m];
+    }
+
+    return NULL;
+}
+
+
+
+static void
+check_outputs (GRand              *rand,
+               XRRScreenResources *resources,
+               guint               noutput,
+               gboolean            common)
+{
+    XfceRandr            randr = { 0, };
+    XfceRandrPrivate     priv = { 0, };
+    XfceRandrOutputInfo *infos;
+    const XfceRRMode    *mode;
+    const XRRModeInfo   *expected;
+    RRMode               id;
+    guint                m;
+    gint                 n, j;
+
+    randr.noutput = noutput;
+    randr.priv = &priv;
+    priv.resources = resources;
+
+    infos = g_new0 (XfceRandrOutputInfo, noutput);
+    priv.output_info = g_new0 (XfceRandrOutputInfo *, noutput);
+    priv.modes = g_new0 (XfceRRMode *, noutput);
+    priv.mode_sets = g_new0 (guint32 *, noutput);
+
+    xfce_randr_build_catalogue (&randr);
+
+    for (m = 0; m < noutput; ++m)
+    {
+        /* a random subset in random order, with an id the resources
+         * do not know now and then, like a driver in the middle of an
+         * update would report */
+        infos[m].modes = g_new0 (RRMode, resources->nmode + 1);
+        for (n = 0; n < resources->nmode; ++n)
+            if ((common && n == resources->nmode - 1)
+                || g_rand_int_range (rand, 0, 3) == 0)
+                infos[m].modes[infos[m].nmode++] = resources->modes[n].id;
+        if (g_rand_int_range (rand, 0, 8) == 0)
+            infos[m].modes[infos[m].nmode++] = 0x7fff;
+
+        for (n = infos[m].nmode - 1; n > 0; --n)
+        {
+            j = g_rand_int_range (rand, 0, n + 1);
+            id = infos[m].modes[n];
+            infos[m].modes[n] = infos[m].modes[j];
+            infos[m].modes[j] = id;
+        }
+
+        priv.output_info[m] = &infos[m];
+        xfce_randr_list_supported_modes (&randr, m);
+    }
+
+    g_assert_cmpuint (xfce_randr_clonable_mode (&randr), ==,
+                      baseline_clonable_mode (resources, priv.output_info, noutput));
+    if (common)
+        g_assert_cmpuint (xfce_randr_clonable_mode (&randr), !=, None);
+
+    for (m = 0; m < noutput; ++m)
+    {
+        for (n = 0; n <= resources->nmode; ++n)
+        {
+            id = n < resources->nmode ? resources->modes[n].id : 0x7fff;
+            mode = xfce_randr_find_mode_by_id (&randr, m, id);
+            expected = baseline_find_mode (resources, &infos[m], id);
+
+            if (expected == NULL)
+            {
+                g_assert_null (mode);
+                continue;
+            }
+
+            g_assert_nonnull (mode);
+            g_assert_cmpuint (mode->id, ==, expected->id);
+            g_assert_cmpuint (mode->width, ==, expected->width);
+            g_assert_cmpuint (mode->height, ==, expected->height);
+        }
+
+        /* the order the output lists them in is kept */
+        for (n = 0; n < infos[m].nmode; ++n)
+            g_assert_cmpuint (priv.modes[m][n].id, ==, infos[m].modes[n]);
+    }
+
+    for (m = 0; m < noutput; ++m)
+    {
+        g_free (priv.modes[m]);
+        g_free (priv.mode_sets[m]);
+        g_free (infos[m].modes);
+    }
+    g_free (priv.modes);
+    g_free (priv.mode_sets);
+    g_free (priv.output_info);
+    g_free (priv.catalogue);
+    g_hash_table_destroy (priv.mode_index);
+    g_free (infos);
+}
+
+
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+    XRRScreenResources  resources = { 0, };
+    GRand              *rand;
+    guint               round;
+    gint                n;
+
+    rand = g_rand_new_with_seed (0x44);
+
+    for (round = 0; round < N_ROUNDS; ++round)
+    {
+        /* around the word size of the bitsets too */
+        resources.nmode = round % 4 == 0 ? 32 * g_rand_int_range (rand, 1, 4)
+                                         : g_rand_int_range (rand, 1, 130);
+        resources.modes = g_new0 (XRRModeInfo, resources.nmode);
+
+        for (n = 0; n < resources.nmode; ++n)
+        {
+            resources.modes[n].id = 0x100 + g_rand_int_range (rand, 0, 4) + 4 * n;
+            resources.modes[n].width = g_rand_int_range (rand, 640, 3841);
+            resources.modes[n].height = g_rand_int_range (rand, 480, 2161);
+            resources.modes[n].dotClock = 148500000;
+            resources.modes[n].hTotal = resources.modes[n].width + 280;
+            resources.modes[n].vTotal = resources.modes[n].height + 45;
+        }
+
+        check_outputs (rand, &resources, g_rand_int_range (rand, 1, 5), round % 2 == 0);
+
+        g_free (resources.modes);
+    }
+
+    g_rand_free (rand);
+
+    return 0;
+}
@@ -43,8 +43,11 @@
 #include <libnotify/notify.h>
 #endif /* !HAVE_LIBNOTIFY */
 
+#include "channel-cache.h"
 #include "debug.h"
 #include "accessibility.h"
+#include "event-dispatch.h"
+#include "helper-module.h"
 
 
 
@@ -93,7 +96,17 @@ struct _XfceAccessibilityHelper
 
 
 
-G_DEFINE_TYPE (XfceAccessibilityHelper, xfce_accessibility_helper, G_TYPE_OBJECT);
+G_DEFINE_DYNAMIC_TYPE (XfceAccessibilityHelper, xfce_accessibility_helper, G_TYPE_OBJECT);
+
+
+
+GType
+xfce_helper_module_register (GTypeModule *type_module)
+{
+    xfce_accessibility_helper_register_type (type_module);
+
+    return XFCE_TYPE_ACCESSIBILITY_HELPER;
+}
 
 
 
@@ -108,17 +121,25 @@ xfce_accessibility_helper_class_init (XfceAccessibilityHelperClass *klass)
 
 
 
+static void
+xfce_accessibility_helper_class_finalize (XfceAccessibilityHelperClass *klass)
+{
+}
+
+
+
 static void
 xfce_accessibility_helper_init (XfceAccessibilityHelper *helper)
 {
     gint dummy;
+    gint xkb_event_base;
 
     helper->channel = NULL;
 #ifdef HAVE_LIBNOTIFY
     helper->notification = NULL;
 #endif /* !HAVE_LIBNOTIFY */
 
-    if (XkbQueryExtension (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), &dummy, &dummy, &dummy, &dummy, &dummy))
+    if (XkbQueryExtension (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), &dummy, &xkb_event_base, &dummy, &dummy, &dummy))
     {
         /* open the channel */
         helper->channel = xfconf_channel_get ("accessibility");
@@ -137,8 +158,9 @@ xfce_accessibility_helper_init (XfceAccessibilityHelper *helper)
         /* add event filter */
         XkbSelectEvents (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()), XkbUseCoreKbd, XkbControlsNotifyMask, XkbControlsNotifyMask);
 
-        /* monitor all window events */
-        gdk_window_add_filter (NULL, xfce_accessibility_helper_event_filter, helper);
+        /* monitor the xkb events */
+        xfsettings_event_dispatch_add ("accessibility", xkb_event_base + XkbEventCode, None,
+                                       xfce_accessibility_helper_event_filter, helper);
 #endif /* !HAVE_LIBNOTIFY */
     }
     else
@@ -156,6 +178,8 @@ xfce_accessibility_helper_finalize (GObject *object)
 #ifdef HAVE_LIBNOTIFY
     XfceAccessibilityHelper *helper = XFCE_ACCESSIBILITY_HELPER (object);
 
+    xfsettings_event_dispatch_remove (xfce_accessibility_helper_event_filter, helper);
+
     /* close an opened notification */
     if (G_UNLIKELY (helper->notification))
         notify_notification_close (helper->notification, NULL);
@@ -202,7 +226,7 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* AccessXKeys */
         if (HAS_FLAG (mask, XkbAccessXKeysMask))
         {
-            if (xfconf_channel_get_bool (helper->channel, "/AccessXKeys", FALSE))
+            if (xfsettings_channel_cache_get_bool (helper->channel, "/AccessXKeys", FALSE))
             {
                 SET_FLAG (xkb->ctrls->enabled_ctrls, XkbAccessXKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbAccessXKeysMask);
@@ -223,18 +247,18 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Sticky keys */
         if (HAS_FLAG (mask, XkbStickyKeysMask))
         {
-            if (xfconf_channel_get_bool (helper->channel, "/StickyKeys", FALSE))
+            if (xfsettings_channel_cache_get_bool (helper->channel, "/StickyKeys", FALSE))
             {
                 SET_FLAG (xkb->ctrls->enabled_ctrls, XkbStickyKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbStickyKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbStickyKeysMask);
 
-                if (xfconf_channel_get_bool (helper->channel, "/StickyKeys/LatchToLock", FALSE))
+                if (xfsettings_channel_cache_get_bool (helper->channel, "/StickyKeys/LatchToLock", FALSE))
                     SET_FLAG (xkb->ctrls->ax_options, XkbAX_LatchToLockMask);
                 else
                     UNSET_FLAG (xkb->ctrls->ax_options, XkbAX_LatchToLockMask);
 
-                if (xfconf_channel_get_bool (helper->channel, "/StickyKeys/TwoKeysDisable", FALSE))
+                if (xfsettings_channel_cache_get_bool (helper->channel, "/StickyKeys/TwoKeysDisable", FALSE))
                     SET_FLAG (xkb->ctrls->ax_options, XkbAX_TwoKeysMask);
                 else
                     UNSET_FLAG (xkb->ctrls->ax_options, XkbAX_TwoKeysMask);
@@ -255,13 +279,13 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Slow keys */
         if (HAS_FLAG (mask, XkbSlowKeysMask))
         {
-            if (xfconf_channel_get_bool (helper->channel, "/SlowKeys", FALSE))
+            if (xfsettings_channel_cache_get_bool (helper->channel, "/SlowKeys", FALSE))
             {
                 SET_FLAG (xkb->ctrls->enabled_ctrls, XkbSlowKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbSlowKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbSlowKeysMask);
 
-                delay = xfconf_channel_get_int (helper->channel, "/SlowKeys/Delay", 100);
+                delay = xfsettings_channel_cache_get_int (helper->channel, "/SlowKeys/Delay", 100);
                 xkb->ctrls->slow_keys_delay = CLAMP (delay, 1, G_MAXUSHORT);
 
                 xfsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "slowkeys enabled (delay=%d)",
@@ -280,13 +304,13 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Bounce keys */
         if (HAS_FLAG (mask, XkbBounceKeysMask))
         {
-            if (xfconf_channel_get_bool (helper->channel, "/BounceKeys", FALSE))
+            if (xfsettings_channel_cache_get_bool (helper->channel, "/BounceKeys", FALSE))
             {
                 SET_FLAG (xkb->ctrls->enabled_ctrls, XkbBounceKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbBounceKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbBounceKeysMask);
 
-                delay = xfconf_channel_get_int (helper->channel, "/BounceKeys/Delay", 100);
+                delay = xfsettings_channel_cache_get_int (helper->channel, "/BounceKeys/Delay", 100);
                 xkb->ctrls->debounce_delay = CLAMP (delay, 1, G_MAXUSHORT);
 
                 xfsettings_dbg (XFSD_DEBUG_ACCESSIBILITY, "bouncekeys enabled (delay=%d)",
@@ -305,18 +329,18 @@ xfce_accessibility_helper_set_xkb (XfceAccessibilityHelper *helper,
         /* Mouse keys */
         if (HAS_FLAG (mask, XkbMouseKeysMask))
         {
-            if (xfconf_channel_get_bool (helper->channel, "/MouseKeys", FALSE))
+            if (xfsettings_channel_cache_get_bool (helper->channel, "/MouseKeys", FALSE))
             {
                 SET_FLAG (xkb->ctrls->enabled_ctrls, XkbMouseKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_mask, XkbMouseKeysMask);
                 UNSET_FLAG (xkb->ctrls->axt_ctrls_values, XkbMouseKeysMask);
 
                 /* get values */
-                delay = xfconf_channel_get_int (helper->channel, "/MouseKeys/Delay", 160);
-                interval = xfconf_channel_get_int (helper->channel, "/MouseKeys/Interval", 20);
-                time_to_max = xfconf_channel_get_int (helper->channel, "/MouseKeys/TimeToMax", 3000);
-                max_speed = xfconf_channel_get_int (helper->channel, "/MouseKeys/MaxSpeed", 1000);
-                curve = xfconf_channel_get_int (helper->channel, "/MouseKeys/Curve", 0);
+                delay = xfsettings_channel_cache_get_int (helper->channel, "/MouseKeys/Delay", 160);
+                interval = xfsettings_channel_cache_get_int (helper->channel, "/MouseKeys/Interval", 20);
+                time_to_max = xfsettings_channel_cache_get_int (helper->channel, "/MouseKeys/TimeToMax", 3000);
+                max_speed = xfsettings_channel_cache_get_int (helper->channel, "/MouseKeys/MaxSpeed", 1000);
+                curve = xfsettings_channel_cache_get_int (helper->channel, "/MouseKeys/Curve", 0);
 
                 /* calculate maximum speed and to to reach it */
                 interval = CLAMP (interval, 1, G_MAXUSHORT);
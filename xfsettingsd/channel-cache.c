@@ -0,0 +1,779 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <xfconf/xfconf.h>
+
+#include "debug.h"
+#include "channel-cache.h"
+
+
+
+typedef struct _ChannelCache ChannelCache;
+struct _ChannelCache
+{
+    /* not referenced, the cache is attached to the channel */
+    XfconfChannel *channel;
+    gchar         *name;
+
+    /* property name -> GValue */
+    GHashTable    *properties;
+
+    guint          hits;
+    guint          misses;
+    guint          incoherent;
+};
+
+
+
+static GQuark           channel_cache_quark = 0;
+static GSList          *channel_caches = NULL;
+
+/* set when the channel-cache debug domain is enabled */
+static gboolean         channel_cache_verify = FALSE;
+static GDBusConnection *channel_cache_bus = NULL;
+
+/* channel name -> properties prefetched at startup, for the caches that
+ * are not created yet; changes are followed until the seeding ends */
+static GHashTable      *channel_cache_seeds = NULL;
+static GDBusConnection *channel_cache_seed_bus = NULL;
+static guint            channel_cache_seed_changed = 0;
+static guint            channel_cache_seed_removed = 0;
+
+
+
+static GValue *
+xfsettings_channel_cache_value_dup (const GValue *value)
+{
+    GValue *copy;
+
+    copy = g_new0 (GValue, 1);
+    g_value_init (copy, G_VALUE_TYPE (value));
+    g_value_copy (value, copy);
+
+    return copy;
+}
+
+
+
+static void
+xfsettings_channel_cache_value_free (gpointer data)
+{
+    GValue *value = data;
+
+    g_value_unset (value);
+    g_free (value);
+}
+
+
+
+/* takes the reference of variant */
+static GValue *
+xfsettings_channel_cache_value_from_variant (GVariant *variant)
+{
+    GValue    *value;
+    GValue    *item;
+    GVariant  *child;
+    GPtrArray *array;
+    gsize      n;
+
+    value = g_new0 (GValue, 1);
+
+    /* the types libxfconf uses for the same properties */
+    if (g_variant_is_of_type (variant, G_VARIANT_TYPE ("av")))
+    {
+        array = g_ptr_array_new_with_free_func (xfsettings_channel_cache_value_free);
+        for (n = 0; n < g_variant_n_children (variant); n++)
+        {
+            child = g_variant_get_child_value (variant, n);
+            item = xfsettings_channel_cache_value_from_variant (g_variant_get_variant (child));
+            g_variant_unref (child);
+            if (item == NULL || G_VALUE_TYPE (item) == XFCONF_TYPE_G_VALUE_ARRAY)
+            {
+                if (item != NULL)
+                    xfsettings_channel_cache_value_free (item);
+                g_ptr_array_unref (array);
+                g_free (value);
+                g_variant_unref (variant);
+                return NULL;
+            }
+            g_ptr_array_add (array, item);
+        }
+        g_value_init (value, XFCONF_TYPE_G_VALUE_ARRAY);
+        g_value_take_boxed (value, array);
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_INT16))
+    {
+        g_value_init (value, XFCONF_TYPE_INT16);
+        xfconf_g_value_set_int16 (value, g_variant_get_int16 (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT16))
+    {
+        g_value_init (value, XFCONF_TYPE_UINT16);
+        xfconf_g_value_set_uint16 (value, g_variant_get_uint16 (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_BOOLEAN)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_BYTE)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_INT32)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT32)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_INT64)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT64)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_DOUBLE)
+             || g_variant_is_of_type (variant, G_VARIANT_TYPE_STRING))
+    {
+        g_dbus_gvariant_to_gvalue (variant, value);
+    }
+    else
+    {
+        g_free (value);
+        value = NULL;
+    }
+
+    g_variant_unref (variant);
+
+    return value;
+}
+
+
+
+static GHashTable *
+xfsettings_channel_cache_properties_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                  xfsettings_channel_cache_value_free);
+}
+
+
+
+static void
+xfsettings_channel_cache_free (gpointer data)
+{
+    ChannelCache *cache = data;
+
+    channel_caches = g_slist_remove (channel_caches, cache);
+
+    g_hash_table_destroy (cache->properties);
+    g_free (cache->name);
+    g_slice_free (ChannelCache, cache);
+}
+
+
+
+static gboolean
+xfsettings_channel_cache_changed_hook (GSignalInvocationHint *ihint,
+                                       guint                  n_param_values,
+                                       const GValue          *param_values,
+                                       gpointer               user_data)
+{
+    ChannelCache *cache;
+    const gchar  *property;
+    const GValue *value;
+
+    g_return_val_if_fail (n_param_values == 3, TRUE);
+
+    /* channels nobody looked up through the cache */
+    cache = g_object_get_qdata (g_value_get_object (&param_values[0]), channel_cache_quark);
+    if (cache == NULL)
+        return TRUE;
+
+    property = g_value_get_string (&param_values[1]);
+    value = g_value_get_boxed (&param_values[2]);
+
+    if (value == NULL || G_VALUE_TYPE (value) == G_TYPE_INVALID)
+        g_hash_table_remove (cache->properties, property);
+    else
+        g_hash_table_replace (cache->properties, g_strdup (property),
+                              xfsettings_channel_cache_value_dup (value));
+
+    return TRUE;
+}
+
+
+
+static void
+xfsettings_channel_cache_load (ChannelCache *cache)
+{
+    GHashTable     *properties;
+    GHashTableIter  iter;
+    gpointer        key, value;
+
+    g_hash_table_remove_all (cache->properties);
+
+    properties = xfconf_channel_get_properties (cache->channel, NULL);
+    if (properties != NULL)
+    {
+        g_hash_table_iter_init (&iter, properties);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+            g_hash_table_insert (cache->properties, g_strdup (key),
+                                 xfsettings_channel_cache_value_dup (value));
+        g_hash_table_destroy (properties);
+    }
+}
+
+
+
+static ChannelCache *
+xfsettings_channel_cache_get (XfconfChannel *channel)
+{
+    ChannelCache   *cache;
+    gint64          start_time;
+
+    if (G_UNLIKELY (channel_cache_quark == 0))
+    {
+        channel_cache_quark = g_quark_from_static_string ("xfsettings-channel-cache");
+
+        /* emission hooks run before all the handlers, so helpers see the
+         * new value no matter when they connected to the channel */
+        g_signal_add_emission_hook (g_signal_lookup ("property-changed", XFCONF_TYPE_CHANNEL),
+                                    0, xfsettings_channel_cache_changed_hook, NULL, NULL);
+
+        channel_cache_verify = xfsettings_dbg_enabled (XFSD_DEBUG_CHANNEL_CACHE);
+        if (channel_cache_verify)
+            channel_cache_bus = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+    }
+
+    cache = g_object_get_qdata (G_OBJECT (channel), channel_cache_quark);
+    if (G_LIKELY (cache != NULL))
+        return cache;
+
+    start_time = g_get_monotonic_time ();
+
+    cache = g_slice_new0 (ChannelCache);
+    cache->channel = channel;
+    g_object_get (G_OBJECT (channel), "channel-name", &cache->name, NULL);
+
+    /* take the prefetched properties, else this is the only round
+     * trip to xfconfd for this channel */
+    if (channel_cache_seeds != NULL
+        && (cache->properties = g_hash_table_lookup (channel_cache_seeds, cache->name)) != NULL)
+    {
+        g_hash_table_ref (cache->properties);
+        g_hash_table_remove (channel_cache_seeds, cache->name);
+    }
+    else
+    {
+        cache->properties = xfsettings_channel_cache_properties_new ();
+        xfsettings_channel_cache_load (cache);
+    }
+
+    g_object_set_qdata_full (G_OBJECT (channel), channel_cache_quark, cache,
+                             xfsettings_channel_cache_free);
+    channel_caches = g_slist_prepend (channel_caches, cache);
+
+    xfsettings_dbg (XFSD_DEBUG_CHANNEL_CACHE, "loaded channel \"%s\", %u properties in %.3f ms",
+                    cache->name, g_hash_table_size (cache->properties),
+                    (g_get_monotonic_time () - start_time) / 1000.0);
+
+    return cache;
+}
+
+
+
+static gchar *
+xfsettings_channel_cache_value_to_string (const GValue *value)
+{
+    GValue  str_value = G_VALUE_INIT;
+    gchar  *str = NULL;
+
+    if (G_VALUE_HOLDS_STRING (value))
+        return g_value_dup_string (value);
+
+    /* arrays and other boxed values are not compared */
+    g_value_init (&str_value, G_TYPE_STRING);
+    if (g_value_type_transformable (G_VALUE_TYPE (value), G_TYPE_STRING)
+        && g_value_transform (value, &str_value))
+        str = g_value_dup_string (&str_value);
+    g_value_unset (&str_value);
+
+    return str;
+}
+
+
+
+static void
+xfsettings_channel_cache_verify (ChannelCache *cache,
+                                 const gchar  *property,
+                                 const GValue *cached)
+{
+    GVariant *reply;
+    GVariant *variant;
+    GValue    value = G_VALUE_INIT;
+    gchar    *str_cached = NULL;
+    gchar    *str_value = NULL;
+    gboolean  coherent;
+
+    if (channel_cache_bus == NULL)
+        return;
+
+    /* ask xfconfd directly, libxfconf has its own cache */
+    reply = g_dbus_connection_call_sync (channel_cache_bus,
+                                         "org.xfce.Xfconf",
+                                         "/org/xfce/Xfconf",
+                                         "org.xfce.Xfconf",
+                                         "GetProperty",
+                                         g_variant_new ("(ss)", cache->name, property),
+                                         G_VARIANT_TYPE ("(v)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1, NULL, NULL);
+
+    if (reply == NULL)
+    {
+        /* property is not set */
+        coherent = cached == NULL;
+    }
+    else
+    {
+        g_variant_get (reply, "(v)", &variant);
+        g_dbus_gvariant_to_gvalue (variant, &value);
+        g_variant_unref (variant);
+        g_variant_unref (reply);
+
+        if (cached == NULL)
+        {
+            coherent = FALSE;
+        }
+        else
+        {
+            str_cached = xfsettings_channel_cache_value_to_string (cached);
+            str_value = xfsettings_channel_cache_value_to_string (&value);
+
+            coherent = str_cached == NULL || str_value == NULL
+                       || strcmp (str_cached, str_value) == 0;
+        }
+
+        g_value_unset (&value);
+    }
+
+    if (!coherent)
+    {
+        cache->incoherent++;
+
+        /* can be a change that is still queued on the bus */
+        xfsettings_dbg (XFSD_DEBUG_CHANNEL_CACHE, "%s%s is incoherent, cached %s, xfconfd %s",
+                        cache->name, property,
+                        cached != NULL ? (str_cached != NULL ? str_cached : "(array)") : "(unset)",
+                        reply != NULL ? (str_value != NULL ? str_value : "(array)") : "(unset)");
+    }
+
+    g_free (str_cached);
+    g_free (str_value);
+}
+
+
+
+static gboolean
+xfsettings_channel_cache_get_value (XfconfChannel *channel,
+                                    const gchar   *property,
+                                    GType          type,
+                                    GValue        *value)
+{
+    ChannelCache *cache;
+    const GValue *cached;
+
+    g_return_val_if_fail (XFCONF_IS_CHANNEL (channel), FALSE);
+    g_return_val_if_fail (property != NULL && *property == '/', FALSE);
+
+    cache = xfsettings_channel_cache_get (channel);
+
+    cached = g_hash_table_lookup (cache->properties, property);
+    if (cached != NULL)
+        cache->hits++;
+    else
+        cache->misses++;
+
+    if (G_UNLIKELY (channel_cache_verify))
+        xfsettings_channel_cache_verify (cache, property, cached);
+
+    if (cached == NULL)
+        return FALSE;
+
+    /* same conversions as the xfconf_channel_get_* functions */
+    g_value_init (value, type);
+    if (G_VALUE_TYPE (cached) == type)
+    {
+        g_value_copy (cached, value);
+    }
+    else if (!g_value_type_transformable (G_VALUE_TYPE (cached), type)
+             || !g_value_transform (cached, value))
+    {
+        g_value_unset (value);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+
+gboolean
+xfsettings_channel_cache_get_bool (XfconfChannel *channel,
+                                   const gchar   *property,
+                                   gboolean       default_value)
+{
+    GValue   value = G_VALUE_INIT;
+    gboolean result = default_value;
+
+    if (xfsettings_channel_cache_get_value (channel, property, G_TYPE_BOOLEAN, &value))
+    {
+        result = g_value_get_boolean (&value);
+        g_value_unset (&value);
+    }
+
+    return result;
+}
+
+
+
+gint32
+xfsettings_channel_cache_get_int (XfconfChannel *channel,
+                                  const gchar   *property,
+                                  gint32         default_value)
+{
+    GValue value = G_VALUE_INIT;
+    gint32 result = default_value;
+
+    if (xfsettings_channel_cache_get_value (channel, property, G_TYPE_INT, &value))
+    {
+        result = g_value_get_int (&value);
+        g_value_unset (&value);
+    }
+
+    return result;
+}
+
+
+
+gdouble
+xfsettings_channel_cache_get_double (XfconfChannel *channel,
+                                     const gchar   *property,
+                                     gdouble        default_value)
+{
+    GValue  value = G_VALUE_INIT;
+    gdouble result = default_value;
+
+    if (xfsettings_channel_cache_get_value (channel, property, G_TYPE_DOUBLE, &value))
+    {
+        result = g_value_get_double (&value);
+        g_value_unset (&value);
+    }
+
+    return result;
+}
+
+
+
+gchar *
+xfsettings_channel_cache_get_string (XfconfChannel *channel,
+                                     const gchar   *property,
+                                     const gchar   *default_value)
+{
+    GValue  value = G_VALUE_INIT;
+    gchar  *result;
+
+    if (xfsettings_channel_cache_get_value (channel, property, G_TYPE_STRING, &value))
+    {
+        result = g_value_dup_string (&value);
+        g_value_unset (&value);
+    }
+    else
+    {
+        result = g_strdup (default_value);
+    }
+
+    return result;
+}
+
+
+
+GHashTable *
+xfsettings_channel_cache_get_properties (XfconfChannel *channel,
+                                         const gchar   *property_base)
+{
+    ChannelCache   *cache;
+    GHashTable     *properties = NULL;
+    GHashTableIter  iter;
+    gpointer        key, value;
+    gsize           len = 0;
+
+    g_return_val_if_fail (XFCONF_IS_CHANNEL (channel), NULL);
+
+    cache = xfsettings_channel_cache_get (channel);
+
+    if (property_base != NULL && strcmp (property_base, "/") != 0)
+        len = strlen (property_base);
+
+    /* same result as xfconf_channel_get_properties: a new table with all
+     * properties in the base, or NULL if there are none */
+    g_hash_table_iter_init (&iter, cache->properties);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        if (len > 0
+            && (strncmp (key, property_base, len) != 0
+                || (((const gchar *) key)[len] != '\0' && ((const gchar *) key)[len] != '/')))
+            continue;
+
+        if (properties == NULL)
+            properties = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                xfsettings_channel_cache_value_free);
+
+        g_hash_table_insert (properties, g_strdup (key),
+                             xfsettings_channel_cache_value_dup (value));
+    }
+
+    if (properties != NULL)
+        cache->hits++;
+    else
+        cache->misses++;
+
+    return properties;
+}
+
+
+
+static void
+xfsettings_channel_cache_seed_signal (GDBusConnection *connection,
+                                      const gchar     *sender_name,
+                                      const gchar     *object_path,
+                                      const gchar     *interface_name,
+                                      const gchar     *signal_name,
+                                      GVariant        *parameters,
+                                      gpointer         user_data)
+{
+    GHashTable  *properties;
+    const gchar *channel_name, *property;
+    GVariant    *variant;
+    GValue      *value = NULL;
+
+    if (channel_cache_seeds == NULL)
+        return;
+
+    if (g_strcmp0 (signal_name, "PropertyChanged") == 0
+        && g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(ssv)")))
+    {
+        g_variant_get (parameters, "(&s&sv)", &channel_name, &property, &variant);
+        value = xfsettings_channel_cache_value_from_variant (variant);
+    }
+    else if (g_strcmp0 (signal_name, "PropertyRemoved") == 0
+             && g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(ss)")))
+    {
+        g_variant_get (parameters, "(&s&s)", &channel_name, &property);
+    }
+    else
+    {
+        return;
+    }
+
+    properties = g_hash_table_lookup (channel_cache_seeds, channel_name);
+    if (properties == NULL)
+    {
+        if (value != NULL)
+            xfsettings_channel_cache_value_free (value);
+        return;
+    }
+
+    if (value != NULL)
+        g_hash_table_replace (properties, g_strdup (property), value);
+    else if (g_strcmp0 (signal_name, "PropertyRemoved") == 0)
+        g_hash_table_remove (properties, property);
+    else
+        /* a value the seed cannot hold, let the cache load the channel */
+        g_hash_table_remove (channel_cache_seeds, channel_name);
+}
+
+
+
+void
+xfsettings_channel_cache_seed_begin (GDBusConnection *connection)
+{
+    g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+
+    if (channel_cache_seeds != NULL)
+        return;
+
+    channel_cache_seeds = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) g_hash_table_unref);
+
+    /* subscribed before the prefetch calls are made, so a change after
+     * xfconfd answered always arrives after the answer */
+    channel_cache_seed_bus = g_object_ref (connection);
+    channel_cache_seed_changed =
+        g_dbus_connection_signal_subscribe (connection, NULL, "org.xfce.Xfconf",
+                                            "PropertyChanged", "/org/xfce/Xfconf", NULL,
+                                            G_DBUS_SIGNAL_FLAGS_NONE,
+                                            xfsettings_channel_cache_seed_signal, NULL, NULL);
+    channel_cache_seed_removed =
+        g_dbus_connection_signal_subscribe (connection, NULL, "org.xfce.Xfconf",
+                                            "PropertyRemoved", "/org/xfce/Xfconf", NULL,
+                                            G_DBUS_SIGNAL_FLAGS_NONE,
+                                            xfsettings_channel_cache_seed_signal, NULL, NULL);
+}
+
+
+
+void
+xfsettings_channel_cache_seed (const gchar *channel_name,
+                               GVariant    *properties)
+{
+    GHashTable   *seed;
+    GVariantIter  iter;
+    const gchar  *property;
+    GVariant     *variant;
+    GValue       *value;
+    GSList       *li;
+
+    g_return_if_fail (channel_name != NULL);
+    g_return_if_fail (g_variant_is_of_type (properties, G_VARIANT_TYPE_VARDICT));
+
+    /* too late, or the channel was loaded in the meantime */
+    if (channel_cache_seeds == NULL)
+        return;
+    for (li = channel_caches; li != NULL; li = li->next)
+        if (strcmp (((ChannelCache *) li->data)->name, channel_name) == 0)
+            return;
+
+    seed = xfsettings_channel_cache_properties_new ();
+    g_variant_iter_init (&iter, properties);
+    while (g_variant_iter_next (&iter, "{&sv}", &property, &variant))
+    {
+        value = xfsettings_channel_cache_value_from_variant (variant);
+        if (value == NULL)
+        {
+            /* let the cache load it with libxfconf's conversions */
+            xfsettings_dbg (XFSD_DEBUG_CHANNEL_CACHE, "not seeding channel \"%s\", "
+                            "%s has an unknown type", channel_name, property);
+            g_hash_table_destroy (seed);
+            return;
+        }
+        g_hash_table_insert (seed, g_strdup (property), value);
+    }
+
+    g_hash_table_replace (channel_cache_seeds, g_strdup (channel_name), seed);
+}
+
+
+
+void
+xfsettings_channel_cache_seed_end (void)
+{
+    if (channel_cache_seeds == NULL)
+        return;
+
+    /* the channels nobody asked for */
+    g_hash_table_destroy (channel_cache_seeds);
+    channel_cache_seeds = NULL;
+
+    g_dbus_connection_signal_unsubscribe (channel_cache_seed_bus, channel_cache_seed_changed);
+    g_dbus_connection_signal_unsubscribe (channel_cache_seed_bus, channel_cache_seed_removed);
+    channel_cache_seed_changed = channel_cache_seed_removed = 0;
+    g_clear_object (&channel_cache_seed_bus);
+}
+
+
+
+void
+xfsettings_channel_cache_reload (XfconfChannel *channel)
+{
+    ChannelCache *cache;
+    gint64        start_time;
+
+    g_return_if_fail (XFCONF_IS_CHANNEL (channel));
+
+    cache = g_object_get_qdata (G_OBJECT (channel), channel_cache_quark);
+    if (cache == NULL)
+        return;
+
+    start_time = g_get_monotonic_time ();
+    xfsettings_channel_cache_load (cache);
+
+    xfsettings_dbg (XFSD_DEBUG_CHANNEL_CACHE, "reloaded channel \"%s\", %u properties in %.3f ms",
+                    cache->name, g_hash_table_size (cache->properties),
+                    (g_get_monotonic_time () - start_time) / 1000.0);
+}
+
+
+
+void
+xfsettings_channel_cache_get_stats (XfconfChannel *channel,
+                                    guint         *hits,
+                                    guint         *misses)
+{
+    ChannelCache *cache = NULL;
+
+    g_return_if_fail (XFCONF_IS_CHANNEL (channel));
+
+    if (channel_cache_quark != 0)
+        cache = g_object_get_qdata (G_OBJECT (channel), channel_cache_quark);
+
+    if (hits != NULL)
+        *hits = cache != NULL ? cache->hits : 0;
+    if (misses != NULL)
+        *misses = cache != NULL ? cache->misses : 0;
+}
+
+
+
+void
+xfsettings_channel_cache_foreach_stats (XfceChannelCacheStatsFunc func,
+                                        gpointer                  user_data)
+{
+    GSList       *li;
+    ChannelCache *cache;
+
+    g_return_if_fail (func != NULL);
+
+    for (li = channel_caches; li != NULL; li = li->next)
+    {
+        cache = li->data;
+        (*func) (cache->name, g_hash_table_size (cache->properties),
+                 cache->hits, cache->misses, user_data);
+    }
+}
+
+
+
+void
+xfsettings_channel_cache_report (void)
+{
+    GSList       *li;
+    ChannelCache *cache;
+
+    for (li = channel_caches; li != NULL; li = li->next)
+    {
+        cache = li->data;
+
+        if (channel_cache_verify)
+            xfsettings_dbg (XFSD_DEBUG_CHANNEL_CACHE, "channel \"%s\": %u properties, "
+                            "%u hits, %u misses, %u incoherent lookups",
+                            cache->name, g_hash_table_size (cache->properties),
+                            cache->hits, cache->misses, cache->incoherent);
+        else
+            xfsettings_dbg (XFSD_DEBUG_CHANNEL_CACHE, "channel \"%s\": %u properties, "
+                            "%u hits, %u misses",
+                            cache->name, g_hash_table_size (cache->properties),
+                            cache->hits, cache->misses);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __CHANNEL_CACHE_H__
+#define __CHANNEL_CACHE_H__
+
+#include <gio/gio.h>
+#include <xfconf/xfconf.h>
+
+/* mirror of a channel, loaded with a single call on the first lookup
+ * and kept up to date from property-changed; lookups never go to xfconfd */
+
+gboolean    xfsettings_channel_cache_get_bool       (XfconfChannel *channel,
+                                                     const gchar   *property,
+                                                     gboolean       default_value);
+
+gint32      xfsettings_channel_cache_get_int        (XfconfChannel *channel,
+                                                     const gchar   *property,
+                                                     gint32         default_value);
+
+gdouble     xfsettings_channel_cache_get_double     (XfconfChannel *channel,
+                                                     const gchar   *property,
+                                                     gdouble        default_value);
+
+gchar      *xfsettings_channel_cache_get_string     (XfconfChannel *channel,
+                                                     const gchar   *property,
+                                                     const gchar   *default_value) G_GNUC_MALLOC;
+
+GHashTable *xfsettings_channel_cache_get_properties (XfconfChannel *channel,
+                                                     const gchar   *property_base);
+
+/* fetches the whole channel again, for callers that know xfconfd has
+ * values whose property-changed signals may not have arrived yet */
+void        xfsettings_channel_cache_reload         (XfconfChannel *channel);
+
+/* startup: follows xfconfd's change signals until seed_end, so the
+ * channels handed to seed stay current until their cache is created */
+void        xfsettings_channel_cache_seed_begin     (GDBusConnection *connection);
+
+void        xfsettings_channel_cache_seed           (const gchar   *channel_name,
+                                                     GVariant      *properties);
+
+void        xfsettings_channel_cache_seed_end       (void);
+
+void        xfsettings_channel_cache_get_stats      (XfconfChannel *channel,
+                                                     guint         *hits,
+                                                     guint         *misses);
+
+typedef void (*XfceChannelCacheStatsFunc) (const gchar *channel_name,
+                                           guint        n_properties,
+                                           guint        hits,
+                                           guint        misses,
+                                           gpointer     user_data);
+
+void        xfsettings_channel_cache_foreach_stats  (XfceChannelCacheStatsFunc  func,
+                                                     gpointer                   user_data);
+
+void        xfsettings_channel_cache_report         (void);
+
+#endif /* !__CHANNEL_CACHE_H__ */
@@ -38,6 +38,10 @@
 #include <gtk/gtk.h>
 
 #include "clipboard-manager.h"
+#include "debug.h"
+#include "event-dispatch.h"
+#include "metrics.h"
+#include "trace.h"
 #include "xsettings.h"
 
 struct _GsdClipboardManagerPrivate
@@ -336,6 +340,9 @@ get_property (TargetData          *tdata,
                 tdata->data = data;
                 tdata->length = length * clipboard_bytes_per_item (format);
                 tdata->format = format;
+
+                xfsettings_metrics_count (XFSD_DEBUG_CLIPBOARD, "saved-bytes", tdata->length);
+                xfsettings_trace (XFSD_TRACE_CLIPBOARD_SAVE, tdata->length, 0, 0);
         }
 }
 
@@ -386,6 +393,9 @@ receive_incrementally (GsdClipboardManager *manager,
 
                 XFree (data);
         } else {
+                xfsettings_metrics_count (XFSD_DEBUG_CLIPBOARD, "saved-bytes", length);
+                xfsettings_trace (XFSD_TRACE_CLIPBOARD_SAVE, length, 0, 0);
+
                 if (!tdata->data) {
                         tdata->data = data;
                         tdata->length = length;
@@ -867,30 +877,14 @@ clipboard_manager_watch_cb (GsdClipboardManager *manager,
                             long                 mask,
                             void                *cb_data)
 {
-        GdkWindow  *gdkwin;
-        GdkDisplay *display;
-
-        display = gdk_display_get_default ();
-        gdkwin = gdk_x11_window_lookup_for_display (display, window);
-
         if (is_start) {
-                if (gdkwin == NULL) {
-                        gdkwin = gdk_x11_window_foreign_new_for_display (display, window);
-                } else {
-                        g_object_ref (gdkwin);
-                }
-
-                gdk_window_add_filter (gdkwin,
-                                       (GdkFilterFunc) clipboard_manager_event_filter,
-                                       manager);
+                xfsettings_event_dispatch_add ("clipboard", XFSETTINGS_EVENT_ANY, window,
+                                               (GdkFilterFunc) clipboard_manager_event_filter,
+                                               manager);
         } else {
-                if (gdkwin == NULL) {
-                        return;
-                }
-                gdk_window_remove_filter (gdkwin,
-                                          (GdkFilterFunc) clipboard_manager_event_filter,
-                                          manager);
-                g_object_unref (gdkwin);
+                xfsettings_event_dispatch_remove_window (window,
+                                                         (GdkFilterFunc) clipboard_manager_event_filter,
+                                                         manager);
         }
 }
 
@@ -0,0 +1,253 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "dbus-service.h"
+#ifdef HAVE_XRANDR
+#include "common/xfce-randr.h"
+#include "displays.h"
+#endif
+#include "metrics.h"
+#include "trace.h"
+
+
+
+static const gchar dbus_service_xml[] =
+    "<node>"
+    "  <interface name='" XFSETTINGS_DBUS_INTERFACE "'>"
+    "    <method name='GetMetrics'>"
+    "      <arg type='a{sv}' name='metrics' direction='out'/>"
+    "    </method>"
+    "    <method name='DumpTrace'>"
+    "      <arg type='s' name='format' direction='in'/>"
+    "      <arg type='s' name='trace' direction='out'/>"
+    "    </method>"
+    "    <method name='DryRunScheme'>"
+    "      <arg type='s' name='scheme' direction='in'/>"
+    "      <arg type='a{sv}' name='plan' direction='out'/>"
+    "    </method>"
+    "    <method name='ApplyScheme'>"
+    "      <arg type='s' name='scheme' direction='in'/>"
+    "      <arg type='s' name='status' direction='out'/>"
+    "      <arg type='x' name='duration_us' direction='out'/>"
+    "      <arg type='u' name='crtcs_changed' direction='out'/>"
+    "    </method>"
+    "    <method name='GetRandrSnapshot'>"
+    "      <arg type='u' name='version' direction='out'/>"
+    "      <arg type='v' name='snapshot' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static GDBusNodeInfo *dbus_service_info = NULL;
+
+
+
+static void
+xfsettings_dbus_service_method_call (GDBusConnection       *connection,
+                                     const gchar           *sender,
+                                     const gchar           *object_path,
+                                     const gchar           *interface_name,
+                                     const gchar           *method_name,
+                                     GVariant              *parameters,
+                                     GDBusMethodInvocation *invocation,
+                                     gpointer               user_data)
+{
+    const gchar *format;
+    gchar       *trace;
+#ifdef HAVE_XRANDR
+    const gchar *scheme;
+    GVariant    *plan;
+    GVariant    *snapshot;
+    GError      *error = NULL;
+    gint64       duration;
+    guint        n_changed;
+    const gchar *statuses[] = { "ok", "invalid", "failed" };
+    XfceDisplaysApplyStatus status;
+#endif
+
+    if (strcmp (method_name, "GetMetrics") == 0)
+    {
+        g_dbus_method_invocation_return_value (invocation,
+                                               g_variant_new ("(@a{sv})", xfsettings_metrics_get ()));
+    }
+    else if (strcmp (method_name, "DumpTrace") == 0)
+    {
+        g_variant_get (parameters, "(&s)", &format);
+        if (strcmp (format, "text") == 0)
+            trace = xfsettings_trace_dump (XFSD_TRACE_FORMAT_TEXT);
+        else if (strcmp (format, "json") == 0)
+            trace = xfsettings_trace_dump (XFSD_TRACE_FORMAT_CHROME);
+        else
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                                   G_DBUS_ERROR_INVALID_ARGS,
+                                                   "Unknown trace format \"%s\", "
+                                                   "expected \"text\" or \"json\"", format);
+            return;
+        }
+
+        g_dbus_method_invocation_return_value (invocation, g_variant_new ("(s)", trace));
+        g_free (trace);
+    }
+    else if (strcmp (method_name, "DryRunScheme") == 0)
+    {
+#ifdef HAVE_XRANDR
+        if (xfce_displays_helper_get_default () == NULL)
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                                   G_DBUS_ERROR_NOT_SUPPORTED,
+                                                   "The displays helper is not running");
+            return;
+        }
+
+        g_variant_get (parameters, "(&s)", &scheme);
+        plan = xfce_displays_helper_dry_run (xfce_displays_helper_get_default (), scheme, &error);
+        if (plan == NULL)
+        {
+            g_dbus_method_invocation_return_gerror (invocation, error);
+            g_error_free (error);
+            return;
+        }
+
+        g_dbus_method_invocation_return_value (invocation, g_variant_new ("(@a{sv})", plan));
+#else
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                               G_DBUS_ERROR_NOT_SUPPORTED,
+                                               "Built without display support");
+#endif
+    }
+    else if (strcmp (method_name, "ApplyScheme") == 0)
+    {
+#ifdef HAVE_XRANDR
+        if (xfce_displays_helper_get_default () == NULL)
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                                   G_DBUS_ERROR_NOT_SUPPORTED,
+                                                   "The displays helper is not running");
+            return;
+        }
+
+        /* the reply goes out once the server applied the layout */
+        g_variant_get (parameters, "(&s)", &scheme);
+        status = xfce_displays_helper_apply_scheme (xfce_displays_helper_get_default (), scheme,
+                                                    &duration, &n_changed);
+
+        g_dbus_method_invocation_return_value (invocation,
+                                               g_variant_new ("(sxu)", statuses[status],
+                                                              duration, n_changed));
+#else
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                               G_DBUS_ERROR_NOT_SUPPORTED,
+                                               "Built without display support");
+#endif
+    }
+    else if (strcmp (method_name, "GetRandrSnapshot") == 0)
+    {
+#ifdef HAVE_XRANDR
+        if (xfce_displays_helper_get_default () == NULL)
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                                   G_DBUS_ERROR_NOT_SUPPORTED,
+                                                   "The displays helper is not running");
+            return;
+        }
+
+        snapshot = xfce_displays_helper_get_randr_snapshot (xfce_displays_helper_get_default (), &error);
+        if (snapshot == NULL)
+        {
+            g_dbus_method_invocation_return_gerror (invocation, error);
+            g_error_free (error);
+            return;
+        }
+
+        g_dbus_method_invocation_return_value (invocation,
+                                               g_variant_new ("(uv)", XFCE_RANDR_SNAPSHOT_VERSION,
+                                                              snapshot));
+#else
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                               G_DBUS_ERROR_NOT_SUPPORTED,
+                                               "Built without display support");
+#endif
+    }
+    else
+    {
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                               G_DBUS_ERROR_UNKNOWN_METHOD,
+                                               "Unknown method %s", method_name);
+    }
+}
+
+
+
+static const GDBusInterfaceVTable dbus_service_vtable =
+{
+    xfsettings_dbus_service_method_call,
+    NULL,
+    NULL
+};
+
+
+
+guint
+xfsettings_dbus_service_register (GDBusConnection  *connection,
+                                  GError          **error)
+{
+    g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), 0);
+
+    if (dbus_service_info == NULL)
+    {
+        dbus_service_info = g_dbus_node_info_new_for_xml (dbus_service_xml, error);
+        if (G_UNLIKELY (dbus_service_info == NULL))
+            return 0;
+    }
+
+    return g_dbus_connection_register_object (connection,
+                                              XFSETTINGS_DBUS_PATH,
+                                              dbus_service_info->interfaces[0],
+                                              &dbus_service_vtable,
+                                              NULL, NULL, error);
+}
+
+
+
+void
+xfsettings_dbus_service_unregister (GDBusConnection *connection,
+                                    guint            registration_id)
+{
+    g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+
+    if (registration_id != 0)
+        g_dbus_connection_unregister_object (connection, registration_id);
+
+    if (dbus_service_info != NULL)
+    {
+        g_dbus_node_info_unref (dbus_service_info);
+        dbus_service_info = NULL;
+    }
+}
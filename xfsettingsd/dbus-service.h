@@ -0,0 +1,33 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __DBUS_SERVICE_H__
+#define __DBUS_SERVICE_H__
+
+#include <gio/gio.h>
+
+#define XFSETTINGS_DBUS_PATH      "/org/xfce/SettingsDaemon"
+#define XFSETTINGS_DBUS_INTERFACE "org.xfce.SettingsDaemon"
+
+guint xfsettings_dbus_service_register   (GDBusConnection  *connection,
+                                          GError          **error);
+
+void  xfsettings_dbus_service_unregister (GDBusConnection  *connection,
+                                          guint             registration_id);
+
+#endif /* !__DBUS_SERVICE_H__ */
@@ -41,6 +41,14 @@ static const GDebugKey dbg_keys[] =
     { "accessibility", XFSD_DEBUG_ACCESSIBILITY },
     { "pointers", XFSD_DEBUG_POINTERS },
     { "displays", XFSD_DEBUG_DISPLAYS },
+    { "launcher", XFSD_DEBUG_LAUNCHER },
+    { "startup", XFSD_DEBUG_STARTUP },
+    { "modules", XFSD_DEBUG_MODULES },
+    { "channel-cache", XFSD_DEBUG_CHANNEL_CACHE },
+    { "events", XFSD_DEBUG_EVENTS },
+    { "watchdog", XFSD_DEBUG_WATCHDOG },
+    { "clipboard", XFSD_DEBUG_CLIPBOARD },
+    { "replay", XFSD_DEBUG_REPLAY },
 };
 
 
@@ -70,25 +78,30 @@ xfsettings_dbg_init (void)
 
 
 
+const gchar *
+xfsettings_dbg_domain_name (XfsdDebugDomain domain)
+{
+    guint i;
+
+    /* lookup domain name */
+    for (i = 0; i < G_N_ELEMENTS (dbg_keys); i++)
+        if (dbg_keys[i].value == domain)
+            return dbg_keys[i].key;
+
+    return NULL;
+}
+
+
+
 static void __attribute__((format (gnu_printf, 2,0)))
 xfsettings_dbg_print (XfsdDebugDomain  domain,
                       const gchar     *message,
                       va_list          args)
 {
-    const gchar *domain_name = NULL;
-    guint        i;
+    const gchar *domain_name;
     gchar       *string;
 
-    /* lookup domain name */
-    for (i = 0; i < G_N_ELEMENTS (dbg_keys); i++)
-    {
-        if (dbg_keys[i].value == domain)
-        {
-            domain_name = dbg_keys[i].key;
-            break;
-        }
-    }
-
+    domain_name = xfsettings_dbg_domain_name (domain);
     g_assert (domain_name != NULL);
 
     string = g_strdup_vprintf (message, args);
@@ -135,3 +148,11 @@ xfsettings_dbg_filtered (XfsdDebugDomain  domain,
     xfsettings_dbg_print (domain, message, args);
     va_end (args);
 }
+
+
+
+gboolean
+xfsettings_dbg_enabled (XfsdDebugDomain domain)
+{
+    return (xfsettings_dbg_init () & domain) != 0;
+}
@@ -33,15 +33,27 @@ typedef enum
    XFSD_DEBUG_ACCESSIBILITY      = 1 << 7,
    XFSD_DEBUG_POINTERS           = 1 << 8,
    XFSD_DEBUG_DISPLAYS           = 1 << 9,
+   XFSD_DEBUG_LAUNCHER           = 1 << 10,
+   XFSD_DEBUG_STARTUP            = 1 << 11,
+   XFSD_DEBUG_MODULES            = 1 << 12,
+   XFSD_DEBUG_CHANNEL_CACHE      = 1 << 13,
+   XFSD_DEBUG_EVENTS             = 1 << 14,
+   XFSD_DEBUG_WATCHDOG           = 1 << 15,
+   XFSD_DEBUG_CLIPBOARD          = 1 << 16,
+   XFSD_DEBUG_REPLAY             = 1 << 17,
 }
 XfsdDebugDomain;
 
-void xfsettings_dbg          (XfsdDebugDomain  domain,
-                              const gchar     *message,
-                              ...) G_GNUC_PRINTF (2, 3);
+void         xfsettings_dbg             (XfsdDebugDomain  domain,
+                                         const gchar     *message,
+                                         ...) G_GNUC_PRINTF (2, 3);
 
-void xfsettings_dbg_filtered (XfsdDebugDomain  domain,
-                              const gchar     *message,
-                              ...) G_GNUC_PRINTF (2, 3);
+void         xfsettings_dbg_filtered    (XfsdDebugDomain  domain,
+                                         const gchar     *message,
+                                         ...) G_GNUC_PRINTF (2, 3);
+
+gboolean     xfsettings_dbg_enabled     (XfsdDebugDomain  domain);
+
+const gchar *xfsettings_dbg_domain_name (XfsdDebugDomain  domain);
 
 #endif /* !__DEBUG_H__ */
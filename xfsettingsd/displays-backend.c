@@ -0,0 +1,468 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <gdk/gdkx.h>
+#include <gtk/gtk.h>
+
+#include <X11/Xatom.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "displays-backend.h"
+#include "event-dispatch.h"
+
+/* check for randr 1.3 or better */
+#if RANDR_MAJOR > 1 || (RANDR_MAJOR == 1 && RANDR_MINOR >= 3)
+#define HAS_RANDR_ONE_POINT_THREE
+#else
+#undef HAS_RANDR_ONE_POINT_THREE
+#endif
+
+
+
+typedef struct _XlibBackend XlibBackend;
+struct _XlibBackend
+{
+    XfceDisplaysBackend             __parent__;
+
+    GdkDisplay                     *display;
+    Display                        *xdisplay;
+    Window                          root;
+    gint                            event_base;
+    Atom                            edid_atom;
+
+    XfceDisplaysBackendChangedFunc  changed_func;
+    XfceDisplaysBackendEdidFunc     edid_func;
+    gpointer                        changed_data;
+};
+
+
+
+static GdkFilterReturn
+xlib_backend_screen_on_event (GdkXEvent *xevent,
+                              GdkEvent  *event,
+                              gpointer   data)
+{
+    XlibBackend *xlib = data;
+
+    (*xlib->changed_func) (xlib->changed_data);
+
+    /* Pass the event on to GTK+ */
+    return GDK_FILTER_CONTINUE;
+}
+
+
+
+static GdkFilterReturn
+xlib_backend_output_on_event (GdkXEvent *gdk_xevent,
+                              GdkEvent  *event,
+                              gpointer   data)
+{
+    XlibBackend                  *xlib = data;
+    XRROutputPropertyNotifyEvent *xevent = gdk_xevent;
+
+    /* another monitor on the same connector, or an unplug and replug
+     * that only shows up as one screen change */
+    if (xevent->subtype == RRNotify_OutputProperty
+        && xevent->property == xlib->edid_atom)
+        (*xlib->edid_func) (xevent->output, xlib->changed_data);
+
+    return GDK_FILTER_CONTINUE;
+}
+
+
+
+static void
+xlib_backend_watch (XfceDisplaysBackend            *backend,
+                    XfceDisplaysBackendChangedFunc  func,
+                    XfceDisplaysBackendEdidFunc     edid_func,
+                    gpointer                        user_data)
+{
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+    xlib->changed_func = func;
+    xlib->edid_func = edid_func;
+    xlib->changed_data = user_data;
+    xlib->edid_atom = gdk_x11_get_xatom_by_name_for_display (xlib->display, RR_PROPERTY_RANDR_EDID);
+
+    /* Set up RandR notifications */
+    XRRSelectInput (xlib->xdisplay, xlib->root, RRScreenChangeNotifyMask | RROutputPropertyNotifyMask);
+    gdk_x11_register_standard_event_type (xlib->display, xlib->event_base, RRNotify + 1);
+    xfsettings_event_dispatch_add ("displays", xlib->event_base + RRScreenChangeNotify,
+                                   xlib->root, xlib_backend_screen_on_event, xlib);
+    xfsettings_event_dispatch_add ("displays-edid", xlib->event_base + RRNotify,
+                                   xlib->root, xlib_backend_output_on_event, xlib);
+}
+
+
+
+static void
+xlib_backend_unwatch (XfceDisplaysBackend *backend)
+{
+    xfsettings_event_dispatch_remove (xlib_backend_screen_on_event, backend);
+    xfsettings_event_dispatch_remove (xlib_backend_output_on_event, backend);
+}
+
+
+
+static XRRScreenResources *
+xlib_backend_get_screen_resources (XfceDisplaysBackend *backend,
+                                   gboolean             current)
+{
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    if (current && (backend->major_version > 1 || backend->minor_version >= 3))
+        return XRRGetScreenResourcesCurrent (xlib->xdisplay, xlib->root);
+#endif
+
+    return XRRGetScreenResources (xlib->xdisplay, xlib->root);
+}
+
+
+
+static void
+xlib_backend_free_screen_resources (XfceDisplaysBackend *backend,
+                                    XRRScreenResources  *resources)
+{
+    XRRFreeScreenResources (resources);
+}
+
+
+
+static XRROutputInfo *
+xlib_backend_get_output_info (XfceDisplaysBackend *backend,
+                              XRRScreenResources  *resources,
+                              RROutput             output)
+{
+    return XRRGetOutputInfo (((XlibBackend *) backend)->xdisplay, resources, output);
+}
+
+
+
+static void
+xlib_backend_free_output_info (XfceDisplaysBackend *backend,
+                               XRROutputInfo       *info)
+{
+    XRRFreeOutputInfo (info);
+}
+
+
+
+static guint8 *
+xlib_backend_get_edid (XfceDisplaysBackend *backend,
+                       RROutput             output,
+                       gsize               *length)
+{
+    XlibBackend   *xlib = (XlibBackend *) backend;
+    unsigned char *prop = NULL;
+    int            actual_format;
+    unsigned long  nitems, bytes_after;
+    Atom           actual_type;
+    Atom           edid_atom;
+    guint8        *result = NULL;
+
+    *length = 0;
+
+    edid_atom = gdk_x11_get_xatom_by_name_for_display (xlib->display, RR_PROPERTY_RANDR_EDID);
+    if (edid_atom == None)
+        return NULL;
+
+    /* the base block and all its extensions, 255 at most */
+    if (XRRGetOutputProperty (xlib->xdisplay, output, edid_atom, 0, 256 * 128 / 4,
+                              False, False, AnyPropertyType,
+                              &actual_type, &actual_format, &nitems,
+                              &bytes_after, &prop) == Success)
+    {
+        if (actual_type == XA_INTEGER && actual_format == 8 && nitems >= 128)
+        {
+            /* drop trailing garbage some drivers leave after the last block */
+            nitems = MIN (nitems, (prop[0x7e] + 1) * 128UL);
+            result = g_memdup (prop, nitems);
+            *length = nitems;
+        }
+    }
+
+    if (prop != NULL)
+        XFree (prop);
+
+    return result;
+}
+
+
+
+static XRRCrtcInfo *
+xlib_backend_get_crtc_info (XfceDisplaysBackend *backend,
+                            XRRScreenResources  *resources,
+                            RRCrtc               crtc)
+{
+    return XRRGetCrtcInfo (((XlibBackend *) backend)->xdisplay, resources, crtc);
+}
+
+
+
+static void
+xlib_backend_free_crtc_info (XfceDisplaysBackend *backend,
+                             XRRCrtcInfo         *info)
+{
+    XRRFreeCrtcInfo (info);
+}
+
+
+
+static void
+xlib_backend_get_crtc_scale (XfceDisplaysBackend *backend,
+                             RRCrtc               crtc,
+                             gdouble             *scalex,
+                             gdouble             *scaley)
+{
+    XRRCrtcTransformAttributes *attr;
+
+    if (XRRGetCrtcTransform (((XlibBackend *) backend)->xdisplay, crtc, &attr) && attr)
+    {
+        *scalex = XFixedToDouble (attr->currentTransform.matrix[0][0]);
+        *scaley = XFixedToDouble (attr->currentTransform.matrix[1][1]);
+        XFree (attr);
+    }
+    else
+    {
+        *scalex = 1.0;
+        *scaley = 1.0;
+    }
+}
+
+
+
+static Status
+xlib_backend_set_crtc_config (XfceDisplaysBackend *backend,
+                              XRRScreenResources  *resources,
+                              RRCrtc               crtc,
+                              gint                 x,
+                              gint                 y,
+                              RRMode               mode,
+                              Rotation             rotation,
+                              RROutput            *outputs,
+                              gint                 noutputs)
+{
+    return XRRSetCrtcConfig (((XlibBackend *) backend)->xdisplay, resources, crtc,
+                             CurrentTime, x, y, mode, rotation, outputs, noutputs);
+}
+
+
+
+static void
+xlib_backend_set_crtc_scale (XfceDisplaysBackend *backend,
+                             RRCrtc               crtc,
+                             gdouble              scalex,
+                             gdouble              scaley)
+{
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    XTransform   transform;
+    const gchar *filter;
+
+    if (scalex == 1 && scaley == 1)
+        filter = "nearest";
+    else
+        filter = "bilinear";
+
+    memset (&transform, '\0', sizeof (transform));
+
+    transform.matrix[0][0] = XDoubleToFixed (scalex);
+    transform.matrix[1][1] = XDoubleToFixed (scaley);
+    transform.matrix[2][2] = XDoubleToFixed (1.0);
+
+    XRRSetCrtcTransform (((XlibBackend *) backend)->xdisplay, crtc,
+                         &transform, (char *) filter, NULL, 0);
+#endif
+}
+
+
+
+static void
+xlib_backend_set_output_primary (XfceDisplaysBackend *backend,
+                                 RROutput             output)
+{
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+    XRRSetOutputPrimary (xlib->xdisplay, xlib->root, output);
+#endif
+}
+
+
+
+static gboolean
+xlib_backend_get_screen_size_range (XfceDisplaysBackend *backend,
+                                    gint                *min_width,
+                                    gint                *min_height,
+                                    gint                *max_width,
+                                    gint                *max_height)
+{
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+    return XRRGetScreenSizeRange (xlib->xdisplay, xlib->root,
+                                  min_width, min_height, max_width, max_height);
+}
+
+
+
+static void
+xlib_backend_get_screen_size (XfceDisplaysBackend *backend,
+                              gint                *width,
+                              gint                *height,
+                              gint                *mm_width,
+                              gint                *mm_height)
+{
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    *width = gdk_screen_width ();
+    *height = gdk_screen_height ();
+    *mm_width = gdk_screen_width_mm ();
+    *mm_height = gdk_screen_height_mm ();
+G_GNUC_END_IGNORE_DEPRECATIONS
+}
+
+
+
+static void
+xlib_backend_set_screen_size (XfceDisplaysBackend *backend,
+                              gint                 width,
+                              gint                 height,
+                              gint                 mm_width,
+                              gint                 mm_height)
+{
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+    XRRSetScreenSize (xlib->xdisplay, xlib->root, width, height, mm_width, mm_height);
+}
+
+
+
+static void
+xlib_backend_begin_changes (XfceDisplaysBackend *backend)
+{
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+    gdk_x11_display_error_trap_push (xlib->display);
+
+    /* grab server to prevent clients from thinking no output is enabled */
+    gdk_x11_display_grab (xlib->display);
+}
+
+
+
+static gint
+xlib_backend_end_changes (XfceDisplaysBackend *backend)
+{
+    XlibBackend *xlib = (XlibBackend *) backend;
+
+    /* release the grab, changes are done */
+    gdk_display_sync (xlib->display);
+    gdk_x11_display_ungrab (xlib->display);
+
+    return gdk_x11_display_error_trap_pop (xlib->display);
+}
+
+
+
+static void
+xlib_backend_free (XfceDisplaysBackend *backend)
+{
+    xlib_backend_unwatch (backend);
+    g_slice_free (XlibBackend, (XlibBackend *) backend);
+}
+
+
+
+XfceDisplaysBackend *
+xfce_displays_backend_xlib_new (GdkDisplay *display)
+{
+    XlibBackend         *xlib;
+    XfceDisplaysBackend *backend;
+    Display             *xdisplay;
+    gint                 event_base, error_base;
+    gint                 major = 0, minor = 0;
+
+    xdisplay = gdk_x11_display_get_xdisplay (display);
+
+    /* check if the randr extension is running */
+    if (!XRRQueryExtension (xdisplay, &event_base, &error_base))
+    {
+        g_critical ("No RANDR extension found in display %s. Display settings won't be applied.",
+                    gdk_display_get_name (display));
+        return NULL;
+    }
+
+    /* query the version */
+    if (!XRRQueryVersion (xdisplay, &major, &minor)
+        || !(major > 1 || (major == 1 && minor >= 2)))
+    {
+        g_critical ("RANDR extension is too old, version %d.%d. "
+                    "Display settings won't be applied.",
+                    major, minor);
+        return NULL;
+    }
+
+    xlib = g_slice_new0 (XlibBackend);
+    xlib->display = display;
+    xlib->xdisplay = xdisplay;
+    xlib->root = GDK_WINDOW_XID (gdk_screen_get_root_window (gdk_display_get_default_screen (display)));
+    xlib->event_base = event_base;
+
+    backend = (XfceDisplaysBackend *) xlib;
+    backend->name = "xlib";
+    backend->major_version = major;
+    backend->minor_version = minor;
+    backend->watch = xlib_backend_watch;
+    backend->unwatch = xlib_backend_unwatch;
+    backend->get_screen_resources = xlib_backend_get_screen_resources;
+    backend->free_screen_resources = xlib_backend_free_screen_resources;
+    backend->get_output_info = xlib_backend_get_output_info;
+    backend->free_output_info = xlib_backend_free_output_info;
+    backend->get_edid = xlib_backend_get_edid;
+    backend->get_crtc_info = xlib_backend_get_crtc_info;
+    backend->free_crtc_info = xlib_backend_free_crtc_info;
+    backend->get_crtc_scale = xlib_backend_get_crtc_scale;
+    backend->set_crtc_config = xlib_backend_set_crtc_config;
+    backend->set_crtc_scale = xlib_backend_set_crtc_scale;
+    backend->set_output_primary = xlib_backend_set_output_primary;
+    backend->get_screen_size_range = xlib_backend_get_screen_size_range;
+    backend->get_screen_size = xlib_backend_get_screen_size;
+    backend->set_screen_size = xlib_backend_set_screen_size;
+    backend->begin_changes = xlib_backend_begin_changes;
+    backend->end_changes = xlib_backend_end_changes;
+    backend->free = xlib_backend_free;
+
+    return backend;
+}
+
+
+
+void
+xfce_displays_backend_free (XfceDisplaysBackend *backend)
+{
+    if (backend != NULL)
+        (*backend->free) (backend);
+}
@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __DISPLAYS_BACKEND_H__
+#define __DISPLAYS_BACKEND_H__
+
+#include <glib.h>
+#include <gdk/gdk.h>
+
+#include <X11/extensions/Xrandr.h>
+
+typedef struct _XfceDisplaysBackend XfceDisplaysBackend;
+
+typedef void (*XfceDisplaysBackendChangedFunc) (gpointer user_data);
+
+typedef void (*XfceDisplaysBackendEdidFunc)    (RROutput output,
+                                                gpointer user_data);
+
+/* everything the displays helper asks RandR goes through this table,
+ * the structures returned are freed with the matching free function */
+struct _XfceDisplaysBackend
+{
+    const gchar         *name;
+
+    /* RandR version of the server */
+    gint                 major_version;
+    gint                 minor_version;
+
+    /* once watching, func is called on the equivalent of
+     * RRScreenChangeNotify and edid_func when the EDID property of an
+     * output changes, like a monitor swapped on the same connector */
+    void                (*watch)                 (XfceDisplaysBackend            *backend,
+                                                  XfceDisplaysBackendChangedFunc  func,
+                                                  XfceDisplaysBackendEdidFunc     edid_func,
+                                                  gpointer                        user_data);
+    void                (*unwatch)               (XfceDisplaysBackend            *backend);
+
+    XRRScreenResources *(*get_screen_resources)  (XfceDisplaysBackend            *backend,
+                                                  gboolean                        current);
+    void                (*free_screen_resources) (XfceDisplaysBackend            *backend,
+                                                  XRRScreenResources             *resources);
+
+    XRROutputInfo      *(*get_output_info)       (XfceDisplaysBackend            *backend,
+                                                  XRRScreenResources             *resources,
+                                                  RROutput                        output);
+    void                (*free_output_info)      (XfceDisplaysBackend            *backend,
+                                                  XRROutputInfo                  *info);
+
+    /* the raw EDID property, 128 bytes or more, free with g_free () */
+    guint8             *(*get_edid)              (XfceDisplaysBackend            *backend,
+                                                  RROutput                        output,
+                                                  gsize                          *length);
+
+    XRRCrtcInfo        *(*get_crtc_info)         (XfceDisplaysBackend            *backend,
+                                                  XRRScreenResources             *resources,
+                                                  RRCrtc                          crtc);
+    void                (*free_crtc_info)        (XfceDisplaysBackend            *backend,
+                                                  XRRCrtcInfo                    *info);
+
+    void                (*get_crtc_scale)        (XfceDisplaysBackend            *backend,
+                                                  RRCrtc                          crtc,
+                                                  gdouble                        *scalex,
+                                                  gdouble                        *scaley);
+
+    Status              (*set_crtc_config)       (XfceDisplaysBackend            *backend,
+                                                  XRRScreenResources             *resources,
+                                                  RRCrtc                          crtc,
+                                                  gint                            x,
+                                                  gint                            y,
+                                                  RRMode                          mode,
+                                                  Rotation                        rotation,
+                                                  RROutput                       *outputs,
+                                                  gint                            noutputs);
+
+    void                (*set_crtc_scale)        (XfceDisplaysBackend            *backend,
+                                                  RRCrtc                          crtc,
+                                                  gdouble                         scalex,
+                                                  gdouble                         scaley);
+
+    void                (*set_output_primary)    (XfceDisplaysBackend            *backend,
+                                                  RROutput                        output);
+
+    gboolean            (*get_screen_size_range) (XfceDisplaysBackend            *backend,
+                                                  gint                           *min_width,
+                                                  gint                           *min_height,
+                                                  gint                           *max_width,
+                                                  gint                           *max_height);
+
+    /* the current size of the screen, in pixels and mm */
+    void                (*get_screen_size)       (XfceDisplaysBackend            *backend,
+                                                  gint                           *width,
+                                                  gint                           *height,
+                                                  gint                           *mm_width,
+                                                  gint                           *mm_height);
+
+    void                (*set_screen_size)       (XfceDisplaysBackend            *backend,
+                                                  gint                            width,
+                                                  gint                            height,
+                                                  gint                            mm_width,
+                                                  gint                            mm_height);
+
+    /* brackets a set of changes, like a server grab; end returns
+     * the X error code of the changes or 0 */
+    void                (*begin_changes)         (XfceDisplaysBackend            *backend);
+    gint                (*end_changes)           (XfceDisplaysBackend            *backend);
+
+    void                (*free)                  (XfceDisplaysBackend            *backend);
+};
+
+/* NULL if the server has no usable RandR extension */
+XfceDisplaysBackend *xfce_displays_backend_xlib_new (GdkDisplay           *display);
+
+/* an in-memory screen described by a key file, see displays-fake.c */
+XfceDisplaysBackend *xfce_displays_backend_fake_new (const gchar          *filename,
+                                                     GError              **error);
+
+void                 xfce_displays_backend_free     (XfceDisplaysBackend  *backend);
+
+#endif /* !__DISPLAYS_BACKEND_H__ */
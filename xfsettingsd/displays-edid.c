@@ -0,0 +1,232 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include <X11/extensions/Xrandr.h>
+
+#include "common/edid.h"
+
+#include "debug.h"
+#include "displays-edid.h"
+#include "metrics.h"
+
+
+
+typedef struct _EdidEntry EdidEntry;
+
+struct _EdidEntry
+{
+    XfceDisplaysEdid edid;
+
+    /* what edid.info points to once decoded */
+    MonitorInfo      info;
+
+    guint            connected : 1;
+
+    /* epoch the data was fetched for, 0 if never */
+    guint            fetched_epoch;
+};
+
+struct _XfceDisplaysEdidCache
+{
+    XfceDisplaysBackend *backend;
+
+    /* RROutput -> EdidEntry */
+    GHashTable          *entries;
+};
+
+
+
+static void
+edid_entry_clear (EdidEntry *entry)
+{
+    g_free (entry->edid.data);
+    entry->edid.data = NULL;
+    entry->edid.length = 0;
+
+    g_free (entry->edid.hash);
+    entry->edid.hash = NULL;
+
+    entry->edid.info = NULL;
+
+    entry->fetched_epoch = 0;
+}
+
+
+
+static void
+edid_entry_free (EdidEntry *entry)
+{
+    edid_entry_clear (entry);
+    g_slice_free (EdidEntry, entry);
+}
+
+
+
+static EdidEntry *
+edid_cache_get_entry (XfceDisplaysEdidCache *cache,
+                      RROutput               output)
+{
+    EdidEntry *entry;
+
+    entry = g_hash_table_lookup (cache->entries, GSIZE_TO_POINTER (output));
+    if (entry == NULL)
+    {
+        entry = g_slice_new0 (EdidEntry);
+        entry->edid.output = output;
+        g_hash_table_insert (cache->entries, GSIZE_TO_POINTER (output), entry);
+    }
+
+    return entry;
+}
+
+
+
+XfceDisplaysEdidCache *
+xfce_displays_edid_cache_new (XfceDisplaysBackend *backend)
+{
+    XfceDisplaysEdidCache *cache;
+
+    g_return_val_if_fail (backend != NULL, NULL);
+
+    cache = g_slice_new0 (XfceDisplaysEdidCache);
+    cache->backend = backend;
+    cache->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                            (GDestroyNotify) edid_entry_free);
+
+    return cache;
+}
+
+
+
+void
+xfce_displays_edid_cache_free (XfceDisplaysEdidCache *cache)
+{
+    if (cache == NULL)
+        return;
+
+    g_hash_table_destroy (cache->entries);
+    g_slice_free (XfceDisplaysEdidCache, cache);
+}
+
+
+
+void
+xfce_displays_edid_cache_set_connected (XfceDisplaysEdidCache *cache,
+                                        RROutput               output,
+                                        gboolean               connected)
+{
+    EdidEntry *entry;
+
+    g_return_if_fail (cache != NULL);
+
+    entry = edid_cache_get_entry (cache, output);
+    if (entry->edid.epoch != 0 && entry->connected == !!connected)
+        return;
+
+    entry->connected = !!connected;
+    entry->edid.epoch++;
+    edid_entry_clear (entry);
+
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Output %lu %s, EDID epoch %u.", output,
+                    connected ? "connected" : "disconnected", entry->edid.epoch);
+}
+
+
+
+void
+xfce_displays_edid_cache_invalidate (XfceDisplaysEdidCache *cache,
+                                     RROutput               output)
+{
+    EdidEntry *entry;
+
+    g_return_if_fail (cache != NULL);
+
+    entry = g_hash_table_lookup (cache->entries, GSIZE_TO_POINTER (output));
+    if (entry == NULL || entry->edid.epoch == 0)
+        return;
+
+    entry->edid.epoch++;
+    edid_entry_clear (entry);
+
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "EDID of output %lu changed, EDID epoch %u.", output,
+                    entry->edid.epoch);
+}
+
+
+
+const XfceDisplaysEdid *
+xfce_displays_edid_cache_lookup (XfceDisplaysEdidCache *cache,
+                                 RROutput               output)
+{
+    EdidEntry *entry;
+    gint64     start_time;
+
+    g_return_val_if_fail (cache != NULL, NULL);
+
+    entry = edid_cache_get_entry (cache, output);
+
+    /* never seen by a reload, consider it connected */
+    if (entry->edid.epoch == 0)
+    {
+        entry->connected = TRUE;
+        entry->edid.epoch = 1;
+    }
+
+    if (entry->fetched_epoch == entry->edid.epoch)
+    {
+        xfsettings_metrics_count (XFSD_DEBUG_DISPLAYS, "edid-hit", 1);
+        return &entry->edid;
+    }
+
+    xfsettings_metrics_count (XFSD_DEBUG_DISPLAYS, "edid-miss", 1);
+    start_time = g_get_monotonic_time ();
+
+    edid_entry_clear (entry);
+    entry->edid.data = cache->backend->get_edid (cache->backend, output, &entry->edid.length);
+
+    if (entry->edid.data != NULL)
+    {
+        entry->edid.hash = g_compute_checksum_for_data (G_CHECKSUM_SHA1, entry->edid.data, 128);
+        if (decode_edid_into (entry->edid.data, entry->edid.length, &entry->info,
+                              &entry->edid.extensions))
+            entry->edid.info = &entry->info;
+        else
+            decode_edid_extensions (entry->edid.data, entry->edid.length, &entry->edid.extensions);
+
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Fetched EDID of output %lu: %" G_GSIZE_FORMAT
+                        " bytes, %d extension block(s).", output, entry->edid.length,
+                        entry->edid.extensions.n_blocks);
+    }
+    else
+    {
+        entry->edid.hash = g_strdup ("");
+        decode_edid_extensions (NULL, 0, &entry->edid.extensions);
+    }
+
+    entry->fetched_epoch = entry->edid.epoch;
+
+    xfsettings_metrics_time (XFSD_DEBUG_DISPLAYS, "edid-fetch", g_get_monotonic_time () - start_time);
+
+    return &entry->edid;
+}
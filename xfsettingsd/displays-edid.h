@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __DISPLAYS_EDID_H__
+#define __DISPLAYS_EDID_H__
+
+#include <glib.h>
+
+#include <X11/extensions/Xrandr.h>
+
+#include "common/edid.h"
+#include "displays-backend.h"
+
+typedef struct _XfceDisplaysEdid      XfceDisplaysEdid;
+typedef struct _XfceDisplaysEdidCache XfceDisplaysEdidCache;
+
+struct _XfceDisplaysEdid
+{
+    RROutput        output;
+
+    /* bumped every time the output is connected or disconnected */
+    guint           epoch;
+
+    /* raw property, base block and extensions, NULL if none */
+    guint8         *data;
+    gsize           length;
+
+    /* SHA-1 of the base block as stored in the profiles, "" if none */
+    gchar          *hash;
+
+    /* decoded base block, completed from the extensions, NULL if invalid */
+    MonitorInfo    *info;
+    EdidExtensions  extensions;
+};
+
+XfceDisplaysEdidCache  *xfce_displays_edid_cache_new           (XfceDisplaysBackend   *backend);
+
+void                    xfce_displays_edid_cache_free          (XfceDisplaysEdidCache *cache);
+
+/* called for every output on each reload, a change of the connection
+ * state starts a new epoch and drops what was fetched for the old one */
+void                    xfce_displays_edid_cache_set_connected (XfceDisplaysEdidCache *cache,
+                                                                RROutput               output,
+                                                                gboolean               connected);
+
+/* the EDID property of the output changed while it stayed connected,
+ * starts a new epoch like a change of the connection state */
+void                    xfce_displays_edid_cache_invalidate    (XfceDisplaysEdidCache *cache,
+                                                                RROutput               output);
+
+/* fetched from the backend once per epoch */
+const XfceDisplaysEdid *xfce_displays_edid_cache_lookup        (XfceDisplaysEdidCache *cache,
+                                                                RROutput               output);
+
+#endif /* !__DISPLAYS_EDID_H__ */
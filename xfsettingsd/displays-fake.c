@@ -0,0 +1,1103 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * An in-memory RandR screen, used instead of the server when
+ * XFSETTINGSD_RANDR_FAKE points to a key file like this one:
+ *
+ *   [Screen]
+ *   # generated outputs, DP-1 to DP-8 unless named
+ *   Outputs=8
+ *   Names=eDP-1;DP-1;DP-2
+ *   # CRTCs, one per output by default
+ *   Crtcs=8
+ *   # latency added to every call, in us
+ *   Latency=200
+ *   # time in ms after the helper starts watching, action and output;
+ *   # swap puts another monitor on the output, with a new EDID
+ *   Steps=1000:unplug:DP-2;2500:plug:DP-2;4000:swap:DP-1
+ *
+ *   [DP-1]
+ *   Connected=false
+ *   Modes=2560x1440@60;1920x1080@60
+ *   Size=600x340
+ *
+ * Every call is counted in the displays metrics.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <glib.h>
+
+#include <X11/extensions/Xrandr.h>
+
+#include "debug.h"
+#include "displays-backend.h"
+#include "metrics.h"
+
+#define FAKE_SCREEN_GROUP "Screen"
+#define FAKE_MAX_SIZE     32768
+
+/* ids of the different objects, like the server they never overlap */
+#define FAKE_MODE_BASE    0x100
+#define FAKE_CRTC_BASE    0x400
+#define FAKE_OUTPUT_BASE  0x800
+
+
+
+typedef enum
+{
+    FAKE_CALL_GET_SCREEN_RESOURCES,
+    FAKE_CALL_GET_OUTPUT_INFO,
+    FAKE_CALL_GET_EDID,
+    FAKE_CALL_GET_CRTC_INFO,
+    FAKE_CALL_GET_CRTC_SCALE,
+    FAKE_CALL_SET_CRTC_CONFIG,
+    FAKE_CALL_SET_CRTC_SCALE,
+    FAKE_CALL_SET_OUTPUT_PRIMARY,
+    FAKE_CALL_GET_SCREEN_SIZE_RANGE,
+    FAKE_CALL_SET_SCREEN_SIZE,
+    FAKE_N_CALLS
+}
+FakeCall;
+
+typedef struct _FakeOutput FakeOutput;
+struct _FakeOutput
+{
+    RROutput  id;
+    gchar    *name;
+    gboolean  connected;
+    gulong    mm_width;
+    gulong    mm_height;
+    RRMode   *modes;
+    gint      nmode;
+    RRCrtc    crtc;
+    guint8    edid[128];
+};
+
+typedef struct _FakeCrtc FakeCrtc;
+struct _FakeCrtc
+{
+    RRCrtc    id;
+    gint      x;
+    gint      y;
+    RRMode    mode;
+    Rotation  rotation;
+    RROutput *outputs;
+    gint      noutput;
+    gdouble   scalex;
+    gdouble   scaley;
+};
+
+typedef enum
+{
+    FAKE_STEP_PLUG,
+    FAKE_STEP_UNPLUG,
+    FAKE_STEP_SWAP
+}
+FakeStepAction;
+
+typedef struct _FakeBackend FakeBackend;
+typedef struct _FakeStep    FakeStep;
+struct _FakeStep
+{
+    FakeBackend    *fake;
+    guint           delay;
+    FakeStepAction  action;
+    gchar          *output;
+};
+
+struct _FakeBackend
+{
+    XfceDisplaysBackend             __parent__;
+
+    GArray                         *modes;
+    GPtrArray                      *outputs;
+    GPtrArray                      *crtcs;
+    GPtrArray                      *steps;
+    GSList                         *step_ids;
+
+    gint                            width;
+    gint                            height;
+    gint                            mm_width;
+    gint                            mm_height;
+    RROutput                        primary;
+    Time                            timestamp;
+
+    gulong                          latency;
+    guint64                         calls[FAKE_N_CALLS];
+
+    /* monitors made so far, for the EDID of the next one */
+    guint                           n_monitors;
+
+    XfceDisplaysBackendChangedFunc  changed_func;
+    XfceDisplaysBackendEdidFunc     edid_func;
+    gpointer                        changed_data;
+    guint                           changed_id;
+};
+
+
+
+static const gchar *fake_call_names[FAKE_N_CALLS] =
+{
+    "fake-get-screen-resources",
+    "fake-get-output-info",
+    "fake-get-edid",
+    "fake-get-crtc-info",
+    "fake-get-crtc-scale",
+    "fake-set-crtc-config",
+    "fake-set-crtc-scale",
+    "fake-set-output-primary",
+    "fake-get-screen-size-range",
+    "fake-set-screen-size",
+};
+
+/* modes of the generated outputs */
+static const gchar *fake_default_modes[] =
+{
+    "2560x1440@60", "1920x1080@60", "1920x1080@50", "1280x1024@60", "1280x720@60", NULL
+};
+
+
+
+static void
+fake_backend_call (FakeBackend *fake,
+                   FakeCall     call)
+{
+    fake->calls[call]++;
+    xfsettings_metrics_count (XFSD_DEBUG_DISPLAYS, fake_call_names[call], 1);
+
+    /* the round trip to the server */
+    if (fake->latency > 0)
+        g_usleep (fake->latency);
+}
+
+
+
+static RRMode
+fake_backend_add_mode (FakeBackend *fake,
+                       const gchar *description)
+{
+    XRRModeInfo  mode;
+    guint        width, height, rate;
+    guint        n;
+    gchar       *name;
+
+    if (sscanf (description, "%ux%u@%u", &width, &height, &rate) != 3
+        || width == 0 || height == 0 || rate == 0)
+    {
+        g_warning ("Invalid fake mode \"%s\", expected WIDTHxHEIGHT@RATE", description);
+        return None;
+    }
+
+    /* modes are shared between outputs */
+    for (n = 0; n < fake->modes->len; n++)
+    {
+        XRRModeInfo *info = &g_array_index (fake->modes, XRRModeInfo, n);
+        if (info->width == width && info->height == height
+            && info->dotClock == (gulong) rate * info->hTotal * info->vTotal)
+            return info->id;
+    }
+
+    name = g_strdup_printf ("%ux%u", width, height);
+
+    memset (&mode, 0, sizeof (mode));
+    mode.id = FAKE_MODE_BASE + fake->modes->len;
+    mode.width = width;
+    mode.height = height;
+    mode.hTotal = width + 160;
+    mode.vTotal = height + 30;
+    mode.dotClock = (gulong) rate * mode.hTotal * mode.vTotal;
+    mode.name = name;
+    mode.nameLength = strlen (name);
+
+    g_array_append_val (fake->modes, mode);
+
+    return mode.id;
+}
+
+
+
+static void
+fake_backend_make_edid (FakeOutput *output,
+                        guint       index)
+{
+    static const guint8  header[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+    guint8              *edid = output->edid;
+    guint8               sum = 0;
+    gchar                name[14];
+    guint                n;
+
+    memset (edid, 0, sizeof (output->edid));
+    memcpy (edid, header, sizeof (header));
+
+    /* vendor "XFC", product and serial from the index */
+    edid[8] = (('X' - '@') << 2) | (('F' - '@') >> 3);
+    edid[9] = (('F' - '@') << 5) | ('C' - '@');
+    edid[10] = index & 0xff;
+    edid[11] = (index >> 8) & 0xff;
+    edid[12] = index & 0xff;
+    edid[16] = 1;
+    edid[17] = 2020 - 1990;
+    edid[18] = 1;
+    edid[19] = 4;
+    edid[21] = output->mm_width / 10;
+    edid[22] = output->mm_height / 10;
+
+    /* monitor name descriptor */
+    edid[54 + 3] = 0xfc;
+    g_snprintf (name, sizeof (name), "Fake %u\n", index);
+    memset (&edid[54 + 5], ' ', 13);
+    memcpy (&edid[54 + 5], name, strlen (name));
+
+    for (n = 0; n < 127; n++)
+        sum += edid[n];
+    edid[127] = (guint8) (0x100 - sum);
+}
+
+
+
+static FakeOutput *
+fake_backend_find_output (FakeBackend *fake,
+                          RROutput     id)
+{
+    guint n;
+
+    for (n = 0; n < fake->outputs->len; n++)
+        if (((FakeOutput *) g_ptr_array_index (fake->outputs, n))->id == id)
+            return g_ptr_array_index (fake->outputs, n);
+
+    return NULL;
+}
+
+
+
+static FakeCrtc *
+fake_backend_find_crtc (FakeBackend *fake,
+                        RRCrtc       id)
+{
+    guint n;
+
+    for (n = 0; n < fake->crtcs->len; n++)
+        if (((FakeCrtc *) g_ptr_array_index (fake->crtcs, n))->id == id)
+            return g_ptr_array_index (fake->crtcs, n);
+
+    return NULL;
+}
+
+
+
+static const XRRModeInfo *
+fake_backend_find_mode (FakeBackend *fake,
+                        RRMode       id)
+{
+    if (id < FAKE_MODE_BASE || id >= FAKE_MODE_BASE + fake->modes->len)
+        return NULL;
+
+    return &g_array_index (fake->modes, XRRModeInfo, id - FAKE_MODE_BASE);
+}
+
+
+
+static gboolean
+fake_backend_changed_idle (gpointer user_data)
+{
+    FakeBackend *fake = user_data;
+
+    fake->changed_id = 0;
+
+    if (fake->changed_func != NULL)
+        (*fake->changed_func) (fake->changed_data);
+
+    return FALSE;
+}
+
+
+
+static void
+fake_backend_queue_changed (FakeBackend *fake)
+{
+    /* the server sends RRScreenChangeNotify once the requests are
+     * processed, the helper sees it from the main loop */
+    if (fake->changed_func != NULL && fake->changed_id == 0)
+        fake->changed_id = g_idle_add (fake_backend_changed_idle, fake);
+}
+
+
+
+static gboolean
+fake_backend_step (gpointer user_data)
+{
+    FakeStep    *step = user_data;
+    FakeBackend *fake = step->fake;
+    FakeOutput  *output = NULL;
+    FakeCrtc    *crtc;
+    guint        n;
+    gint         m;
+
+    fake->step_ids = g_slist_remove (fake->step_ids, GUINT_TO_POINTER (g_source_get_id (g_main_current_source ())));
+
+    for (n = 0; n < fake->outputs->len && output == NULL; n++)
+        if (g_strcmp0 (((FakeOutput *) g_ptr_array_index (fake->outputs, n))->name, step->output) == 0)
+            output = g_ptr_array_index (fake->outputs, n);
+
+    if (output == NULL)
+    {
+        g_warning ("Fake step for unknown output %s", step->output);
+        return FALSE;
+    }
+
+    if (step->action == FAKE_STEP_SWAP)
+    {
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Fake monitor swap on %s.", output->name);
+
+        /* the server replaces the EDID property and reports the new
+         * configuration, the output stays connected */
+        fake_backend_make_edid (output, ++fake->n_monitors);
+        fake->timestamp++;
+
+        if (fake->edid_func != NULL)
+            (*fake->edid_func) (output->id, fake->changed_data);
+        if (fake->changed_func != NULL)
+            (*fake->changed_func) (fake->changed_data);
+
+        return FALSE;
+    }
+
+    if (output->connected == (step->action == FAKE_STEP_PLUG))
+        return FALSE;
+
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Fake %s of %s.",
+                    step->action == FAKE_STEP_PLUG ? "plug" : "unplug", output->name);
+
+    output->connected = step->action == FAKE_STEP_PLUG;
+
+    /* like the server, an unplugged output leaves its CRTC, which is
+     * disabled once it drives nothing */
+    if (!output->connected && output->crtc != None)
+    {
+        crtc = fake_backend_find_crtc (fake, output->crtc);
+        for (m = 0; crtc != NULL && m < crtc->noutput; m++)
+        {
+            if (crtc->outputs[m] == output->id)
+            {
+                crtc->outputs[m] = crtc->outputs[--crtc->noutput];
+                break;
+            }
+        }
+
+        if (crtc != NULL && crtc->noutput == 0)
+        {
+            g_free (crtc->outputs);
+            crtc->outputs = NULL;
+            crtc->mode = None;
+            crtc->x = crtc->y = 0;
+        }
+
+        output->crtc = None;
+    }
+
+    fake->timestamp++;
+
+    if (fake->changed_func != NULL)
+        (*fake->changed_func) (fake->changed_data);
+
+    return FALSE;
+}
+
+
+
+static void
+fake_backend_watch (XfceDisplaysBackend            *backend,
+                    XfceDisplaysBackendChangedFunc  func,
+                    XfceDisplaysBackendEdidFunc     edid_func,
+                    gpointer                        user_data)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    FakeStep    *step;
+    guint        n, id;
+
+    fake->changed_func = func;
+    fake->edid_func = edid_func;
+    fake->changed_data = user_data;
+
+    /* the script starts now */
+    for (n = 0; n < fake->steps->len; n++)
+    {
+        step = g_ptr_array_index (fake->steps, n);
+        id = g_timeout_add (step->delay, fake_backend_step, step);
+        fake->step_ids = g_slist_prepend (fake->step_ids, GUINT_TO_POINTER (id));
+    }
+}
+
+
+
+static void
+fake_backend_unwatch (XfceDisplaysBackend *backend)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    GSList      *li;
+
+    for (li = fake->step_ids; li != NULL; li = li->next)
+        g_source_remove (GPOINTER_TO_UINT (li->data));
+    g_slist_free (fake->step_ids);
+    fake->step_ids = NULL;
+
+    if (fake->changed_id != 0)
+    {
+        g_source_remove (fake->changed_id);
+        fake->changed_id = 0;
+    }
+
+    fake->changed_func = NULL;
+    fake->edid_func = NULL;
+}
+
+
+
+static XRRScreenResources *
+fake_backend_get_screen_resources (XfceDisplaysBackend *backend,
+                                   gboolean             current)
+{
+    FakeBackend        *fake = (FakeBackend *) backend;
+    XRRScreenResources *resources;
+    guint               n;
+
+    fake_backend_call (fake, FAKE_CALL_GET_SCREEN_RESOURCES);
+
+    resources = g_new0 (XRRScreenResources, 1);
+    resources->timestamp = fake->timestamp;
+    resources->configTimestamp = fake->timestamp;
+
+    resources->ncrtc = fake->crtcs->len;
+    resources->crtcs = g_new0 (RRCrtc, fake->crtcs->len);
+    for (n = 0; n < fake->crtcs->len; n++)
+        resources->crtcs[n] = ((FakeCrtc *) g_ptr_array_index (fake->crtcs, n))->id;
+
+    resources->noutput = fake->outputs->len;
+    resources->outputs = g_new0 (RROutput, fake->outputs->len);
+    for (n = 0; n < fake->outputs->len; n++)
+        resources->outputs[n] = ((FakeOutput *) g_ptr_array_index (fake->outputs, n))->id;
+
+    /* the names stay owned by the backend */
+    resources->nmode = fake->modes->len;
+    resources->modes = g_memdup (fake->modes->data, fake->modes->len * sizeof (XRRModeInfo));
+
+    return resources;
+}
+
+
+
+static void
+fake_backend_free_screen_resources (XfceDisplaysBackend *backend,
+                                    XRRScreenResources  *resources)
+{
+    if (resources == NULL)
+        return;
+
+    g_free (resources->crtcs);
+    g_free (resources->outputs);
+    g_free (resources->modes);
+    g_free (resources);
+}
+
+
+
+static XRROutputInfo *
+fake_backend_get_output_info (XfceDisplaysBackend *backend,
+                              XRRScreenResources  *resources,
+                              RROutput             id)
+{
+    FakeBackend   *fake = (FakeBackend *) backend;
+    FakeOutput    *output;
+    XRROutputInfo *info;
+    guint          n;
+
+    fake_backend_call (fake, FAKE_CALL_GET_OUTPUT_INFO);
+
+    output = fake_backend_find_output (fake, id);
+    if (output == NULL)
+        return NULL;
+
+    info = g_new0 (XRROutputInfo, 1);
+    info->timestamp = fake->timestamp;
+    info->crtc = output->crtc;
+    info->name = g_strdup (output->name);
+    info->nameLen = strlen (output->name);
+    info->connection = output->connected ? RR_Connected : RR_Disconnected;
+    info->subpixel_order = SubPixelUnknown;
+
+    if (output->connected)
+    {
+        info->mm_width = output->mm_width;
+        info->mm_height = output->mm_height;
+        info->nmode = output->nmode;
+        info->npreferred = output->nmode > 0 ? 1 : 0;
+        info->modes = g_memdup (output->modes, output->nmode * sizeof (RRMode));
+    }
+
+    /* every CRTC can drive every output */
+    info->ncrtc = fake->crtcs->len;
+    info->crtcs = g_new0 (RRCrtc, fake->crtcs->len);
+    for (n = 0; n < fake->crtcs->len; n++)
+        info->crtcs[n] = ((FakeCrtc *) g_ptr_array_index (fake->crtcs, n))->id;
+
+    return info;
+}
+
+
+
+static void
+fake_backend_free_output_info (XfceDisplaysBackend *backend,
+                               XRROutputInfo       *info)
+{
+    if (info == NULL)
+        return;
+
+    g_free (info->name);
+    g_free (info->crtcs);
+    g_free (info->clones);
+    g_free (info->modes);
+    g_free (info);
+}
+
+
+
+static guint8 *
+fake_backend_get_edid (XfceDisplaysBackend *backend,
+                       RROutput             id,
+                       gsize               *length)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    FakeOutput  *output;
+
+    fake_backend_call (fake, FAKE_CALL_GET_EDID);
+
+    *length = 0;
+
+    output = fake_backend_find_output (fake, id);
+    if (output == NULL || !output->connected)
+        return NULL;
+
+    *length = sizeof (output->edid);
+
+    return g_memdup (output->edid, sizeof (output->edid));
+}
+
+
+
+static XRRCrtcInfo *
+fake_backend_get_crtc_info (XfceDisplaysBackend *backend,
+                            XRRScreenResources  *resources,
+                            RRCrtc               id)
+{
+    FakeBackend       *fake = (FakeBackend *) backend;
+    FakeCrtc          *crtc;
+    XRRCrtcInfo       *info;
+    const XRRModeInfo *mode;
+    guint              n;
+
+    fake_backend_call (fake, FAKE_CALL_GET_CRTC_INFO);
+
+    crtc = fake_backend_find_crtc (fake, id);
+    if (crtc == NULL)
+        return NULL;
+
+    info = g_new0 (XRRCrtcInfo, 1);
+    info->timestamp = fake->timestamp;
+    info->x = crtc->x;
+    info->y = crtc->y;
+    info->mode = crtc->mode;
+    info->rotation = crtc->rotation;
+    info->rotations = RR_Rotate_0 | RR_Rotate_90 | RR_Rotate_180 | RR_Rotate_270
+                      | RR_Reflect_X | RR_Reflect_Y;
+
+    mode = fake_backend_find_mode (fake, crtc->mode);
+    if (mode != NULL)
+    {
+        if ((crtc->rotation & (RR_Rotate_90 | RR_Rotate_270)) != 0)
+        {
+            info->width = mode->height;
+            info->height = mode->width;
+        }
+        else
+        {
+            info->width = mode->width;
+            info->height = mode->height;
+        }
+    }
+
+    info->noutput = crtc->noutput;
+    info->outputs = g_memdup (crtc->outputs, crtc->noutput * sizeof (RROutput));
+
+    info->npossible = fake->outputs->len;
+    info->possible = g_new0 (RROutput, fake->outputs->len);
+    for (n = 0; n < fake->outputs->len; n++)
+        info->possible[n] = ((FakeOutput *) g_ptr_array_index (fake->outputs, n))->id;
+
+    return info;
+}
+
+
+
+static void
+fake_backend_free_crtc_info (XfceDisplaysBackend *backend,
+                             XRRCrtcInfo         *info)
+{
+    if (info == NULL)
+        return;
+
+    g_free (info->outputs);
+    g_free (info->possible);
+    g_free (info);
+}
+
+
+
+static void
+fake_backend_get_crtc_scale (XfceDisplaysBackend *backend,
+                             RRCrtc               id,
+                             gdouble             *scalex,
+                             gdouble             *scaley)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    FakeCrtc    *crtc;
+
+    fake_backend_call (fake, FAKE_CALL_GET_CRTC_SCALE);
+
+    crtc = fake_backend_find_crtc (fake, id);
+    *scalex = crtc != NULL ? crtc->scalex : 1.0;
+    *scaley = crtc != NULL ? crtc->scaley : 1.0;
+}
+
+
+
+static Status
+fake_backend_set_crtc_config (XfceDisplaysBackend *backend,
+                              XRRScreenResources  *resources,
+                              RRCrtc               id,
+                              gint                 x,
+                              gint                 y,
+                              RRMode               mode,
+                              Rotation             rotation,
+                              RROutput            *outputs,
+                              gint                 noutputs)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    FakeCrtc    *crtc;
+    FakeOutput  *output;
+    gint         n;
+
+    fake_backend_call (fake, FAKE_CALL_SET_CRTC_CONFIG);
+
+    crtc = fake_backend_find_crtc (fake, id);
+    if (crtc == NULL || (mode != None && fake_backend_find_mode (fake, mode) == NULL))
+        return RRSetConfigFailed;
+
+    /* detach the current outputs */
+    for (n = 0; n < crtc->noutput; n++)
+    {
+        output = fake_backend_find_output (fake, crtc->outputs[n]);
+        if (output != NULL && output->crtc == crtc->id)
+            output->crtc = None;
+    }
+
+    crtc->x = x;
+    crtc->y = y;
+    crtc->mode = mode;
+    crtc->rotation = rotation;
+
+    g_free (crtc->outputs);
+    crtc->outputs = NULL;
+    crtc->noutput = 0;
+
+    if (mode != None && noutputs > 0)
+    {
+        crtc->outputs = g_memdup (outputs, noutputs * sizeof (RROutput));
+        crtc->noutput = noutputs;
+
+        for (n = 0; n < noutputs; n++)
+        {
+            output = fake_backend_find_output (fake, outputs[n]);
+            if (output != NULL)
+                output->crtc = crtc->id;
+        }
+    }
+
+    fake->timestamp++;
+    fake_backend_queue_changed (fake);
+
+    return RRSetConfigSuccess;
+}
+
+
+
+static void
+fake_backend_set_crtc_scale (XfceDisplaysBackend *backend,
+                             RRCrtc               id,
+                             gdouble              scalex,
+                             gdouble              scaley)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    FakeCrtc    *crtc;
+
+    fake_backend_call (fake, FAKE_CALL_SET_CRTC_SCALE);
+
+    crtc = fake_backend_find_crtc (fake, id);
+    if (crtc != NULL)
+    {
+        crtc->scalex = scalex;
+        crtc->scaley = scaley;
+    }
+}
+
+
+
+static void
+fake_backend_set_output_primary (XfceDisplaysBackend *backend,
+                                 RROutput             output)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+
+    fake_backend_call (fake, FAKE_CALL_SET_OUTPUT_PRIMARY);
+
+    fake->primary = output;
+}
+
+
+
+static gboolean
+fake_backend_get_screen_size_range (XfceDisplaysBackend *backend,
+                                    gint                *min_width,
+                                    gint                *min_height,
+                                    gint                *max_width,
+                                    gint                *max_height)
+{
+    fake_backend_call ((FakeBackend *) backend, FAKE_CALL_GET_SCREEN_SIZE_RANGE);
+
+    *min_width = *min_height = 8;
+    *max_width = *max_height = FAKE_MAX_SIZE;
+
+    return TRUE;
+}
+
+
+
+static void
+fake_backend_get_screen_size (XfceDisplaysBackend *backend,
+                              gint                *width,
+                              gint                *height,
+                              gint                *mm_width,
+                              gint                *mm_height)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+
+    /* no round trip, gdk keeps the size */
+    *width = fake->width;
+    *height = fake->height;
+    *mm_width = fake->mm_width;
+    *mm_height = fake->mm_height;
+}
+
+
+
+static void
+fake_backend_set_screen_size (XfceDisplaysBackend *backend,
+                              gint                 width,
+                              gint                 height,
+                              gint                 mm_width,
+                              gint                 mm_height)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+
+    fake_backend_call (fake, FAKE_CALL_SET_SCREEN_SIZE);
+
+    fake->width = width;
+    fake->height = height;
+    fake->mm_width = mm_width;
+    fake->mm_height = mm_height;
+
+    fake_backend_queue_changed (fake);
+}
+
+
+
+static void
+fake_backend_begin_changes (XfceDisplaysBackend *backend)
+{
+}
+
+
+
+static gint
+fake_backend_end_changes (XfceDisplaysBackend *backend)
+{
+    return 0;
+}
+
+
+
+static void
+fake_backend_free_output (gpointer data)
+{
+    FakeOutput *output = data;
+
+    g_free (output->name);
+    g_free (output->modes);
+    g_slice_free (FakeOutput, output);
+}
+
+
+
+static void
+fake_backend_free_crtc (gpointer data)
+{
+    FakeCrtc *crtc = data;
+
+    g_free (crtc->outputs);
+    g_slice_free (FakeCrtc, crtc);
+}
+
+
+
+static void
+fake_backend_free_step (gpointer data)
+{
+    FakeStep *step = data;
+
+    g_free (step->output);
+    g_slice_free (FakeStep, step);
+}
+
+
+
+static void
+fake_backend_free (XfceDisplaysBackend *backend)
+{
+    FakeBackend *fake = (FakeBackend *) backend;
+    guint        n;
+
+    fake_backend_unwatch (backend);
+
+    for (n = 0; n < FAKE_N_CALLS; n++)
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "%s: %" G_GUINT64_FORMAT " calls",
+                        fake_call_names[n], fake->calls[n]);
+
+    for (n = 0; n < fake->modes->len; n++)
+        g_free (g_array_index (fake->modes, XRRModeInfo, n).name);
+    g_array_free (fake->modes, TRUE);
+
+    g_ptr_array_free (fake->outputs, TRUE);
+    g_ptr_array_free (fake->crtcs, TRUE);
+    g_ptr_array_free (fake->steps, TRUE);
+
+    g_slice_free (FakeBackend, fake);
+}
+
+
+
+static gboolean
+fake_backend_load (FakeBackend  *fake,
+                   GKeyFile     *keyfile,
+                   GError      **error)
+{
+    FakeOutput  *output;
+    FakeCrtc    *crtc;
+    FakeStep    *step;
+    gchar      **names;
+    gchar      **modes;
+    gchar      **steps;
+    gchar      **parts;
+    gchar       *size;
+    gint         noutputs, ncrtcs;
+    gint         n, m;
+    gsize        len;
+    RRMode       mode;
+
+    noutputs = g_key_file_get_integer (keyfile, FAKE_SCREEN_GROUP, "Outputs", NULL);
+    if (noutputs <= 0)
+        noutputs = 2;
+
+    ncrtcs = g_key_file_get_integer (keyfile, FAKE_SCREEN_GROUP, "Crtcs", NULL);
+    if (ncrtcs <= 0)
+        ncrtcs = noutputs;
+
+    fake->latency = MAX (g_key_file_get_integer (keyfile, FAKE_SCREEN_GROUP, "Latency", NULL), 0);
+
+    names = g_key_file_get_string_list (keyfile, FAKE_SCREEN_GROUP, "Names", &len, NULL);
+
+    for (n = 0; n < ncrtcs; n++)
+    {
+        crtc = g_slice_new0 (FakeCrtc);
+        crtc->id = FAKE_CRTC_BASE + n;
+        crtc->rotation = RR_Rotate_0;
+        crtc->scalex = crtc->scaley = 1.0;
+        g_ptr_array_add (fake->crtcs, crtc);
+    }
+
+    for (n = 0; n < noutputs; n++)
+    {
+        output = g_slice_new0 (FakeOutput);
+        output->id = FAKE_OUTPUT_BASE + n;
+        output->crtc = None;
+
+        if (names != NULL && (gsize) n < len)
+            output->name = g_strdup (names[n]);
+        else
+            output->name = g_strdup_printf ("DP-%d", n + 1);
+
+        output->connected = g_key_file_has_key (keyfile, output->name, "Connected", NULL)
+                            ? g_key_file_get_boolean (keyfile, output->name, "Connected", NULL)
+                            : TRUE;
+
+        output->mm_width = 600;
+        output->mm_height = 340;
+        size = g_key_file_get_string (keyfile, output->name, "Size", NULL);
+        if (size != NULL && sscanf (size, "%lux%lu", &output->mm_width, &output->mm_height) != 2)
+            g_warning ("Invalid fake size \"%s\" for %s", size, output->name);
+        g_free (size);
+
+        modes = g_key_file_get_string_list (keyfile, output->name, "Modes", NULL, NULL);
+        if (modes == NULL)
+            modes = g_strdupv ((gchar **) fake_default_modes);
+
+        output->modes = g_new0 (RRMode, g_strv_length (modes));
+        for (m = 0; modes[m] != NULL; m++)
+        {
+            mode = fake_backend_add_mode (fake, modes[m]);
+            if (mode != None)
+                output->modes[output->nmode++] = mode;
+        }
+        g_strfreev (modes);
+
+        fake_backend_make_edid (output, ++fake->n_monitors);
+
+        g_ptr_array_add (fake->outputs, output);
+    }
+
+    g_strfreev (names);
+
+    steps = g_key_file_get_string_list (keyfile, FAKE_SCREEN_GROUP, "Steps", NULL, NULL);
+    for (n = 0; steps != NULL && steps[n] != NULL; n++)
+    {
+        parts = g_strsplit (steps[n], ":", 3);
+        if (g_strv_length (parts) != 3
+            || (strcmp (parts[1], "plug") != 0 && strcmp (parts[1], "unplug") != 0
+                && strcmp (parts[1], "swap") != 0))
+        {
+            g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                         "Invalid step \"%s\", expected DELAY:plug|unplug|swap:OUTPUT", steps[n]);
+            g_strfreev (parts);
+            g_strfreev (steps);
+            return FALSE;
+        }
+
+        step = g_slice_new0 (FakeStep);
+        step->fake = fake;
+        step->delay = strtoul (parts[0], NULL, 10);
+        if (strcmp (parts[1], "plug") == 0)
+            step->action = FAKE_STEP_PLUG;
+        else if (strcmp (parts[1], "unplug") == 0)
+            step->action = FAKE_STEP_UNPLUG;
+        else
+            step->action = FAKE_STEP_SWAP;
+        step->output = g_strdup (parts[2]);
+        g_ptr_array_add (fake->steps, step);
+
+        g_strfreev (parts);
+    }
+    g_strfreev (steps);
+
+    return TRUE;
+}
+
+
+
+XfceDisplaysBackend *
+xfce_displays_backend_fake_new (const gchar  *filename,
+                                GError      **error)
+{
+    FakeBackend         *fake;
+    XfceDisplaysBackend *backend;
+    GKeyFile            *keyfile;
+
+    g_return_val_if_fail (filename != NULL, NULL);
+
+    keyfile = g_key_file_new ();
+    if (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, error))
+    {
+        g_key_file_free (keyfile);
+        return NULL;
+    }
+
+    fake = g_slice_new0 (FakeBackend);
+    fake->modes = g_array_new (FALSE, TRUE, sizeof (XRRModeInfo));
+    fake->outputs = g_ptr_array_new_with_free_func (fake_backend_free_output);
+    fake->crtcs = g_ptr_array_new_with_free_func (fake_backend_free_crtc);
+    fake->steps = g_ptr_array_new_with_free_func (fake_backend_free_step);
+    fake->timestamp = 1;
+
+    backend = (XfceDisplaysBackend *) fake;
+    backend->name = "fake";
+    backend->major_version = 1;
+    backend->minor_version = 5;
+    backend->watch = fake_backend_watch;
+    backend->unwatch = fake_backend_unwatch;
+    backend->get_screen_resources = fake_backend_get_screen_resources;
+    backend->free_screen_resources = fake_backend_free_screen_resources;
+    backend->get_output_info = fake_backend_get_output_info;
+    backend->free_output_info = fake_backend_free_output_info;
+    backend->get_edid = fake_backend_get_edid;
+    backend->get_crtc_info = fake_backend_get_crtc_info;
+    backend->free_crtc_info = fake_backend_free_crtc_info;
+    backend->get_crtc_scale = fake_backend_get_crtc_scale;
+    backend->set_crtc_config = fake_backend_set_crtc_config;
+    backend->set_crtc_scale = fake_backend_set_crtc_scale;
+    backend->set_output_primary = fake_backend_set_output_primary;
+    backend->get_screen_size_range = fake_backend_get_screen_size_range;
+    backend->get_screen_size = fake_backend_get_screen_size;
+    backend->set_screen_size = fake_backend_set_screen_size;
+    backend->begin_changes = fake_backend_begin_changes;
+    backend->end_changes = fake_backend_end_changes;
+    backend->free = fake_backend_free;
+
+    if (!fake_backend_load (fake, keyfile, error))
+    {
+        fake_backend_free (backend);
+        backend = NULL;
+    }
+    else
+    {
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Fake RandR screen with %u outputs, %u CRTCs, %u modes.",
+                        fake->outputs->len, fake->crtcs->len, fake->modes->len);
+    }
+
+    g_key_file_free (keyfile);
+
+    return backend;
+}
@@ -39,8 +39,15 @@
 #include "common/display-profiles.h"
 #include "common/xfce-randr.h"
 
+#include "channel-cache.h"
 #include "debug.h"
 #include "displays.h"
+#include "displays-backend.h"
+#include "displays-edid.h"
+#include "metrics.h"
+#include "launcher.h"
+#include "replay.h"
+#include "trace.h"
 #ifdef HAVE_UPOWERGLIB
 #include "displays-upower.h"
 #endif
@@ -79,14 +86,45 @@ typedef struct _XfceRROutput XfceRROutput;
 
 
 
+/* steps of the job that follows screen change events */
+typedef enum
+{
+    XFCE_DISPLAYS_STAGE_PLAN,
+    XFCE_DISPLAYS_STAGE_APPLY
+}
+XfceDisplaysStage;
+
+/* what the plan stage decided to do */
+typedef enum
+{
+    XFCE_DISPLAYS_SCREEN_DEFAULT  = 1 << 0, /* the active profile is Default again */
+    XFCE_DISPLAYS_SCREEN_APPLY    = 1 << 1, /* apply the changed crtcs */
+    XFCE_DISPLAYS_SCREEN_INTERNAL = 1 << 2, /* re-enable the internal output */
+    XFCE_DISPLAYS_SCREEN_NOTIFY   = 1 << 3  /* start the minimal dialog */
+}
+XfceDisplaysScreenActions;
+
+
+
+/* only plan layouts, set by xfsettingsd --dry-run */
+static gboolean xfsettingsd_displays_dry_run = FALSE;
+
+/* the running helper, for the D-Bus methods */
+static XfceDisplaysHelper *xfsettingsd_displays_helper = NULL;
+
+
+
 static void             xfce_displays_helper_dispose                        (GObject                 *object);
 static void             xfce_displays_helper_finalize                       (GObject                 *object);
 static void             xfce_displays_helper_reload                         (XfceDisplaysHelper      *helper);
 static gchar           *xfce_displays_helper_get_matching_profile           (XfceDisplaysHelper      *helper);
-static GdkFilterReturn  xfce_displays_helper_screen_on_event                (GdkXEvent               *xevent,
-                                                                             GdkEvent                *event,
+static void             xfce_displays_helper_screen_changed                 (gpointer                 data);
+static void             xfce_displays_helper_edid_changed                   (RROutput                 output,
                                                                              gpointer                 data);
-static void             xfce_displays_helper_set_screen_size                (XfceDisplaysHelper      *helper);
+static gboolean         xfce_displays_helper_screen_job                     (gpointer                 data);
+static gboolean         xfce_displays_helper_screen_plan                    (XfceDisplaysHelper      *helper);
+static void             xfce_displays_helper_screen_apply                   (XfceDisplaysHelper      *helper);
+static gboolean         xfce_displays_helper_check_screen_size              (XfceDisplaysHelper      *helper);
 static gboolean         xfce_displays_helper_load_from_xfconf               (XfceDisplaysHelper      *helper,
                                                                              const gchar             *scheme,
                                                                              GHashTable              *saved_outputs,
@@ -96,6 +134,8 @@ static void             xfce_displays_helper_free_output                    (Xfc
 static GPtrArray       *xfce_displays_helper_list_crtcs                     (XfceDisplaysHelper      *helper);
 static XfceRRCrtc      *xfce_displays_helper_find_crtc_by_id                (XfceDisplaysHelper      *helper,
                                                                              RRCrtc                   id);
+static XfceRRCrtc      *xfce_displays_helper_copy_crtc                      (const XfceRRCrtc        *crtc);
+static GPtrArray       *xfce_displays_helper_copy_crtcs                     (GPtrArray               *crtcs);
 static void             xfce_displays_helper_free_crtc                      (XfceRRCrtc              *crtc);
 static XfceRRCrtc      *xfce_displays_helper_find_usable_crtc               (XfceDisplaysHelper      *helper,
                                                                              XfceRROutput            *output);
@@ -105,7 +145,7 @@ static void             xfce_displays_helper_normalize_crtc                 (Xfc
                                                                              XfceDisplaysHelper      *helper);
 static Status           xfce_displays_helper_disable_crtc                   (XfceDisplaysHelper      *helper,
                                                                              RRCrtc                   crtc);
-static void             xfce_displays_helper_workaround_crtc_size           (XfceRRCrtc              *crtc,
+static gboolean         xfce_displays_helper_check_crtc_size                (XfceRRCrtc              *crtc,
                                                                              XfceDisplaysHelper      *helper);
 static void             xfce_displays_helper_apply_crtc_transform           (XfceRRCrtc              *crtc,
                                                                              XfceDisplaysHelper      *helper);
@@ -113,13 +153,31 @@ static void             xfce_displays_helper_apply_crtc                     (Xfc
                                                                              XfceDisplaysHelper      *helper);
 static void             xfce_displays_helper_set_outputs                    (XfceRRCrtc              *crtc,
                                                                              XfceRROutput            *output);
-static void             xfce_displays_helper_apply_all                      (XfceDisplaysHelper      *helper);
-static void             xfce_displays_helper_channel_apply                  (XfceDisplaysHelper      *helper,
+static gboolean         xfce_displays_helper_apply_all                      (XfceDisplaysHelper      *helper,
+                                                                             guint                   *n_changed);
+static gboolean         xfce_displays_helper_load_scheme                    (XfceDisplaysHelper      *helper,
                                                                              const gchar             *scheme);
+static XfceDisplaysApplyStatus xfce_displays_helper_channel_apply           (XfceDisplaysHelper      *helper,
+                                                                             const gchar             *scheme,
+                                                                             guint                   *n_changed);
 static void             xfce_displays_helper_channel_property_changed       (XfconfChannel           *channel,
                                                                              const gchar             *property_name,
                                                                              const GValue            *value,
                                                                              XfceDisplaysHelper      *helper);
+static XfceRROutput    *xfce_displays_helper_find_internal                  (XfceDisplaysHelper      *helper);
+static void             xfce_displays_helper_resolve_internal               (XfceDisplaysHelper      *helper);
+static gboolean         xfce_displays_helper_prepare_internal               (XfceDisplaysHelper      *helper,
+                                                                             XfceRROutput            *lvds,
+                                                                             gboolean                 lid_is_closed);
+static GPtrArray       *xfce_displays_helper_plan_lid                       (XfceDisplaysHelper      *helper,
+                                                                             XfceRROutput            *lvds,
+                                                                             gboolean                 lid_is_closed);
+static void             xfce_displays_helper_update_lid_plans               (XfceDisplaysHelper      *helper);
+static void             xfce_displays_helper_free_lid_plans                 (XfceDisplaysHelper      *helper);
+#ifdef HAVE_UPOWERGLIB
+static gboolean         xfce_displays_helper_lid_plans_idle                 (gpointer                 data);
+#endif
+static void             xfce_displays_helper_invalidate_lid_plans           (XfceDisplaysHelper      *helper);
 static void             xfce_displays_helper_toggle_internal                (gpointer                *power,
                                                                              gboolean                 lid_is_closed,
                                                                              XfceDisplaysHelper      *helper);
@@ -139,6 +197,16 @@ struct _XfceDisplaysHelper
     XfconfChannel      *channel;
     guint               handler;
 
+    /* screen change job, its stage and plan */
+    guint               screen_id;
+    XfceDisplaysStage   screen_stage;
+    gboolean            screen_pending;
+    gboolean            screen_edids_changed;
+    GPtrArray          *screen_outputs;
+    GPtrArray          *screen_crtcs;
+    gchar              *screen_profile;
+    guint               screen_actions;
+
 #ifdef HAS_RANDR_ONE_POINT_THREE
     gint                has_1_3;
     gint                primary;
@@ -147,12 +215,25 @@ struct _XfceDisplaysHelper
 #ifdef HAVE_UPOWERGLIB
     XfceDisplaysUPower *power;
     gint                phandler;
+    guint               lid_plan_id;
+#endif
+
+    /* internal panel and the crtcs for an open and a closed lid, built
+     * ahead of the lid events; a NULL plan means nothing to change */
+    RROutput            internal;
+    GPtrArray          *lid_plans[2];
+    gboolean            lid_plans_valid;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    gint                lid_primary[2];
 #endif
 
     GdkDisplay         *display;
-    GdkWindow          *root_window;
-    Display            *xdisplay;
-    gint                event_base;
+
+    /* RandR access, the server or a fake screen */
+    XfceDisplaysBackend *backend;
+
+    /* EDID per output and connection epoch */
+    XfceDisplaysEdidCache *edids;
 
     /* RandR cache */
     XRRScreenResources *resources;
@@ -191,10 +272,11 @@ struct _XfceRRCrtc
 
 struct _XfceRROutput
 {
-    RROutput       id;
-    XRROutputInfo *info;
-    RRMode         preferred_mode;
-    guint          active : 1;
+    RROutput             id;
+    XfceDisplaysBackend *backend;
+    XRROutputInfo       *info;
+    RRMode               preferred_mode;
+    guint                active : 1;
 };
 
 
@@ -216,114 +298,140 @@ xfce_displays_helper_class_init (XfceDisplaysHelperClass *klass)
 static void
 xfce_displays_helper_init (XfceDisplaysHelper *helper)
 {
-    gint major = 0, minor = 0;
-    gint error_base, err;
+    const gchar *fake;
+    GHashTable  *packed;
+    GError      *error = NULL;
+    gint         err;
 
 #ifdef HAVE_UPOWERGLIB
     helper->power = NULL;
     helper->phandler = 0;
+    helper->lid_plan_id = 0;
 #endif
+    helper->internal = None;
+    helper->lid_plans[0] = helper->lid_plans[1] = NULL;
+    helper->lid_plans_valid = FALSE;
     helper->resources = NULL;
     helper->outputs = NULL;
     helper->crtcs = NULL;
     helper->handler = 0;
+    helper->screen_id = 0;
+    helper->screen_pending = FALSE;
+    helper->screen_outputs = NULL;
+    helper->screen_crtcs = NULL;
+    helper->screen_profile = NULL;
+    helper->screen_actions = 0;
 
     /* get the default display */
     helper->display = gdk_display_get_default ();
-    helper->xdisplay = gdk_x11_display_get_xdisplay (helper->display);
-    helper->root_window = gdk_get_default_root_window ();
 
-    /* check if the randr extension is running */
-    if (XRRQueryExtension (helper->xdisplay, &helper->event_base, &error_base))
+    /* benchmark against a scripted screen instead of the server */
+    fake = g_getenv ("XFSETTINGSD_RANDR_FAKE");
+    if (G_UNLIKELY (fake != NULL))
     {
-        /* query the version */
-        if (XRRQueryVersion (helper->xdisplay, &major, &minor)
-            && (major > 1 || (major == 1 && minor >= 2)))
+        helper->backend = xfce_displays_backend_fake_new (fake, &error);
+        if (helper->backend == NULL)
         {
-            gdk_x11_display_error_trap_push (helper->display);
-            /* get the screen resource */
-            helper->resources = XRRGetScreenResources (helper->xdisplay,
-                                                       GDK_WINDOW_XID (helper->root_window));
-            gdk_display_flush (helper->display);
-            err = gdk_x11_display_error_trap_pop (helper->display);
-            if (err)
-            {
-                g_critical ("XRRGetScreenResources failed (err: %d). "
-                            "Display settings won't be applied.", err);
-                return;
-            }
+            g_warning ("Failed to load the fake RandR screen %s: %s", fake, error->message);
+            g_error_free (error);
+        }
+    }
 
-            /* get all existing CRTCs and connected outputs */
-            helper->crtcs = xfce_displays_helper_list_crtcs (helper);
-            helper->outputs = xfce_displays_helper_list_outputs (helper);
-
-            /* Set up RandR notifications */
-            XRRSelectInput (helper->xdisplay,
-                            GDK_WINDOW_XID (helper->root_window),
-                            RRScreenChangeNotifyMask);
-            gdk_x11_register_standard_event_type (helper->display,
-                                                  helper->event_base,
-                                                  RRNotify + 1);
-            gdk_window_add_filter (helper->root_window,
-                                   xfce_displays_helper_screen_on_event,
-                                   helper);
+    if (helper->backend == NULL)
+        helper->backend = xfce_displays_backend_xlib_new (helper->display);
 
-#ifdef HAVE_UPOWERGLIB
-            helper->power = g_object_new (XFCE_TYPE_DISPLAYS_UPOWER, NULL);
-            helper->phandler = g_signal_connect (G_OBJECT (helper->power),
-                                                 "lid-changed",
-                                                 G_CALLBACK (xfce_displays_helper_toggle_internal),
-                                                 helper);
+    /* no randr extension or too old */
+    if (helper->backend == NULL)
+        return;
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->has_1_3 = (helper->backend->major_version > 1
+                       || (helper->backend->major_version == 1 && helper->backend->minor_version >= 3));
 #endif
 
-            /* open the channel */
-            helper->channel = xfconf_channel_get ("displays");
+    helper->edids = xfce_displays_edid_cache_new (helper->backend);
+
+    gdk_x11_display_error_trap_push (helper->display);
+    /* get the screen resource */
+    helper->resources = helper->backend->get_screen_resources (helper->backend, FALSE);
+    gdk_display_flush (helper->display);
+    err = gdk_x11_display_error_trap_pop (helper->display);
+    if (err || helper->resources == NULL)
+    {
+        g_critical ("XRRGetScreenResources failed (err: %d). "
+                    "Display settings won't be applied.", err);
+        return;
+    }
+
+    /* get all existing CRTCs and connected outputs */
+    helper->crtcs = xfce_displays_helper_list_crtcs (helper);
+    helper->outputs = xfce_displays_helper_list_outputs (helper);
+    xfce_displays_helper_resolve_internal (helper);
+
+    xfsettingsd_displays_helper = helper;
 
-            /* remove any leftover apply property before setting the monitor */
-            xfconf_channel_reset_property (helper->channel, APPLY_SCHEME_PROP, FALSE);
-            xfconf_channel_set_string (helper->channel, ACTIVE_PROFILE, DEFAULT_SCHEME_NAME);
+    /* leave the server and the channel alone */
+    if (xfsettingsd_displays_dry_run)
+    {
+        helper->channel = xfconf_channel_get ("displays");
+        return;
+    }
 
-            /* monitor channel changes */
-            helper->handler = g_signal_connect (G_OBJECT (helper->channel),
-                                                "property-changed",
-                                                G_CALLBACK (xfce_displays_helper_channel_property_changed),
-                                                helper);
+    /* Set up RandR notifications */
+    helper->backend->watch (helper->backend, xfce_displays_helper_screen_changed,
+                            xfce_displays_helper_edid_changed, helper);
 
-#ifdef HAS_RANDR_ONE_POINT_THREE
-            helper->has_1_3 = (major > 1 || (major == 1 && minor >= 3));
+#ifdef HAVE_UPOWERGLIB
+    helper->power = g_object_new (XFCE_TYPE_DISPLAYS_UPOWER, NULL);
+    helper->phandler = g_signal_connect (G_OBJECT (helper->power),
+                                         "lid-changed",
+                                         G_CALLBACK (xfce_displays_helper_toggle_internal),
+                                         helper);
 #endif
 
-            /*  check if we can auto-enable a profile */
-            if (xfconf_channel_get_bool (helper->channel, AUTO_ENABLE_PROFILES, FALSE) &&
-                xfconf_channel_get_bool (helper->channel, NOTIFY_PROP, FALSE))
-            {
-                gchar *matching_profile = NULL;
+    /* open the channel */
+    helper->channel = xfconf_channel_get ("displays");
 
-                matching_profile = xfce_displays_helper_get_matching_profile (helper);
-                if (matching_profile)
-                {
-                    xfce_displays_helper_channel_apply (helper, matching_profile);
-                }
-                else {
-                    xfce_displays_helper_channel_apply (helper, DEFAULT_SCHEME_NAME);
-                }
-            }
-            /* restore the default scheme */
-            else {
-                xfce_displays_helper_channel_apply (helper, DEFAULT_SCHEME_NAME);
-            }
-        }
-        else
+    /* remove any leftover apply property before setting the monitor */
+    xfsettings_replay_ignore_push ();
+    xfconf_channel_reset_property (helper->channel, APPLY_SCHEME_PROP, FALSE);
+    xfconf_channel_set_string (helper->channel, ACTIVE_PROFILE, DEFAULT_SCHEME_NAME);
+    xfsettings_replay_ignore_pop ();
+
+    /* the per-scheme copies of earlier builds are not read anymore */
+    packed = xfsettings_channel_cache_get_properties (helper->channel, "/Schemes/Packed");
+    if (packed != NULL)
+    {
+        xfsettings_replay_ignore_push ();
+        xfconf_channel_reset_property (helper->channel, "/Schemes/Packed", TRUE);
+        xfsettings_replay_ignore_pop ();
+        g_hash_table_destroy (packed);
+    }
+
+    /* monitor channel changes */
+    helper->handler = g_signal_connect (G_OBJECT (helper->channel),
+                                        "property-changed",
+                                        G_CALLBACK (xfce_displays_helper_channel_property_changed),
+                                        helper);
+
+    /*  check if we can auto-enable a profile */
+    if (xfsettings_channel_cache_get_bool (helper->channel, AUTO_ENABLE_PROFILES, FALSE) &&
+        xfsettings_channel_cache_get_bool (helper->channel, NOTIFY_PROP, FALSE))
+    {
+        gchar *matching_profile = NULL;
+
+        matching_profile = xfce_displays_helper_get_matching_profile (helper);
+        if (matching_profile)
         {
-             g_critical ("RANDR extension is too old, version %d.%d. "
-                         "Display settings won't be applied.",
-                         major, minor);
+            xfce_displays_helper_channel_apply (helper, matching_profile, NULL);
+        }
+        else {
+            xfce_displays_helper_channel_apply (helper, DEFAULT_SCHEME_NAME, NULL);
         }
     }
-    else
-    {
-        g_critical ("No RANDR extension found in display %s. Display settings won't be applied.",
-                    gdk_display_get_name (helper->display));
+    /* restore the default scheme */
+    else {
+        xfce_displays_helper_channel_apply (helper, DEFAULT_SCHEME_NAME, NULL);
     }
 }
 
@@ -349,11 +457,39 @@ xfce_displays_helper_dispose (GObject *object)
         g_object_unref (helper->power);
         helper->phandler = 0;
     }
+
+    if (helper->lid_plan_id != 0)
+    {
+        g_source_remove (helper->lid_plan_id);
+        helper->lid_plan_id = 0;
+    }
 #endif
 
-    gdk_window_remove_filter (helper->root_window,
-                              xfce_displays_helper_screen_on_event,
-                              helper);
+    xfce_displays_helper_free_lid_plans (helper);
+
+    if (helper->backend != NULL)
+        helper->backend->unwatch (helper->backend);
+
+    if (helper->screen_id != 0)
+    {
+        g_source_remove (helper->screen_id);
+        helper->screen_id = 0;
+    }
+
+    if (helper->screen_outputs)
+    {
+        g_ptr_array_unref (helper->screen_outputs);
+        helper->screen_outputs = NULL;
+    }
+
+    if (helper->screen_crtcs)
+    {
+        g_ptr_array_unref (helper->screen_crtcs);
+        helper->screen_crtcs = NULL;
+    }
+
+    if (xfsettingsd_displays_helper == helper)
+        xfsettingsd_displays_helper = NULL;
 
     if (helper->outputs)
     {
@@ -381,7 +517,7 @@ xfce_displays_helper_finalize (GObject *object)
     if (helper->resources)
     {
         gdk_x11_display_error_trap_push (helper->display);
-        XRRFreeScreenResources (helper->resources);
+        helper->backend->free_screen_resources (helper->backend, helper->resources);
         gdk_display_flush (helper->display);
         if (gdk_x11_display_error_trap_pop (helper->display) != 0)
         {
@@ -390,6 +526,14 @@ xfce_displays_helper_finalize (GObject *object)
         helper->resources = NULL;
     }
 
+    xfce_displays_edid_cache_free (helper->edids);
+    helper->edids = NULL;
+
+    g_free (helper->screen_profile);
+
+    xfce_displays_backend_free (helper->backend);
+    helper->backend = NULL;
+
     (*G_OBJECT_CLASS (xfce_displays_helper_parent_class)->finalize) (object);
 }
 
@@ -409,20 +553,13 @@ xfce_displays_helper_reload (XfceDisplaysHelper *helper)
     gdk_x11_display_error_trap_push (helper->display);
 
     /* Free the screen resources */
-    XRRFreeScreenResources (helper->resources);
+    helper->backend->free_screen_resources (helper->backend, helper->resources);
 
     /* get the screen resource */
-#ifdef HAS_RANDR_ONE_POINT_THREE
     /* xfce_displays_helper_reload () is usually called after a xrandr notification,
        which means that X is aware of the new hardware already. So, if possible,
        do not reprobe the hardware again. */
-    if (helper->has_1_3)
-        helper->resources = XRRGetScreenResourcesCurrent (helper->xdisplay,
-                                                          GDK_WINDOW_XID (helper->root_window));
-    else
-#endif
-    helper->resources = XRRGetScreenResources (helper->xdisplay,
-                                               GDK_WINDOW_XID (helper->root_window));
+    helper->resources = helper->backend->get_screen_resources (helper->backend, TRUE);
 
     gdk_display_flush (helper->display);
     err = gdk_x11_display_error_trap_pop (helper->display);
@@ -432,32 +569,26 @@ xfce_displays_helper_reload (XfceDisplaysHelper *helper)
     /* recreate the caches */
     helper->crtcs = xfce_displays_helper_list_crtcs (helper);
     helper->outputs = xfce_displays_helper_list_outputs (helper);
+    xfce_displays_helper_resolve_internal (helper);
 }
 
 
 
 static gchar **
-xfce_displays_helper_get_display_infos (gint       noutput,
-                                        Display   *xdisplay,
-                                        GPtrArray *outputs)
+xfce_displays_helper_get_display_infos (XfceDisplaysHelper *helper)
 {
-    gchar    **display_infos;
-    gint       m;
-    guint8    *edid_data;
-
-    display_infos = g_new0 (gchar *, noutput + 1);
-    /* get all display edids, to only query randr once */
-    for (m = 0; m < noutput; ++m)
+    const XfceDisplaysEdid  *edid;
+    XfceRROutput            *output;
+    gchar                  **display_infos;
+    guint                    m;
+
+    display_infos = g_new0 (gchar *, helper->outputs->len + 1);
+    /* the edids are only fetched once per connection of the output */
+    for (m = 0; m < helper->outputs->len; ++m)
     {
-        XfceRROutput *output;
-
-        output = g_ptr_array_index (outputs, m);
-        edid_data = xfce_randr_read_edid_data (xdisplay, output->id);
-
-        if (edid_data)
-            display_infos[m] = g_compute_checksum_for_data (G_CHECKSUM_SHA1 , edid_data, 128);
-        else
-            display_infos[m] = g_strdup ("");
+        output = g_ptr_array_index (helper->outputs, m);
+        edid = xfce_displays_edid_cache_lookup (helper->edids, output->id);
+        display_infos[m] = g_strdup (edid->hash);
     }
 
     return display_infos;
@@ -473,15 +604,16 @@ xfce_displays_helper_get_matching_profile (XfceDisplaysHelper *helper)
     gchar              *profile_name;
     gchar              *property;
     gchar             **display_infos;
+    GHashTable         *properties;
 
-    display_infos = xfce_displays_helper_get_display_infos (helper->outputs->len,
-                                                            helper->xdisplay,
-                                                            helper->outputs);
-    if (display_infos)
-    {
-        profiles = display_settings_get_profiles (display_infos, helper->channel);
-        g_strfreev (display_infos);
-    }
+    /* match against the cached channel, no round trip to xfconfd */
+    display_infos = xfce_displays_helper_get_display_infos (helper);
+    properties = xfsettings_channel_cache_get_properties (helper->channel, NULL);
+    if (display_infos && properties)
+        profiles = display_settings_get_profiles_from_properties (display_infos, properties);
+    g_strfreev (display_infos);
+    if (properties)
+        g_hash_table_destroy (properties);
 
     if (profiles == NULL)
     {
@@ -491,7 +623,7 @@ xfce_displays_helper_get_matching_profile (XfceDisplaysHelper *helper)
     {
         profile = g_list_nth_data (profiles, 0);
         property = g_strdup_printf ("/%s", (gchar *) profile);
-        profile_name = xfconf_channel_get_string (helper->channel, property, NULL);
+        profile_name = xfsettings_channel_cache_get_string (helper->channel, property, NULL);
         xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Applied the only matching display profile: %s", profile_name);
         g_free (profile_name);
         g_free (property);
@@ -507,192 +639,333 @@ xfce_displays_helper_get_matching_profile (XfceDisplaysHelper *helper)
 
 
 
-static GdkFilterReturn
-xfce_displays_helper_screen_on_event (GdkXEvent *xevent,
-                                      GdkEvent  *event,
-                                      gpointer   data)
+static void
+xfce_displays_helper_screen_changed (gpointer data)
+{
+    XfceDisplaysHelper *helper = XFCE_DISPLAYS_HELPER (data);
+
+    /* called from the event filter: only note the event, the reload and
+     * the apply run from the main loop, a burst of events needs one */
+    helper->screen_pending = TRUE;
+    xfsettings_metrics_count (XFSD_DEBUG_DISPLAYS, "screen-event", 1);
+
+    if (helper->screen_id == 0)
+    {
+        helper->screen_stage = XFCE_DISPLAYS_STAGE_PLAN;
+        helper->screen_id = g_idle_add (xfce_displays_helper_screen_job, helper);
+    }
+}
+
+
+
+static void
+xfce_displays_helper_edid_changed (RROutput output,
+                                   gpointer data)
+{
+    XfceDisplaysHelper *helper = XFCE_DISPLAYS_HELPER (data);
+
+    /* another monitor on the connector, the profile has to be matched
+     * again even if the outputs stayed the same */
+    xfce_displays_edid_cache_invalidate (helper->edids, output);
+    helper->screen_edids_changed = TRUE;
+
+    xfce_displays_helper_screen_changed (helper);
+}
+
+
+
+static gboolean
+xfce_displays_helper_screen_job (gpointer data)
 {
     XfceDisplaysHelper *helper = XFCE_DISPLAYS_HELPER (data);
-    GPtrArray          *old_outputs;
-    XfceRRCrtc         *crtc = NULL;
+
+    switch (helper->screen_stage)
+    {
+        case XFCE_DISPLAYS_STAGE_PLAN:
+            helper->screen_pending = FALSE;
+            if (!xfce_displays_helper_screen_plan (helper))
+                break;
+
+            /* let the other sources run before touching the server */
+            helper->screen_stage = XFCE_DISPLAYS_STAGE_APPLY;
+            return TRUE;
+
+        case XFCE_DISPLAYS_STAGE_APPLY:
+            if (helper->screen_pending)
+            {
+                /* the plan is out of date, make a new one */
+                helper->screen_stage = XFCE_DISPLAYS_STAGE_PLAN;
+                return TRUE;
+            }
+            xfce_displays_helper_screen_apply (helper);
+            break;
+    }
+
+    g_clear_pointer (&helper->screen_profile, g_free);
+    if (helper->screen_outputs != NULL)
+    {
+        g_ptr_array_unref (helper->screen_outputs);
+        helper->screen_outputs = NULL;
+    }
+    if (helper->screen_crtcs != NULL)
+    {
+        g_ptr_array_unref (helper->screen_crtcs);
+        helper->screen_crtcs = NULL;
+    }
+    helper->screen_id = 0;
+
+    return FALSE;
+}
+
+
+
+static gboolean
+xfce_displays_helper_screen_plan (XfceDisplaysHelper *helper)
+{
+    GPtrArray          *old_outputs, *current_crtcs;
+    XfceRRCrtc         *crtc;
     XfceRROutput       *output, *o;
-    XEvent             *e = xevent;
-    gint                event_num;
     gint                j;
+    gint                screen_width, screen_height, mm_width, mm_height;
     guint               n, m, nactive = 0;
-    gboolean            found = FALSE, changed = FALSE, autorefresh;
+    gboolean            found = FALSE, changed = FALSE;
+    gboolean            edids_changed;
 
-    if (!e)
-        return GDK_FILTER_CONTINUE;
+    helper->screen_actions = 0;
+    g_clear_pointer (&helper->screen_profile, g_free);
 
-    event_num = e->type - helper->event_base;
+    edids_changed = helper->screen_edids_changed;
+    helper->screen_edids_changed = FALSE;
 
-    autorefresh = xfconf_channel_get_bool (helper->channel, AUTO_REFRESH_PROP, TRUE);
-    if (autorefresh && event_num == RRScreenChangeNotify)
-    {
-        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "RRScreenChangeNotify event received.");
+    if (!xfsettings_channel_cache_get_bool (helper->channel, AUTO_REFRESH_PROP, TRUE))
+        return FALSE;
 
-        old_outputs = g_ptr_array_ref (helper->outputs);
-        xfce_displays_helper_reload (helper);
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "RRScreenChangeNotify event received.");
 
-        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Noutput: before = %d, after = %d.",
-                        old_outputs->len, helper->outputs->len);
+    /* diff against the outputs from before the first event of the burst */
+    if (helper->screen_outputs == NULL)
+        helper->screen_outputs = g_ptr_array_ref (helper->outputs);
+    old_outputs = helper->screen_outputs;
+    xfce_displays_helper_reload (helper);
 
-        /* Check if we have different amount of outputs and a matching profile and
-           apply it if there's only one */
-        if (old_outputs->len > helper->outputs->len ||
-            old_outputs->len < helper->outputs->len)
-        {
-            if (xfconf_channel_get_bool (helper->channel, AUTO_ENABLE_PROFILES, FALSE) &&
-                xfconf_channel_get_bool (helper->channel, NOTIFY_PROP, FALSE))
-            {
-                gchar *matching_profile = NULL;
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Noutput: before = %d, after = %d.",
+                    old_outputs->len, helper->outputs->len);
+    xfsettings_trace (XFSD_TRACE_DISPLAYS_SCREEN_CHANGE,
+                      old_outputs->len, helper->outputs->len, 0);
 
-                matching_profile = xfce_displays_helper_get_matching_profile (helper);
-                if (matching_profile)
-                {
-                    xfce_displays_helper_channel_apply (helper, matching_profile);
-                    return GDK_FILTER_CONTINUE;
-                }
-            }
-            xfconf_channel_set_string (helper->channel, ACTIVE_PROFILE, DEFAULT_SCHEME_NAME);
+    /* Check if we have different amount of outputs or other monitors, and a
+       matching profile and apply it if there's only one */
+    if (old_outputs->len != helper->outputs->len || edids_changed)
+    {
+        if (xfsettings_channel_cache_get_bool (helper->channel, AUTO_ENABLE_PROFILES, FALSE) &&
+            xfsettings_channel_cache_get_bool (helper->channel, NOTIFY_PROP, FALSE))
+        {
+            helper->screen_profile = xfce_displays_helper_get_matching_profile (helper);
+            if (helper->screen_profile != NULL)
+                return TRUE;
         }
+        helper->screen_actions |= XFCE_DISPLAYS_SCREEN_DEFAULT;
+    }
 
-        if (old_outputs->len > helper->outputs->len)
+    /* plan on copies, the cache keeps mirroring the server until the
+     * apply stage swaps the plan in */
+    current_crtcs = helper->crtcs;
+    helper->crtcs = xfce_displays_helper_copy_crtcs (current_crtcs);
+
+    if (old_outputs->len > helper->outputs->len)
+    {
+        /* Diff the new and old output list to find removed outputs */
+        for (n = 0; n < old_outputs->len; ++n)
         {
-            /* Diff the new and old output list to find removed outputs */
-            for (n = 0; n < old_outputs->len; ++n)
+            found = FALSE;
+            output = g_ptr_array_index (old_outputs, n);
+            for (m = 0; m < helper->outputs->len && !found; ++m)
             {
-                found = FALSE;
-                output = g_ptr_array_index (old_outputs, n);
-                for (m = 0; m < helper->outputs->len && !found; ++m)
-                {
-                    o = g_ptr_array_index (helper->outputs, m);
-                    found = o->id == output->id;
-                }
-                if (!found)
+                o = g_ptr_array_index (helper->outputs, m);
+                found = o->id == output->id;
+            }
+            if (!found)
+            {
+                xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Output disconnected: %s",
+                                output->info->name);
+                /* force deconfiguring the crtc for the removed output,
+                 * this happens with the other changes */
+                crtc = NULL;
+                if (output->info->crtc != None)
+                    crtc = xfce_displays_helper_find_crtc_by_id (helper,
+                                                                 output->info->crtc);
+                if (crtc)
                 {
-                    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Output disconnected: %s",
-                                    output->info->name);
-                    /* force deconfiguring the crtc for the removed output */
-                    if (output->info->crtc != None)
-                        crtc = xfce_displays_helper_find_crtc_by_id (helper,
-                                                                     output->info->crtc);
-                    if (crtc)
-                    {
-                        crtc->mode = None;
-                        xfce_displays_helper_disable_crtc (helper, crtc->id);
-                    }
-                    /* if the output was active, we must recalculate the screen size */
-                    changed |= output->active;
+                    crtc->mode = None;
+                    crtc->noutput = 0;
+                    crtc->changed = TRUE;
+                    changed = TRUE;
                 }
+                /* if the output was active, we must recalculate the screen size */
+                changed |= output->active;
             }
+        }
 
-            /* Basically, this means the external output was disconnected,
-               so reenable the internal one if needed. */
-            for (n = 0; n < helper->outputs->len; ++n)
-            {
-                output = g_ptr_array_index (helper->outputs, n);
-                if (output->active)
-                    ++nactive;
-            }
-            if (nactive == 0)
-            {
-                xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "No active output anymore! "
-                                "Attempting to re-enable the internal output.");
-                xfce_displays_helper_toggle_internal (NULL, FALSE, helper);
-            }
-            else if (changed)
-                xfce_displays_helper_apply_all (helper);
+        /* Basically, this means the external output was disconnected,
+           so reenable the internal one if needed. */
+        for (n = 0; n < helper->outputs->len; ++n)
+        {
+            output = g_ptr_array_index (helper->outputs, n);
+            if (output->active)
+                ++nactive;
         }
-        else
+        if (nactive == 0)
         {
-            /* Diff the new and old output list to find new outputs */
-            for (n = 0; n < helper->outputs->len; ++n)
+            xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "No active output anymore! "
+                            "Attempting to re-enable the internal output.");
+            helper->screen_actions |= XFCE_DISPLAYS_SCREEN_INTERNAL;
+        }
+        if (changed)
+            helper->screen_actions |= XFCE_DISPLAYS_SCREEN_APPLY;
+    }
+    else
+    {
+        /* Diff the new and old output list to find new outputs */
+        for (n = 0; n < helper->outputs->len; ++n)
+        {
+            found = FALSE;
+            output = g_ptr_array_index (helper->outputs, n);
+            for (m = 0; m < old_outputs->len && !found; ++m)
             {
-                found = FALSE;
-                output = g_ptr_array_index (helper->outputs, n);
-                for (m = 0; m < old_outputs->len && !found; ++m)
-                {
-                    o = g_ptr_array_index (old_outputs, m);
-                    found = o->id == output->id;
-                }
-                if (!found)
+                o = g_ptr_array_index (old_outputs, m);
+                found = o->id == output->id;
+            }
+            if (!found)
+            {
+                xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "New output connected: %s",
+                                output->info->name);
+                /* need to enable crtc for output ? */
+                if (output->info->crtc == None)
                 {
-                    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "New output connected: %s",
-                                    output->info->name);
-                    /* need to enable crtc for output ? */
-                    if (output->info->crtc == None)
+                    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "enabling crtc for %s", output->info->name);
+                    crtc = xfce_displays_helper_find_usable_crtc (helper, output);
+                    if (crtc)
                     {
-                        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "enabling crtc for %s", output->info->name);
-                        crtc = xfce_displays_helper_find_usable_crtc (helper, output);
-                        if (crtc)
+                        crtc->mode = output->preferred_mode;
+                        crtc->rotation = RR_Rotate_0;
+                        helper->backend->get_screen_size (helper->backend, &screen_width, &screen_height,
+                                                          &mm_width, &mm_height);
+                        if ((crtc->x > screen_width + 1) || (crtc->y > screen_height + 1)) {
+                            crtc->x = crtc->y = 0;
+                        } /* else - leave values from last time we saw the monitor */
+                        /* set width and height */
+                        for (j = 0; j < helper->resources->nmode; ++j)
                         {
-                            crtc->mode = output->preferred_mode;
-                            crtc->rotation = RR_Rotate_0;
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-                            if ((crtc->x > gdk_screen_width() + 1) || (crtc->y > gdk_screen_height() + 1)) {
-G_GNUC_END_IGNORE_DEPRECATIONS
-                                crtc->x = crtc->y = 0;
-                            } /* else - leave values from last time we saw the monitor */
-                            /* set width and height */
-                            for (j = 0; j < helper->resources->nmode; ++j)
+                            if (helper->resources->modes[j].id == output->preferred_mode)
                             {
-                                if (helper->resources->modes[j].id == output->preferred_mode)
-                                {
-                                    crtc->width = helper->resources->modes[j].width;
-                                    crtc->height = helper->resources->modes[j].height;
-                                    break;
-                                }
+                                crtc->width = helper->resources->modes[j].width;
+                                crtc->height = helper->resources->modes[j].height;
+                                break;
                             }
-                            xfce_displays_helper_set_outputs (crtc, output);
-                            crtc->changed = TRUE;
                         }
+                        xfce_displays_helper_set_outputs (crtc, output);
+                        crtc->changed = TRUE;
                     }
-
-                    changed = TRUE;
                 }
+
+                changed = TRUE;
             }
-            if (changed)
-                xfce_displays_helper_apply_all (helper);
+        }
+
+        if (changed)
+        {
+            helper->screen_actions |= XFCE_DISPLAYS_SCREEN_APPLY;
 
             /* Start the minimal dialog according to the user preferences */
-            if (changed && xfconf_channel_get_bool (helper->channel, NOTIFY_PROP, FALSE))
-                xfce_spawn_command_line_on_screen (NULL, "xfce4-display-settings -m", FALSE,
-                                                   FALSE, NULL);
+            if (xfsettings_channel_cache_get_bool (helper->channel, NOTIFY_PROP, FALSE))
+                helper->screen_actions |= XFCE_DISPLAYS_SCREEN_NOTIFY;
         }
-        g_ptr_array_unref (old_outputs);
     }
 
-    /* Pass the event on to GTK+ */
-    return GDK_FILTER_CONTINUE;
+    if (helper->screen_crtcs != NULL)
+        g_ptr_array_unref (helper->screen_crtcs);
+    helper->screen_crtcs = helper->crtcs;
+    helper->crtcs = current_crtcs;
+
+    return helper->screen_actions != 0;
 }
 
 
 
 static void
-xfce_displays_helper_set_screen_size (XfceDisplaysHelper *helper)
+xfce_displays_helper_screen_apply (XfceDisplaysHelper *helper)
+{
+    guint n;
+
+    if (helper->screen_profile != NULL)
+    {
+        xfce_displays_helper_channel_apply (helper, helper->screen_profile, NULL);
+        return;
+    }
+
+    /* like before the staged job, no profile is active from here on */
+    if (helper->screen_actions & XFCE_DISPLAYS_SCREEN_DEFAULT)
+    {
+        xfsettings_replay_ignore_push ();
+        xfconf_channel_set_string (helper->channel, ACTIVE_PROFILE, DEFAULT_SCHEME_NAME);
+        xfsettings_replay_ignore_pop ();
+    }
+
+    /* the planned layout becomes the cache */
+    if (helper->screen_crtcs != NULL)
+    {
+        g_ptr_array_unref (helper->crtcs);
+        helper->crtcs = helper->screen_crtcs;
+        helper->screen_crtcs = NULL;
+    }
+
+    if (helper->screen_actions & XFCE_DISPLAYS_SCREEN_INTERNAL)
+        xfce_displays_helper_toggle_internal (NULL, FALSE, helper);
+
+    if (helper->screen_actions & XFCE_DISPLAYS_SCREEN_APPLY)
+    {
+        /* toggling the internal output may already have applied everything */
+        for (n = 0; n < helper->crtcs->len; n++)
+        {
+            if (((XfceRRCrtc *) g_ptr_array_index (helper->crtcs, n))->changed)
+            {
+                xfce_displays_helper_apply_all (helper, NULL);
+                break;
+            }
+        }
+    }
+
+    if (helper->screen_actions & XFCE_DISPLAYS_SCREEN_NOTIFY)
+        xfsettings_launcher_spawn_command_line (NULL, "xfce4-display-settings -m",
+                                                FALSE, NULL);
+}
+
+
+
+static gboolean
+xfce_displays_helper_check_screen_size (XfceDisplaysHelper *helper)
 {
     gint min_width, min_height, max_width, max_height;
+    gint width, height, mm_width, mm_height;
 
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && helper->resources);
 
     /* get the screen size extremums */
-    if (!XRRGetScreenSizeRange (helper->xdisplay, GDK_WINDOW_XID (helper->root_window),
-                                &min_width, &min_height, &max_width, &max_height))
+    if (!helper->backend->get_screen_size_range (helper->backend, &min_width, &min_height,
+                                                 &max_width, &max_height))
     {
         g_warning ("Unable to get the range of screen sizes. "
                    "Display settings may fail to apply.");
-        return;
+        return FALSE;
     }
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    helper->backend->get_screen_size (helper->backend, &width, &height, &mm_width, &mm_height);
+
     xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "min_h = %d, min_w = %d, max_h = %d, max_w = %d, "
                     "prev_h = %d, prev_w = %d, prev_hmm = %d, prev_wmm = %d, h = %d, w = %d, "
                     "hmm = %d, wmm = %d.", min_height, min_width, max_height, max_width,
-                    gdk_screen_height (), gdk_screen_width (), gdk_screen_height_mm (),
-                    gdk_screen_width_mm (), helper->height, helper->width, helper->mm_height,
-                    helper->mm_width);
+                    height, width, mm_height, mm_width, helper->height, helper->width,
+                    helper->mm_height, helper->mm_width);
     if (helper->width > max_width || helper->height > max_height)
     {
         g_warning ("Your screen can't handle the requested size. "
@@ -700,19 +973,12 @@ G_GNUC_BEGIN_IGNORE_DEPRECATIONS
                    helper->width, helper->height, max_width, max_height);
     }
     /* set the screen size only if it's really needed and valid */
-    if (helper->width >= min_width && helper->width <= max_width
-        && helper->height >= min_height && helper->height <= max_height
-        && (helper->width != gdk_screen_width ()
-            || helper->height != gdk_screen_height ()
-            || helper->mm_width != gdk_screen_width_mm ()
-            || helper->mm_height != gdk_screen_height_mm ()))
-    {
-        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Applying desktop dimensions: %dx%d (px), %dx%d (mm).",
-                        helper->width, helper->height, helper->mm_width, helper->mm_height);
-        XRRSetScreenSize (helper->xdisplay, GDK_WINDOW_XID (helper->root_window),
-                          helper->width, helper->height, helper->mm_width, helper->mm_height);
-    }
-G_GNUC_END_IGNORE_DEPRECATIONS
+    return (helper->width >= min_width && helper->width <= max_width
+            && helper->height >= min_height && helper->height <= max_height
+            && (helper->width != width
+                || helper->height != height
+                || helper->mm_width != mm_width
+                || helper->mm_height != mm_height));
 }
 
 
@@ -986,17 +1252,22 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
     XfceRROutput  *output;
     XfceRRCrtc    *crtc;
     gint           best_dist, dist, n, m, l, err;
+    gint           screen_width, screen_height, mm_width, mm_height;
 
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && helper->resources);
 
     outputs = g_ptr_array_new ();
 
+    helper->backend->get_screen_size (helper->backend, &screen_width, &screen_height,
+                                      &mm_width, &mm_height);
+
     /* get all connected outputs */
     outputs = g_ptr_array_new_with_free_func ((GDestroyNotify) xfce_displays_helper_free_output);
     for (n = 0; n < helper->resources->noutput; ++n)
     {
         gdk_x11_display_error_trap_push (helper->display);
-        output_info = XRRGetOutputInfo (helper->xdisplay, helper->resources, helper->resources->outputs[n]);
+        output_info = helper->backend->get_output_info (helper->backend, helper->resources,
+                                                        helper->resources->outputs[n]);
         gdk_display_flush (helper->display);
         err = gdk_x11_display_error_trap_pop (helper->display);
         if (err || !output_info)
@@ -1006,14 +1277,18 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
             continue;
         }
 
+        xfce_displays_edid_cache_set_connected (helper->edids, helper->resources->outputs[n],
+                                                output_info->connection == RR_Connected);
+
         if (output_info->connection != RR_Connected)
         {
-            XRRFreeOutputInfo (output_info);
+            helper->backend->free_output_info (helper->backend, output_info);
             continue;
         }
 
         output = g_new0 (XfceRROutput, 1);
         output->id = helper->resources->outputs[n];
+        output->backend = helper->backend;
         output->info = output_info;
 
         /* find the preferred mode */
@@ -1028,15 +1303,13 @@ xfce_displays_helper_list_outputs (XfceDisplaysHelper *helper)
                 if (helper->resources->modes[m].id != output->info->modes[l])
                     continue;
 
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
                 if (l < output->info->npreferred)
                     dist = 0;
-                else if ((output->info->mm_height != 0) && (gdk_screen_height_mm () != 0))
-                    dist = (1000 * gdk_screen_height () / gdk_screen_height_mm () -
+                else if ((output->info->mm_height != 0) && (mm_height != 0))
+                    dist = (1000 * screen_height / mm_height -
                             1000 * helper->resources->modes[m].height / output->info->mm_height);
                 else
-                    dist = gdk_screen_height () - helper->resources->modes[m].height;
-G_GNUC_END_IGNORE_DEPRECATIONS
+                    dist = screen_height - helper->resources->modes[m].height;
 
                 dist = ABS (dist);
 
@@ -1074,7 +1347,7 @@ xfce_displays_helper_free_output (XfceRROutput *output)
         return;
 
     gdk_x11_display_error_trap_push (gdk_display_get_default ());
-    XRRFreeOutputInfo (output->info);
+    output->backend->free_output_info (output->backend, output->info);
     gdk_display_flush (gdk_display_get_default ());
     if (gdk_x11_display_error_trap_pop (gdk_display_get_default ()) != 0)
     {
@@ -1093,17 +1366,17 @@ xfce_displays_helper_list_crtcs (XfceDisplaysHelper *helper)
     XfceRRCrtc  *crtc;
     gint         n, err;
 
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && helper->resources);
 
     /* get all existing CRTCs */
     crtcs = g_ptr_array_new_with_free_func ((GDestroyNotify) xfce_displays_helper_free_crtc);
     for (n = 0; n < helper->resources->ncrtc; ++n)
     {
-        XRRCrtcTransformAttributes  *attr;
         xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Detected CRTC %lu.", helper->resources->crtcs[n]);
 
         gdk_x11_display_error_trap_push (helper->display);
-        crtc_info = XRRGetCrtcInfo (helper->xdisplay, helper->resources, helper->resources->crtcs[n]);
+        crtc_info = helper->backend->get_crtc_info (helper->backend, helper->resources,
+                                                    helper->resources->crtcs[n]);
         gdk_display_flush (helper->display);
         err = gdk_x11_display_error_trap_pop (helper->display);
         if (err || !crtc_info)
@@ -1122,17 +1395,7 @@ xfce_displays_helper_list_crtcs (XfceDisplaysHelper *helper)
         crtc->height = crtc_info->height;
         crtc->x = crtc_info->x;
         crtc->y = crtc_info->y;
-        if (XRRGetCrtcTransform (helper->xdisplay, helper->resources->crtcs[n], &attr) && attr)
-        {
-            crtc->scalex = XFixedToDouble (attr->currentTransform.matrix[0][0]);
-            crtc->scaley = XFixedToDouble (attr->currentTransform.matrix[1][1]);
-            XFree (attr);
-        }
-        else
-        {
-            crtc->scalex = 1.0;
-            crtc->scaley = 1.0;
-        }
+        helper->backend->get_crtc_scale (helper->backend, crtc->id, &crtc->scalex, &crtc->scaley);
 
         crtc->noutput = crtc_info->noutput;
         crtc->outputs = NULL;
@@ -1147,7 +1410,7 @@ xfce_displays_helper_list_crtcs (XfceDisplaysHelper *helper)
                                        crtc_info->npossible * sizeof (RROutput));
 
         crtc->changed = FALSE;
-        XRRFreeCrtcInfo (crtc_info);
+        helper->backend->free_crtc_info (helper->backend, crtc_info);
 
         /* cache it */
         g_ptr_array_add (crtcs, crtc);
@@ -1179,6 +1442,37 @@ xfce_displays_helper_find_crtc_by_id (XfceDisplaysHelper *helper,
 
 
 
+static XfceRRCrtc *
+xfce_displays_helper_copy_crtc (const XfceRRCrtc *crtc)
+{
+    XfceRRCrtc *copy;
+
+    copy = g_memdup (crtc, sizeof (XfceRRCrtc));
+    if (crtc->outputs != NULL)
+        copy->outputs = g_memdup (crtc->outputs, crtc->noutput * sizeof (RROutput));
+    if (crtc->possible != NULL)
+        copy->possible = g_memdup (crtc->possible, crtc->npossible * sizeof (RROutput));
+
+    return copy;
+}
+
+
+
+static GPtrArray *
+xfce_displays_helper_copy_crtcs (GPtrArray *crtcs)
+{
+    GPtrArray *copy;
+    guint      n;
+
+    copy = g_ptr_array_new_with_free_func ((GDestroyNotify) xfce_displays_helper_free_crtc);
+    for (n = 0; n < crtcs->len; ++n)
+        g_ptr_array_add (copy, xfce_displays_helper_copy_crtc (g_ptr_array_index (crtcs, n)));
+
+    return copy;
+}
+
+
+
 static void
 xfce_displays_helper_free_crtc (XfceRRCrtc *crtc)
 {
@@ -1296,38 +1590,37 @@ static Status
 xfce_displays_helper_disable_crtc (XfceDisplaysHelper *helper,
                                    RRCrtc              crtc)
 {
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && helper->resources);
 
     xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Disabling CRTC %lu.", crtc);
 
-    return XRRSetCrtcConfig (helper->xdisplay, helper->resources, crtc,
-                             CurrentTime, 0, 0, None, RR_Rotate_0, NULL, 0);
+    return helper->backend->set_crtc_config (helper->backend, helper->resources, crtc,
+                                             0, 0, None, RR_Rotate_0, NULL, 0);
 }
 
 
 
-static void
-xfce_displays_helper_workaround_crtc_size (XfceRRCrtc         *crtc,
-                                           XfceDisplaysHelper *helper)
+static gboolean
+xfce_displays_helper_check_crtc_size (XfceRRCrtc         *crtc,
+                                      XfceDisplaysHelper *helper)
 {
     XRRCrtcInfo *crtc_info;
+    gboolean     too_big;
 
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources && crtc);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && helper->resources && crtc);
 
     /* The CRTC needs to be disabled if its previous mode won't fit in the new screen.
        It will be reenabled with its new mode (known to fit) after the screen size is
        changed, unless the user disabled it (no need to reenable it then). */
-    crtc_info = XRRGetCrtcInfo (helper->xdisplay, helper->resources, crtc->id);
-    if ((crtc_info->x + crtc_info->width > (guint) helper->width) ||
-        (crtc_info->y + crtc_info->height > (guint) helper->height))
-    {
-        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "CRTC %lu must be temporarily disabled.", crtc->id);
-        if (xfce_displays_helper_disable_crtc (helper, crtc->id) == RRSetConfigSuccess)
-            crtc->changed = (crtc->mode != None);
-        else
-            g_warning ("Failed to temporarily disable CRTC %lu.", crtc->id);
-    }
-    XRRFreeCrtcInfo (crtc_info);
+    crtc_info = helper->backend->get_crtc_info (helper->backend, helper->resources, crtc->id);
+    if (crtc_info == NULL)
+        return FALSE;
+
+    too_big = ((crtc_info->x + crtc_info->width > (guint) helper->width) ||
+               (crtc_info->y + crtc_info->height > (guint) helper->height));
+    helper->backend->free_crtc_info (helper->backend, crtc_info);
+
+    return too_big;
 }
 
 
@@ -1336,10 +1629,7 @@ static void
 xfce_displays_helper_apply_crtc_transform (XfceRRCrtc         *crtc,
                                            XfceDisplaysHelper *helper)
 {
-    XTransform transform;
-    gchar *filter;
-
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && crtc);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && crtc);
 
     if (!crtc->changed)
         return;
@@ -1347,25 +1637,10 @@ xfce_displays_helper_apply_crtc_transform (XfceRRCrtc         *crtc,
 #ifdef HAS_RANDR_ONE_POINT_THREE
     if (helper->has_1_3)
     {
-        if (crtc->scalex == 1 && crtc->scaley == 1)
-            filter = "nearest";
-        else
-            filter = "bilinear";
-
-        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Applying CRTC %lu Transform: x=%lf y=%lf, filter=%s.", crtc->id,
-                        crtc->scalex, crtc->scaley, filter);
-
-        memset(&transform, '\0', sizeof(transform));
-
-        transform.matrix[0][0] = XDoubleToFixed(crtc->scalex);
-        transform.matrix[1][1] = XDoubleToFixed(crtc->scaley);
-        transform.matrix[2][2] = XDoubleToFixed(1.0);
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Applying CRTC %lu Transform: x=%lf y=%lf.", crtc->id,
+                        crtc->scalex, crtc->scaley);
 
-        XRRSetCrtcTransform(helper->xdisplay, crtc->id,
-                            &transform,
-                            filter,
-                            NULL,
-                            0);
+        helper->backend->set_crtc_scale (helper->backend, crtc->id, crtc->scalex, crtc->scaley);
     }
 #endif
 }
@@ -1378,7 +1653,7 @@ xfce_displays_helper_apply_crtc (XfceRRCrtc         *crtc,
 {
     Status ret;
 
-    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->xdisplay && helper->resources && crtc);
+    g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->backend && helper->resources && crtc);
 
     xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Configuring CRTC %lu.", crtc->id);
 
@@ -1392,9 +1667,9 @@ xfce_displays_helper_apply_crtc (XfceRRCrtc         *crtc,
         } else {
             xfce_displays_helper_apply_crtc_transform (crtc, helper);
 
-            ret = XRRSetCrtcConfig (helper->xdisplay, helper->resources, crtc->id,
-                                    CurrentTime, crtc->x, crtc->y, crtc->mode,
-                                    crtc->rotation, crtc->outputs, crtc->noutput);
+            ret = helper->backend->set_crtc_config (helper->backend, helper->resources, crtc->id,
+                                                    crtc->x, crtc->y, crtc->mode,
+                                                    crtc->rotation, crtc->outputs, crtc->noutput);
         }
 
         if (ret == RRSetConfigSuccess)
@@ -1442,11 +1717,22 @@ xfce_displays_helper_set_outputs (XfceRRCrtc   *crtc,
 
 
 
-static void
-xfce_displays_helper_apply_all (XfceDisplaysHelper *helper)
+static gboolean
+xfce_displays_helper_apply_all (XfceDisplaysHelper *helper,
+                                guint              *n_changed)
 {
+    XfceRRCrtc *crtc;
+    gint64      start_time, grab_time;
+    guint       n, ncrtcs = 0;
+    gboolean    succeeded = TRUE;
+
     g_assert (XFCE_IS_DISPLAYS_HELPER (helper) && helper->crtcs);
 
+    start_time = g_get_monotonic_time ();
+
+    /* the layout changes, the lid plans were made for the old one */
+    xfce_displays_helper_invalidate_lid_plans (helper);
+
     helper->mm_width = helper->mm_height = helper->width = helper->height = 0;
     helper->min_x = helper->min_y = 32768;
 
@@ -1454,59 +1740,95 @@ xfce_displays_helper_apply_all (XfceDisplaysHelper *helper)
     g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_get_topleftmost_pos, helper);
     g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_normalize_crtc, helper);
 
-    gdk_x11_display_error_trap_push (helper->display);
-
     /* grab server to prevent clients from thinking no output is enabled */
-    gdk_x11_display_grab (helper->display);
+    grab_time = g_get_monotonic_time ();
+    helper->backend->begin_changes (helper->backend);
 
-    /* disable CRTCs that won't fit in the new screen */
-    g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_workaround_crtc_size, helper);
+    /* disable CRTCs that won't fit in the new screen, the sizes are
+     * asked under the grab so no other client changes them meanwhile */
+    for (n = 0; n < helper->crtcs->len; n++)
+    {
+        crtc = g_ptr_array_index (helper->crtcs, n);
+        if (!xfce_displays_helper_check_crtc_size (crtc, helper))
+            continue;
 
-    /* set the screen size only if it's really needed and valid */
-    xfce_displays_helper_set_screen_size (helper);
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "CRTC %lu must be temporarily disabled.", crtc->id);
+        if (xfce_displays_helper_disable_crtc (helper, crtc->id) == RRSetConfigSuccess)
+            crtc->changed = (crtc->mode != None);
+        else
+            g_warning ("Failed to temporarily disable CRTC %lu.", crtc->id);
+    }
+
+    if (xfce_displays_helper_check_screen_size (helper))
+    {
+        xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Applying desktop dimensions: %dx%d (px), %dx%d (mm).",
+                        helper->width, helper->height, helper->mm_width, helper->mm_height);
+        helper->backend->set_screen_size (helper->backend, helper->width, helper->height,
+                                          helper->mm_width, helper->mm_height);
+    }
+
+    for (n = 0; n < helper->crtcs->len; n++)
+        if (((XfceRRCrtc *) g_ptr_array_index (helper->crtcs, n))->changed)
+            ncrtcs++;
 
     /* final loop, apply crtc changes */
     g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_apply_crtc, helper);
 
-#ifdef HAS_RANDR_ONE_POINT_THREE
-        if (helper->has_1_3)
-            XRRSetOutputPrimary (helper->xdisplay, GDK_WINDOW_XID (helper->root_window),
-                                 helper->primary);
-#endif
-
     /* release the grab, changes are done */
-    gdk_display_sync (helper->display);
-    gdk_x11_display_ungrab (helper->display);
-    if (gdk_x11_display_error_trap_pop (helper->display) != 0)
+    if (helper->backend->end_changes (helper->backend) != 0)
     {
         g_critical ("Failed to apply display settings");
+        succeeded = FALSE;
     }
+
+    grab_time = g_get_monotonic_time () - grab_time;
+    xfsettings_metrics_time (XFSD_DEBUG_DISPLAYS, "grab", grab_time);
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Server grabbed for %" G_GINT64_FORMAT " us, "
+                    "%u CRTC(s) changed.", grab_time, ncrtcs);
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    /* not a layout change, no need to hold the grab for it */
+    if (helper->has_1_3)
+    {
+        gdk_x11_display_error_trap_push (helper->display);
+        helper->backend->set_output_primary (helper->backend, helper->primary);
+        gdk_display_flush (helper->display);
+        if (gdk_x11_display_error_trap_pop (helper->display) != 0)
+            g_warning ("Failed to set the primary output");
+    }
+#endif
+
+    /* CRTCs the server refused stay marked as changed */
+    for (n = 0; n < helper->crtcs->len; n++)
+        if (((XfceRRCrtc *) g_ptr_array_index (helper->crtcs, n))->changed)
+            succeeded = FALSE;
+
+    xfsettings_metrics_time (XFSD_DEBUG_DISPLAYS, "apply", g_get_monotonic_time () - start_time);
+    xfsettings_trace (XFSD_TRACE_DISPLAYS_APPLY, g_get_monotonic_time () - start_time, ncrtcs, 0);
+
+    if (n_changed != NULL)
+        *n_changed = ncrtcs;
+
+    return succeeded;
 }
 
 
 
-static void
-xfce_displays_helper_channel_apply (XfceDisplaysHelper *helper,
-                                    const gchar        *scheme)
+static gboolean
+xfce_displays_helper_load_scheme (XfceDisplaysHelper *helper,
+                                  const gchar        *scheme)
 {
     gchar       property[512];
     guint       n, nactive;
     GHashTable *saved_outputs;
 
-    saved_outputs = NULL;
-#ifdef HAS_RANDR_ONE_POINT_THREE
-    helper->primary = None;
-#endif
-
-    xfconf_channel_set_string (helper->channel, ACTIVE_PROFILE, scheme);
-
     /* finally the list of saved outputs from xfconf */
     g_snprintf (property, sizeof (property), "/%s", scheme);
-    saved_outputs = xfconf_channel_get_properties (helper->channel, property);
+    saved_outputs = xfsettings_channel_cache_get_properties (helper->channel, property);
 
     /* nothing saved, nothing to do */
     if (saved_outputs == NULL)
-        goto err_cleanup;
+        return FALSE;
 
     /* first loop, loads all the outputs, and gets the number of active ones */
     nactive = 0;
@@ -1520,20 +1842,45 @@ xfce_displays_helper_channel_apply (XfceDisplaysHelper *helper,
 
     xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Total %d active output(s).", nactive);
 
+    /* Free the xfconf properties */
+    g_hash_table_destroy (saved_outputs);
+
     /* safety check */
     if (nactive == 0)
     {
         g_critical ("Stored Xfconf properties disable all outputs, aborting.");
-        goto err_cleanup;
+        return FALSE;
     }
 
+    return TRUE;
+}
+
+
+
+static XfceDisplaysApplyStatus
+xfce_displays_helper_channel_apply (XfceDisplaysHelper *helper,
+                                    const gchar        *scheme,
+                                    guint              *n_changed)
+{
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->primary = None;
+#endif
+
+    if (n_changed != NULL)
+        *n_changed = 0;
+
+    xfsettings_replay_ignore_push ();
+    xfconf_channel_set_string (helper->channel, ACTIVE_PROFILE, scheme);
+    xfsettings_replay_ignore_pop ();
+
+    if (!xfce_displays_helper_load_scheme (helper, scheme))
+        return XFCE_DISPLAYS_APPLY_INVALID;
+
     /* apply settings */
-    xfce_displays_helper_apply_all (helper);
+    if (!xfce_displays_helper_apply_all (helper, n_changed))
+        return XFCE_DISPLAYS_APPLY_FAILED;
 
-err_cleanup:
-    /* Free the xfconf properties */
-    if (saved_outputs)
-        g_hash_table_destroy (saved_outputs);
+    return XFCE_DISPLAYS_APPLY_OK;
 }
 
 
@@ -1548,26 +1895,49 @@ xfce_displays_helper_channel_property_changed (XfconfChannel      *channel,
         g_strcmp0 (property_name, APPLY_SCHEME_PROP) == 0))
     {
         /* apply */
-        xfce_displays_helper_channel_apply (helper, g_value_get_string (value));
+        xfce_displays_helper_channel_apply (helper, g_value_get_string (value), NULL);
         /* remove the apply property */
+        xfsettings_replay_ignore_push ();
         xfconf_channel_reset_property (channel, APPLY_SCHEME_PROP, FALSE);
+        xfsettings_replay_ignore_pop ();
+    }
+    else if (g_str_has_prefix (property_name, "/" DEFAULT_SCHEME_NAME "/"))
+    {
+        /* the lid plans restore the internal output from Default */
+        xfce_displays_helper_invalidate_lid_plans (helper);
+    }
+}
+
+
+
+static XfceRROutput *
+xfce_displays_helper_find_internal (XfceDisplaysHelper *helper)
+{
+    XfceRROutput *output;
+    guint         n;
+
+    if (helper->internal == None)
+        return NULL;
+
+    for (n = 0; n < helper->outputs->len; ++n)
+    {
+        output = g_ptr_array_index (helper->outputs, n);
+        if (output->id == helper->internal)
+            return output;
     }
+
+    return NULL;
 }
 
 
 
 static void
-xfce_displays_helper_toggle_internal (gpointer           *power,
-                                      gboolean            lid_is_closed,
-                                      XfceDisplaysHelper *helper)
+xfce_displays_helper_resolve_internal (XfceDisplaysHelper *helper)
 {
-    GHashTable    *saved_outputs;
-    XfceRRCrtc    *crtc = NULL;
-    XfceRROutput  *output, *lvds = NULL;
-    gboolean       active = FALSE;
-    guint          n;
-    gint           m;
+    XfceRROutput *output;
+    guint         n;
 
+    helper->internal = None;
     for (n = 0; n < helper->outputs->len; ++n)
     {
         output = g_ptr_array_index (helper->outputs, n);
@@ -1578,23 +1948,36 @@ xfce_displays_helper_toggle_internal (gpointer           *power,
             || g_str_has_prefix (output->info->name, "eDP")
             || strcmp (output->info->name, "PANEL") == 0)
         {
-            lvds = output;
+            helper->internal = output->id;
             break;
         }
     }
 
-    if (!lvds)
-        return;
+    /* the topology changed */
+    xfce_displays_helper_invalidate_lid_plans (helper);
+}
 
-    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Toggling internal output %s.",
-                    lvds->info->name);
+
+
+static gboolean
+xfce_displays_helper_prepare_internal (XfceDisplaysHelper *helper,
+                                       XfceRROutput       *lvds,
+                                       gboolean            lid_is_closed)
+{
+    GHashTable    *saved_outputs;
+    XfceRRCrtc    *crtc = NULL;
+    XfceRROutput  *output;
+    gboolean       active = FALSE;
+    guint          n;
+    gint           m;
+    gint           screen_width, screen_height, mm_width, mm_height;
 
     if (lvds->active && lid_is_closed)
     {
         /* if active and the lid is closed, deactivate it */
         crtc = xfce_displays_helper_find_usable_crtc (helper, lvds);
         if (!crtc)
-            return;
+            return FALSE;
         crtc->mode = None;
         crtc->noutput = 0;
         crtc->changed = TRUE;
@@ -1603,7 +1986,7 @@ xfce_displays_helper_toggle_internal (gpointer           *power,
     else if (!lvds->active && !lid_is_closed)
     {
         /* re-activate it because the user opened the lid */
-        saved_outputs = xfconf_channel_get_properties (helper->channel, "/" DEFAULT_SCHEME_NAME);
+        saved_outputs = xfsettings_channel_cache_get_properties (helper->channel, "/" DEFAULT_SCHEME_NAME);
         if (saved_outputs)
         {
             /* first, ensure the position of the other outputs is correct */
@@ -1629,12 +2012,12 @@ xfce_displays_helper_toggle_internal (gpointer           *power,
             /* autoset the preferred mode */
             crtc = xfce_displays_helper_find_usable_crtc (helper, lvds);
             if (!crtc)
-                return;
+                return FALSE;
             crtc->mode = lvds->preferred_mode;
             crtc->rotation = RR_Rotate_0;
-G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-            if ((crtc->x > gdk_screen_width() + 1) || (crtc->y > gdk_screen_height() + 1)) {
-G_GNUC_END_IGNORE_DEPRECATIONS
+            helper->backend->get_screen_size (helper->backend, &screen_width, &screen_height,
+                                              &mm_width, &mm_height);
+            if ((crtc->x > screen_width + 1) || (crtc->y > screen_height + 1)) {
                 crtc->x = crtc->y = 0;
             } /* else - leave values from last time we saw the monitor */
             /* set width and height */
@@ -1654,8 +2037,515 @@ G_GNUC_END_IGNORE_DEPRECATIONS
                         lvds->info->name);
     }
     else
+        return FALSE;
+
+    return TRUE;
+}
+
+
+
+static GPtrArray *
+xfce_displays_helper_plan_lid (XfceDisplaysHelper *helper,
+                               XfceRROutput       *lvds,
+                               gboolean            lid_is_closed)
+{
+    GPtrArray *current_crtcs, *plan;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    gint       primary = helper->primary;
+#endif
+
+    /* plan on copies, the cache keeps mirroring the server */
+    current_crtcs = helper->crtcs;
+    helper->crtcs = xfce_displays_helper_copy_crtcs (current_crtcs);
+
+    plan = helper->crtcs;
+    if (!xfce_displays_helper_prepare_internal (helper, lvds, lid_is_closed))
+    {
+        g_ptr_array_unref (plan);
+        plan = NULL;
+    }
+
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->lid_primary[lid_is_closed ? 1 : 0] = helper->primary;
+    helper->primary = primary;
+#endif
+    helper->crtcs = current_crtcs;
+
+    return plan;
+}
+
+
+
+static void
+xfce_displays_helper_update_lid_plans (XfceDisplaysHelper *helper)
+{
+    XfceRROutput *lvds;
+    gint64        start_time;
+
+    xfce_displays_helper_free_lid_plans (helper);
+
+    lvds = xfce_displays_helper_find_internal (helper);
+    if (lvds != NULL)
+    {
+        start_time = g_get_monotonic_time ();
+        helper->lid_plans[0] = xfce_displays_helper_plan_lid (helper, lvds, FALSE);
+        helper->lid_plans[1] = xfce_displays_helper_plan_lid (helper, lvds, TRUE);
+        xfsettings_metrics_time (XFSD_DEBUG_DISPLAYS, "lid-plan", g_get_monotonic_time () - start_time);
+    }
+
+    helper->lid_plans_valid = TRUE;
+}
+
+
+
+static void
+xfce_displays_helper_free_lid_plans (XfceDisplaysHelper *helper)
+{
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS (helper->lid_plans); ++n)
+    {
+        if (helper->lid_plans[n] != NULL)
+        {
+            g_ptr_array_unref (helper->lid_plans[n]);
+            helper->lid_plans[n] = NULL;
+        }
+    }
+
+    helper->lid_plans_valid = FALSE;
+}
+
+
+
+#ifdef HAVE_UPOWERGLIB
+static gboolean
+xfce_displays_helper_lid_plans_idle (gpointer data)
+{
+    XfceDisplaysHelper *helper = XFCE_DISPLAYS_HELPER (data);
+
+    helper->lid_plan_id = 0;
+
+    if (!helper->lid_plans_valid && helper->crtcs != NULL && helper->outputs != NULL)
+        xfce_displays_helper_update_lid_plans (helper);
+
+    return FALSE;
+}
+#endif
+
+
+
+static void
+xfce_displays_helper_invalidate_lid_plans (XfceDisplaysHelper *helper)
+{
+    xfce_displays_helper_free_lid_plans (helper);
+
+#ifdef HAVE_UPOWERGLIB
+    /* have them ready before the next lid event */
+    if (helper->power != NULL && helper->lid_plan_id == 0)
+        helper->lid_plan_id = g_idle_add (xfce_displays_helper_lid_plans_idle, helper);
+#endif
+}
+
+
+
+static void
+xfce_displays_helper_toggle_internal (gpointer           *power,
+                                      gboolean            lid_is_closed,
+                                      XfceDisplaysHelper *helper)
+{
+    XfceRROutput  *lvds;
+    GPtrArray     *plan;
+    gint64         start_time;
+    guint          idx = lid_is_closed ? 1 : 0;
+
+    start_time = g_get_monotonic_time ();
+
+    lvds = xfce_displays_helper_find_internal (helper);
+    if (!lvds)
         return;
 
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Toggling internal output %s.",
+                    lvds->info->name);
+    xfsettings_trace (XFSD_TRACE_DISPLAYS_LID, lid_is_closed, 0, 0);
+
+    if (!helper->lid_plans_valid)
+    {
+        xfsettings_metrics_count (XFSD_DEBUG_DISPLAYS, "lid-plan-miss", 1);
+        xfce_displays_helper_update_lid_plans (helper);
+    }
+
+    /* nothing to do, e.g. the panel is already off */
+    plan = helper->lid_plans[idx];
+    if (plan == NULL)
+        return;
+
+    /* the plan becomes the cache, apply_all drops the other one */
+    helper->lid_plans[idx] = NULL;
+    g_ptr_array_unref (helper->crtcs);
+    helper->crtcs = plan;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->primary = helper->lid_primary[idx];
+#endif
+
     /* apply settings */
-    xfce_displays_helper_apply_all (helper);
+    xfce_displays_helper_apply_all (helper, NULL);
+
+    xfsettings_metrics_time (XFSD_DEBUG_DISPLAYS, "lid-toggle", g_get_monotonic_time () - start_time);
+    xfsettings_dbg (XFSD_DEBUG_DISPLAYS, "Lid %s handled in %" G_GINT64_FORMAT " us.",
+                    lid_is_closed ? "close" : "open", g_get_monotonic_time () - start_time);
+}
+
+
+
+XfceDisplaysHelper *
+xfce_displays_helper_get_default (void)
+{
+    return xfsettingsd_displays_helper;
+}
+
+
+
+void
+xfce_displays_helper_set_dry_run (gboolean dry_run)
+{
+    xfsettingsd_displays_dry_run = dry_run;
+}
+
+
+
+GVariant *
+xfce_displays_helper_dry_run (XfceDisplaysHelper  *helper,
+                              const gchar         *scheme,
+                              GError             **error)
+{
+    GVariantBuilder  builder, crtcs, outputs, phases;
+    GPtrArray       *server_crtcs;
+    XfceRRCrtc      *crtc, *current;
+    XfceRROutput    *output;
+    gchar           *matched = NULL;
+    gint64           start_time;
+    gboolean         loaded;
+    guint            n, o;
+    gint             m;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    gint             primary = helper->primary;
+#endif
+
+    g_return_val_if_fail (XFCE_IS_DISPLAYS_HELPER (helper), NULL);
+
+    if (helper->crtcs == NULL || helper->outputs == NULL)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "No usable RandR extension, nothing to plan");
+        return NULL;
+    }
+
+    g_variant_builder_init (&phases, G_VARIANT_TYPE ("a{sx}"));
+
+    /* pick the scheme like on startup */
+    start_time = g_get_monotonic_time ();
+    if (scheme == NULL || *scheme == '\0')
+    {
+        if (xfsettings_channel_cache_get_bool (helper->channel, AUTO_ENABLE_PROFILES, FALSE)
+            && xfsettings_channel_cache_get_bool (helper->channel, NOTIFY_PROP, FALSE))
+            matched = xfce_displays_helper_get_matching_profile (helper);
+
+        scheme = matched != NULL ? matched : DEFAULT_SCHEME_NAME;
+    }
+    g_variant_builder_add (&phases, "{sx}", "match", g_get_monotonic_time () - start_time);
+
+    /* plan on copies, the cache keeps mirroring the server */
+    server_crtcs = helper->crtcs;
+    helper->crtcs = xfce_displays_helper_copy_crtcs (server_crtcs);
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->primary = None;
+#endif
+
+    start_time = g_get_monotonic_time ();
+    loaded = xfce_displays_helper_load_scheme (helper, scheme);
+    g_variant_builder_add (&phases, "{sx}", "load", g_get_monotonic_time () - start_time);
+
+    /* the part of apply_all that does not talk to the server */
+    start_time = g_get_monotonic_time ();
+    helper->mm_width = helper->mm_height = helper->width = helper->height = 0;
+    helper->min_x = helper->min_y = 32768;
+    if (loaded)
+    {
+        g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_get_topleftmost_pos, helper);
+        g_ptr_array_foreach (helper->crtcs, (GFunc) xfce_displays_helper_normalize_crtc, helper);
+    }
+    g_variant_builder_add (&phases, "{sx}", "plan", g_get_monotonic_time () - start_time);
+
+    g_variant_builder_init (&crtcs, G_VARIANT_TYPE ("aa{sv}"));
+    for (n = 0; loaded && n < helper->crtcs->len; ++n)
+    {
+        crtc = g_ptr_array_index (helper->crtcs, n);
+        current = g_ptr_array_index (server_crtcs, n);
+
+        g_variant_builder_init (&outputs, G_VARIANT_TYPE ("as"));
+        for (m = 0; m < crtc->noutput; ++m)
+        {
+            for (o = 0; o < helper->outputs->len; ++o)
+            {
+                output = g_ptr_array_index (helper->outputs, o);
+                if (output->id == crtc->outputs[m])
+                    g_variant_builder_add (&outputs, "s", output->info->name);
+            }
+        }
+
+        g_variant_builder_open (&crtcs, G_VARIANT_TYPE ("a{sv}"));
+        g_variant_builder_add (&crtcs, "{sv}", "id", g_variant_new_uint64 (crtc->id));
+        g_variant_builder_add (&crtcs, "{sv}", "changed", g_variant_new_boolean (crtc->changed));
+        g_variant_builder_add (&crtcs, "{sv}", "mode", g_variant_new_uint64 (crtc->mode));
+        g_variant_builder_add (&crtcs, "{sv}", "x", g_variant_new_int32 (crtc->x));
+        g_variant_builder_add (&crtcs, "{sv}", "y", g_variant_new_int32 (crtc->y));
+        g_variant_builder_add (&crtcs, "{sv}", "width", g_variant_new_int32 (crtc->width));
+        g_variant_builder_add (&crtcs, "{sv}", "height", g_variant_new_int32 (crtc->height));
+        g_variant_builder_add (&crtcs, "{sv}", "rotation", g_variant_new_uint32 (crtc->rotation));
+        g_variant_builder_add (&crtcs, "{sv}", "scale-x", g_variant_new_double (crtc->scalex));
+        g_variant_builder_add (&crtcs, "{sv}", "scale-y", g_variant_new_double (crtc->scaley));
+        g_variant_builder_add (&crtcs, "{sv}", "outputs", g_variant_builder_end (&outputs));
+        /* what workaround_crtc_size would do before resizing the screen */
+        g_variant_builder_add (&crtcs, "{sv}", "disabled-first",
+                               g_variant_new_boolean (current->mode != None
+                                                      && (current->x + current->width > helper->width
+                                                          || current->y + current->height > helper->height)));
+        g_variant_builder_close (&crtcs);
+    }
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}", "scheme", g_variant_new_string (scheme));
+    g_variant_builder_add (&builder, "{sv}", "matched", g_variant_new_boolean (matched != NULL));
+    g_variant_builder_add (&builder, "{sv}", "valid", g_variant_new_boolean (loaded));
+    g_variant_builder_add (&builder, "{sv}", "width", g_variant_new_int32 (helper->width));
+    g_variant_builder_add (&builder, "{sv}", "height", g_variant_new_int32 (helper->height));
+    g_variant_builder_add (&builder, "{sv}", "mm-width", g_variant_new_int32 (helper->mm_width));
+    g_variant_builder_add (&builder, "{sv}", "mm-height", g_variant_new_int32 (helper->mm_height));
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    g_variant_builder_add (&builder, "{sv}", "primary", g_variant_new_uint64 (helper->primary));
+#endif
+    g_variant_builder_add (&builder, "{sv}", "crtcs", g_variant_builder_end (&crtcs));
+    g_variant_builder_add (&builder, "{sv}", "phases", g_variant_builder_end (&phases));
+
+    /* back to the state of the server */
+    g_ptr_array_unref (helper->crtcs);
+    helper->crtcs = server_crtcs;
+#ifdef HAS_RANDR_ONE_POINT_THREE
+    helper->primary = primary;
+#endif
+
+    g_free (matched);
+
+    return g_variant_builder_end (&builder);
+}
+
+
+
+XfceDisplaysApplyStatus
+xfce_displays_helper_apply_scheme (XfceDisplaysHelper *helper,
+                                   const gchar        *scheme,
+                                   gint64             *duration,
+                                   guint              *n_changed)
+{
+    XfceDisplaysApplyStatus status;
+    gint64                  start_time;
+
+    g_return_val_if_fail (XFCE_IS_DISPLAYS_HELPER (helper), XFCE_DISPLAYS_APPLY_INVALID);
+    g_return_val_if_fail (scheme != NULL, XFCE_DISPLAYS_APPLY_INVALID);
+
+    start_time = g_get_monotonic_time ();
+
+    if (n_changed != NULL)
+        *n_changed = 0;
+
+    if (helper->crtcs == NULL || helper->outputs == NULL || xfsettingsd_displays_dry_run)
+        status = XFCE_DISPLAYS_APPLY_INVALID;
+    else
+    {
+        /* the caller saved the scheme right before calling, the
+         * property-changed signals may still be on their way */
+        xfsettings_channel_cache_reload (helper->channel);
+
+        status = xfce_displays_helper_channel_apply (helper, scheme, n_changed);
+    }
+
+    if (duration != NULL)
+        *duration = g_get_monotonic_time () - start_time;
+
+    return status;
+}
+
+
+
+GVariant *
+xfce_displays_helper_get_randr_snapshot (XfceDisplaysHelper  *helper,
+                                         GError             **error)
+{
+    GVariantBuilder         outputs, crtcs, modes;
+    const XfceDisplaysEdid *edid;
+    XfceRROutput           *output;
+    XfceRRCrtc             *crtc;
+    Rotation                rotations;
+    gchar                  *name;
+    guint                   n;
+    gint                    m;
+
+    g_return_val_if_fail (XFCE_IS_DISPLAYS_HELPER (helper), NULL);
+
+    if (helper->crtcs == NULL || helper->outputs == NULL)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                             "No usable RandR extension");
+        return NULL;
+    }
+
+    /* the cache is behind the server until the screen job ran */
+    if (helper->screen_id != 0)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                             "The displays are being configured");
+        return NULL;
+    }
+
+    /* a scheme is being applied, the cache is ahead of the server */
+    for (n = 0; n < helper->crtcs->len; ++n)
+    {
+        if (((XfceRRCrtc *) g_ptr_array_index (helper->crtcs, n))->changed)
+        {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                                 "The displays are being configured");
+            return NULL;
+        }
+    }
+
+    g_variant_builder_init (&outputs, G_VARIANT_TYPE ("a(tsuutatatitqqiiddss)"));
+    for (n = 0; n < helper->outputs->len; ++n)
+    {
+        output = g_ptr_array_index (helper->outputs, n);
+
+        g_variant_builder_init (&crtcs, G_VARIANT_TYPE ("at"));
+        rotations = XFCE_RANDR_ROTATIONS_MASK | XFCE_RANDR_REFLECTIONS_MASK;
+        for (m = 0; m < output->info->ncrtc; ++m)
+        {
+            g_variant_builder_add (&crtcs, "t", (guint64) output->info->crtcs[m]);
+
+            /* what every possible crtc supports, for a disabled output */
+            crtc = xfce_displays_helper_find_crtc_by_id (helper, output->info->crtcs[m]);
+            if (crtc != NULL)
+                rotations &= crtc->rotations;
+        }
+
+        g_variant_builder_init (&modes, G_VARIANT_TYPE ("at"));
+        for (m = 0; m < output->info->nmode; ++m)
+            g_variant_builder_add (&modes, "t", (guint64) output->info->modes[m]);
+
+        edid = xfce_displays_edid_cache_lookup (helper->edids, output->id);
+        name = make_output_name (output->info->name, edid != NULL ? edid->info : NULL, n);
+
+        crtc = xfce_displays_helper_find_crtc_by_id (helper, output->info->crtc);
+        if (crtc != NULL)
+        {
+            g_variant_builder_add (&outputs, "(tsuutatatitqqiiddss)",
+                                   (guint64) output->id, output->info->name,
+                                   (guint32) output->info->mm_width,
+                                   (guint32) output->info->mm_height,
+                                   (guint64) crtc->id, &crtcs, &modes,
+                                   output->info->npreferred, (guint64) crtc->mode,
+                                   (guint16) crtc->rotation, (guint16) crtc->rotations,
+                                   crtc->x, crtc->y, crtc->scalex, crtc->scaley,
+                                   edid != NULL ? edid->hash : "", name);
+        }
+        else
+        {
+            g_variant_builder_add (&outputs, "(tsuutatatitqqiiddss)",
+                                   (guint64) output->id, output->info->name,
+                                   (guint32) output->info->mm_width,
+                                   (guint32) output->info->mm_height,
+                                   (guint64) None, &crtcs, &modes,
+                                   output->info->npreferred, (guint64) None,
+                                   (guint16) RR_Rotate_0, (guint16) rotations,
+                                   0, 0, 0.0, 0.0,
+                                   edid != NULL ? edid->hash : "", name);
+        }
+
+        g_free (name);
+    }
+
+    return g_variant_new ("(tt@a(tsuutatatitqqiiddss))",
+                          (guint64) helper->resources->timestamp,
+                          (guint64) helper->resources->configTimestamp,
+                          g_variant_builder_end (&outputs));
+}
+
+
+
+gchar *
+xfce_displays_helper_format_plan (GVariant *plan)
+{
+    GString      *str;
+    GVariant     *crtcs, *crtc, *phases, *names;
+    GVariantIter  iter;
+    const gchar  *scheme, *name;
+    const gchar **strv;
+    gboolean      matched, valid, changed, disabled_first;
+    gint          width, height, x, y;
+    guint64       id, mode;
+    gint64        duration;
+    gchar        *joined;
+    gsize         n;
+
+    g_return_val_if_fail (g_variant_is_of_type (plan, G_VARIANT_TYPE_VARDICT), NULL);
+
+    str = g_string_new (NULL);
+
+    g_variant_lookup (plan, "scheme", "&s", &scheme);
+    g_variant_lookup (plan, "matched", "b", &matched);
+    g_variant_lookup (plan, "valid", "b", &valid);
+    g_string_append_printf (str, "Scheme: %s%s%s\n", scheme,
+                            matched ? " (matching profile)" : "",
+                            valid ? "" : ", nothing to apply");
+
+    g_variant_lookup (plan, "width", "i", &width);
+    g_variant_lookup (plan, "height", "i", &height);
+    g_string_append_printf (str, "Screen: %dx%d\n", width, height);
+
+    crtcs = g_variant_lookup_value (plan, "crtcs", G_VARIANT_TYPE ("aa{sv}"));
+    for (n = 0; crtcs != NULL && n < g_variant_n_children (crtcs); n++)
+    {
+        crtc = g_variant_get_child_value (crtcs, n);
+        g_variant_lookup (crtc, "id", "t", &id);
+        g_variant_lookup (crtc, "changed", "b", &changed);
+        g_variant_lookup (crtc, "mode", "t", &mode);
+        g_variant_lookup (crtc, "x", "i", &x);
+        g_variant_lookup (crtc, "y", "i", &y);
+        g_variant_lookup (crtc, "width", "i", &width);
+        g_variant_lookup (crtc, "height", "i", &height);
+        g_variant_lookup (crtc, "disabled-first", "b", &disabled_first);
+        names = g_variant_lookup_value (crtc, "outputs", G_VARIANT_TYPE_STRING_ARRAY);
+        strv = g_variant_get_strv (names, NULL);
+        joined = g_strjoinv (",", (gchar **) strv);
+        g_free (strv);
+
+        if (mode == None)
+            g_string_append_printf (str, "CRTC %" G_GUINT64_FORMAT ": off", id);
+        else
+            g_string_append_printf (str, "CRTC %" G_GUINT64_FORMAT ": %dx%d+%d+%d mode 0x%" G_GINT64_MODIFIER "x [%s]",
+                                    id, width, height, x, y, mode, joined);
+        g_string_append_printf (str, "%s%s\n", changed ? ", changed" : "",
+                                disabled_first ? ", disabled first" : "");
+
+        g_free (joined);
+        g_variant_unref (names);
+        g_variant_unref (crtc);
+    }
+    if (crtcs != NULL)
+        g_variant_unref (crtcs);
+
+    phases = g_variant_lookup_value (plan, "phases", G_VARIANT_TYPE ("a{sx}"));
+    g_variant_iter_init (&iter, phases);
+    while (g_variant_iter_next (&iter, "{&sx}", &name, &duration))
+        g_string_append_printf (str, "Phase %s: %" G_GINT64_FORMAT " us\n", name, duration);
+    g_variant_unref (phases);
+
+    return g_string_free (str, FALSE);
 }
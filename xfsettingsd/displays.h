@@ -19,6 +19,8 @@
 #ifndef __DISPLAYS_H__
 #define __DISPLAYS_H__
 
+#include <glib-object.h>
+
 typedef struct _XfceDisplaysHelperClass XfceDisplaysHelperClass;
 typedef struct _XfceDisplaysHelper      XfceDisplaysHelper;
 
@@ -29,6 +31,41 @@ typedef struct _XfceDisplaysHelper      XfceDisplaysHelper;
 #define XFCE_IS_DISPLAYS_HELPER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), XFCE_TYPE_DISPLAYS_HELPER))
 #define XFCE_DISPLAYS_HELPER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), XFCE_TYPE_DISPLAYS_HELPER, XfceDisplaysHelperClass))
 
-GType xfce_displays_helper_get_type (void) G_GNUC_CONST;
+typedef enum
+{
+    XFCE_DISPLAYS_APPLY_OK,
+    XFCE_DISPLAYS_APPLY_INVALID, /* nothing saved or all outputs disabled */
+    XFCE_DISPLAYS_APPLY_FAILED   /* the server refused some of the changes */
+}
+XfceDisplaysApplyStatus;
+
+GType               xfce_displays_helper_get_type    (void) G_GNUC_CONST;
+
+/* the running helper, NULL if none */
+XfceDisplaysHelper *xfce_displays_helper_get_default (void);
+
+/* the helper created next only plans, it does not apply a scheme
+ * nor watch the screen */
+void                xfce_displays_helper_set_dry_run (gboolean             dry_run);
+
+/* what applying scheme would do, the matching profile or the default
+ * one if scheme is NULL or empty, without touching the server; a
+ * vardict with the screen size, the CRTC plan and the phase timings */
+GVariant           *xfce_displays_helper_dry_run     (XfceDisplaysHelper  *helper,
+                                                      const gchar         *scheme,
+                                                      GError             **error);
+
+gchar              *xfce_displays_helper_format_plan (GVariant            *plan);
+
+/* applies scheme right away and returns when the server is done */
+XfceDisplaysApplyStatus xfce_displays_helper_apply_scheme (XfceDisplaysHelper *helper,
+                                                           const gchar        *scheme,
+                                                           gint64             *duration,
+                                                           guint              *n_changed);
+
+/* the connected outputs as the helper last read them from the server,
+ * in the XFCE_RANDR_SNAPSHOT_TYPE format of common/xfce-randr.h */
+GVariant           *xfce_displays_helper_get_randr_snapshot (XfceDisplaysHelper  *helper,
+                                                             GError             **error);
 
 #endif /* !__DISPLAYS_H__ */
@@ -0,0 +1,374 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <X11/Xlib.h>
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+
+#include "debug.h"
+#include "event-dispatch.h"
+#include "trace.h"
+#include "watchdog.h"
+
+/* X event types are 7 bits, the last slot holds the handlers for
+ * all event types */
+#define EVENT_TABLE_SIZE 128
+#define EVENT_TABLE_ANY  EVENT_TABLE_SIZE
+
+
+
+typedef struct _EventStats EventStats;
+struct _EventStats
+{
+    gchar   *name;
+
+    guint64  n_calls;
+    gint64   total_time;
+    gint64   max_time;
+};
+
+typedef struct _EventHandler EventHandler;
+struct _EventHandler
+{
+    EventStats    *stats;
+
+    /* None for all windows */
+    Window         window;
+
+    GdkFilterFunc  func;
+    gpointer       user_data;
+
+    /* removed while dispatching */
+    guint          removed : 1;
+};
+
+
+
+/* handlers per event type, in the order they were added */
+static GSList     *dispatch_table[EVENT_TABLE_SIZE + 1];
+static gboolean    dispatch_filter_added = FALSE;
+static guint       dispatch_depth = 0;
+static gboolean    dispatch_needs_purge = FALSE;
+
+/* sees every event that has a handler, before it is dispatched */
+static XfceEventMonitorFunc dispatch_monitor = NULL;
+static gpointer             dispatch_monitor_data = NULL;
+
+/* name -> EventStats, kept when handlers are removed */
+static GHashTable *dispatch_stats = NULL;
+
+
+
+static void
+xfsettings_event_dispatch_stats_free (gpointer data)
+{
+    EventStats *stats = data;
+
+    g_free (stats->name);
+    g_slice_free (EventStats, stats);
+}
+
+
+
+static void
+xfsettings_event_dispatch_purge (void)
+{
+    GSList *li, *lnext;
+    guint   i;
+
+    for (i = 0; i <= EVENT_TABLE_SIZE; i++)
+    {
+        for (li = dispatch_table[i]; li != NULL; li = lnext)
+        {
+            EventHandler *handler = li->data;
+
+            lnext = li->next;
+            if (handler->removed)
+            {
+                dispatch_table[i] = g_slist_delete_link (dispatch_table[i], li);
+                g_slice_free (EventHandler, handler);
+            }
+        }
+    }
+
+    dispatch_needs_purge = FALSE;
+}
+
+
+
+static GdkFilterReturn
+xfsettings_event_dispatch_list (GSList    *handlers,
+                                GdkXEvent *gdkxevent,
+                                GdkEvent  *gdkevent)
+{
+    XEvent          *xevent = gdkxevent;
+    GSList          *li;
+    EventHandler    *handler;
+    GdkFilterReturn  result = GDK_FILTER_CONTINUE;
+    gint64           start_time, elapsed;
+    const gchar     *label;
+
+    for (li = handlers; li != NULL && result == GDK_FILTER_CONTINUE; li = li->next)
+    {
+        handler = li->data;
+
+        if (handler->removed
+            || (handler->window != None && handler->window != xevent->xany.window))
+            continue;
+
+        start_time = g_get_monotonic_time ();
+        label = xfsettings_watchdog_set_label (handler->stats->name);
+
+        result = (*handler->func) (gdkxevent, gdkevent, handler->user_data);
+
+        xfsettings_watchdog_set_label (label);
+        elapsed = g_get_monotonic_time () - start_time;
+        handler->stats->n_calls++;
+        handler->stats->total_time += elapsed;
+        if (elapsed > handler->stats->max_time)
+            handler->stats->max_time = elapsed;
+
+        xfsettings_trace (XFSD_TRACE_X_EVENT, elapsed, xevent->type, 0);
+    }
+
+    return result;
+}
+
+
+
+static GdkFilterReturn
+xfsettings_event_dispatch_filter (GdkXEvent *gdkxevent,
+                                  GdkEvent  *gdkevent,
+                                  gpointer   user_data)
+{
+    XEvent          *xevent = gdkxevent;
+    GdkFilterReturn  result = GDK_FILTER_CONTINUE;
+
+    /* handlers can remove themselves or others, entries are only
+     * freed when leaving the outermost dispatch */
+    dispatch_depth++;
+
+    if (G_UNLIKELY (dispatch_monitor != NULL)
+        && (dispatch_table[EVENT_TABLE_ANY] != NULL
+            || (xevent->type >= 0 && xevent->type < EVENT_TABLE_SIZE
+                && dispatch_table[xevent->type] != NULL)))
+        (*dispatch_monitor) (xevent, dispatch_monitor_data);
+
+    if (G_LIKELY (xevent->type >= 0 && xevent->type < EVENT_TABLE_SIZE))
+        result = xfsettings_event_dispatch_list (dispatch_table[xevent->type], gdkxevent, gdkevent);
+
+    if (result == GDK_FILTER_CONTINUE)
+        result = xfsettings_event_dispatch_list (dispatch_table[EVENT_TABLE_ANY], gdkxevent, gdkevent);
+
+    dispatch_depth--;
+
+    if (dispatch_depth == 0 && dispatch_needs_purge)
+        xfsettings_event_dispatch_purge ();
+
+    return result;
+}
+
+
+
+void
+xfsettings_event_dispatch_add (const gchar   *name,
+                               gint           event_type,
+                               Window         window,
+                               GdkFilterFunc  func,
+                               gpointer       user_data)
+{
+    EventHandler *handler;
+    EventStats   *stats;
+    guint         slot;
+
+    g_return_if_fail (name != NULL);
+    g_return_if_fail (func != NULL);
+    g_return_if_fail (event_type == XFSETTINGS_EVENT_ANY
+                      || (event_type >= 0 && event_type < EVENT_TABLE_SIZE));
+
+    if (G_UNLIKELY (dispatch_stats == NULL))
+        dispatch_stats = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                xfsettings_event_dispatch_stats_free);
+
+    stats = g_hash_table_lookup (dispatch_stats, name);
+    if (stats == NULL)
+    {
+        stats = g_slice_new0 (EventStats);
+        stats->name = g_strdup (name);
+        g_hash_table_insert (dispatch_stats, stats->name, stats);
+    }
+
+    handler = g_slice_new0 (EventHandler);
+    handler->stats = stats;
+    handler->window = window;
+    handler->func = func;
+    handler->user_data = user_data;
+
+    slot = event_type == XFSETTINGS_EVENT_ANY ? EVENT_TABLE_ANY : (guint) event_type;
+    dispatch_table[slot] = g_slist_append (dispatch_table[slot], handler);
+
+    /* one filter for the whole daemon */
+    if (!dispatch_filter_added)
+    {
+        gdk_window_add_filter (NULL, xfsettings_event_dispatch_filter, NULL);
+        dispatch_filter_added = TRUE;
+    }
+
+    xfsettings_dbg (XFSD_DEBUG_EVENTS, "%s handles event type %d on window 0x%lx",
+                    name, event_type, window);
+}
+
+
+
+static void
+xfsettings_event_dispatch_remove_internal (gboolean      match_window,
+                                           Window        window,
+                                           GdkFilterFunc func,
+                                           gpointer      user_data)
+{
+    GSList       *li;
+    EventHandler *handler;
+    guint         i;
+
+    for (i = 0; i <= EVENT_TABLE_SIZE; i++)
+    {
+        for (li = dispatch_table[i]; li != NULL; li = li->next)
+        {
+            handler = li->data;
+
+            if (!handler->removed
+                && handler->func == func
+                && handler->user_data == user_data
+                && (!match_window || handler->window == window))
+            {
+                handler->removed = TRUE;
+
+                /* a window can be watched more than once, like
+                 * gdk_window_remove_filter only remove one */
+                if (match_window)
+                    goto done;
+            }
+        }
+    }
+
+done:
+    if (dispatch_depth > 0)
+        dispatch_needs_purge = TRUE;
+    else
+        xfsettings_event_dispatch_purge ();
+}
+
+
+
+void
+xfsettings_event_dispatch_remove (GdkFilterFunc func,
+                                  gpointer      user_data)
+{
+    g_return_if_fail (func != NULL);
+
+    xfsettings_event_dispatch_remove_internal (FALSE, None, func, user_data);
+}
+
+
+
+void
+xfsettings_event_dispatch_remove_window (Window        window,
+                                         GdkFilterFunc func,
+                                         gpointer      user_data)
+{
+    g_return_if_fail (func != NULL);
+
+    xfsettings_event_dispatch_remove_internal (TRUE, window, func, user_data);
+}
+
+
+
+void
+xfsettings_event_dispatch_set_monitor (XfceEventMonitorFunc func,
+                                       gpointer             user_data)
+{
+    dispatch_monitor = func;
+    dispatch_monitor_data = user_data;
+}
+
+
+
+void
+xfsettings_event_dispatch_inject (XEvent *xevent)
+{
+    GdkEvent event;
+
+    g_return_if_fail (xevent != NULL);
+
+    /* the handlers only look at the X event */
+    memset (&event, 0, sizeof (event));
+    event.type = GDK_NOTHING;
+
+    xfsettings_event_dispatch_filter (xevent, &event, NULL);
+}
+
+
+
+void
+xfsettings_event_dispatch_foreach_stats (XfceEventStatsFunc func,
+                                         gpointer           user_data)
+{
+    GHashTableIter  iter;
+    EventStats     *stats;
+
+    g_return_if_fail (func != NULL);
+
+    if (dispatch_stats == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, dispatch_stats);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer) &stats))
+        (*func) (stats->name, stats->n_calls, stats->total_time, stats->max_time, user_data);
+}
+
+
+
+static void
+xfsettings_event_dispatch_report_stats (const gchar *name,
+                                        guint64      n_calls,
+                                        gint64       total_time,
+                                        gint64       max_time,
+                                        gpointer     user_data)
+{
+    xfsettings_dbg (XFSD_DEBUG_EVENTS, "%s: %" G_GUINT64_FORMAT " events, "
+                    "%.3f ms total, %.3f ms max",
+                    name, n_calls, total_time / 1000.0, max_time / 1000.0);
+}
+
+
+
+void
+xfsettings_event_dispatch_report (void)
+{
+    xfsettings_event_dispatch_foreach_stats (xfsettings_event_dispatch_report_stats, NULL);
+}
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __EVENT_DISPATCH_H__
+#define __EVENT_DISPATCH_H__
+
+#include <gdk/gdk.h>
+#include <X11/Xlib.h>
+
+/* handler for all event types, to be used for extensions that
+ * need to see every event (libxklavier) or for a single window */
+#define XFSETTINGS_EVENT_ANY (-1)
+
+typedef void (*XfceEventStatsFunc) (const gchar *name,
+                                    guint64      n_calls,
+                                    gint64       total_time,
+                                    gint64       max_time,
+                                    gpointer     user_data);
+
+typedef void (*XfceEventMonitorFunc) (const XEvent *xevent,
+                                      gpointer      user_data);
+
+void xfsettings_event_dispatch_add           (const gchar        *name,
+                                              gint                event_type,
+                                              Window              window,
+                                              GdkFilterFunc       func,
+                                              gpointer            user_data);
+
+void xfsettings_event_dispatch_remove        (GdkFilterFunc       func,
+                                              gpointer            user_data);
+
+void xfsettings_event_dispatch_remove_window (Window              window,
+                                              GdkFilterFunc       func,
+                                              gpointer            user_data);
+
+/* the monitor sees every event that has a handler, injected events
+ * are dispatched to the handlers as if they came from the server */
+void xfsettings_event_dispatch_set_monitor   (XfceEventMonitorFunc  func,
+                                              gpointer              user_data);
+
+void xfsettings_event_dispatch_inject        (XEvent             *xevent);
+
+void xfsettings_event_dispatch_foreach_stats (XfceEventStatsFunc  func,
+                                              gpointer            user_data);
+
+void xfsettings_event_dispatch_report        (void);
+
+#endif /* !__EVENT_DISPATCH_H__ */
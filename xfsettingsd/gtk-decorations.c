@@ -27,6 +27,7 @@
 #include <xfconf/xfconf.h>
 #include <libxfce4util/libxfce4util.h>
 #include "gtk-decorations.h"
+#include "replay.h"
 
 #define DEFAULT_LAYOUT "O|HMC"
 
@@ -113,8 +114,10 @@ xfce_decorations_set_decoration_layout (XfceDecorationsHelper *helper,
     }
 
     gtk_decoration_layout = g_string_free (join, FALSE);
+    xfsettings_replay_ignore_push ();
     xfconf_channel_set_string (helper->xsettings_channel,
                              "/Gtk/DecorationLayout", gtk_decoration_layout);
+    xfsettings_replay_ignore_pop ();
     g_free (gtk_decoration_layout);
 }
 
@@ -0,0 +1,357 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <gmodule.h>
+#include <xfconf/xfconf.h>
+
+#include "debug.h"
+#include "helper-module.h"
+#include "startup.h"
+#include "trace.h"
+
+/* seconds a helper that is not needed anymore is kept around */
+#define HELPER_MODULE_IDLE_TIMEOUT 30
+
+
+
+static void     xfce_helper_module_finalize         (GObject          *object);
+static gboolean xfce_helper_module_load             (GTypeModule      *type_module);
+static void     xfce_helper_module_unload           (GTypeModule      *type_module);
+static void     xfce_helper_module_property_changed (XfconfChannel    *channel,
+                                                     const gchar      *property_name,
+                                                     const GValue     *value,
+                                                     XfceHelperModule *module);
+
+
+
+struct _XfceHelperModuleClass
+{
+    GTypeModuleClass __parent__;
+};
+
+struct _XfceHelperModule
+{
+    GTypeModule                 __parent__;
+
+    gchar                      *filename;
+
+    GModule                    *library;
+    GType                       helper_type;
+
+    /* policy */
+    XfconfChannel              *channel;
+    XfceHelperModuleNeededFunc  needed_func;
+
+    /* the running helper */
+    GObject                    *helper;
+    guint                       unload_timeout_id;
+
+    /* don't retry a module that failed to load */
+    guint                       load_failed : 1;
+};
+
+
+
+G_DEFINE_TYPE (XfceHelperModule, xfce_helper_module, G_TYPE_TYPE_MODULE)
+
+
+
+static void
+xfce_helper_module_class_init (XfceHelperModuleClass *klass)
+{
+    GObjectClass     *gobject_class;
+    GTypeModuleClass *type_module_class;
+
+    gobject_class = G_OBJECT_CLASS (klass);
+    gobject_class->finalize = xfce_helper_module_finalize;
+
+    type_module_class = G_TYPE_MODULE_CLASS (klass);
+    type_module_class->load = xfce_helper_module_load;
+    type_module_class->unload = xfce_helper_module_unload;
+}
+
+
+
+static void
+xfce_helper_module_init (XfceHelperModule *module)
+{
+    module->helper_type = G_TYPE_NONE;
+}
+
+
+
+static void
+xfce_helper_module_finalize (GObject *object)
+{
+    XfceHelperModule *module = XFCE_HELPER_MODULE (object);
+
+    /* type modules are never finalized once used, this is for the
+     * ones that were never loaded */
+    g_free (module->filename);
+
+    (*G_OBJECT_CLASS (xfce_helper_module_parent_class)->finalize) (object);
+}
+
+
+
+static gboolean
+xfce_helper_module_load (GTypeModule *type_module)
+{
+    XfceHelperModule             *module = XFCE_HELPER_MODULE (type_module);
+    XfceHelperModuleRegisterFunc  register_func;
+
+    module->library = g_module_open (module->filename, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+    if (G_UNLIKELY (module->library == NULL))
+    {
+        g_critical ("Failed to load helper module \"%s\": %s",
+                    module->filename, g_module_error ());
+        return FALSE;
+    }
+
+    if (!g_module_symbol (module->library, XFCE_HELPER_MODULE_REGISTER, (gpointer) &register_func))
+    {
+        g_critical ("Helper module \"%s\" lacks the %s function",
+                    module->filename, XFCE_HELPER_MODULE_REGISTER);
+        g_module_close (module->library);
+        module->library = NULL;
+        return FALSE;
+    }
+
+    /* the modules link libraries (libxklavier, libnotify) that register
+     * static types, those cannot be unmapped safely; unloading releases
+     * the helper and everything it allocated */
+    g_module_make_resident (module->library);
+
+    module->helper_type = (*register_func) (type_module);
+
+    return module->helper_type != G_TYPE_NONE;
+}
+
+
+
+static void
+xfce_helper_module_unload (GTypeModule *type_module)
+{
+    XfceHelperModule *module = XFCE_HELPER_MODULE (type_module);
+
+    g_module_close (module->library);
+    module->library = NULL;
+}
+
+
+
+static glong
+xfce_helper_module_get_rss (void)
+{
+    FILE  *fp;
+    glong  size, resident = 0;
+
+    /* resident set size in KiB, 0 where /proc is not available */
+    fp = fopen ("/proc/self/statm", "r");
+    if (fp != NULL)
+    {
+        if (fscanf (fp, "%ld %ld", &size, &resident) != 2)
+            resident = 0;
+        fclose (fp);
+    }
+
+    return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+
+
+static void
+xfce_helper_module_activate (XfceHelperModule *module)
+{
+    const gchar *name = G_TYPE_MODULE (module)->name;
+    gint64       start_time;
+    glong        rss;
+
+    start_time = g_get_monotonic_time ();
+    rss = xfce_helper_module_get_rss ();
+
+    if (!g_type_module_use (G_TYPE_MODULE (module)))
+    {
+        module->load_failed = TRUE;
+        xfsettings_trace (XFSD_TRACE_MODULE_LOAD, g_get_monotonic_time () - start_time, FALSE, 0);
+        return;
+    }
+
+    module->helper = g_object_new (module->helper_type, NULL);
+
+    xfsettings_dbg (XFSD_DEBUG_MODULES, "loaded \"%s\" in %.3f ms, rss %+ld KiB",
+                    name, (g_get_monotonic_time () - start_time) / 1000.0,
+                    xfce_helper_module_get_rss () - rss);
+
+    xfsettings_trace (XFSD_TRACE_MODULE_LOAD, g_get_monotonic_time () - start_time, TRUE, 0);
+    xfsettings_startup_mark (name, start_time);
+}
+
+
+
+static void
+xfce_helper_module_deactivate (XfceHelperModule *module)
+{
+    glong rss;
+
+    rss = xfce_helper_module_get_rss ();
+
+    g_object_unref (module->helper);
+    module->helper = NULL;
+
+    g_type_module_unuse (G_TYPE_MODULE (module));
+
+    xfsettings_dbg (XFSD_DEBUG_MODULES, "unloaded \"%s\", rss %+ld KiB",
+                    G_TYPE_MODULE (module)->name,
+                    xfce_helper_module_get_rss () - rss);
+}
+
+
+
+static gboolean
+xfce_helper_module_unload_timeout (gpointer user_data)
+{
+    XfceHelperModule *module = XFCE_HELPER_MODULE (user_data);
+
+    module->unload_timeout_id = 0;
+
+    if (module->helper != NULL)
+        xfce_helper_module_deactivate (module);
+
+    return FALSE;
+}
+
+
+
+static void
+xfce_helper_module_update (XfceHelperModule *module)
+{
+    gboolean needed;
+
+    needed = module->needed_func == NULL || (*module->needed_func) (module->channel);
+
+    if (needed)
+    {
+        /* keep the helper */
+        if (module->unload_timeout_id != 0)
+        {
+            g_source_remove (module->unload_timeout_id);
+            module->unload_timeout_id = 0;
+        }
+
+        if (module->helper == NULL && !module->load_failed)
+            xfce_helper_module_activate (module);
+    }
+    else if (module->helper != NULL && module->unload_timeout_id == 0)
+    {
+        /* give the helper some time to apply the change that made it
+         * useless, and avoid reloading when the user toggles back */
+        module->unload_timeout_id = g_timeout_add_seconds (HELPER_MODULE_IDLE_TIMEOUT,
+                                                           xfce_helper_module_unload_timeout,
+                                                           module);
+    }
+}
+
+
+
+static void
+xfce_helper_module_property_changed (XfconfChannel    *channel,
+                                     const gchar      *property_name,
+                                     const GValue     *value,
+                                     XfceHelperModule *module)
+{
+    xfce_helper_module_update (module);
+}
+
+
+
+XfceHelperModule *
+xfce_helper_module_new (const gchar                *name,
+                        const gchar                *channel_name,
+                        XfceHelperModuleNeededFunc  needed_func,
+                        XfceHelperModuleFlags       flags)
+{
+    XfceHelperModule *module;
+    const gchar      *moduledir;
+
+    g_return_val_if_fail (name != NULL, NULL);
+
+    /* the tests run the daemon from the build tree */
+    moduledir = g_getenv ("XFSETTINGSD_MODULE_PATH");
+    if (moduledir == NULL || *moduledir == '\0')
+        moduledir = XFSETTINGSD_MODULEDIR;
+
+    module = g_object_new (XFCE_TYPE_HELPER_MODULE, NULL);
+    g_type_module_set_name (G_TYPE_MODULE (module), name);
+    module->filename = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.%s",
+                                        moduledir, name, G_MODULE_SUFFIX);
+    module->needed_func = needed_func;
+
+    if (channel_name != NULL)
+    {
+        /* run after the helper's own handler, so it sees the change
+         * before it is unloaded */
+        module->channel = xfconf_channel_get (channel_name);
+        g_signal_connect_after (G_OBJECT (module->channel), "property-changed",
+                                G_CALLBACK (xfce_helper_module_property_changed), module);
+    }
+
+    /* apply the settings once, the update below unloads the helper
+     * again after the idle timeout if it is not needed */
+    if ((flags & XFCE_HELPER_MODULE_FLAGS_APPLY_ONCE) != 0)
+        xfce_helper_module_activate (module);
+
+    xfce_helper_module_update (module);
+
+    return module;
+}
+
+
+
+void
+xfce_helper_module_stop (XfceHelperModule *module)
+{
+    g_return_if_fail (XFCE_IS_HELPER_MODULE (module));
+
+    if (module->channel != NULL)
+    {
+        g_signal_handlers_disconnect_by_func (G_OBJECT (module->channel),
+                                              G_CALLBACK (xfce_helper_module_property_changed),
+                                              module);
+        module->channel = NULL;
+    }
+
+    if (module->unload_timeout_id != 0)
+    {
+        g_source_remove (module->unload_timeout_id);
+        module->unload_timeout_id = 0;
+    }
+
+    if (module->helper != NULL)
+        xfce_helper_module_deactivate (module);
+}
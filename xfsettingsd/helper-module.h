@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __HELPER_MODULE_H__
+#define __HELPER_MODULE_H__
+
+#include <glib-object.h>
+#include <gmodule.h>
+#include <xfconf/xfconf.h>
+
+G_BEGIN_DECLS
+
+/* symbol each helper module exports, it registers the helper type in
+ * the type module and returns it */
+#define XFCE_HELPER_MODULE_REGISTER "xfce_helper_module_register"
+
+typedef GType (*XfceHelperModuleRegisterFunc) (GTypeModule *type_module);
+
+G_MODULE_EXPORT GType xfce_helper_module_register (GTypeModule *type_module);
+
+/* returns TRUE if the helper is needed with the current settings */
+typedef gboolean (*XfceHelperModuleNeededFunc) (XfconfChannel *channel);
+
+typedef enum /*< flags >*/
+{
+    XFCE_HELPER_MODULE_FLAGS_NONE       = 0,
+
+    /* load the helper on startup even if it is not needed: it also
+     * switches off what the session may have enabled */
+    XFCE_HELPER_MODULE_FLAGS_APPLY_ONCE = 1 << 0,
+}
+XfceHelperModuleFlags;
+
+#define XFCE_TYPE_HELPER_MODULE            (xfce_helper_module_get_type ())
+#define XFCE_HELPER_MODULE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), XFCE_TYPE_HELPER_MODULE, XfceHelperModule))
+#define XFCE_HELPER_MODULE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), XFCE_TYPE_HELPER_MODULE, XfceHelperModuleClass))
+#define XFCE_IS_HELPER_MODULE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XFCE_TYPE_HELPER_MODULE))
+#define XFCE_IS_HELPER_MODULE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), XFCE_TYPE_HELPER_MODULE))
+#define XFCE_HELPER_MODULE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), XFCE_TYPE_HELPER_MODULE, XfceHelperModuleClass))
+
+typedef struct _XfceHelperModuleClass XfceHelperModuleClass;
+typedef struct _XfceHelperModule      XfceHelperModule;
+
+GType             xfce_helper_module_get_type (void) G_GNUC_CONST;
+
+XfceHelperModule *xfce_helper_module_new      (const gchar                *name,
+                                               const gchar                *channel_name,
+                                               XfceHelperModuleNeededFunc  needed_func,
+                                               XfceHelperModuleFlags       flags);
+
+void              xfce_helper_module_stop     (XfceHelperModule           *module);
+
+G_END_DECLS
+
+#endif /* !__HELPER_MODULE_H__ */
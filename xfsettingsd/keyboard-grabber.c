@@ -0,0 +1,753 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Key grabber used by the keyboard shortcuts helper.
+ *
+ * Unlike the grabber in libxfce4kbd-private, which traps and syncs every
+ * single XGrabKey, grabs are collected in a batch and sent to the server
+ * in one go. After a single XSync the errors that came back are matched
+ * to the requests by their serial, so one round trip is enough to know
+ * which shortcuts could not be grabbed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+
+#include "debug.h"
+#include "event-dispatch.h"
+#include "keyboard-grabber.h"
+
+/* real X modifiers we care about */
+#define MODIFIER_MASK  (ShiftMask | LockMask | ControlMask | Mod1Mask \
+                        | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
+
+/* key for the lookup table of grabbed keys */
+#define GRAB_KEY(keycode, modifiers) \
+    GUINT_TO_POINTER (((keycode) << 8) | ((modifiers) & 0xff))
+
+/* key for the lookup table of shortcuts, the accelerator as parsed by gtk */
+#define ACCEL_KEY(keyval, modifiers) \
+    (((guint64) (modifiers) << 32) | (keyval))
+
+
+
+typedef struct _XfceKeyGrab   XfceKeyGrab;
+typedef struct _XfceKeyGrabOp XfceKeyGrabOp;
+
+
+
+static void            xfce_key_grabber_keys_changed (GdkKeymap      *keymap,
+                                                      XfceKeyGrabber *grabber);
+static GdkFilterReturn xfce_key_grabber_event_filter (GdkXEvent      *gdk_xevent,
+                                                      GdkEvent       *event,
+                                                      gpointer        user_data);
+
+
+
+struct _XfceKeyGrabber
+{
+    XfceKeyGrabberFunc  func;
+    gpointer            user_data;
+
+    GdkDisplay         *display;
+    Display            *xdisplay;
+    GdkWindow          *root_window;
+    GdkKeymap          *keymap;
+    gulong              keys_changed_id;
+
+    /* shortcut string -> XfceKeyGrab */
+    GHashTable         *grabs;
+
+    /* GRAB_KEY (keycode, modifiers) -> XfceKeyGrab owning the grab */
+    GHashTable         *active;
+
+    /* ACCEL_KEY (keyval, modifiers) -> XfceKeyGrab, to match key presses */
+    GHashTable         *accels;
+
+    /* lock modifiers and all their combinations */
+    guint               ignored_mask;
+    guint               lock_combos[8];
+    guint               n_lock_combos;
+};
+
+struct _XfceKeyGrab
+{
+    gchar  *shortcut;
+    guint   keyval;
+    guint   modifiers;
+
+    /* ACCEL_KEY of the parsed shortcut, before the modifiers are mapped */
+    guint64 accel_key;
+
+    /* sorted keycodes grabbed on the server */
+    GArray *keycodes;
+};
+
+struct _XfceKeyGrabOp
+{
+    XfceKeyGrab *grab;
+    guint        keycode;
+    guint        modifiers;
+    guint        ungrab : 1;
+
+    /* serials of the first and last request sent for this op */
+    gulong       first_serial;
+    gulong       last_serial;
+
+    /* number of lock combinations the server refused */
+    guint        n_failed;
+};
+
+
+
+/* errors collected while a batch is being flushed */
+static GArray        *batch_errors = NULL;
+static gulong         batch_first_serial = 0;
+static XErrorHandler  batch_previous_handler = NULL;
+
+
+
+static gint
+xfce_key_grabber_x_error_handler (Display     *xdisplay,
+                                  XErrorEvent *xevent)
+{
+    /* only swallow errors caused by the batch, pass on the rest */
+    if (batch_errors != NULL && xevent->serial >= batch_first_serial)
+    {
+        g_array_append_val (batch_errors, xevent->serial);
+        return 0;
+    }
+
+    if (batch_previous_handler != NULL)
+        return batch_previous_handler (xdisplay, xevent);
+
+    return 0;
+}
+
+
+
+static void
+xfce_key_grabber_update_lock_masks (XfceKeyGrabber *grabber)
+{
+    guint masks[3];
+    guint n, i, combo;
+
+    masks[0] = LockMask;
+    masks[1] = XkbKeysymToModifiers (grabber->xdisplay, XK_Num_Lock);
+    masks[2] = XkbKeysymToModifiers (grabber->xdisplay, XK_Scroll_Lock);
+
+    grabber->ignored_mask = masks[0] | masks[1] | masks[2];
+    grabber->n_lock_combos = 0;
+
+    for (n = 0; n < G_N_ELEMENTS (grabber->lock_combos); n++)
+    {
+        combo = 0;
+        for (i = 0; i < G_N_ELEMENTS (masks); i++)
+            if ((n & (1 << i)) != 0)
+                combo |= masks[i];
+
+        /* unmapped lock keys produce duplicate combinations */
+        for (i = 0; i < grabber->n_lock_combos; i++)
+            if (grabber->lock_combos[i] == combo)
+                break;
+
+        if (i == grabber->n_lock_combos)
+            grabber->lock_combos[grabber->n_lock_combos++] = combo;
+    }
+}
+
+
+
+static gint
+xfce_key_grabber_compare_keycodes (gconstpointer a,
+                                   gconstpointer b)
+{
+    return (gint) *(const guint *) a - (gint) *(const guint *) b;
+}
+
+
+
+static GArray *
+xfce_key_grabber_resolve (XfceKeyGrabber *grabber,
+                          guint           keyval)
+{
+    GdkKeymapKey *keys;
+    GArray       *keycodes;
+    gint          n_keys, n;
+    guint         i;
+
+    keycodes = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    if (gdk_keymap_get_entries_for_keyval (grabber->keymap, keyval, &keys, &n_keys))
+    {
+        for (n = 0; n < n_keys; n++)
+        {
+            /* the same keycode shows up once per group and level */
+            for (i = 0; i < keycodes->len; i++)
+                if (g_array_index (keycodes, guint, i) == keys[n].keycode)
+                    break;
+
+            if (i == keycodes->len)
+                g_array_append_val (keycodes, keys[n].keycode);
+        }
+
+        g_free (keys);
+    }
+
+    g_array_sort (keycodes, xfce_key_grabber_compare_keycodes);
+
+    return keycodes;
+}
+
+
+
+static guint
+xfce_key_grabber_real_modifiers (XfceKeyGrabber  *grabber,
+                                 GdkModifierType  modifiers)
+{
+    /* map Super, Hyper and Meta on the real modifiers */
+    gdk_keymap_map_virtual_modifiers (grabber->keymap, &modifiers);
+
+    return modifiers & MODIFIER_MASK & ~grabber->ignored_mask;
+}
+
+
+
+static void
+xfce_key_grabber_grab_free (XfceKeyGrab *grab)
+{
+    g_free (grab->shortcut);
+    g_array_free (grab->keycodes, TRUE);
+    g_slice_free (XfceKeyGrab, grab);
+}
+
+
+
+static void
+xfce_key_grabber_queue (XfceKeyGrabber *grabber,
+                        GArray         *ops,
+                        XfceKeyGrab    *grab,
+                        guint           keycode,
+                        guint           modifiers,
+                        gboolean        ungrab)
+{
+    XfceKeyGrabOp op = { 0, };
+
+    /* never release a key that another shortcut took over */
+    if (ungrab && g_hash_table_lookup (grabber->active, GRAB_KEY (keycode, modifiers)) != grab)
+        return;
+
+    op.grab = grab;
+    op.keycode = keycode;
+    op.modifiers = modifiers;
+    op.ungrab = !!ungrab;
+
+    g_array_append_val (ops, op);
+}
+
+
+
+static void
+xfce_key_grabber_queue_all (XfceKeyGrabber *grabber,
+                            GArray         *ops,
+                            XfceKeyGrab    *grab,
+                            gboolean        ungrab)
+{
+    guint i;
+
+    for (i = 0; i < grab->keycodes->len; i++)
+    {
+        xfce_key_grabber_queue (grabber, ops, grab, g_array_index (grab->keycodes, guint, i),
+                                grab->modifiers, ungrab);
+    }
+}
+
+
+
+static void
+xfce_key_grabber_flush (XfceKeyGrabber *grabber,
+                        GArray         *ops)
+{
+    XfceKeyGrabOp *op;
+    Window         root;
+    gulong         serial;
+    guint          n, i, n_requests = 0;
+    guint          n_grabbed = 0, n_failed = 0;
+    gint64         timestamp;
+    GHashTable    *failed_grabs;
+    gpointer       key;
+
+    if (ops->len == 0)
+        return;
+
+    timestamp = g_get_monotonic_time ();
+    root = GDK_WINDOW_XID (grabber->root_window);
+
+    /* install our handler so each error can be matched to its request,
+     * earlier requests still have a lower serial and are passed on */
+    g_assert (batch_errors == NULL);
+    batch_errors = g_array_new (FALSE, FALSE, sizeof (gulong));
+    batch_first_serial = NextRequest (grabber->xdisplay);
+    batch_previous_handler = XSetErrorHandler (xfce_key_grabber_x_error_handler);
+
+    /* pipeline all the requests */
+    for (n = 0; n < ops->len; n++)
+    {
+        op = &g_array_index (ops, XfceKeyGrabOp, n);
+        op->first_serial = NextRequest (grabber->xdisplay);
+
+        for (i = 0; i < grabber->n_lock_combos; i++)
+        {
+            if (op->ungrab)
+            {
+                XUngrabKey (grabber->xdisplay, op->keycode,
+                            op->modifiers | grabber->lock_combos[i], root);
+            }
+            else
+            {
+                XGrabKey (grabber->xdisplay, op->keycode,
+                          op->modifiers | grabber->lock_combos[i], root,
+                          False, GrabModeAsync, GrabModeAsync);
+            }
+        }
+
+        op->last_serial = NextRequest (grabber->xdisplay) - 1;
+        n_requests += grabber->n_lock_combos;
+    }
+
+    /* one round trip for the entire batch */
+    XSync (grabber->xdisplay, False);
+
+    XSetErrorHandler (batch_previous_handler);
+    batch_previous_handler = NULL;
+
+    /* errors arrive in request order, so both lists can be walked once */
+    for (i = 0, n = 0; i < batch_errors->len; i++)
+    {
+        serial = g_array_index (batch_errors, gulong, i);
+
+        while (n < ops->len && g_array_index (ops, XfceKeyGrabOp, n).last_serial < serial)
+            n++;
+
+        if (n == ops->len)
+            break;
+
+        op = &g_array_index (ops, XfceKeyGrabOp, n);
+        if (op->first_serial <= serial)
+            op->n_failed++;
+    }
+
+    g_array_free (batch_errors, TRUE);
+    batch_errors = NULL;
+
+    /* reconcile the lookup table with what the server accepted */
+    failed_grabs = g_hash_table_new (g_direct_hash, g_direct_equal);
+    for (n = 0; n < ops->len; n++)
+    {
+        op = &g_array_index (ops, XfceKeyGrabOp, n);
+        key = GRAB_KEY (op->keycode, op->modifiers);
+
+        if (op->ungrab)
+        {
+            if (g_hash_table_lookup (grabber->active, key) == op->grab)
+                g_hash_table_remove (grabber->active, key);
+        }
+        else if (op->n_failed < grabber->n_lock_combos)
+        {
+            /* at least some of the lock combinations are ours */
+            g_hash_table_insert (grabber->active, key, op->grab);
+            n_grabbed++;
+
+            if (op->n_failed > 0)
+                g_hash_table_add (failed_grabs, op->grab);
+        }
+        else
+        {
+            g_hash_table_add (failed_grabs, op->grab);
+            n_failed++;
+        }
+    }
+
+    if (g_hash_table_size (failed_grabs) > 0)
+    {
+        GHashTableIter  iter;
+        XfceKeyGrab    *grab;
+
+        g_hash_table_iter_init (&iter, failed_grabs);
+        while (g_hash_table_iter_next (&iter, (gpointer *) &grab, NULL))
+            g_warning ("Failed to grab shortcut \"%s\", it is probably "
+                       "already in use by another application.", grab->shortcut);
+    }
+
+    g_hash_table_destroy (failed_grabs);
+
+    xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS,
+                    "flushed %u key ops (%u requests, %u grabbed, %u failed) in %.2f ms",
+                    ops->len, n_requests, n_grabbed, n_failed,
+                    (g_get_monotonic_time () - timestamp) / 1000.0);
+}
+
+
+
+static gboolean
+xfce_key_grabber_add_internal (XfceKeyGrabber *grabber,
+                               const gchar    *shortcut,
+                               GArray         *ops)
+{
+    XfceKeyGrab     *grab;
+    guint            keyval;
+    GdkModifierType  modifiers;
+
+    gtk_accelerator_parse (shortcut, &keyval, &modifiers);
+    if (G_UNLIKELY (keyval == 0))
+    {
+        xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "invalid shortcut \"%s\"", shortcut);
+        return FALSE;
+    }
+
+    /* release the old grab if the shortcut was already known */
+    grab = g_hash_table_lookup (grabber->grabs, shortcut);
+    if (grab != NULL)
+    {
+        xfce_key_grabber_queue_all (grabber, ops, grab, TRUE);
+        g_array_free (grab->keycodes, TRUE);
+    }
+    else
+    {
+        grab = g_slice_new0 (XfceKeyGrab);
+        grab->shortcut = g_strdup (shortcut);
+        g_hash_table_insert (grabber->grabs, grab->shortcut, grab);
+    }
+
+    grab->keyval = keyval;
+    grab->modifiers = xfce_key_grabber_real_modifiers (grabber, modifiers);
+    grab->accel_key = ACCEL_KEY (keyval, modifiers);
+    g_hash_table_replace (grabber->accels, &grab->accel_key, grab);
+    grab->keycodes = xfce_key_grabber_resolve (grabber, keyval);
+
+    xfce_key_grabber_queue_all (grabber, ops, grab, FALSE);
+
+    return TRUE;
+}
+
+
+
+XfceKeyGrabber *
+xfce_key_grabber_new (XfceKeyGrabberFunc func,
+                      gpointer           user_data)
+{
+    XfceKeyGrabber *grabber;
+
+    g_return_val_if_fail (func != NULL, NULL);
+
+    grabber = g_slice_new0 (XfceKeyGrabber);
+    grabber->func = func;
+    grabber->user_data = user_data;
+
+    grabber->display = gdk_display_get_default ();
+    grabber->xdisplay = gdk_x11_display_get_xdisplay (grabber->display);
+    grabber->root_window = gdk_get_default_root_window ();
+    grabber->keymap = gdk_keymap_get_for_display (grabber->display);
+
+    grabber->grabs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                            (GDestroyNotify) xfce_key_grabber_grab_free);
+    grabber->active = g_hash_table_new (g_direct_hash, g_direct_equal);
+    grabber->accels = g_hash_table_new (g_int64_hash, g_int64_equal);
+
+    xfce_key_grabber_update_lock_masks (grabber);
+
+    grabber->keys_changed_id =
+        g_signal_connect (G_OBJECT (grabber->keymap), "keys-changed",
+                          G_CALLBACK (xfce_key_grabber_keys_changed), grabber);
+
+    xfsettings_event_dispatch_add ("keyboard-shortcuts", KeyPress, GDK_WINDOW_XID (grabber->root_window),
+                                   xfce_key_grabber_event_filter, grabber);
+
+    return grabber;
+}
+
+
+
+void
+xfce_key_grabber_free (XfceKeyGrabber *grabber)
+{
+    GHashTableIter  iter;
+    XfceKeyGrab    *grab;
+    GArray         *ops;
+
+    if (G_UNLIKELY (grabber == NULL))
+        return;
+
+    xfsettings_event_dispatch_remove (xfce_key_grabber_event_filter, grabber);
+    g_signal_handler_disconnect (G_OBJECT (grabber->keymap), grabber->keys_changed_id);
+
+    /* release all grabs in one batch */
+    ops = g_array_new (FALSE, FALSE, sizeof (XfceKeyGrabOp));
+    g_hash_table_iter_init (&iter, grabber->grabs);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &grab))
+        xfce_key_grabber_queue_all (grabber, ops, grab, TRUE);
+    xfce_key_grabber_flush (grabber, ops);
+    g_array_free (ops, TRUE);
+
+    g_hash_table_destroy (grabber->accels);
+    g_hash_table_destroy (grabber->active);
+    g_hash_table_destroy (grabber->grabs);
+
+    g_slice_free (XfceKeyGrabber, grabber);
+}
+
+
+
+void
+xfce_key_grabber_add (XfceKeyGrabber *grabber,
+                      const gchar    *shortcut)
+{
+    const gchar *shortcuts[] = { shortcut, NULL };
+
+    xfce_key_grabber_add_bulk (grabber, shortcuts);
+}
+
+
+
+void
+xfce_key_grabber_add_bulk (XfceKeyGrabber     *grabber,
+                           const gchar *const *shortcuts)
+{
+    GArray *ops;
+    guint   n;
+
+    g_return_if_fail (grabber != NULL);
+    g_return_if_fail (shortcuts != NULL);
+
+    ops = g_array_new (FALSE, FALSE, sizeof (XfceKeyGrabOp));
+
+    for (n = 0; shortcuts[n] != NULL; n++)
+        xfce_key_grabber_add_internal (grabber, shortcuts[n], ops);
+
+    xfce_key_grabber_flush (grabber, ops);
+    g_array_free (ops, TRUE);
+}
+
+
+
+void
+xfce_key_grabber_remove (XfceKeyGrabber *grabber,
+                         const gchar    *shortcut)
+{
+    XfceKeyGrab *grab;
+    GArray      *ops;
+
+    g_return_if_fail (grabber != NULL);
+    g_return_if_fail (shortcut != NULL);
+
+    grab = g_hash_table_lookup (grabber->grabs, shortcut);
+    if (grab == NULL)
+        return;
+
+    ops = g_array_new (FALSE, FALSE, sizeof (XfceKeyGrabOp));
+    xfce_key_grabber_queue_all (grabber, ops, grab, TRUE);
+    xfce_key_grabber_flush (grabber, ops);
+    g_array_free (ops, TRUE);
+
+    if (g_hash_table_lookup (grabber->accels, &grab->accel_key) == grab)
+        g_hash_table_remove (grabber->accels, &grab->accel_key);
+
+    g_hash_table_remove (grabber->grabs, shortcut);
+}
+
+
+
+guint
+xfce_key_grabber_get_n_grabs (XfceKeyGrabber *grabber)
+{
+    g_return_val_if_fail (grabber != NULL, 0);
+
+    return g_hash_table_size (grabber->active);
+}
+
+
+
+static void
+xfce_key_grabber_keys_changed (GdkKeymap      *keymap,
+                               XfceKeyGrabber *grabber)
+{
+    GHashTableIter   iter;
+    XfceKeyGrab     *grab;
+    GArray          *ops;
+    GArray          *keycodes;
+    guint            old_ignored_mask;
+    guint            old_combos[G_N_ELEMENTS (grabber->lock_combos)];
+    guint            new_combos[G_N_ELEMENTS (grabber->lock_combos)];
+    guint            old_n_combos, new_n_combos;
+    guint            modifiers;
+    guint            i, j, a, b;
+    gboolean         regrab_all;
+    GdkModifierType  virtual_modifiers;
+
+    ops = g_array_new (FALSE, FALSE, sizeof (XfceKeyGrabOp));
+
+    old_ignored_mask = grabber->ignored_mask;
+    old_n_combos = grabber->n_lock_combos;
+    memcpy (old_combos, grabber->lock_combos, sizeof (old_combos));
+
+    xfce_key_grabber_update_lock_masks (grabber);
+
+    regrab_all = old_ignored_mask != grabber->ignored_mask;
+    if (regrab_all)
+    {
+        xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "lock modifiers changed, regrabbing all keys");
+
+        /* the existing grabs have to be released with the old lock combinations */
+        new_n_combos = grabber->n_lock_combos;
+        memcpy (new_combos, grabber->lock_combos, sizeof (new_combos));
+        grabber->n_lock_combos = old_n_combos;
+        memcpy (grabber->lock_combos, old_combos, sizeof (old_combos));
+
+        g_hash_table_iter_init (&iter, grabber->grabs);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &grab))
+            xfce_key_grabber_queue_all (grabber, ops, grab, TRUE);
+
+        xfce_key_grabber_flush (grabber, ops);
+        g_array_set_size (ops, 0);
+
+        grabber->n_lock_combos = new_n_combos;
+        memcpy (grabber->lock_combos, new_combos, sizeof (new_combos));
+    }
+
+    g_hash_table_iter_init (&iter, grabber->grabs);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &grab))
+    {
+        gtk_accelerator_parse (grab->shortcut, NULL, &virtual_modifiers);
+        modifiers = xfce_key_grabber_real_modifiers (grabber, virtual_modifiers);
+        keycodes = xfce_key_grabber_resolve (grabber, grab->keyval);
+
+        if (regrab_all || modifiers != grab->modifiers)
+        {
+            /* the modifier mapping moved, grab everything again */
+            if (!regrab_all)
+                xfce_key_grabber_queue_all (grabber, ops, grab, TRUE);
+
+            g_array_free (grab->keycodes, TRUE);
+            grab->keycodes = keycodes;
+            grab->modifiers = modifiers;
+
+            xfce_key_grabber_queue_all (grabber, ops, grab, FALSE);
+            continue;
+        }
+
+        /* diff the sorted keycode lists, only touch what moved */
+        for (a = 0, b = 0; a < grab->keycodes->len || b < keycodes->len;)
+        {
+            i = a < grab->keycodes->len ? g_array_index (grab->keycodes, guint, a) : G_MAXUINT;
+            j = b < keycodes->len ? g_array_index (keycodes, guint, b) : G_MAXUINT;
+
+            if (i == j)
+            {
+                a++;
+                b++;
+            }
+            else if (i < j)
+            {
+                xfce_key_grabber_queue (grabber, ops, grab, i, grab->modifiers, TRUE);
+                a++;
+            }
+            else
+            {
+                xfce_key_grabber_queue (grabber, ops, grab, j, grab->modifiers, FALSE);
+                b++;
+            }
+        }
+
+        g_array_free (grab->keycodes, TRUE);
+        grab->keycodes = keycodes;
+    }
+
+    xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "keymap changed, %u key ops needed", ops->len);
+
+    xfce_key_grabber_flush (grabber, ops);
+    g_array_free (ops, TRUE);
+}
+
+
+
+static GdkFilterReturn
+xfce_key_grabber_event_filter (GdkXEvent *gdk_xevent,
+                               GdkEvent  *event,
+                               gpointer   user_data)
+{
+    XfceKeyGrabber  *grabber = user_data;
+    XEvent          *xevent = gdk_xevent;
+    XfceKeyGrab     *grab;
+    GdkModifierType  modifiers;
+    GdkModifierType  consumed;
+    guint            keyval;
+    guint64          accel_key;
+    gchar           *accel_name;
+
+    if (xevent->type != KeyPress)
+        return GDK_FILTER_CONTINUE;
+
+    /* match on the keyval of the pressed level and group, like the grabber
+     * in libxfce4kbd-private, the keycode alone does not know about them */
+    modifiers = xevent->xkey.state;
+    if (!gdk_keymap_translate_keyboard_state (grabber->keymap, xevent->xkey.keycode,
+                                              modifiers, XkbGroupForCoreState (xevent->xkey.state),
+                                              &keyval, NULL, NULL, &consumed))
+        return GDK_FILTER_CONTINUE;
+
+    /* Alt + Print is not SysReq, see bug #7897 */
+    if (keyval == GDK_KEY_Sys_Req && (modifiers & GDK_MOD1_MASK) != 0)
+    {
+        consumed = 0;
+        keyval = GDK_KEY_Print;
+    }
+
+    /* keep Shift when it selected the level, gtk_accelerator_{name,parse}
+     * expect it in the modifiers, see bug #8744 */
+    if ((modifiers & GDK_SHIFT_MASK) != 0 && (consumed & GDK_SHIFT_MASK) != 0)
+        consumed &= ~GDK_SHIFT_MASK;
+
+    modifiers &= ~consumed;
+    modifiers &= gtk_accelerator_get_default_mod_mask ();
+
+    /* normalize the same way the shortcuts were parsed */
+    accel_name = gtk_accelerator_name (keyval, modifiers);
+    gtk_accelerator_parse (accel_name, &keyval, &modifiers);
+    g_free (accel_name);
+
+    accel_key = ACCEL_KEY (keyval, modifiers);
+    grab = g_hash_table_lookup (grabber->accels, &accel_key);
+    if (grab != NULL)
+        grabber->func (grab->shortcut, xevent->xkey.time, grabber->user_data);
+
+    return GDK_FILTER_CONTINUE;
+}
@@ -0,0 +1,50 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __KEYBOARD_GRABBER_H__
+#define __KEYBOARD_GRABBER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _XfceKeyGrabber XfceKeyGrabber;
+
+typedef void (*XfceKeyGrabberFunc) (const gchar *shortcut,
+                                    guint32      timestamp,
+                                    gpointer     user_data);
+
+XfceKeyGrabber *xfce_key_grabber_new         (XfceKeyGrabberFunc  func,
+                                              gpointer            user_data);
+
+void            xfce_key_grabber_free        (XfceKeyGrabber     *grabber);
+
+void            xfce_key_grabber_add         (XfceKeyGrabber     *grabber,
+                                              const gchar        *shortcut);
+
+void            xfce_key_grabber_add_bulk    (XfceKeyGrabber     *grabber,
+                                              const gchar *const *shortcuts);
+
+void            xfce_key_grabber_remove      (XfceKeyGrabber     *grabber,
+                                              const gchar        *shortcut);
+
+guint           xfce_key_grabber_get_n_grabs (XfceKeyGrabber     *grabber);
+
+G_END_DECLS
+
+#endif /* !__KEYBOARD_GRABBER_H__ */
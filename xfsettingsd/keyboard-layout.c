@@ -41,8 +41,11 @@
 #include <libxklavier/xklavier.h>
 #endif /* HAVE_LIBXKLAVIER */
 
+#include "channel-cache.h"
 #include "debug.h"
+#include "event-dispatch.h"
 #include "keyboard-layout.h"
+#include "helper-module.h"
 
 static void xfce_keyboard_layout_helper_finalize                  (GObject                       *object);
 static void xfce_keyboard_layout_helper_process_xmodmap           (void);
@@ -90,7 +93,15 @@ struct _XfceKeyboardLayoutHelper
 #endif /* HAVE_LIBXKLAVIER */
 };
 
-G_DEFINE_TYPE (XfceKeyboardLayoutHelper, xfce_keyboard_layout_helper, G_TYPE_OBJECT);
+G_DEFINE_DYNAMIC_TYPE (XfceKeyboardLayoutHelper, xfce_keyboard_layout_helper, G_TYPE_OBJECT);
+
+GType
+xfce_helper_module_register (GTypeModule *type_module)
+{
+    xfce_keyboard_layout_helper_register_type (type_module);
+
+    return XFCE_TYPE_KEYBOARD_LAYOUT_HELPER;
+}
 
 static void
 xfce_keyboard_layout_helper_class_init (XfceKeyboardLayoutHelperClass *klass)
@@ -101,6 +112,11 @@ xfce_keyboard_layout_helper_class_init (XfceKeyboardLayoutHelperClass *klass)
     gobject_class->finalize = xfce_keyboard_layout_helper_finalize;
 }
 
+static void
+xfce_keyboard_layout_helper_class_finalize (XfceKeyboardLayoutHelperClass *klass)
+{
+}
+
 static void
 xfce_keyboard_layout_helper_init (XfceKeyboardLayoutHelper *helper)
 {
@@ -110,7 +126,7 @@ xfce_keyboard_layout_helper_init (XfceKeyboardLayoutHelper *helper)
     /* open the channel */
     helper->channel = xfconf_channel_get ("keyboard-layout");
 
-    helper->xkb_disable_settings = xfconf_channel_get_bool (helper->channel, "/Default/XkbDisable", TRUE);
+    helper->xkb_disable_settings = xfsettings_channel_cache_get_bool (helper->channel, "/Default/XkbDisable", TRUE);
 
 #ifdef HAVE_LIBXKLAVIER
     helper->engine = xkl_engine_get_instance (GDK_DISPLAY_XDISPLAY(gdk_display_get_default()));
@@ -124,7 +140,9 @@ xfce_keyboard_layout_helper_init (XfceKeyboardLayoutHelper *helper)
         xkl_config_rec_get_from_server(helper->config, helper->engine);
         helper->system_keyboard_model = g_strdup(helper->config->model);
 
-        gdk_window_add_filter(NULL, (GdkFilterFunc)handle_xevent, helper);
+        /* libxklavier filters the events itself */
+        xfsettings_event_dispatch_add ("keyboard-layout", XFSETTINGS_EVENT_ANY, None,
+                                       (GdkFilterFunc) handle_xevent, helper);
         g_signal_connect(helper->engine, "X-new-device",
                          G_CALLBACK(xfce_keyboard_layout_reset_xkl_config), helper);
         xkl_engine_start_listen(helper->engine, XKLL_TRACK_KEYBOARD_STATE);
@@ -151,7 +169,7 @@ xfce_keyboard_layout_helper_finalize (GObject *object)
     if (helper->engine != NULL)
     {
         xkl_engine_stop_listen (helper->engine, XKLL_TRACK_KEYBOARD_STATE);
-        gdk_window_remove_filter (NULL, (GdkFilterFunc) handle_xevent, helper);
+        xfsettings_event_dispatch_remove ((GdkFilterFunc) handle_xevent, helper);
         g_object_unref (helper->config);
         g_object_unref (helper->engine);
         g_free (helper->system_keyboard_model);
@@ -201,7 +219,7 @@ xfce_keyboard_layout_helper_set_model (XfceKeyboardLayoutHelper *helper)
 
     if (!helper->xkb_disable_settings)
     {
-        xkbmodel = xfconf_channel_get_string (helper->channel, "/Default/XkbModel", NULL);
+        xkbmodel = xfsettings_channel_cache_get_string (helper->channel, "/Default/XkbModel", NULL);
         if (!xkbmodel || !*xkbmodel)
         {
             /* If xkb model is not set by user, we want to try to use the system default */
@@ -238,8 +256,8 @@ xfce_keyboard_layout_helper_set (XfceKeyboardLayoutHelper *helper,
     if (!helper->xkb_disable_settings)
     {
         xfconf_values  = g_strjoinv (",", *xkl_config_option);
-        xkl_values  = xfconf_channel_get_string (helper->channel,
-                                                 xfconf_option_name, xfconf_values);
+        xkl_values  = xfsettings_channel_cache_get_string (helper->channel,
+                                                           xfconf_option_name, xfconf_values);
 
         if (g_strcmp0 (xfconf_values, xkl_values) != 0)
         {
@@ -332,8 +350,8 @@ xfce_keyboard_layout_helper_set_option (XfceKeyboardLayoutHelper *helper,
         xkl_option_value = xfce_keyboard_layout_get_option (helper->config->options,
                                                             xkb_option_name, &other_options);
 
-        option_value = xfconf_channel_get_string (helper->channel, xfconf_option_name,
-                                                  xkl_option_value);
+        option_value = xfsettings_channel_cache_get_string (helper->channel, xfconf_option_name,
+                                                            xkl_option_value);
         if (g_strcmp0 (option_value, xkl_option_value) != 0)
         {
             gchar *options_string;
@@ -446,7 +464,7 @@ xfce_keyboard_layout_reset_xkl_config (XklEngine *xklengine,
         xkl_config_rec_reset (helper->config);
         xkl_config_rec_get_from_server (helper->config, helper->engine);
 
-        xfconf_model = xfconf_channel_get_string (helper->channel, "/Default/XkbModel", NULL);
+        xfconf_model = xfsettings_channel_cache_get_string (helper->channel, "/Default/XkbModel", NULL);
         if (xfconf_model && *xfconf_model &&
             g_strcmp0 (xfconf_model, helper->config->model) != 0 &&
             g_strcmp0 (helper->system_keyboard_model, helper->config->model) != 0)
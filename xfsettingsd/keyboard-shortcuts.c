@@ -37,10 +37,13 @@
 #include <libxfce4util/libxfce4util.h>
 #include <xfconf/xfconf.h>
 #include <libxfce4kbd-private/xfce-shortcuts-provider.h>
-#include <libxfce4kbd-private/xfce-shortcuts-grabber.h>
 
 #include "debug.h"
+#include "keyboard-grabber.h"
 #include "keyboard-shortcuts.h"
+#include "launcher.h"
+#include "metrics.h"
+#include "trace.h"
 
 
 
@@ -59,10 +62,9 @@ static void            xfce_keyboard_shortcuts_helper_shortcut_added     (XfceSh
 static void            xfce_keyboard_shortcuts_helper_shortcut_removed   (XfceShortcutsProvider            *provider,
                                                                           const gchar                      *shortcut,
                                                                           XfceKeyboardShortcutsHelper      *helper);
-static void            xfce_keyboard_shortcuts_helper_shortcut_activated (XfceShortcutsGrabber             *grabber,
-                                                                          const gchar                      *shortcut,
-                                                                          gint                              timestamp,
-                                                                          XfceKeyboardShortcutsHelper      *helper);
+static void            xfce_keyboard_shortcuts_helper_shortcut_activated (const gchar                      *shortcut,
+                                                                          guint32                           timestamp,
+                                                                          gpointer                          user_data);
 static void            xfce_keyboard_shortcuts_helper_load_shortcuts     (XfceKeyboardShortcutsHelper      *helper);
 
 
@@ -79,7 +81,7 @@ struct _XfceKeyboardShortcutsHelper
   /* Xfconf channel used for managing the keyboard shortcuts */
   XfconfChannel         *channel;
 
-  XfceShortcutsGrabber  *grabber;
+  XfceKeyGrabber        *grabber;
   XfceShortcutsProvider *provider;
 };
 
@@ -103,11 +105,8 @@ xfce_keyboard_shortcuts_helper_class_init (XfceKeyboardShortcutsHelperClass *kla
 static void
 xfce_keyboard_shortcuts_helper_init (XfceKeyboardShortcutsHelper *helper)
 {
-  /* Create shortcuts grabber */
-  helper->grabber = xfce_shortcuts_grabber_new ();
-
-  /* Be notified when a shortcut is pressed */
-  g_signal_connect (helper->grabber, "shortcut-activated", G_CALLBACK (xfce_keyboard_shortcuts_helper_shortcut_activated), helper);
+  /* Create shortcuts grabber, be notified when a shortcut is pressed */
+  helper->grabber = xfce_key_grabber_new (xfce_keyboard_shortcuts_helper_shortcut_activated, helper);
 
   /* Create shortcuts provider */
   helper->provider = xfce_shortcuts_provider_new ("commands");
@@ -130,7 +129,7 @@ xfce_keyboard_shortcuts_helper_finalize (GObject *object)
   g_object_unref (helper->provider);
 
   /* Free shortcuts grabber */
-  g_object_unref (helper->grabber);
+  xfce_key_grabber_free (helper->grabber);
 
   (*G_OBJECT_CLASS (xfce_keyboard_shortcuts_helper_parent_class)->finalize) (object);
 }
@@ -143,7 +142,7 @@ xfce_keyboard_shortcuts_helper_shortcut_added (XfceShortcutsProvider       *prov
                                                XfceKeyboardShortcutsHelper *helper)
 {
   g_return_if_fail (XFCE_IS_KEYBOARD_SHORTCUTS_HELPER (helper));
-  xfce_shortcuts_grabber_add (helper->grabber, shortcut);
+  xfce_key_grabber_add (helper->grabber, shortcut);
 
   xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "add \"%s\"", shortcut);
 }
@@ -156,7 +155,7 @@ xfce_keyboard_shortcuts_helper_shortcut_removed (XfceShortcutsProvider       *pr
                                                  XfceKeyboardShortcutsHelper *helper)
 {
   g_return_if_fail (XFCE_IS_KEYBOARD_SHORTCUTS_HELPER (helper));
-  xfce_shortcuts_grabber_remove (helper->grabber, shortcut);
+  xfce_key_grabber_remove (helper->grabber, shortcut);
 
   xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "remove \"%s\"", shortcut);
 }
@@ -164,50 +163,58 @@ xfce_keyboard_shortcuts_helper_shortcut_removed (XfceShortcutsProvider       *pr
 
 
 static void
-_xfce_keyboard_shortcuts_helper_load_shortcut (XfceShortcut                *shortcut,
-                                               XfceKeyboardShortcutsHelper *helper)
+xfce_keyboard_shortcuts_helper_load_shortcuts (XfceKeyboardShortcutsHelper *helper)
 {
-  g_return_if_fail (shortcut != NULL);
-  g_return_if_fail (XFCE_IS_KEYBOARD_SHORTCUTS_HELPER (helper));
+  GList         *shortcuts, *li;
+  XfceShortcut  *shortcut;
+  const gchar  **strings;
+  guint          n;
 
-  xfce_shortcuts_grabber_add (helper->grabber, shortcut->shortcut);
+  g_return_if_fail (XFCE_IS_KEYBOARD_SHORTCUTS_HELPER (helper));
 
-  xfsettings_dbg_filtered (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "loaded \"%s\" => \"%s\"",
-                           shortcut->shortcut, shortcut->command);
-}
+  /* Collect all shortcuts and grab them in a single batch */
+  shortcuts = xfce_shortcuts_provider_get_shortcuts (helper->provider);
+  strings = g_new0 (const gchar *, g_list_length (shortcuts) + 1);
 
+  for (li = shortcuts, n = 0; li != NULL; li = li->next)
+    {
+      shortcut = li->data;
+      if (G_UNLIKELY (shortcut == NULL || shortcut->shortcut == NULL))
+        continue;
 
+      strings[n++] = shortcut->shortcut;
 
-static void
-xfce_keyboard_shortcuts_helper_load_shortcuts (XfceKeyboardShortcutsHelper *helper)
-{
-  GList *shortcuts;
+      xfsettings_dbg_filtered (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "loaded \"%s\" => \"%s\"",
+                               shortcut->shortcut, shortcut->command);
+    }
 
-  g_return_if_fail (XFCE_IS_KEYBOARD_SHORTCUTS_HELPER (helper));
+  xfce_key_grabber_add_bulk (helper->grabber, strings);
+  xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "%u shortcuts loaded, %u keys grabbed",
+                  n, xfce_key_grabber_get_n_grabs (helper->grabber));
 
-  /* Load shortcuts one by one */
-  shortcuts = xfce_shortcuts_provider_get_shortcuts (helper->provider);
-  g_list_foreach (shortcuts, (GFunc) _xfce_keyboard_shortcuts_helper_load_shortcut, helper);
-  xfsettings_dbg (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "%d shortcuts loaded", g_list_length (shortcuts));
+  g_free (strings);
   xfce_shortcuts_free (shortcuts);
 }
 
 
 
 static void
-xfce_keyboard_shortcuts_helper_shortcut_activated (XfceShortcutsGrabber        *grabber,
-                                                   const gchar                 *shortcut,
-                                                   gint                         timestamp,
-                                                   XfceKeyboardShortcutsHelper *helper)
+xfce_keyboard_shortcuts_helper_shortcut_activated (const gchar *shortcut,
+                                                   guint32      timestamp,
+                                                   gpointer     user_data)
 {
-  XfceShortcut  *sc;
-  GError        *error = NULL;
-  gchar        **argv;
-  gboolean       succeed;
+  XfceKeyboardShortcutsHelper  *helper = user_data;
+  XfceShortcut                 *sc;
+  GError                       *error = NULL;
+  gchar                       **argv;
+  gboolean                      succeed;
+  gint64                        start_time;
 
   g_return_if_fail (XFCE_IS_KEYBOARD_SHORTCUTS_HELPER (helper));
   g_return_if_fail (XFCE_IS_SHORTCUTS_PROVIDER (helper->provider));
 
+  start_time = g_get_monotonic_time ();
+
   /* Ignore empty shortcuts */
   if (shortcut == NULL || g_utf8_strlen (shortcut, -1) == 0)
     return;
@@ -230,13 +237,19 @@ xfce_keyboard_shortcuts_helper_shortcut_activated (XfceShortcutsGrabber        *
   succeed = g_shell_parse_argv (sc->command, NULL, &argv, &error);
   if (G_LIKELY (succeed))
     {
-      succeed = xfce_spawn_on_screen (xfce_gdk_screen_get_active (NULL),
-                                      NULL, argv, NULL, G_SPAWN_SEARCH_PATH,
-                                      sc->snotify, timestamp, NULL, &error);
+      succeed = xfsettings_launcher_spawn (xfce_gdk_screen_get_active (NULL),
+                                           NULL, argv, NULL, sc->snotify,
+                                           timestamp, &error);
 
       g_strfreev (argv);
     }
 
+  /* time from the key press until the command is started */
+  xfsettings_metrics_time (XFSD_DEBUG_KEYBOARD_SHORTCUTS, "activation",
+                           g_get_monotonic_time () - start_time);
+  xfsettings_trace (XFSD_TRACE_SHORTCUT_ACTIVATE, g_get_monotonic_time () - start_time,
+                    timestamp, 0);
+
   if (!succeed)
     {
       xfce_dialog_show_error (NULL, error, _("Failed to launch shortcut \"%s\""), shortcut);
@@ -40,8 +40,12 @@
 #include <xfconf/xfconf.h>
 #include <libxfce4util/libxfce4util.h>
 
+#include "channel-cache.h"
 #include "debug.h"
+#include "event-dispatch.h"
 #include "keyboards.h"
+#include "replay.h"
+#include "trace.h"
 
 
 
@@ -138,7 +142,8 @@ xfce_keyboards_helper_init (XfceKeyboardsHelper *helper)
 
             /* add an event filter */
             if (gdk_x11_display_error_trap_pop (gdk_display_get_default ()) == 0)
-                gdk_window_add_filter (NULL, xfce_keyboards_helper_event_filter, helper);
+                xfsettings_event_dispatch_add ("keyboards", helper->device_presence_event_type, None,
+                                               xfce_keyboards_helper_event_filter, helper);
             else
                 g_warning ("Failed to create device filter");
         }
@@ -161,6 +166,10 @@ xfce_keyboards_helper_finalize (GObject *object)
 {
     XfceKeyboardsHelper *helper = XFCE_KEYBOARDS_HELPER (object);
 
+#ifdef DEVICE_HOTPLUGGING
+    xfsettings_event_dispatch_remove (xfce_keyboards_helper_event_filter, helper);
+#endif
+
     /* Save the numlock state */
     xfce_keyboards_helper_save_numlock_state (helper->channel);
 
@@ -176,7 +185,7 @@ xfce_keyboards_helper_set_auto_repeat_mode (XfceKeyboardsHelper *helper)
     gboolean         repeat;
 
     /* load setting */
-    repeat = xfconf_channel_get_bool (helper->channel, "/Default/KeyRepeat", TRUE);
+    repeat = xfsettings_channel_cache_get_bool (helper->channel, "/Default/KeyRepeat", TRUE);
 
     /* set key repeat */
     values.auto_repeat_mode = repeat ? 1 : 0;
@@ -198,8 +207,8 @@ xfce_keyboards_helper_set_repeat_rate (XfceKeyboardsHelper *helper)
     gint       delay, rate;
 
     /* load settings */
-    delay = xfconf_channel_get_int (helper->channel, "/Default/KeyRepeat/Delay", 500);
-    rate = xfconf_channel_get_int (helper->channel, "/Default/KeyRepeat/Rate", 20);
+    delay = xfsettings_channel_cache_get_int (helper->channel, "/Default/KeyRepeat/Delay", 500);
+    rate = xfsettings_channel_cache_get_int (helper->channel, "/Default/KeyRepeat/Rate", 20);
 
     gdk_x11_display_error_trap_push (gdk_display_get_default ());
 
@@ -262,9 +271,9 @@ xfce_keyboards_helper_restore_numlock_state (XfconfChannel *channel)
     gboolean      state;
 
     if (xfconf_channel_has_property (channel, "/Default/Numlock")
-        && xfconf_channel_get_bool (channel, "/Default/RestoreNumlock", TRUE))
+        && xfsettings_channel_cache_get_bool (channel, "/Default/RestoreNumlock", TRUE))
     {
-        state = xfconf_channel_get_bool (channel, "/Default/Numlock", FALSE);
+        state = xfsettings_channel_cache_get_bool (channel, "/Default/Numlock", FALSE);
 
         gdk_x11_display_error_trap_push (gdk_display_get_default ());
 
@@ -303,7 +312,9 @@ xfce_keyboards_helper_save_numlock_state (XfconfChannel *channel)
 
     xfsettings_dbg (XFSD_DEBUG_KEYBOARDS, "save numlock %s", numlock_state ? "on" : "off");
 
+    xfsettings_replay_ignore_push ();
     xfconf_channel_set_bool (channel, "/Default/Numlock", numlock_state);
+    xfsettings_replay_ignore_pop ();
 }
 
 
@@ -370,6 +381,8 @@ xfce_keyboards_helper_event_filter (GdkXEvent *xevent,
     if (!xfce_keyboards_helper_device_is_keyboard(dpn_event->deviceid))
         return GDK_FILTER_CONTINUE;
 
+    xfsettings_trace (XFSD_TRACE_KEYBOARDS_DEVICE, dpn_event->deviceid, 0, 0);
+
     /* New keyboard added. Need to reapply settings. */
     xfce_keyboards_helper_set_all_settings (helper);
 
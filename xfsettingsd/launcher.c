@@ -0,0 +1,588 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The launcher is a small child process that is forked from xfsettingsd
+ * before GTK+ and the helpers are initialized. Shortcut activations and
+ * other spawns are sent to it over a socketpair, so the (much larger)
+ * daemon process is never forked once it is running.
+ *
+ * A request is a 32-bit length followed by the payload: the number of
+ * argv and envp entries (both 32-bit) and a list of nul-terminated
+ * strings; the working directory (empty for none), argv and envp. The
+ * launcher answers with a LauncherReply.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4ui/libxfce4ui.h>
+
+#include "debug.h"
+#include "launcher.h"
+
+/* upper limit for a single request, protects the launcher from garbage */
+#define LAUNCHER_MAX_REQUEST (1024 * 1024)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+
+
+extern char **environ;
+
+typedef struct _LauncherReply LauncherReply;
+struct _LauncherReply
+{
+    gint32 pid;
+    gint32 errnum;
+    gint64 spawn_time;
+};
+
+
+
+static gint  launcher_fd = -1;
+static pid_t launcher_pid = 0;
+
+
+
+static gboolean
+xfsettings_launcher_write_all (gint          fd,
+                               gconstpointer data,
+                               gsize         len)
+{
+    const gchar *p = data;
+    gssize       n;
+
+    while (len > 0)
+    {
+        /* use send() so a dead peer does not raise SIGPIPE */
+        n = send (fd, p, len, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+
+
+static gboolean
+xfsettings_launcher_read_all (gint     fd,
+                              gpointer data,
+                              gsize    len)
+{
+    gchar  *p = data;
+    gssize  n;
+
+    while (len > 0)
+    {
+        n = read (fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        else if (n == 0)
+        {
+            /* peer closed the socket */
+            return FALSE;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+
+
+static void
+xfsettings_launcher_set_cloexec (gint fd)
+{
+    gint flags;
+
+    flags = fcntl (fd, F_GETFD);
+    if (flags >= 0)
+        fcntl (fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+
+
+static pid_t
+xfsettings_launcher_child_spawn (const gchar  *working_directory,
+                                 gchar       **argv,
+                                 gchar       **envp,
+                                 gint         *errnum)
+{
+    gint    pipe_fds[2];
+    gint    child_errno = 0;
+    pid_t   pid;
+    gssize  n;
+
+    /* pipe to report a failing exec, closed on success */
+    if (pipe (pipe_fds) < 0)
+    {
+        *errnum = errno;
+        return -1;
+    }
+
+    xfsettings_launcher_set_cloexec (pipe_fds[0]);
+    xfsettings_launcher_set_cloexec (pipe_fds[1]);
+
+    pid = fork ();
+    if (pid < 0)
+    {
+        *errnum = errno;
+        close (pipe_fds[0]);
+        close (pipe_fds[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        /* restore the dispositions changed by the launcher, ignored
+         * signals survive the exec */
+        signal (SIGCHLD, SIG_DFL);
+        signal (SIGPIPE, SIG_DFL);
+
+#ifdef HAVE_SETSID
+        setsid ();
+#endif
+
+        if (*working_directory == '\0' || chdir (working_directory) == 0)
+        {
+            environ = envp;
+            execvp (argv[0], argv);
+        }
+
+        child_errno = errno;
+        n = write (pipe_fds[1], &child_errno, sizeof (child_errno));
+        _exit (n == sizeof (child_errno) ? 127 : 126);
+    }
+
+    close (pipe_fds[1]);
+
+    do
+        n = read (pipe_fds[0], &child_errno, sizeof (child_errno));
+    while (n < 0 && errno == EINTR);
+
+    close (pipe_fds[0]);
+
+    if (n == sizeof (child_errno))
+    {
+        /* exec failed, the child is reaped automatically */
+        *errnum = child_errno;
+        return -1;
+    }
+
+    *errnum = 0;
+
+    return pid;
+}
+
+
+
+static gboolean
+xfsettings_launcher_child_parse (gchar    *buffer,
+                                 guint32   len,
+                                 gchar   **working_directory,
+                                 gchar  ***argv,
+                                 gchar  ***envp)
+{
+    guint32  header[2];
+    gchar   *p, *end;
+    gchar   *nul;
+    guint32  i, n;
+    gchar  **strv;
+
+    if (len < sizeof (header))
+        return FALSE;
+
+    memcpy (header, buffer, sizeof (header));
+    if (header[0] == 0 || header[0] > len || header[1] > len)
+        return FALSE;
+
+    p = buffer + sizeof (header);
+    end = buffer + len;
+
+    /* working directory, argv and envp in a single pointer array */
+    n = 1 + header[0] + 1 + header[1] + 1;
+    strv = g_new0 (gchar *, n);
+
+    for (i = 0; i < n; i++)
+    {
+        /* the arrays are terminated with a NULL */
+        if (i == 1 + header[0] || i == n - 1)
+            continue;
+
+        nul = memchr (p, '\0', end - p);
+        if (nul == NULL)
+        {
+            g_free (strv);
+            return FALSE;
+        }
+
+        strv[i] = p;
+        p = nul + 1;
+    }
+
+    *working_directory = strv[0];
+    *argv = strv + 1;
+    *envp = strv + 1 + header[0] + 1;
+
+    return TRUE;
+}
+
+
+
+static void G_GNUC_NORETURN
+xfsettings_launcher_child_main (gint fd)
+{
+    guint32         len;
+    gchar          *buffer;
+    gchar          *working_directory;
+    gchar         **argv;
+    gchar         **envp;
+    LauncherReply   reply;
+    gint            errnum;
+    gint64          start_time;
+
+    /* spawned processes are reaped by the kernel, the launcher itself
+     * only talks to the daemon */
+    signal (SIGCHLD, SIG_IGN);
+    signal (SIGPIPE, SIG_IGN);
+
+    for (;;)
+    {
+        /* leave when the daemon closed its end of the socket */
+        if (!xfsettings_launcher_read_all (fd, &len, sizeof (len))
+            || len > LAUNCHER_MAX_REQUEST)
+            break;
+
+        buffer = g_malloc (len);
+        if (!xfsettings_launcher_read_all (fd, buffer, len))
+        {
+            g_free (buffer);
+            break;
+        }
+
+        memset (&reply, 0, sizeof (reply));
+
+        if (xfsettings_launcher_child_parse (buffer, len, &working_directory, &argv, &envp))
+        {
+            start_time = g_get_monotonic_time ();
+            reply.pid = xfsettings_launcher_child_spawn (working_directory, argv, envp, &errnum);
+            reply.errnum = errnum;
+            reply.spawn_time = g_get_monotonic_time () - start_time;
+
+            /* argv points right behind the working directory */
+            g_free (argv - 1);
+        }
+        else
+        {
+            reply.pid = -1;
+            reply.errnum = EINVAL;
+        }
+
+        g_free (buffer);
+
+        if (!xfsettings_launcher_write_all (fd, &reply, sizeof (reply)))
+            break;
+    }
+
+    _exit (EXIT_SUCCESS);
+}
+
+
+
+gboolean
+xfsettings_launcher_start (void)
+{
+    gint  fds[2];
+    pid_t pid;
+
+    g_return_val_if_fail (launcher_fd == -1, FALSE);
+
+    /* allow users to disable the launcher */
+    if (g_getenv ("XFSETTINGSD_NO_LAUNCHER") != NULL)
+        return FALSE;
+
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        g_warning ("Failed to create the launcher socket: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    xfsettings_launcher_set_cloexec (fds[0]);
+    xfsettings_launcher_set_cloexec (fds[1]);
+
+    pid = fork ();
+    if (pid < 0)
+    {
+        g_warning ("Failed to fork the launcher: %s", g_strerror (errno));
+        close (fds[0]);
+        close (fds[1]);
+        return FALSE;
+    }
+
+    if (pid == 0)
+    {
+        close (fds[0]);
+        xfsettings_launcher_child_main (fds[1]);
+    }
+
+    close (fds[1]);
+
+    launcher_fd = fds[0];
+    launcher_pid = pid;
+
+    xfsettings_dbg (XFSD_DEBUG_LAUNCHER, "started launcher (pid=%d)", (gint) pid);
+
+    return TRUE;
+}
+
+
+
+void
+xfsettings_launcher_stop (void)
+{
+    if (launcher_fd == -1)
+        return;
+
+    /* the launcher leaves when its socket is closed */
+    close (launcher_fd);
+    launcher_fd = -1;
+
+    while (waitpid (launcher_pid, NULL, 0) < 0 && errno == EINTR);
+    launcher_pid = 0;
+}
+
+
+
+static gboolean
+xfsettings_launcher_request (const gchar    *working_directory,
+                             gchar         **argv,
+                             gchar         **envp,
+                             LauncherReply  *reply)
+{
+    GByteArray *request;
+    guint32     header[2];
+    guint32     len;
+    guint       i;
+    gboolean    succeed;
+
+    header[0] = g_strv_length (argv);
+    header[1] = g_strv_length (envp);
+
+    request = g_byte_array_sized_new (1024);
+    g_byte_array_append (request, (const guint8 *) &header, sizeof (header));
+
+    if (working_directory == NULL)
+        working_directory = "";
+    g_byte_array_append (request, (const guint8 *) working_directory, strlen (working_directory) + 1);
+    for (i = 0; argv[i] != NULL; i++)
+        g_byte_array_append (request, (const guint8 *) argv[i], strlen (argv[i]) + 1);
+    for (i = 0; envp[i] != NULL; i++)
+        g_byte_array_append (request, (const guint8 *) envp[i], strlen (envp[i]) + 1);
+
+    len = request->len;
+    succeed = len <= LAUNCHER_MAX_REQUEST
+              && xfsettings_launcher_write_all (launcher_fd, &len, sizeof (len))
+              && xfsettings_launcher_write_all (launcher_fd, request->data, len)
+              && xfsettings_launcher_read_all (launcher_fd, reply, sizeof (*reply));
+
+    g_byte_array_free (request, TRUE);
+
+    if (!succeed && len <= LAUNCHER_MAX_REQUEST)
+    {
+        /* the launcher is gone, spawn from the daemon from now on */
+        g_warning ("Lost connection to the launcher, spawning directly");
+        xfsettings_launcher_stop ();
+    }
+
+    return succeed;
+}
+
+
+
+gboolean
+xfsettings_launcher_spawn (GdkScreen    *screen,
+                           const gchar  *working_directory,
+                           gchar       **argv,
+                           gchar       **envp,
+                           gboolean      startup_notify,
+                           guint32       startup_timestamp,
+                           GError      **error)
+{
+    GdkAppLaunchContext *context = NULL;
+    GAppInfo            *info;
+    gchar               *startup_id = NULL;
+    gchar              **env;
+    LauncherReply        reply;
+    gint64               start_time;
+
+    g_return_val_if_fail (screen == NULL || GDK_IS_SCREEN (screen), FALSE);
+    g_return_val_if_fail (argv != NULL && argv[0] != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    if (screen == NULL)
+        screen = xfce_gdk_screen_get_active (NULL);
+
+    /* no launcher running, spawn from the daemon */
+    if (launcher_fd == -1)
+    {
+        return xfce_spawn_on_screen (screen, working_directory, argv, envp,
+                                     G_SPAWN_SEARCH_PATH, startup_notify,
+                                     startup_timestamp, NULL, error);
+    }
+
+    start_time = g_get_monotonic_time ();
+
+    env = envp != NULL ? g_strdupv (envp) : g_get_environ ();
+    env = g_environ_setenv (env, "DISPLAY", gdk_display_get_name (gdk_screen_get_display (screen)), TRUE);
+
+    if (startup_notify)
+    {
+        /* let gdk broadcast the startup sequence and remove it on timeout */
+        context = gdk_display_get_app_launch_context (gdk_screen_get_display (screen));
+        gdk_app_launch_context_set_screen (context, screen);
+        gdk_app_launch_context_set_timestamp (context, startup_timestamp);
+
+        info = g_app_info_create_from_commandline (argv[0], NULL, G_APP_INFO_CREATE_NONE, NULL);
+        if (info != NULL)
+        {
+            startup_id = g_app_launch_context_get_startup_notify_id (G_APP_LAUNCH_CONTEXT (context), info, NULL);
+            g_object_unref (G_OBJECT (info));
+        }
+
+        if (startup_id != NULL)
+            env = g_environ_setenv (env, "DESKTOP_STARTUP_ID", startup_id, TRUE);
+    }
+    else
+    {
+        env = g_environ_unsetenv (env, "DESKTOP_STARTUP_ID");
+    }
+
+    if (!xfsettings_launcher_request (working_directory, argv, env, &reply))
+    {
+        if (startup_id != NULL)
+            g_app_launch_context_launch_failed (G_APP_LAUNCH_CONTEXT (context), startup_id);
+
+        g_strfreev (env);
+        g_free (startup_id);
+        if (context != NULL)
+            g_object_unref (G_OBJECT (context));
+
+        return xfce_spawn_on_screen (screen, working_directory, argv, envp,
+                                     G_SPAWN_SEARCH_PATH, startup_notify,
+                                     startup_timestamp, NULL, error);
+    }
+
+    if (reply.pid < 0)
+    {
+        if (startup_id != NULL)
+            g_app_launch_context_launch_failed (G_APP_LAUNCH_CONTEXT (context), startup_id);
+
+        g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                     _("Failed to execute child process \"%s\" (%s)"),
+                     argv[0], g_strerror (reply.errnum));
+    }
+    else
+    {
+        xfsettings_dbg (XFSD_DEBUG_LAUNCHER,
+                        "spawned \"%s\" (pid=%d) in %.3f ms, launcher %.3f ms",
+                        argv[0], (gint) reply.pid,
+                        (g_get_monotonic_time () - start_time) / 1000.0,
+                        reply.spawn_time / 1000.0);
+    }
+
+    g_strfreev (env);
+    g_free (startup_id);
+    if (context != NULL)
+        g_object_unref (G_OBJECT (context));
+
+    return reply.pid >= 0;
+}
+
+
+
+gboolean
+xfsettings_launcher_spawn_command_line (GdkScreen    *screen,
+                                        const gchar  *command_line,
+                                        gboolean      startup_notify,
+                                        GError      **error)
+{
+    gchar    **argv;
+    gboolean   succeed;
+
+    g_return_val_if_fail (command_line != NULL, FALSE);
+
+    if (!g_shell_parse_argv (command_line, NULL, &argv, error))
+        return FALSE;
+
+    succeed = xfsettings_launcher_spawn (screen, NULL, argv, NULL, startup_notify,
+                                         gtk_get_current_event_time (), error);
+
+    g_strfreev (argv);
+
+    return succeed;
+}
@@ -0,0 +1,41 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LAUNCHER_H__
+#define __LAUNCHER_H__
+
+#include <gdk/gdk.h>
+
+gboolean xfsettings_launcher_start              (void);
+
+void     xfsettings_launcher_stop               (void);
+
+gboolean xfsettings_launcher_spawn              (GdkScreen    *screen,
+                                                 const gchar  *working_directory,
+                                                 gchar       **argv,
+                                                 gchar       **envp,
+                                                 gboolean      startup_notify,
+                                                 guint32       startup_timestamp,
+                                                 GError      **error);
+
+gboolean xfsettings_launcher_spawn_command_line (GdkScreen    *screen,
+                                                 const gchar  *command_line,
+                                                 gboolean      startup_notify,
+                                                 GError      **error);
+
+#endif /* !__LAUNCHER_H__ */
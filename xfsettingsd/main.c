@@ -51,12 +51,19 @@
 
 #include <locale.h>
 
+#include "channel-cache.h"
+#include "dbus-service.h"
 #include "debug.h"
-#include "accessibility.h"
+#include "event-dispatch.h"
 #include "pointers.h"
+#include "replay.h"
 #include "keyboards.h"
-#include "keyboard-layout.h"
 #include "keyboard-shortcuts.h"
+#include "helper-module.h"
+#include "launcher.h"
+#include "startup.h"
+#include "trace.h"
+#include "watchdog.h"
 #include "workspaces.h"
 #include "clipboard-manager.h"
 #include "gtk-decorations.h"
@@ -77,16 +84,39 @@ static gboolean opt_version = FALSE;
 static gboolean opt_daemon = FALSE;
 static gboolean opt_disable_wm_check = FALSE;
 static gboolean opt_replace = FALSE;
+static gchar   *opt_record = NULL;
+static gchar   *opt_replay = NULL;
+#ifdef HAVE_XRANDR
+static gboolean opt_dry_run = FALSE;
+#endif
 static guint owner_id;
+static guint service_id;
+
+typedef struct
+{
+    const gchar                *name;
+    const gchar                *channel_name;
+    XfceHelperModuleNeededFunc  needed_func;
+    XfceHelperModuleFlags       flags;
+}
+ModuleInfo;
+
+static gboolean accessibility_needed   (XfconfChannel *channel);
+static gboolean keyboard_layout_needed (XfconfChannel *channel);
+
+/* helpers loaded on demand from modules */
+static const ModuleInfo module_infos[] =
+{
+    { "accessibility", "accessibility", accessibility_needed, XFCE_HELPER_MODULE_FLAGS_APPLY_ONCE },
+    { "keyboard-layout", "keyboard-layout", keyboard_layout_needed, XFCE_HELPER_MODULE_FLAGS_NONE },
+};
 
 struct t_data_set
 {
     XfceSMClient         *sm_client;
     GObject              *pointer_helper;
     GObject              *keyboards_helper;
-    GObject              *accessibility_helper;
     GObject              *shortcuts_helper;
-    GObject              *keyboard_layout_helper;
     GObject              *gtk_decorations_helper;
     GObject              *xsettings_helper;
     GObject              *clipboard_daemon;
@@ -94,6 +124,43 @@ struct t_data_set
     GObject              *displays_helper;
 #endif
     GObject              *workspaces_helper;
+
+    XfceHelperModule     *modules[G_N_ELEMENTS (module_infos)];
+
+    /* staged initialization of the helpers */
+    guint                 init_idle_id;
+    guint                 n_helpers;
+    guint                 n_modules;
+};
+
+typedef struct
+{
+    const gchar *name;
+    GType      (*get_type) (void);
+    glong        offset;
+
+    /* channel prefetched before the helper is created */
+    const gchar *channel_name;
+}
+HelperInfo;
+
+/* helpers created after the xsettings owner, in this order */
+static const HelperInfo helper_infos[] =
+{
+#ifdef HAVE_XRANDR
+    { "displays", xfce_displays_helper_get_type,
+      G_STRUCT_OFFSET (struct t_data_set, displays_helper), "displays" },
+#endif
+    { "pointers", xfce_pointers_helper_get_type,
+      G_STRUCT_OFFSET (struct t_data_set, pointer_helper), "pointers" },
+    { "keyboards", xfce_keyboards_helper_get_type,
+      G_STRUCT_OFFSET (struct t_data_set, keyboards_helper), "keyboards" },
+    { "keyboard-shortcuts", xfce_keyboard_shortcuts_helper_get_type,
+      G_STRUCT_OFFSET (struct t_data_set, shortcuts_helper), "xfce4-keyboard-shortcuts" },
+    { "workspaces", xfce_workspaces_helper_get_type,
+      G_STRUCT_OFFSET (struct t_data_set, workspaces_helper), "xfwm4" },
+    { "gtk-decorations", xfce_decorations_helper_get_type,
+      G_STRUCT_OFFSET (struct t_data_set, gtk_decorations_helper), NULL },
 };
 
 
@@ -103,6 +170,11 @@ static GOptionEntry option_entries[] =
     { "daemon", 0, 0, G_OPTION_ARG_NONE, &opt_daemon, N_("Fork to the background"), NULL },
     { "disable-wm-check", 'D', 0, G_OPTION_ARG_NONE, &opt_disable_wm_check, N_("Do not wait for a window manager on startup"), NULL },
     { "replace", 0, 0, G_OPTION_ARG_NONE, &opt_replace, N_("Replace running xsettings daemon (if any)"), NULL },
+    { "record", 0, 0, G_OPTION_ARG_FILENAME, &opt_record, N_("Record the X events and settings changes to a file"), N_("FILE") },
+    { "replay", 0, 0, G_OPTION_ARG_FILENAME, &opt_replay, N_("Replay a recording, report the time it took and quit"), N_("FILE") },
+#ifdef HAVE_XRANDR
+    { "dry-run", 0, 0, G_OPTION_ARG_NONE, &opt_dry_run, N_("Print the display layout that would be applied and quit"), NULL },
+#endif
     { NULL }
 };
 
@@ -116,39 +188,44 @@ on_name_lost (GDBusConnection *connection,
     gtk_main_quit ();
 }
 
-static void
-on_name_acquired (GDBusConnection *connection,
-                  const gchar     *name,
-                  gpointer         user_data)
+static gboolean
+accessibility_needed (XfconfChannel *channel)
 {
-    GBusNameOwnerFlags         dbus_flags;
-    struct t_data_set         *s_data;
-    GError                    *error = NULL;
+    /* only needed when one of the features is enabled, the disabled
+     * ones are applied by the startup load of the module */
+    return xfsettings_channel_cache_get_bool (channel, "/AccessXKeys", FALSE)
+           || xfsettings_channel_cache_get_bool (channel, "/StickyKeys", FALSE)
+           || xfsettings_channel_cache_get_bool (channel, "/SlowKeys", FALSE)
+           || xfsettings_channel_cache_get_bool (channel, "/BounceKeys", FALSE)
+           || xfsettings_channel_cache_get_bool (channel, "/MouseKeys", FALSE);
+}
 
-    s_data = (struct t_data_set*) user_data;
+static gboolean
+keyboard_layout_needed (XfconfChannel *channel)
+{
+    gchar    *xmodmap_path;
+    gboolean  needed;
 
-    /* launch settings manager */
-    s_data->xsettings_helper = g_object_new (XFCE_TYPE_XSETTINGS_HELPER, NULL);
-    xfce_xsettings_helper_register (XFCE_XSETTINGS_HELPER (s_data->xsettings_helper),
-                                    gdk_display_get_default (), opt_replace);
+    if (!xfsettings_channel_cache_get_bool (channel, "/Default/XkbDisable", TRUE))
+        return TRUE;
 
-    /* create the sub daemons */
-#ifdef HAVE_XRANDR
-    s_data->displays_helper = g_object_new (XFCE_TYPE_DISPLAYS_HELPER, NULL);
-#endif
-    s_data->pointer_helper = g_object_new (XFCE_TYPE_POINTERS_HELPER, NULL);
-    s_data->keyboards_helper = g_object_new (XFCE_TYPE_KEYBOARDS_HELPER, NULL);
-    s_data->accessibility_helper = g_object_new (XFCE_TYPE_ACCESSIBILITY_HELPER, NULL);
-    s_data->shortcuts_helper = g_object_new (XFCE_TYPE_KEYBOARD_SHORTCUTS_HELPER, NULL);
-    s_data->keyboard_layout_helper = g_object_new (XFCE_TYPE_KEYBOARD_LAYOUT_HELPER, NULL);
-#ifdef GDK_WINDOWING_X11
-    xfce_workspaces_helper_disable_wm_check (opt_disable_wm_check);
-#endif
-    s_data->workspaces_helper = g_object_new (XFCE_TYPE_WORKSPACES_HELPER, NULL);
-    s_data->gtk_decorations_helper = g_object_new (XFCE_TYPE_DECORATIONS_HELPER, NULL);
+    /* the helper also loads the user's xmodmap file */
+    xmodmap_path = g_build_filename (xfce_get_homedir (), ".Xmodmap", NULL);
+    needed = g_file_test (xmodmap_path, G_FILE_TEST_EXISTS);
+    g_free (xmodmap_path);
+
+    return needed;
+}
+
+static void
+connect_session_manager (struct t_data_set *s_data)
+{
+    GError *error = NULL;
+    gint64  start_time;
 
-    /* connect to session always, even if we quit below.  this way the
-     * session manager won't wait for us to time out. */
+    /* the session starts the next priority groups once we are
+     * registered, so this waits until the settings are applied */
+    start_time = g_get_monotonic_time ();
     s_data->sm_client = xfce_sm_client_get ();
     xfce_sm_client_set_restart_style (s_data->sm_client, XFCE_SM_CLIENT_RESTART_IMMEDIATELY);
     xfce_sm_client_set_desktop_file (s_data->sm_client, XFSETTINGS_DESKTOP_FILE);
@@ -159,9 +236,54 @@ on_name_acquired (GDBusConnection *connection,
         g_printerr ("Failed to connect to session manager: %s\n", error->message);
         g_clear_error (&error);
     }
+    xfsettings_startup_mark ("session manager", start_time);
+}
+
+static gboolean
+init_helpers_idle (gpointer user_data)
+{
+    struct t_data_set         *s_data = user_data;
+    const HelperInfo          *info;
+    const ModuleInfo          *module_info;
+    gint64                     start_time;
+    GError                    *error = NULL;
+
+    /* create one helper per iteration, so events and the prefetch
+     * replies are handled in between */
+    if (s_data->n_helpers < G_N_ELEMENTS (helper_infos))
+    {
+        info = &helper_infos[s_data->n_helpers++];
+
+        start_time = g_get_monotonic_time ();
+        xfsettings_watchdog_set_label (info->name);
+        G_STRUCT_MEMBER (GObject *, s_data, info->offset) = g_object_new (info->get_type (), NULL);
+        xfsettings_watchdog_set_label (NULL);
+        xfsettings_startup_mark (info->name, start_time);
+
+        return TRUE;
+    }
+
+    /* the modules load their helper if it is needed, or once to apply it */
+    if (s_data->n_modules < G_N_ELEMENTS (module_infos))
+    {
+        module_info = &module_infos[s_data->n_modules];
+        xfsettings_watchdog_set_label (module_info->name);
+        s_data->modules[s_data->n_modules++] = xfce_helper_module_new (module_info->name,
+                                                                       module_info->channel_name,
+                                                                       module_info->needed_func,
+                                                                       module_info->flags);
+        xfsettings_watchdog_set_label (NULL);
+
+        return TRUE;
+    }
+
+    /* every helper and module applied its settings */
+    connect_session_manager (s_data);
 
     if (g_getenv ("XFSETTINGSD_NO_CLIPBOARD") == NULL)
     {
+        start_time = g_get_monotonic_time ();
+
         s_data->clipboard_daemon = g_object_new (GSD_TYPE_CLIPBOARD_MANAGER, NULL);
         if (!gsd_clipboard_manager_start (GSD_CLIPBOARD_MANAGER (s_data->clipboard_daemon), opt_replace))
         {
@@ -170,8 +292,61 @@ on_name_acquired (GDBusConnection *connection,
 
             g_printerr (G_LOG_DOMAIN ": %s\n", "Another clipboard manager is already running.");
         }
+
+        xfsettings_startup_mark ("clipboard", start_time);
+    }
+
+    s_data->init_idle_id = 0;
+
+    xfsettings_startup_finish ();
+
+    /* benchmark the helpers */
+    if (opt_replay != NULL && !xfsettings_replay_run (opt_replay, &error))
+    {
+        g_printerr (G_LOG_DOMAIN ": %s\n", error->message);
+        g_error_free (error);
+        gtk_main_quit ();
     }
 
+    return FALSE;
+}
+
+static void
+on_name_acquired (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+    GBusNameOwnerFlags         dbus_flags;
+    struct t_data_set         *s_data;
+    gint64                     start_time;
+    guint                      i;
+
+    s_data = (struct t_data_set*) user_data;
+
+    /* launch settings manager, the session waits for the owner so this
+     * goes first and is flushed right away */
+    start_time = g_get_monotonic_time ();
+    s_data->xsettings_helper = g_object_new (XFCE_TYPE_XSETTINGS_HELPER, NULL);
+    xfce_xsettings_helper_register (XFCE_XSETTINGS_HELPER (s_data->xsettings_helper),
+                                    gdk_display_get_default (), opt_replace);
+    gdk_display_flush (gdk_display_get_default ());
+    xfsettings_startup_mark ("xsettings", start_time);
+
+    /* fetch the channels of the other helpers in the background, the
+     * replies fill the channel caches the helpers are created with */
+    for (i = 0; i < G_N_ELEMENTS (helper_infos); i++)
+        if (helper_infos[i].channel_name != NULL)
+            xfsettings_startup_prefetch (connection, helper_infos[i].channel_name);
+    for (i = 0; i < G_N_ELEMENTS (module_infos); i++)
+        xfsettings_startup_prefetch (connection, module_infos[i].channel_name);
+
+#ifdef GDK_WINDOWING_X11
+    xfce_workspaces_helper_disable_wm_check (opt_disable_wm_check);
+#endif
+
+    /* create the sub daemons */
+    s_data->init_idle_id = g_idle_add_full (G_PRIORITY_DEFAULT, init_helpers_idle, s_data, NULL);
+
     /* Update the name flags to allow replacement */
     dbus_flags = G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT;
     g_bus_own_name_on_connection (connection, XFSETTINGS_DBUS_NAME, dbus_flags, NULL, NULL, NULL, NULL );
@@ -185,6 +360,65 @@ signal_handler (gint signum,
     gtk_main_quit ();
 }
 
+static void
+watchdog_signal_handler (gint     signum,
+                         gpointer user_data)
+{
+    xfsettings_watchdog_dump ();
+}
+
+static void
+trace_signal_handler (gint     signum,
+                      gpointer user_data)
+{
+    xfsettings_trace_write ();
+}
+
+#ifdef HAVE_XRANDR
+static gint
+dry_run_displays (void)
+{
+    GObject  *helper;
+    GVariant *plan;
+    GError   *error = NULL;
+    gchar    *report;
+    gint64    start_time;
+    gint      ret = EXIT_FAILURE;
+
+    if (!xfconf_init (&error))
+    {
+        g_printerr (G_LOG_DOMAIN ": %s\n", error->message);
+        g_error_free (error);
+        return EXIT_FAILURE;
+    }
+
+    /* a planning only helper, next to the running daemon */
+    start_time = g_get_monotonic_time ();
+    xfce_displays_helper_set_dry_run (TRUE);
+    helper = g_object_new (XFCE_TYPE_DISPLAYS_HELPER, NULL);
+
+    plan = xfce_displays_helper_dry_run (XFCE_DISPLAYS_HELPER (helper), NULL, &error);
+    if (plan != NULL)
+    {
+        report = xfce_displays_helper_format_plan (plan);
+        g_print ("%sTotal: %" G_GINT64_FORMAT " us\n", report, g_get_monotonic_time () - start_time);
+        g_free (report);
+        g_variant_unref (g_variant_ref_sink (plan));
+        ret = EXIT_SUCCESS;
+    }
+    else
+    {
+        g_printerr (G_LOG_DOMAIN ": %s\n", error->message);
+        g_error_free (error);
+    }
+
+    g_object_unref (helper);
+    xfconf_shutdown ();
+
+    return ret;
+}
+#endif
+
 static gint
 daemonize (void)
 {
@@ -223,6 +457,10 @@ main (gint argc, gchar **argv)
     GBusNameOwnerFlags    dbus_flags;
     gboolean              name_owned;
     GVariant             *name_owned_variant;
+    gint64                start_time;
+    gboolean              watchdog_enabled;
+
+    xfsettings_startup_begin ();
 
     xfce_textdomain (GETTEXT_PACKAGE, LOCALEDIR, "UTF-8");
 
@@ -262,6 +500,31 @@ main (gint argc, gchar **argv)
         return EXIT_SUCCESS;
     }
 
+    /* refuse before any helper applies the settings */
+    if (opt_replay != NULL && !xfsettings_replay_check_bus (&error))
+    {
+        g_printerr (G_LOG_DOMAIN ": %s\n", error->message);
+        g_error_free (error);
+        return EXIT_FAILURE;
+    }
+
+#ifdef HAVE_XRANDR
+    /* plan the display layout without taking over, before the launcher
+     * is forked or the process daemonized */
+    if (opt_dry_run)
+    {
+        if (!gtk_init_check (&argc, &argv))
+        {
+            g_printerr ("%s: %s\n", G_LOG_DOMAIN, "Unable to open display.");
+            return EXIT_FAILURE;
+        }
+
+        setlocale (LC_NUMERIC, "C");
+
+        return dry_run_displays ();
+    }
+#endif
+
     /* daemonize the process */
     if (opt_daemon)
     {
@@ -272,6 +535,11 @@ main (gint argc, gchar **argv)
         }
     }
 
+    /* fork the launcher while the process is still small, spawns
+     * from the helpers are handed to it later */
+    xfsettings_launcher_start ();
+
+    start_time = g_get_monotonic_time ();
     if (!gtk_init_check (&argc, &argv))
     {
         if (G_LIKELY (error))
@@ -289,6 +557,8 @@ main (gint argc, gchar **argv)
         return EXIT_FAILURE;
     }
 
+    xfsettings_startup_mark ("gtk init", start_time);
+
     setlocale(LC_NUMERIC,"C");
 
     /* Initialize our data set */
@@ -326,6 +596,15 @@ main (gint argc, gchar **argv)
             return EXIT_SUCCESS;
         }
 
+        /* export the daemon's own interface before taking the name */
+        service_id = xfsettings_dbus_service_register (dbus_connection, &error);
+        if (G_UNLIKELY (service_id == 0))
+        {
+            g_warning ("Failed to export the %s interface: %s",
+                       XFSETTINGS_DBUS_INTERFACE, error->message);
+            g_clear_error (&error);
+        }
+
         /* Allow the settings daemon to be replaced */
         dbus_flags = G_BUS_NAME_OWNER_FLAGS_NONE;
         if (opt_replace || name_owned)
@@ -341,6 +620,7 @@ main (gint argc, gchar **argv)
         return EXIT_FAILURE;
     }
 
+    start_time = g_get_monotonic_time ();
     if (!xfconf_init (&error))
     {
         g_error ("Failed to connect to xfconf daemon: %s.", error->message);
@@ -348,16 +628,43 @@ main (gint argc, gchar **argv)
 
         return EXIT_FAILURE;
     }
+    xfsettings_startup_mark ("xfconf init", start_time);
+
+    if (opt_record != NULL && !xfsettings_replay_record (opt_record, &error))
+    {
+        g_printerr (G_LOG_DOMAIN ": %s\n", error->message);
+        g_clear_error (&error);
+    }
+
+    /* optional main loop stall detection */
+    watchdog_enabled = xfsettings_watchdog_start ();
 
     /* setup signal handlers to properly quit the main loop */
     if (xfce_posix_signal_handler_init (NULL))
     {
         for (i = 0; i < G_N_ELEMENTS (signums); i++)
             xfce_posix_signal_handler_set_handler (signums[i], signal_handler, NULL, NULL);
+
+        /* write the watchdog report on request */
+        if (watchdog_enabled)
+            xfce_posix_signal_handler_set_handler (SIGUSR1, watchdog_signal_handler, NULL, NULL);
+
+        /* write the trace rings on request */
+        xfce_posix_signal_handler_set_handler (SIGUSR2, trace_signal_handler, NULL, NULL);
     }
 
     gtk_main();
 
+    xfsettings_watchdog_stop ();
+    xfsettings_replay_record_stop ();
+
+    xfsettings_channel_cache_report ();
+    xfsettings_event_dispatch_report ();
+
+    /* stop creating helpers if we quit early */
+    if (s_data.init_idle_id != 0)
+        g_source_remove (s_data.init_idle_id);
+
     /* release the sub daemons */
     UNREF_GOBJECT(s_data.xsettings_helper);
 
@@ -366,12 +673,13 @@ main (gint argc, gchar **argv)
 #endif
     UNREF_GOBJECT (s_data.pointer_helper);
     UNREF_GOBJECT (s_data.keyboards_helper);
-    UNREF_GOBJECT (s_data.accessibility_helper);
     UNREF_GOBJECT (s_data.shortcuts_helper);
-    UNREF_GOBJECT (s_data.keyboard_layout_helper);
     UNREF_GOBJECT (s_data.workspaces_helper);
     UNREF_GOBJECT (s_data.gtk_decorations_helper);
 
+    for (i = 0; i < s_data.n_modules; i++)
+        xfce_helper_module_stop (s_data.modules[i]);
+
     if (G_LIKELY (s_data.clipboard_daemon != NULL))
     {
         gsd_clipboard_manager_stop (GSD_CLIPBOARD_MANAGER (s_data.clipboard_daemon));
@@ -382,10 +690,13 @@ main (gint argc, gchar **argv)
 
     UNREF_GOBJECT (s_data.sm_client);
 
+    xfsettings_launcher_stop ();
+
     /* release the dbus name */
     if (dbus_connection != NULL)
     {
         g_bus_unown_name (owner_id);
+        xfsettings_dbus_service_unregister (dbus_connection, service_id);
         g_dbus_connection_close_sync (dbus_connection, NULL, NULL);
     }
 
@@ -0,0 +1,273 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <xfconf/xfconf.h>
+
+#include "channel-cache.h"
+#include "debug.h"
+#include "event-dispatch.h"
+#include "metrics.h"
+
+/* one table per debug domain bit */
+#define METRICS_N_DOMAINS 32
+
+
+
+typedef enum
+{
+    METRIC_COUNTER,
+    METRIC_HISTOGRAM
+}
+MetricType;
+
+typedef struct _Metric Metric;
+struct _Metric
+{
+    MetricType  type;
+
+    /* counter value or number of samples */
+    guint64     count;
+
+    /* histogram, in us */
+    gint64      sum;
+    gint64      min;
+    gint64      max;
+    guint64    *buckets;
+};
+
+
+
+/* upper bounds of the histogram buckets in us, the last bucket is
+ * for everything above */
+static const gint64  metrics_buckets[] =
+{
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000,
+    50000, 100000, 250000, 500000, 1000000
+};
+
+/* static name -> Metric */
+static GHashTable   *metrics_domains[METRICS_N_DOMAINS];
+
+
+
+static void
+xfsettings_metrics_free (gpointer data)
+{
+    Metric *metric = data;
+
+    g_free (metric->buckets);
+    g_slice_free (Metric, metric);
+}
+
+
+
+static Metric *
+xfsettings_metrics_lookup (XfsdDebugDomain  domain,
+                           const gchar     *name,
+                           MetricType       type)
+{
+    gint    bit;
+    Metric *metric;
+
+    bit = g_bit_nth_lsf (domain, -1);
+    g_return_val_if_fail (bit >= 0 && bit < METRICS_N_DOMAINS, NULL);
+
+    if (G_UNLIKELY (metrics_domains[bit] == NULL))
+        metrics_domains[bit] = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                      xfsettings_metrics_free);
+
+    metric = g_hash_table_lookup (metrics_domains[bit], name);
+    if (G_UNLIKELY (metric == NULL))
+    {
+        metric = g_slice_new0 (Metric);
+        metric->type = type;
+        if (type == METRIC_HISTOGRAM)
+        {
+            metric->min = G_MAXINT64;
+            metric->buckets = g_new0 (guint64, G_N_ELEMENTS (metrics_buckets) + 1);
+        }
+
+        g_hash_table_insert (metrics_domains[bit], (gpointer) name, metric);
+    }
+
+    g_return_val_if_fail (metric->type == type, NULL);
+
+    return metric;
+}
+
+
+
+void
+xfsettings_metrics_count (XfsdDebugDomain  domain,
+                          const gchar     *name,
+                          guint64          value)
+{
+    Metric *metric;
+
+    metric = xfsettings_metrics_lookup (domain, name, METRIC_COUNTER);
+    if (G_LIKELY (metric != NULL))
+        metric->count += value;
+}
+
+
+
+void
+xfsettings_metrics_time (XfsdDebugDomain  domain,
+                         const gchar     *name,
+                         gint64           duration)
+{
+    Metric *metric;
+    guint   i;
+
+    metric = xfsettings_metrics_lookup (domain, name, METRIC_HISTOGRAM);
+    if (G_UNLIKELY (metric == NULL))
+        return;
+
+    metric->count++;
+    metric->sum += duration;
+    metric->min = MIN (metric->min, duration);
+    metric->max = MAX (metric->max, duration);
+
+    for (i = 0; i < G_N_ELEMENTS (metrics_buckets); i++)
+        if (duration < metrics_buckets[i])
+            break;
+    metric->buckets[i]++;
+}
+
+
+
+static GVariant *
+xfsettings_metrics_histogram_variant (const Metric *metric)
+{
+    GVariantBuilder dict;
+    GVariantBuilder buckets;
+    guint           i;
+
+    g_variant_builder_init (&buckets, G_VARIANT_TYPE ("a(xt)"));
+    for (i = 0; i <= G_N_ELEMENTS (metrics_buckets); i++)
+    {
+        /* -1 is the open bucket */
+        g_variant_builder_add (&buckets, "(xt)",
+                               i < G_N_ELEMENTS (metrics_buckets) ? metrics_buckets[i] : (gint64) -1,
+                               metric->buckets[i]);
+    }
+
+    g_variant_builder_init (&dict, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&dict, "{sv}", "count", g_variant_new_uint64 (metric->count));
+    g_variant_builder_add (&dict, "{sv}", "sum-us", g_variant_new_int64 (metric->sum));
+    g_variant_builder_add (&dict, "{sv}", "min-us", g_variant_new_int64 (metric->count > 0 ? metric->min : 0));
+    g_variant_builder_add (&dict, "{sv}", "max-us", g_variant_new_int64 (metric->max));
+    g_variant_builder_add (&dict, "{sv}", "buckets", g_variant_builder_end (&buckets));
+
+    return g_variant_builder_end (&dict);
+}
+
+
+
+static void
+xfsettings_metrics_add_event_stats (const gchar *name,
+                                    guint64      n_calls,
+                                    gint64       total_time,
+                                    gint64       max_time,
+                                    gpointer     user_data)
+{
+    GVariantBuilder  dict;
+    gchar           *key;
+
+    g_variant_builder_init (&dict, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&dict, "{sv}", "count", g_variant_new_uint64 (n_calls));
+    g_variant_builder_add (&dict, "{sv}", "sum-us", g_variant_new_int64 (total_time));
+    g_variant_builder_add (&dict, "{sv}", "max-us", g_variant_new_int64 (max_time));
+
+    key = g_strconcat (xfsettings_dbg_domain_name (XFSD_DEBUG_EVENTS), ".", name, NULL);
+    g_variant_builder_add (user_data, "{sv}", key, g_variant_builder_end (&dict));
+    g_free (key);
+}
+
+
+
+static void
+xfsettings_metrics_add_channel_stats (const gchar *channel_name,
+                                      guint        n_properties,
+                                      guint        hits,
+                                      guint        misses,
+                                      gpointer     user_data)
+{
+    GVariantBuilder  dict;
+    gchar           *key;
+
+    g_variant_builder_init (&dict, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&dict, "{sv}", "properties", g_variant_new_uint32 (n_properties));
+    g_variant_builder_add (&dict, "{sv}", "hits", g_variant_new_uint32 (hits));
+    g_variant_builder_add (&dict, "{sv}", "misses", g_variant_new_uint32 (misses));
+
+    key = g_strconcat (xfsettings_dbg_domain_name (XFSD_DEBUG_CHANNEL_CACHE), ".", channel_name, NULL);
+    g_variant_builder_add (user_data, "{sv}", key, g_variant_builder_end (&dict));
+    g_free (key);
+}
+
+
+
+GVariant *
+xfsettings_metrics_get (void)
+{
+    GVariantBuilder  builder;
+    GHashTableIter   iter;
+    const gchar     *name;
+    const gchar     *domain_name;
+    Metric          *metric;
+    gchar           *key;
+    gint             bit;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+    for (bit = 0; bit < METRICS_N_DOMAINS; bit++)
+    {
+        if (metrics_domains[bit] == NULL)
+            continue;
+
+        domain_name = xfsettings_dbg_domain_name (1 << bit);
+        if (domain_name == NULL)
+            domain_name = "general";
+
+        g_hash_table_iter_init (&iter, metrics_domains[bit]);
+        while (g_hash_table_iter_next (&iter, (gpointer) &name, (gpointer) &metric))
+        {
+            key = g_strconcat (domain_name, ".", name, NULL);
+
+            if (metric->type == METRIC_COUNTER)
+                g_variant_builder_add (&builder, "{sv}", key, g_variant_new_uint64 (metric->count));
+            else
+                g_variant_builder_add (&builder, "{sv}", key,
+                                       xfsettings_metrics_histogram_variant (metric));
+
+            g_free (key);
+        }
+    }
+
+    /* statistics the other modules keep themselves */
+    xfsettings_event_dispatch_foreach_stats (xfsettings_metrics_add_event_stats, &builder);
+    xfsettings_channel_cache_foreach_stats (xfsettings_metrics_add_channel_stats, &builder);
+
+    return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,40 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <glib.h>
+
+#include "debug.h"
+
+/* the metrics are only updated from the main thread, names must be
+ * static strings */
+
+void      xfsettings_metrics_count    (XfsdDebugDomain   domain,
+                                       const gchar      *name,
+                                       guint64           value);
+
+void      xfsettings_metrics_time     (XfsdDebugDomain   domain,
+                                       const gchar      *name,
+                                       gint64            duration);
+
+/* a{sv} with all metrics, for the GetMetrics method */
+GVariant *xfsettings_metrics_get      (void);
+
+#endif /* !__METRICS_H__ */
@@ -41,9 +41,13 @@
 #include <libxfce4util/libxfce4util.h>
 #include <locale.h>
 
+#include "channel-cache.h"
 #include "debug.h"
+#include "event-dispatch.h"
+#include "metrics.h"
 #include "pointers.h"
 #include "pointers-defines.h"
+#include "trace.h"
 
 #define MAX_DENOMINATOR (100.00)
 
@@ -181,7 +185,8 @@ xfce_pointers_helper_init (XfcePointersHelper *helper)
 
             /* add an event filter */
             if (gdk_x11_display_error_trap_pop (gdk_display_get_default ()) == 0)
-                gdk_window_add_filter (NULL, xfce_pointers_helper_event_filter, helper);
+                xfsettings_event_dispatch_add ("pointers", helper->device_presence_event_type, None,
+                                               xfce_pointers_helper_event_filter, helper);
             else
                 g_warning ("Failed to create device filter");
         }
@@ -194,6 +199,10 @@ xfce_pointers_helper_init (XfcePointersHelper *helper)
 static void
 xfce_pointers_helper_finalize (GObject *object)
 {
+#ifdef DEVICE_HOTPLUGGING
+    xfsettings_event_dispatch_remove (xfce_pointers_helper_event_filter, object);
+#endif
+
     xfce_pointers_helper_syndaemon_stop (XFCE_POINTERS_HELPER (object));
 
     (*G_OBJECT_CLASS (xfce_pointers_helper_parent_class)->finalize) (object);
@@ -294,7 +303,7 @@ xfce_pointers_helper_syndaemon_check (XfcePointersHelper *helper)
     GError      *error = NULL;
 
     /* only stop a running daemon */
-    if (!xfconf_channel_get_bool (helper->channel, "/DisableTouchpadWhileTyping", FALSE))
+    if (!xfsettings_channel_cache_get_bool (helper->channel, "/DisableTouchpadWhileTyping", FALSE))
         goto start_stop_daemon;
 
     gdk_x11_display_error_trap_push (gdk_display_get_default ());
@@ -346,9 +355,9 @@ xfce_pointers_helper_syndaemon_check (XfcePointersHelper *helper)
 
     if (have_synaptics)
     {
-        disable_duration = xfconf_channel_get_double (helper->channel,
-                                                      "/DisableTouchpadDuration",
-                                                      2.0);
+        disable_duration = xfsettings_channel_cache_get_double (helper->channel,
+                                                                "/DisableTouchpadDuration",
+                                                                2.0);
         setlocale(LC_NUMERIC, "C"); /* syndaemon needs a dot for the float. Nothing localized! */
         g_snprintf (disable_duration_string, sizeof (disable_duration_string),
                     "%.1f", disable_duration);
@@ -939,6 +948,9 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
     GHashTable      *props;
     XfcePointerData  pointer_data;
 #endif
+    gint64           start_time;
+
+    start_time = g_get_monotonic_time ();
 
     gdk_x11_display_error_trap_push (gdk_display_get_default ());
     device_list = XListInputDevices (xdisplay, &ndevices);
@@ -976,10 +988,10 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
 
         /* read buttonmap properties */
         g_snprintf (prop, sizeof (prop), "/%s/RightHanded", device_name);
-        right_handed = xfconf_channel_get_bool (helper->channel, prop, -1);
+        right_handed = xfsettings_channel_cache_get_bool (helper->channel, prop, -1);
 
         g_snprintf (prop, sizeof (prop), "/%s/ReverseScrolling", device_name);
-        reverse_scrolling = xfconf_channel_get_bool (helper->channel, prop, -1);
+        reverse_scrolling = xfsettings_channel_cache_get_bool (helper->channel, prop, -1);
 
         if (right_handed != -1 || reverse_scrolling != -1)
         {
@@ -989,10 +1001,10 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
 
         /* read feedback settings */
         g_snprintf (prop, sizeof (prop), "/%s/Threshold", device_name);
-        threshold = xfconf_channel_get_int (helper->channel, prop, -1);
+        threshold = xfsettings_channel_cache_get_int (helper->channel, prop, -1);
 
         g_snprintf (prop, sizeof (prop), "/%s/Acceleration", device_name);
-        acceleration = xfconf_channel_get_double (helper->channel, prop, -1.00);
+        acceleration = xfsettings_channel_cache_get_double (helper->channel, prop, -1.00);
 
         if (threshold != -1 || acceleration != -1.00)
         {
@@ -1002,7 +1014,7 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
 
         /* read mode settings */
         g_snprintf (prop, sizeof (prop), "/%s/Mode", device_name);
-        mode =  xfconf_channel_get_string  (helper->channel, prop, NULL);
+        mode =  xfsettings_channel_cache_get_string (helper->channel, prop, NULL);
 
         if (mode != NULL)
         {
@@ -1014,7 +1026,7 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
 #ifdef DEVICE_PROPERTIES
         /* set device properties */
         g_snprintf (prop, sizeof (prop), "/%s/Properties", device_name);
-        props = xfconf_channel_get_properties (helper->channel, prop);
+        props = xfsettings_channel_cache_get_properties (helper->channel, prop);
 
         if (props != NULL)
         {
@@ -1034,6 +1046,10 @@ xfce_pointers_helper_restore_devices (XfcePointersHelper *helper,
     }
 
     XFreeDeviceList (device_list);
+
+    xfsettings_metrics_time (XFSD_DEBUG_POINTERS, "restore", g_get_monotonic_time () - start_time);
+    xfsettings_trace (XFSD_TRACE_POINTERS_RESTORE, g_get_monotonic_time () - start_time,
+                      xid != NULL ? *xid : 0, 0);
 }
 
 
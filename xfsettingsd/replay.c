@@ -0,0 +1,639 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <X11/Xlib.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <xfconf/xfconf.h>
+
+#include "debug.h"
+#include "event-dispatch.h"
+#include "replay.h"
+
+#define REPLAY_HEADER    "# xfsettingsd recording 1"
+#define REPLAY_TYPE      "(xsssv)"
+
+/* time the helpers get to handle the last record */
+#define REPLAY_SETTLE_MS 500
+
+/* set by whoever started the private session bus for the replay */
+#define REPLAY_PRIVATE_BUS_ENV "XFSETTINGSD_REPLAY_PRIVATE_BUS"
+
+
+
+/* recording */
+static GString         *record_buffer = NULL;
+static gchar           *record_filename = NULL;
+static gint64           record_start = 0;
+static gulong           record_hook_id = 0;
+static guint            record_ignore = 0;
+
+/* replay */
+static GPtrArray       *replay_records = NULL;
+static gchar           *replay_name = NULL;
+static guint            replay_pos = 0;
+static gint64           replay_start = 0;
+static gint64           replay_end = 0;
+static gint64           replay_poll_time = 0;
+static GPollFunc        replay_default_poll = NULL;
+static gulong           replay_start_request = 0;
+static guint            replay_n_xfconf = 0;
+static guint            replay_n_x_events = 0;
+static guint            replay_n_skipped = 0;
+static gint             replay_dbus_calls = 0;
+static guint            replay_dbus_filter_id = 0;
+static GDBusConnection *replay_bus = NULL;
+
+
+
+static void
+xfsettings_replay_record_add (const gchar *kind,
+                              const gchar *channel_name,
+                              const gchar *property,
+                              GVariant    *value)
+{
+    GVariant *record;
+    gchar    *text;
+
+    record = g_variant_new (REPLAY_TYPE, g_get_monotonic_time () - record_start,
+                            kind, channel_name, property, value);
+    g_variant_ref_sink (record);
+
+    text = g_variant_print (record, FALSE);
+    g_string_append (record_buffer, text);
+    g_string_append_c (record_buffer, '\n');
+
+    g_free (text);
+    g_variant_unref (record);
+}
+
+
+
+static GVariant *
+xfsettings_replay_value_to_variant (const GValue *value)
+{
+    GVariantBuilder  builder;
+    GPtrArray       *array;
+    GVariant        *child;
+    const gchar     *str;
+    guint            i;
+
+    switch (G_VALUE_TYPE (value))
+    {
+        case G_TYPE_BOOLEAN:
+            return g_variant_new_boolean (g_value_get_boolean (value));
+
+        case G_TYPE_INT:
+            return g_variant_new_int32 (g_value_get_int (value));
+
+        case G_TYPE_UINT:
+            return g_variant_new_uint32 (g_value_get_uint (value));
+
+        case G_TYPE_INT64:
+            return g_variant_new_int64 (g_value_get_int64 (value));
+
+        case G_TYPE_UINT64:
+            return g_variant_new_uint64 (g_value_get_uint64 (value));
+
+        case G_TYPE_DOUBLE:
+            return g_variant_new_double (g_value_get_double (value));
+
+        case G_TYPE_STRING:
+            str = g_value_get_string (value);
+            return g_variant_new_string (str != NULL ? str : "");
+
+        default:
+            break;
+    }
+
+    /* xfconf arrays are a GPtrArray of GValues */
+    if (G_VALUE_TYPE (value) == G_TYPE_PTR_ARRAY)
+    {
+        array = g_value_get_boxed (value);
+        if (array == NULL)
+            return NULL;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+        for (i = 0; i < array->len; i++)
+        {
+            child = xfsettings_replay_value_to_variant (g_ptr_array_index (array, i));
+            if (child == NULL)
+            {
+                g_variant_builder_clear (&builder);
+                return NULL;
+            }
+
+            g_variant_builder_add (&builder, "v", child);
+        }
+
+        return g_variant_builder_end (&builder);
+    }
+
+    return NULL;
+}
+
+
+
+static gboolean
+xfsettings_replay_variant_to_value (GVariant *variant,
+                                    GValue   *value)
+{
+    if (g_variant_is_of_type (variant, G_VARIANT_TYPE_BOOLEAN))
+    {
+        g_value_init (value, G_TYPE_BOOLEAN);
+        g_value_set_boolean (value, g_variant_get_boolean (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_INT32))
+    {
+        g_value_init (value, G_TYPE_INT);
+        g_value_set_int (value, g_variant_get_int32 (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT32))
+    {
+        g_value_init (value, G_TYPE_UINT);
+        g_value_set_uint (value, g_variant_get_uint32 (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_INT64))
+    {
+        g_value_init (value, G_TYPE_INT64);
+        g_value_set_int64 (value, g_variant_get_int64 (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT64))
+    {
+        g_value_init (value, G_TYPE_UINT64);
+        g_value_set_uint64 (value, g_variant_get_uint64 (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_DOUBLE))
+    {
+        g_value_init (value, G_TYPE_DOUBLE);
+        g_value_set_double (value, g_variant_get_double (variant));
+    }
+    else if (g_variant_is_of_type (variant, G_VARIANT_TYPE_STRING))
+    {
+        g_value_init (value, G_TYPE_STRING);
+        g_value_set_string (value, g_variant_get_string (variant, NULL));
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+
+static gboolean
+xfsettings_replay_changed_hook (GSignalInvocationHint *ihint,
+                                guint                  n_param_values,
+                                const GValue          *param_values,
+                                gpointer               user_data)
+{
+    gchar        *channel_name;
+    const gchar  *property;
+    const GValue *value;
+    GVariant     *variant;
+
+    g_return_val_if_fail (n_param_values == 3, TRUE);
+
+    /* the daemon writes it again when the recording is replayed */
+    if (record_ignore > 0)
+        return TRUE;
+
+    g_object_get (g_value_get_object (&param_values[0]), "channel-name", &channel_name, NULL);
+    property = g_value_get_string (&param_values[1]);
+    value = g_value_get_boxed (&param_values[2]);
+
+    if (value == NULL || G_VALUE_TYPE (value) == G_TYPE_INVALID)
+    {
+        xfsettings_replay_record_add ("reset", channel_name, property,
+                                      g_variant_new_boolean (FALSE));
+    }
+    else
+    {
+        variant = xfsettings_replay_value_to_variant (value);
+        if (variant != NULL)
+            xfsettings_replay_record_add ("set", channel_name, property, variant);
+        else
+            g_message ("Not recording %s%s, values of type %s are not supported",
+                       channel_name, property, G_VALUE_TYPE_NAME (value));
+    }
+
+    g_free (channel_name);
+
+    return TRUE;
+}
+
+
+
+static void
+xfsettings_replay_x_event_monitor (const XEvent *xevent,
+                                   gpointer      user_data)
+{
+    gchar *encoded;
+
+    encoded = g_base64_encode ((const guchar *) xevent, sizeof (XEvent));
+    xfsettings_replay_record_add ("x", "", "", g_variant_new_string (encoded));
+    g_free (encoded);
+}
+
+
+
+gboolean
+xfsettings_replay_record (const gchar  *filename,
+                          GError      **error)
+{
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (record_buffer == NULL, FALSE);
+
+    /* fail early, not when the session ends */
+    if (!g_file_set_contents (filename, REPLAY_HEADER "\n", -1, error))
+        return FALSE;
+
+    record_filename = g_strdup (filename);
+    record_buffer = g_string_new (REPLAY_HEADER "\n");
+    record_start = g_get_monotonic_time ();
+
+    /* the signal only exists once the class is loaded */
+    g_type_class_unref (g_type_class_ref (XFCONF_TYPE_CHANNEL));
+    record_hook_id = g_signal_add_emission_hook (g_signal_lookup ("property-changed", XFCONF_TYPE_CHANNEL),
+                                                 0, xfsettings_replay_changed_hook, NULL, NULL);
+    xfsettings_event_dispatch_set_monitor (xfsettings_replay_x_event_monitor, NULL);
+
+    xfsettings_dbg (XFSD_DEBUG_REPLAY, "recording to %s", filename);
+
+    return TRUE;
+}
+
+
+
+void
+xfsettings_replay_record_stop (void)
+{
+    GError *error = NULL;
+
+    if (record_buffer == NULL)
+        return;
+
+    xfsettings_event_dispatch_set_monitor (NULL, NULL);
+    g_signal_remove_emission_hook (g_signal_lookup ("property-changed", XFCONF_TYPE_CHANNEL),
+                                   record_hook_id);
+
+    if (!g_file_set_contents (record_filename, record_buffer->str, record_buffer->len, &error))
+    {
+        g_warning ("Failed to write the recording: %s", error->message);
+        g_error_free (error);
+    }
+    else
+    {
+        xfsettings_dbg (XFSD_DEBUG_REPLAY, "recorded %.1f s to %s",
+                        (g_get_monotonic_time () - record_start) / 1000000.0,
+                        record_filename);
+    }
+
+    g_string_free (record_buffer, TRUE);
+    record_buffer = NULL;
+    g_free (record_filename);
+    record_filename = NULL;
+}
+
+
+
+void
+xfsettings_replay_ignore_push (void)
+{
+    record_ignore++;
+}
+
+
+
+void
+xfsettings_replay_ignore_pop (void)
+{
+    g_return_if_fail (record_ignore > 0);
+
+    record_ignore--;
+}
+
+
+
+gboolean
+xfsettings_replay_check_bus (GError **error)
+{
+    /* the replay writes the recorded settings to xfconfd, only do that
+     * on a bus that was started for it */
+    if (g_strcmp0 (g_getenv (REPLAY_PRIVATE_BUS_ENV), "1") != 0)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+                     "Refusing to replay on the session bus, it overwrites the settings in xfconfd. "
+                     "Run it on a private bus, e.g. dbus-run-session, with %s=1",
+                     REPLAY_PRIVATE_BUS_ENV);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+
+static gint
+xfsettings_replay_poll (GPollFD *ufds,
+                        guint    nfds,
+                        gint     timeout)
+{
+    gint64 start_time;
+    gint   result;
+
+    /* everything outside the poll is main loop work */
+    start_time = g_get_monotonic_time ();
+    result = (*replay_default_poll) (ufds, nfds, timeout);
+    replay_poll_time += g_get_monotonic_time () - start_time;
+
+    return result;
+}
+
+
+
+static GDBusMessage *
+xfsettings_replay_dbus_filter (GDBusConnection *connection,
+                               GDBusMessage    *message,
+                               gboolean         incoming,
+                               gpointer         user_data)
+{
+    /* runs in the gdbus worker thread */
+    if (!incoming && g_dbus_message_get_message_type (message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL)
+        g_atomic_int_inc (&replay_dbus_calls);
+
+    return message;
+}
+
+
+
+static void
+xfsettings_replay_one (GVariant *record)
+{
+    const gchar   *kind;
+    const gchar   *channel_name;
+    const gchar   *property;
+    GVariant      *variant;
+    XfconfChannel *channel;
+    const gchar   *encoded;
+    guchar        *data;
+    gsize          len;
+    XEvent         xevent;
+    GValue         value = G_VALUE_INIT;
+    GPtrArray     *array;
+    GVariantIter   iter;
+    GVariant      *child;
+    GVariant      *inner;
+    GValue        *element;
+
+    g_variant_get (record, "(x&s&s&sv)", NULL, &kind, &channel_name, &property, &variant);
+
+    if (strcmp (kind, "x") == 0)
+    {
+        encoded = g_variant_get_string (variant, NULL);
+        data = g_base64_decode (encoded, &len);
+        if (len == sizeof (XEvent))
+        {
+            memcpy (&xevent, data, sizeof (XEvent));
+
+            /* windows of the recorded session can be gone */
+            gdk_x11_display_error_trap_push (gdk_display_get_default ());
+            xfsettings_event_dispatch_inject (&xevent);
+            gdk_x11_display_error_trap_pop_ignored (gdk_display_get_default ());
+
+            replay_n_x_events++;
+        }
+        else
+        {
+            replay_n_skipped++;
+        }
+        g_free (data);
+    }
+    else if (strcmp (kind, "set") == 0)
+    {
+        channel = xfconf_channel_get (channel_name);
+
+        if (g_variant_is_of_type (variant, G_VARIANT_TYPE ("av")))
+        {
+            array = g_ptr_array_new ();
+            g_variant_iter_init (&iter, variant);
+            while ((child = g_variant_iter_next_value (&iter)) != NULL)
+            {
+                inner = g_variant_get_variant (child);
+                element = g_new0 (GValue, 1);
+                if (xfsettings_replay_variant_to_value (inner, element))
+                    g_ptr_array_add (array, element);
+                else
+                    g_free (element);
+                g_variant_unref (inner);
+                g_variant_unref (child);
+            }
+
+            xfconf_channel_set_arrayv (channel, property, array);
+            xfconf_array_free (array);
+            replay_n_xfconf++;
+        }
+        else if (xfsettings_replay_variant_to_value (variant, &value))
+        {
+            xfconf_channel_set_property (channel, property, &value);
+            g_value_unset (&value);
+            replay_n_xfconf++;
+        }
+        else
+        {
+            replay_n_skipped++;
+        }
+    }
+    else if (strcmp (kind, "reset") == 0)
+    {
+        xfconf_channel_reset_property (xfconf_channel_get (channel_name), property, FALSE);
+        replay_n_xfconf++;
+    }
+    else
+    {
+        replay_n_skipped++;
+    }
+
+    g_variant_unref (variant);
+}
+
+
+
+static gint64
+xfsettings_replay_record_time (guint pos)
+{
+    gint64 time;
+
+    g_variant_get_child (g_ptr_array_index (replay_records, pos), 0, "x", &time);
+
+    return time;
+}
+
+
+
+static gboolean
+xfsettings_replay_finish (gpointer user_data)
+{
+    gint64 wall_time;
+    gint64 busy_time;
+
+    g_main_context_set_poll_func (NULL, replay_default_poll);
+
+    /* the wall time ends with the last record, the busy time also
+     * covers the work it caused during the settle period */
+    wall_time = replay_end - replay_start;
+    busy_time = g_get_monotonic_time () - replay_start - replay_poll_time;
+
+    g_print ("%s: %u xfconf changes, %u X events, %u skipped\n"
+             "%s: wall %.3f ms, main loop busy %.3f ms, %lu X requests, %d D-Bus calls\n",
+             replay_name, replay_n_xfconf, replay_n_x_events, replay_n_skipped,
+             replay_name, wall_time / 1000.0, busy_time / 1000.0,
+             NextRequest (gdk_x11_get_default_xdisplay ()) - replay_start_request,
+             g_atomic_int_get (&replay_dbus_calls));
+
+    g_dbus_connection_remove_filter (replay_bus, replay_dbus_filter_id);
+    g_object_unref (replay_bus);
+    replay_bus = NULL;
+
+    g_ptr_array_free (replay_records, TRUE);
+    replay_records = NULL;
+
+    gtk_main_quit ();
+
+    return FALSE;
+}
+
+
+
+static gboolean
+xfsettings_replay_step (gpointer user_data)
+{
+    gint64 offset;
+    gint64 delay;
+
+    offset = g_get_monotonic_time () - replay_start;
+
+    /* everything that is due, relative to the first record */
+    while (replay_pos < replay_records->len)
+    {
+        delay = xfsettings_replay_record_time (replay_pos)
+                - xfsettings_replay_record_time (0) - offset;
+        if (delay > 0)
+        {
+            g_timeout_add_full (G_PRIORITY_DEFAULT, MAX (delay / 1000, 1),
+                                xfsettings_replay_step, NULL, NULL);
+            return FALSE;
+        }
+
+        xfsettings_replay_one (g_ptr_array_index (replay_records, replay_pos++));
+    }
+
+    replay_end = g_get_monotonic_time ();
+    xfsettings_dbg (XFSD_DEBUG_REPLAY, "replayed %u records, settling", replay_records->len);
+
+    g_timeout_add_full (G_PRIORITY_LOW, REPLAY_SETTLE_MS, xfsettings_replay_finish, NULL, NULL);
+
+    return FALSE;
+}
+
+
+
+gboolean
+xfsettings_replay_run (const gchar  *filename,
+                       GError      **error)
+{
+    gchar     *contents;
+    gchar    **lines;
+    GVariant  *record;
+    guint      i;
+
+    g_return_val_if_fail (filename != NULL, FALSE);
+    g_return_val_if_fail (replay_records == NULL, FALSE);
+
+    if (!xfsettings_replay_check_bus (error))
+        return FALSE;
+
+    if (!g_file_get_contents (filename, &contents, NULL, error))
+        return FALSE;
+
+    replay_records = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+    lines = g_strsplit (contents, "\n", -1);
+    g_free (contents);
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        if (*lines[i] == '\0' || *lines[i] == '#')
+            continue;
+
+        record = g_variant_parse (G_VARIANT_TYPE (REPLAY_TYPE), lines[i], NULL, NULL, error);
+        if (record == NULL)
+        {
+            g_prefix_error (error, "%s:%u: ", filename, i + 1);
+            g_strfreev (lines);
+            g_ptr_array_free (replay_records, TRUE);
+            replay_records = NULL;
+            return FALSE;
+        }
+
+        g_ptr_array_add (replay_records, g_variant_ref_sink (record));
+    }
+
+    g_strfreev (lines);
+
+    g_free (replay_name);
+    replay_name = g_path_get_basename (filename);
+
+    replay_bus = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, error);
+    if (replay_bus == NULL)
+    {
+        g_ptr_array_free (replay_records, TRUE);
+        replay_records = NULL;
+        return FALSE;
+    }
+
+    replay_dbus_filter_id = g_dbus_connection_add_filter (replay_bus, xfsettings_replay_dbus_filter,
+                                                          NULL, NULL);
+
+    replay_default_poll = g_main_context_get_poll_func (NULL);
+    g_main_context_set_poll_func (NULL, xfsettings_replay_poll);
+
+    replay_pos = 0;
+    replay_start = g_get_monotonic_time ();
+    replay_start_request = NextRequest (gdk_x11_get_default_xdisplay ());
+
+    xfsettings_dbg (XFSD_DEBUG_REPLAY, "replaying %u records from %s",
+                    replay_records->len, filename);
+
+    g_idle_add (xfsettings_replay_step, NULL);
+
+    return TRUE;
+}
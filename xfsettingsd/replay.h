@@ -0,0 +1,47 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <glib.h>
+
+/* records the X events the helpers handle and the xfconf changes
+ * they see, until xfsettings_replay_record_stop () writes the file */
+gboolean xfsettings_replay_record      (const gchar  *filename,
+                                        GError      **error);
+
+void     xfsettings_replay_record_stop (void);
+
+/* around the daemon's own xfconf writes, they are not recorded since
+ * the helpers make them again when the recording is replayed */
+void     xfsettings_replay_ignore_push (void);
+
+void     xfsettings_replay_ignore_pop  (void);
+
+/* the replay only runs with XFSETTINGSD_REPLAY_PRIVATE_BUS=1, set on
+ * the private session bus the replay is meant for */
+gboolean xfsettings_replay_check_bus   (GError      **error);
+
+/* replays a recording with its original timing, the xfconf changes
+ * go through xfconfd and the X events are injected in the dispatcher;
+ * the report is printed and the main loop quits when done */
+gboolean xfsettings_replay_run         (const gchar  *filename,
+                                        GError      **error);
+
+#endif /* !__REPLAY_H__ */
@@ -0,0 +1,261 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "channel-cache.h"
+#include "debug.h"
+#include "startup.h"
+
+#define STARTUP_REPORT_DIR  "xfce4" G_DIR_SEPARATOR_S "xfsettingsd" G_DIR_SEPARATOR_S
+#define STARTUP_REPORT_FILE "startup.log"
+
+
+
+typedef struct _StartupEntry StartupEntry;
+struct _StartupEntry
+{
+    gchar  *name;
+
+    /* relative to the start of the daemon */
+    gint64  start;
+    gint64  duration;
+};
+
+typedef struct _StartupPrefetch StartupPrefetch;
+struct _StartupPrefetch
+{
+    gchar  *channel_name;
+    gint64  start_time;
+};
+
+
+
+static gint64   startup_time = 0;
+static GArray  *startup_entries = NULL;
+static guint    startup_n_prefetches = 0;
+static gboolean startup_finished = FALSE;
+
+
+
+static gint
+xfsettings_startup_entry_compare (gconstpointer a,
+                                  gconstpointer b)
+{
+    const StartupEntry *entry_a = a;
+    const StartupEntry *entry_b = b;
+
+    if (entry_a->start == entry_b->start)
+        return 0;
+
+    return entry_a->start < entry_b->start ? -1 : 1;
+}
+
+
+
+static void
+xfsettings_startup_write_report (void)
+{
+    GString      *report;
+    StartupEntry *entry;
+    guint         i;
+    gchar        *dir;
+    gchar        *filename;
+    GError       *error = NULL;
+
+    g_array_sort (startup_entries, xfsettings_startup_entry_compare);
+
+    report = g_string_new ("# xfsettingsd startup report\n"
+                           "#    start (ms)   duration (ms)  step\n");
+
+    for (i = 0; i < startup_entries->len; i++)
+    {
+        entry = &g_array_index (startup_entries, StartupEntry, i);
+        g_string_append_printf (report, "%14.3f %15.3f  %s\n",
+                                entry->start / 1000.0,
+                                entry->duration / 1000.0,
+                                entry->name);
+    }
+
+    dir = xfce_resource_save_location (XFCE_RESOURCE_CACHE, STARTUP_REPORT_DIR, TRUE);
+    if (dir != NULL)
+    {
+        filename = g_build_filename (dir, STARTUP_REPORT_FILE, NULL);
+        if (!g_file_set_contents (filename, report->str, report->len, &error))
+        {
+            g_warning ("Failed to write the startup report: %s", error->message);
+            g_error_free (error);
+        }
+        else
+        {
+            xfsettings_dbg (XFSD_DEBUG_STARTUP, "report written to %s", filename);
+        }
+
+        g_free (filename);
+        g_free (dir);
+    }
+
+    g_string_free (report, TRUE);
+
+    for (i = 0; i < startup_entries->len; i++)
+        g_free (g_array_index (startup_entries, StartupEntry, i).name);
+    g_array_free (startup_entries, TRUE);
+    startup_entries = NULL;
+}
+
+
+
+void
+xfsettings_startup_begin (void)
+{
+    g_return_if_fail (startup_entries == NULL);
+
+    startup_time = g_get_monotonic_time ();
+    startup_entries = g_array_new (FALSE, FALSE, sizeof (StartupEntry));
+}
+
+
+
+gint64
+xfsettings_startup_mark (const gchar *name,
+                         gint64       start_time)
+{
+    StartupEntry entry;
+    gint64       now;
+
+    g_return_val_if_fail (name != NULL, 0);
+
+    now = g_get_monotonic_time ();
+
+    /* the report has already been written */
+    if (startup_entries == NULL)
+        return now;
+
+    entry.name = g_strdup (name);
+    entry.start = start_time - startup_time;
+    entry.duration = now - start_time;
+    g_array_append_val (startup_entries, entry);
+
+    xfsettings_dbg (XFSD_DEBUG_STARTUP, "%s took %.3f ms (at %.3f ms)",
+                    name, entry.duration / 1000.0, entry.start / 1000.0);
+
+    return now;
+}
+
+
+
+static void
+xfsettings_startup_prefetch_done (GObject      *source_object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+    StartupPrefetch *prefetch = user_data;
+    GVariant        *reply;
+    GVariant        *properties;
+    GError          *error = NULL;
+    gchar           *name;
+
+    reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), result, &error);
+    if (reply != NULL)
+    {
+        /* the helper's channel cache starts from this */
+        properties = g_variant_get_child_value (reply, 0);
+        xfsettings_channel_cache_seed (prefetch->channel_name, properties);
+        g_variant_unref (properties);
+        g_variant_unref (reply);
+    }
+    else
+    {
+        /* not fatal, the helper will load the channel itself */
+        xfsettings_dbg (XFSD_DEBUG_STARTUP, "prefetching channel \"%s\" failed: %s",
+                        prefetch->channel_name, error->message);
+        g_error_free (error);
+    }
+
+    name = g_strdup_printf ("prefetch %s", prefetch->channel_name);
+    xfsettings_startup_mark (name, prefetch->start_time);
+    g_free (name);
+
+    g_free (prefetch->channel_name);
+    g_slice_free (StartupPrefetch, prefetch);
+
+    startup_n_prefetches--;
+    if (startup_finished && startup_n_prefetches == 0 && startup_entries != NULL)
+        xfsettings_startup_write_report ();
+}
+
+
+
+void
+xfsettings_startup_prefetch (GDBusConnection *connection,
+                             const gchar     *channel_name)
+{
+    StartupPrefetch *prefetch;
+
+    g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+    g_return_if_fail (channel_name != NULL);
+
+    prefetch = g_slice_new (StartupPrefetch);
+    prefetch->channel_name = g_strdup (channel_name);
+    prefetch->start_time = g_get_monotonic_time ();
+
+    xfsettings_channel_cache_seed_begin (connection);
+
+    /* fetch the channel while other helpers are initialized, the reply
+     * fills the channel cache */
+    g_dbus_connection_call (connection,
+                            "org.xfce.Xfconf",
+                            "/org/xfce/Xfconf",
+                            "org.xfce.Xfconf",
+                            "GetAllProperties",
+                            g_variant_new ("(ss)", channel_name, "/"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            xfsettings_startup_prefetch_done,
+                            prefetch);
+
+    startup_n_prefetches++;
+}
+
+
+
+void
+xfsettings_startup_finish (void)
+{
+    if (startup_finished)
+        return;
+
+    xfsettings_startup_mark ("startup", startup_time);
+
+    startup_finished = TRUE;
+
+    /* all helpers exist, their caches took what they needed */
+    xfsettings_channel_cache_seed_end ();
+
+    /* wait for pending prefetches, so they end up in the report */
+    if (startup_n_prefetches == 0 && startup_entries != NULL)
+        xfsettings_startup_write_report ();
+}
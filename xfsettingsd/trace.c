@@ -0,0 +1,275 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "debug.h"
+#include "trace.h"
+
+#define TRACE_REPORT_DIR "xfce4" G_DIR_SEPARATOR_S "xfsettingsd" G_DIR_SEPARATOR_S
+
+/* records per domain, a power of two */
+#define TRACE_RING_SIZE  1024
+#define TRACE_N_DOMAINS  32
+
+/* the first argument is a duration in us */
+#define TRACE_SPAN       (1 << 0)
+
+
+
+typedef struct _TraceRecord TraceRecord;
+struct _TraceRecord
+{
+    /* end of the event, relative to trace_start */
+    gint64  time;
+    guint32 event;
+    guint32 args[3];
+};
+
+typedef struct _TraceRing TraceRing;
+struct _TraceRing
+{
+    /* total number of records written */
+    guint64     n_records;
+    TraceRecord records[TRACE_RING_SIZE];
+};
+
+typedef struct _TraceEventInfo TraceEventInfo;
+struct _TraceEventInfo
+{
+    XfsdDebugDomain  domain;
+    const gchar     *name;
+    guint            flags;
+};
+
+
+
+static const TraceEventInfo trace_events[XFSD_TRACE_N_EVENTS] =
+{
+    [XFSD_TRACE_X_EVENT]                = { XFSD_DEBUG_EVENTS, "x-event", TRACE_SPAN },
+    [XFSD_TRACE_XSETTINGS_NOTIFY]       = { XFSD_DEBUG_XSETTINGS, "notify", 0 },
+    [XFSD_TRACE_DISPLAYS_SCREEN_CHANGE] = { XFSD_DEBUG_DISPLAYS, "screen-change", 0 },
+    [XFSD_TRACE_DISPLAYS_APPLY]         = { XFSD_DEBUG_DISPLAYS, "apply", TRACE_SPAN },
+    [XFSD_TRACE_DISPLAYS_LID]           = { XFSD_DEBUG_DISPLAYS, "lid", 0 },
+    [XFSD_TRACE_POINTERS_RESTORE]       = { XFSD_DEBUG_POINTERS, "restore", TRACE_SPAN },
+    [XFSD_TRACE_KEYBOARDS_DEVICE]       = { XFSD_DEBUG_KEYBOARDS, "device", 0 },
+    [XFSD_TRACE_SHORTCUT_ACTIVATE]      = { XFSD_DEBUG_KEYBOARD_SHORTCUTS, "activate", TRACE_SPAN },
+    [XFSD_TRACE_WORKSPACES_SYNC]        = { XFSD_DEBUG_WORKSPACES, "sync", 0 },
+    [XFSD_TRACE_CLIPBOARD_SAVE]         = { XFSD_DEBUG_CLIPBOARD, "save", 0 },
+    [XFSD_TRACE_MODULE_LOAD]            = { XFSD_DEBUG_MODULES, "load", TRACE_SPAN },
+    [XFSD_TRACE_WATCHDOG_STALL]         = { XFSD_DEBUG_WATCHDOG, "stall", TRACE_SPAN },
+};
+
+static TraceRing *trace_rings[TRACE_N_DOMAINS];
+static gint64     trace_start = 0;
+static gint       trace_enabled = -1;
+
+
+
+void
+xfsettings_trace (XfsdTraceEvent event,
+                  guint32        arg0,
+                  guint32        arg1,
+                  guint32        arg2)
+{
+    TraceRing   *ring;
+    TraceRecord *record;
+    gint         bit;
+
+    if (G_UNLIKELY (trace_enabled != 1))
+    {
+        if (trace_enabled == 0)
+            return;
+
+        /* always on, unless disabled explicitly */
+        trace_enabled = g_getenv ("XFSETTINGSD_NO_TRACE") == NULL;
+        trace_start = g_get_monotonic_time ();
+        if (trace_enabled == 0)
+            return;
+    }
+
+    g_return_if_fail (event < XFSD_TRACE_N_EVENTS);
+
+    bit = g_bit_nth_lsf (trace_events[event].domain, -1);
+
+    ring = trace_rings[bit];
+    if (G_UNLIKELY (ring == NULL))
+        ring = trace_rings[bit] = g_new0 (TraceRing, 1);
+
+    record = &ring->records[ring->n_records++ & (TRACE_RING_SIZE - 1)];
+    record->time = g_get_monotonic_time () - trace_start;
+    record->event = event;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+}
+
+
+
+static gint
+xfsettings_trace_compare (gconstpointer a,
+                          gconstpointer b)
+{
+    const TraceRecord *record_a = *(const TraceRecord **) a;
+    const TraceRecord *record_b = *(const TraceRecord **) b;
+
+    if (record_a->time == record_b->time)
+        return 0;
+
+    return record_a->time < record_b->time ? -1 : 1;
+}
+
+
+
+gchar *
+xfsettings_trace_dump (XfsdTraceFormat format)
+{
+    GPtrArray            *records;
+    GString              *dump;
+    TraceRing            *ring;
+    const TraceRecord    *record;
+    const TraceEventInfo *info;
+    const gchar          *domain_name;
+    guint64               n, first;
+    guint                 i;
+    gint                  bit;
+    gint64                start;
+
+    /* merge the rings, in time order */
+    records = g_ptr_array_new ();
+    for (bit = 0; bit < TRACE_N_DOMAINS; bit++)
+    {
+        ring = trace_rings[bit];
+        if (ring == NULL)
+            continue;
+
+        first = ring->n_records > TRACE_RING_SIZE ? ring->n_records - TRACE_RING_SIZE : 0;
+        for (n = first; n < ring->n_records; n++)
+            g_ptr_array_add (records, &ring->records[n & (TRACE_RING_SIZE - 1)]);
+    }
+    g_ptr_array_sort (records, xfsettings_trace_compare);
+
+    if (format == XFSD_TRACE_FORMAT_CHROME)
+        dump = g_string_new ("{\"traceEvents\":[\n");
+    else
+        dump = g_string_new ("#     time (ms)  domain              event          arguments\n");
+
+    for (i = 0; i < records->len; i++)
+    {
+        record = g_ptr_array_index (records, i);
+        info = &trace_events[record->event];
+        domain_name = xfsettings_dbg_domain_name (info->domain);
+
+        if (format == XFSD_TRACE_FORMAT_CHROME)
+        {
+            /* one thread per domain, spans end at the record time */
+            if ((info->flags & TRACE_SPAN) != 0)
+            {
+                start = record->time - record->args[0];
+                g_string_append_printf (dump, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                                        "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%u,\"pid\":%d,\"tid\":%d,"
+                                        "\"args\":{\"arg1\":%u,\"arg2\":%u}}",
+                                        i > 0 ? ",\n" : "", info->name, domain_name,
+                                        start, record->args[0], (gint) getpid (),
+                                        g_bit_nth_lsf (info->domain, -1),
+                                        record->args[1], record->args[2]);
+            }
+            else
+            {
+                g_string_append_printf (dump, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+                                        "\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d,"
+                                        "\"args\":{\"arg0\":%u,\"arg1\":%u,\"arg2\":%u}}",
+                                        i > 0 ? ",\n" : "", info->name, domain_name,
+                                        record->time, (gint) getpid (),
+                                        g_bit_nth_lsf (info->domain, -1),
+                                        record->args[0], record->args[1], record->args[2]);
+            }
+        }
+        else if ((info->flags & TRACE_SPAN) != 0)
+        {
+            g_string_append_printf (dump, "%15.3f  %-18s  %-13s  %.3f ms, %u %u\n",
+                                    record->time / 1000.0, domain_name, info->name,
+                                    record->args[0] / 1000.0, record->args[1], record->args[2]);
+        }
+        else
+        {
+            g_string_append_printf (dump, "%15.3f  %-18s  %-13s  %u %u %u\n",
+                                    record->time / 1000.0, domain_name, info->name,
+                                    record->args[0], record->args[1], record->args[2]);
+        }
+    }
+
+    if (format == XFSD_TRACE_FORMAT_CHROME)
+        g_string_append (dump, "\n]}\n");
+
+    g_ptr_array_free (records, TRUE);
+
+    return g_string_free (dump, FALSE);
+}
+
+
+
+void
+xfsettings_trace_write (void)
+{
+    static const struct
+    {
+        XfsdTraceFormat  format;
+        const gchar     *filename;
+    }
+    files[] =
+    {
+        { XFSD_TRACE_FORMAT_TEXT, "trace.log" },
+        { XFSD_TRACE_FORMAT_CHROME, "trace.json" },
+    };
+    gchar  *dir;
+    gchar  *filename;
+    gchar  *dump;
+    guint   i;
+    GError *error = NULL;
+
+    dir = xfce_resource_save_location (XFCE_RESOURCE_CACHE, TRACE_REPORT_DIR, TRUE);
+    if (dir == NULL)
+        return;
+
+    for (i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        dump = xfsettings_trace_dump (files[i].format);
+        filename = g_build_filename (dir, files[i].filename, NULL);
+
+        if (!g_file_set_contents (filename, dump, -1, &error))
+        {
+            g_warning ("Failed to write the trace: %s", error->message);
+            g_clear_error (&error);
+        }
+
+        g_free (filename);
+        g_free (dump);
+    }
+
+    g_free (dir);
+}
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <glib.h>
+
+/* the events and their domains are listed in trace.c, events marked
+ * as a span pass their duration in us as the first argument */
+typedef enum
+{
+    XFSD_TRACE_X_EVENT,                /* duration, event type */
+    XFSD_TRACE_XSETTINGS_NOTIFY,       /* serial, settings, bytes */
+    XFSD_TRACE_DISPLAYS_SCREEN_CHANGE, /* outputs before, outputs after */
+    XFSD_TRACE_DISPLAYS_APPLY,         /* duration, crtcs */
+    XFSD_TRACE_DISPLAYS_LID,           /* closed */
+    XFSD_TRACE_POINTERS_RESTORE,       /* duration, device id or 0 */
+    XFSD_TRACE_KEYBOARDS_DEVICE,       /* device id */
+    XFSD_TRACE_SHORTCUT_ACTIVATE,      /* duration, X timestamp */
+    XFSD_TRACE_WORKSPACES_SYNC,        /* to X, names, generation */
+    XFSD_TRACE_CLIPBOARD_SAVE,         /* bytes */
+    XFSD_TRACE_MODULE_LOAD,            /* duration, loaded */
+    XFSD_TRACE_WATCHDOG_STALL,         /* duration */
+
+    XFSD_TRACE_N_EVENTS
+}
+XfsdTraceEvent;
+
+typedef enum
+{
+    XFSD_TRACE_FORMAT_TEXT,
+    XFSD_TRACE_FORMAT_CHROME
+}
+XfsdTraceFormat;
+
+/* records the event in the ring buffer of its domain, main thread only */
+void   xfsettings_trace       (XfsdTraceEvent   event,
+                               guint32          arg0,
+                               guint32          arg1,
+                               guint32          arg2);
+
+gchar *xfsettings_trace_dump  (XfsdTraceFormat  format) G_GNUC_MALLOC;
+
+void   xfsettings_trace_write (void);
+
+#endif /* !__TRACE_H__ */
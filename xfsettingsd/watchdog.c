@@ -0,0 +1,519 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#include <glib.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "debug.h"
+#include "metrics.h"
+#include "trace.h"
+#include "watchdog.h"
+
+#define WATCHDOG_REPORT_DIR  "xfce4" G_DIR_SEPARATOR_S "xfsettingsd" G_DIR_SEPARATOR_S
+#define WATCHDOG_REPORT_FILE "watchdog.log"
+
+/* default threshold in ms if XFSETTINGSD_WATCHDOG is not a number */
+#define WATCHDOG_DEFAULT_THRESHOLD 200
+
+#define WATCHDOG_N_SLOWEST    8
+#define WATCHDOG_MAX_FRAMES   32
+#define WATCHDOG_NAME_LEN     64
+
+/* sent to the main thread to sample what it is doing, the daemon
+ * does not use profiling timers */
+#define WATCHDOG_SIGNAL       SIGPROF
+
+
+
+typedef struct _WatchdogIncident WatchdogIncident;
+struct _WatchdogIncident
+{
+    /* in us, start in wall clock time */
+    gint64   duration;
+    gint64   start;
+
+    /* first function outside glib the main loop dispatched to */
+    gchar    source[WATCHDOG_NAME_LEN];
+    gchar    label[WATCHDOG_NAME_LEN];
+    gchar  **backtrace;
+};
+
+
+
+/* upper bounds of the histogram buckets in ms, the last bucket is
+ * for everything above */
+static const gint64 watchdog_buckets[] = { 250, 500, 1000, 2500, 5000, 10000 };
+
+static GMutex            watchdog_lock;
+static GCond             watchdog_cond;
+static GThread          *watchdog_thread = NULL;
+static gboolean          watchdog_running = FALSE;
+static gint64            watchdog_threshold = 0;
+static GPollFunc         watchdog_default_poll = NULL;
+
+/* main loop state, protected by watchdog_lock */
+static gboolean          watchdog_in_poll = TRUE;
+static gint64            watchdog_iteration_start = 0;
+static gboolean          watchdog_stalled = FALSE;
+static WatchdogIncident  watchdog_current;
+
+/* statistics, protected by watchdog_lock */
+static guint             watchdog_n_stalls = 0;
+static guint             watchdog_histogram[G_N_ELEMENTS (watchdog_buckets) + 1];
+static WatchdogIncident  watchdog_slowest[WATCHDOG_N_SLOWEST];
+static guint             watchdog_n_slowest = 0;
+
+/* set by the main thread */
+static const gchar      *watchdog_label = NULL;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_t         watchdog_main_thread;
+
+/* written by the signal handler, read by the main thread once the
+ * stall is over */
+static gpointer          watchdog_frames[WATCHDOG_MAX_FRAMES];
+static gint              watchdog_n_frames = 0;
+static gint              watchdog_sampled = 0;
+#endif
+
+
+
+static void
+xfsettings_watchdog_copy_name (gchar       *dest,
+                               const gchar *name,
+                               gsize        len)
+{
+    guint i;
+
+    for (i = 0; name != NULL && i < len && name[i] != '\0' && i < WATCHDOG_NAME_LEN - 1; i++)
+        dest[i] = name[i];
+    dest[i] = '\0';
+}
+
+
+
+#ifdef HAVE_PTHREAD_H
+static void
+xfsettings_watchdog_sample (gint signum)
+{
+    gint errsv = errno;
+
+    /* only copy the return addresses, backtrace was loaded when the
+     * watchdog started; the frames are resolved by the main thread */
+#ifdef HAVE_EXECINFO_H
+    watchdog_n_frames = backtrace (watchdog_frames, WATCHDOG_MAX_FRAMES);
+#endif
+
+    g_atomic_int_set (&watchdog_sampled, 1);
+
+    errno = errsv;
+}
+#endif
+
+
+
+static void
+xfsettings_watchdog_capture_locked (void)
+{
+    memset (&watchdog_current, 0, sizeof (watchdog_current));
+    watchdog_current.start = g_get_real_time ()
+                             - (g_get_monotonic_time () - watchdog_iteration_start);
+    xfsettings_watchdog_copy_name (watchdog_current.label,
+                                   g_atomic_pointer_get (&watchdog_label), G_MAXSIZE);
+
+#ifdef HAVE_PTHREAD_H
+    g_atomic_int_set (&watchdog_sampled, 0);
+#endif
+}
+
+
+
+static void
+xfsettings_watchdog_resolve (WatchdogIncident *incident)
+{
+#if defined (HAVE_PTHREAD_H) && defined (HAVE_EXECINFO_H)
+    sigset_t      mask, old_mask;
+    gpointer      frames[WATCHDOG_MAX_FRAMES];
+    gint          n_frames = 0;
+    gint          n, dispatch;
+    gchar       **symbols;
+    const gchar  *name;
+
+    /* a late sample must not change the frames while they are copied */
+    sigemptyset (&mask);
+    sigaddset (&mask, WATCHDOG_SIGNAL);
+    pthread_sigmask (SIG_BLOCK, &mask, &old_mask);
+
+    if (g_atomic_int_get (&watchdog_sampled) != 0)
+    {
+        n_frames = watchdog_n_frames;
+        memcpy (frames, watchdog_frames, n_frames * sizeof (gpointer));
+        g_atomic_int_set (&watchdog_sampled, 0);
+    }
+
+    pthread_sigmask (SIG_SETMASK, &old_mask, NULL);
+
+    /* skip the signal handler and the trampoline */
+    if (n_frames <= 2)
+        return;
+
+    symbols = backtrace_symbols (frames, n_frames);
+    if (symbols == NULL)
+        return;
+
+    incident->backtrace = g_new0 (gchar *, n_frames - 1);
+    for (n = 2, dispatch = -1; n < n_frames; n++)
+    {
+        incident->backtrace[n - 2] = g_strdup (symbols[n]);
+        if (dispatch == -1 && strstr (symbols[n], "g_main_context_dispatch") != NULL)
+            dispatch = n;
+    }
+
+    /* the callback of the source is the first frame outside glib on
+     * top of the dispatch */
+    for (n = dispatch - 1; dispatch != -1 && n >= 2; n--)
+    {
+        if (strstr (symbols[n], "libglib-2.0") == NULL)
+        {
+            /* "binary(function+offset) [address]" */
+            name = strchr (symbols[n], '(');
+            if (name != NULL && name[1] != '+' && name[1] != ')')
+                xfsettings_watchdog_copy_name (incident->source, name + 1, strcspn (name + 1, "+)"));
+            else
+                xfsettings_watchdog_copy_name (incident->source, symbols[n], G_MAXSIZE);
+            break;
+        }
+    }
+
+    free (symbols);
+#endif
+}
+
+
+
+static void
+xfsettings_watchdog_record_locked (WatchdogIncident *incident)
+{
+    guint i, pos;
+
+    watchdog_n_stalls++;
+
+    for (i = 0; i < G_N_ELEMENTS (watchdog_buckets); i++)
+        if (incident->duration < watchdog_buckets[i] * 1000)
+            break;
+    watchdog_histogram[i]++;
+
+    /* this runs in the main thread */
+    xfsettings_metrics_time (XFSD_DEBUG_WATCHDOG, "stall", incident->duration);
+    xfsettings_trace (XFSD_TRACE_WATCHDOG_STALL, incident->duration, 0, 0);
+
+    xfsettings_dbg (XFSD_DEBUG_WATCHDOG, "main loop stalled for %.1f ms in \"%s\" (%s)",
+                    incident->duration / 1000.0,
+                    *incident->source != '\0' ? incident->source : "unnamed source",
+                    *incident->label != '\0' ? incident->label : "no label");
+
+    /* keep the slowest incidents, sorted by duration */
+    for (pos = 0; pos < watchdog_n_slowest; pos++)
+        if (incident->duration > watchdog_slowest[pos].duration)
+            break;
+
+    if (pos == WATCHDOG_N_SLOWEST)
+    {
+        g_strfreev (incident->backtrace);
+        return;
+    }
+
+    if (watchdog_n_slowest == WATCHDOG_N_SLOWEST)
+        g_strfreev (watchdog_slowest[--watchdog_n_slowest].backtrace);
+
+    memmove (&watchdog_slowest[pos + 1], &watchdog_slowest[pos],
+             (watchdog_n_slowest - pos) * sizeof (WatchdogIncident));
+    watchdog_slowest[pos] = *incident;
+    watchdog_n_slowest++;
+}
+
+
+
+static gint
+xfsettings_watchdog_poll (GPollFD *ufds,
+                          guint    nfds,
+                          gint     timeout)
+{
+    WatchdogIncident incident;
+    gboolean         stalled;
+    gint             result;
+
+    g_mutex_lock (&watchdog_lock);
+    stalled = watchdog_stalled;
+    if (stalled)
+    {
+        incident = watchdog_current;
+        incident.duration = g_get_monotonic_time () - watchdog_iteration_start;
+        watchdog_stalled = FALSE;
+    }
+    watchdog_in_poll = TRUE;
+    g_mutex_unlock (&watchdog_lock);
+
+    if (stalled)
+    {
+        /* resolve the sample outside the signal handler and the lock */
+        xfsettings_watchdog_resolve (&incident);
+
+        g_mutex_lock (&watchdog_lock);
+        xfsettings_watchdog_record_locked (&incident);
+        g_mutex_unlock (&watchdog_lock);
+    }
+
+    result = (*watchdog_default_poll) (ufds, nfds, timeout);
+
+    g_mutex_lock (&watchdog_lock);
+    watchdog_in_poll = FALSE;
+    watchdog_iteration_start = g_get_monotonic_time ();
+    g_mutex_unlock (&watchdog_lock);
+
+    return result;
+}
+
+
+
+static gpointer
+xfsettings_watchdog_thread (gpointer data)
+{
+    gint64 end_time;
+
+    g_mutex_lock (&watchdog_lock);
+
+    while (watchdog_running)
+    {
+        end_time = g_get_monotonic_time () + watchdog_threshold / 2;
+        while (watchdog_running && g_cond_wait_until (&watchdog_cond, &watchdog_lock, end_time))
+            ;
+
+        if (!watchdog_in_poll
+            && !watchdog_stalled
+            && g_get_monotonic_time () - watchdog_iteration_start > watchdog_threshold)
+        {
+            /* the duration is known when the main loop polls again */
+            watchdog_stalled = TRUE;
+            xfsettings_watchdog_capture_locked ();
+
+#ifdef HAVE_PTHREAD_H
+            /* interrupt the main thread to see what it is doing, it
+             * takes the lock when the stall is over */
+            g_mutex_unlock (&watchdog_lock);
+            pthread_kill (watchdog_main_thread, WATCHDOG_SIGNAL);
+            g_mutex_lock (&watchdog_lock);
+#endif
+        }
+    }
+
+    g_mutex_unlock (&watchdog_lock);
+
+    return NULL;
+}
+
+
+
+gboolean
+xfsettings_watchdog_start (void)
+{
+    const gchar      *value;
+    gint64            threshold;
+#ifdef HAVE_PTHREAD_H
+    struct sigaction  sa;
+#endif
+
+    g_return_val_if_fail (watchdog_thread == NULL, FALSE);
+
+    value = g_getenv ("XFSETTINGSD_WATCHDOG");
+    if (value == NULL || *value == '\0')
+        return FALSE;
+
+    threshold = g_ascii_strtoll (value, NULL, 10);
+    if (threshold <= 0)
+        threshold = WATCHDOG_DEFAULT_THRESHOLD;
+    watchdog_threshold = threshold * 1000;
+
+#ifdef HAVE_PTHREAD_H
+    watchdog_main_thread = pthread_self ();
+
+    memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = xfsettings_watchdog_sample;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset (&sa.sa_mask);
+    sigaction (WATCHDOG_SIGNAL, &sa, NULL);
+
+#ifdef HAVE_EXECINFO_H
+    /* the first call loads libgcc, do that outside the signal handler */
+    watchdog_n_frames = backtrace (watchdog_frames, WATCHDOG_MAX_FRAMES);
+#endif
+#endif
+
+    watchdog_iteration_start = g_get_monotonic_time ();
+    watchdog_default_poll = g_main_context_get_poll_func (NULL);
+    g_main_context_set_poll_func (NULL, xfsettings_watchdog_poll);
+
+    watchdog_running = TRUE;
+    watchdog_thread = g_thread_new ("watchdog", xfsettings_watchdog_thread, NULL);
+
+    xfsettings_dbg (XFSD_DEBUG_WATCHDOG, "watching for stalls over %" G_GINT64_FORMAT " ms",
+                    threshold);
+
+    return TRUE;
+}
+
+
+
+void
+xfsettings_watchdog_stop (void)
+{
+    guint i;
+
+    if (watchdog_thread == NULL)
+        return;
+
+    g_mutex_lock (&watchdog_lock);
+    watchdog_running = FALSE;
+    g_cond_signal (&watchdog_cond);
+    g_mutex_unlock (&watchdog_lock);
+
+    g_thread_join (watchdog_thread);
+    watchdog_thread = NULL;
+
+    g_main_context_set_poll_func (NULL, watchdog_default_poll);
+
+#ifdef HAVE_PTHREAD_H
+    signal (WATCHDOG_SIGNAL, SIG_DFL);
+#endif
+
+    for (i = 0; i < watchdog_n_slowest; i++)
+        g_strfreev (watchdog_slowest[i].backtrace);
+    watchdog_n_slowest = 0;
+}
+
+
+
+const gchar *
+xfsettings_watchdog_set_label (const gchar *label)
+{
+    const gchar *previous = watchdog_label;
+
+    /* the labels are static strings, only the pointer is shared */
+    g_atomic_pointer_set (&watchdog_label, label);
+
+    return previous;
+}
+
+
+
+void
+xfsettings_watchdog_dump (void)
+{
+    GString          *report;
+    WatchdogIncident *incident;
+    GDateTime        *date_time;
+    gchar            *date;
+    gchar            *dir;
+    gchar            *filename;
+    guint             i, n;
+    GError           *error = NULL;
+
+    if (watchdog_thread == NULL)
+        return;
+
+    report = g_string_new ("# xfsettingsd main loop stalls\n");
+
+    g_mutex_lock (&watchdog_lock);
+
+    g_string_append_printf (report, "threshold: %" G_GINT64_FORMAT " ms\n"
+                            "stalls: %u\n\n# duration (ms)  count\n",
+                            watchdog_threshold / 1000, watchdog_n_stalls);
+
+    for (i = 0; i < G_N_ELEMENTS (watchdog_histogram); i++)
+    {
+        if (i < G_N_ELEMENTS (watchdog_buckets))
+            g_string_append_printf (report, "< %-14" G_GINT64_FORMAT " %u\n",
+                                    watchdog_buckets[i], watchdog_histogram[i]);
+        else
+            g_string_append_printf (report, ">= %-13" G_GINT64_FORMAT " %u\n",
+                                    watchdog_buckets[i - 1], watchdog_histogram[i]);
+    }
+
+    for (i = 0; i < watchdog_n_slowest; i++)
+    {
+        incident = &watchdog_slowest[i];
+
+        date_time = g_date_time_new_from_unix_local (incident->start / G_USEC_PER_SEC);
+        date = g_date_time_format (date_time, "%F %T");
+        g_date_time_unref (date_time);
+
+        g_string_append_printf (report, "\n# %.1f ms at %s\nsource: %s\nlabel: %s\n",
+                                incident->duration / 1000.0, date,
+                                *incident->source != '\0' ? incident->source : "(unnamed)",
+                                *incident->label != '\0' ? incident->label : "(none)");
+        g_free (date);
+
+        for (n = 0; incident->backtrace != NULL && incident->backtrace[n] != NULL; n++)
+            g_string_append_printf (report, "  #%-2u %s\n", n, incident->backtrace[n]);
+    }
+
+    g_mutex_unlock (&watchdog_lock);
+
+    dir = xfce_resource_save_location (XFCE_RESOURCE_CACHE, WATCHDOG_REPORT_DIR, TRUE);
+    if (dir != NULL)
+    {
+        filename = g_build_filename (dir, WATCHDOG_REPORT_FILE, NULL);
+        if (!g_file_set_contents (filename, report->str, report->len, &error))
+        {
+            g_warning ("Failed to write the watchdog report: %s", error->message);
+            g_error_free (error);
+        }
+        else
+        {
+            xfsettings_dbg (XFSD_DEBUG_WATCHDOG, "report written to %s", filename);
+        }
+
+        g_free (filename);
+        g_free (dir);
+    }
+
+    g_string_free (report, TRUE);
+}
@@ -0,0 +1,35 @@
+/*
+ *  Copyright (c) 2020 The Xfce development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __WATCHDOG_H__
+#define __WATCHDOG_H__
+
+#include <glib.h>
+
+gboolean     xfsettings_watchdog_start     (void);
+
+void         xfsettings_watchdog_stop      (void);
+
+/* name of the work the main loop is doing, for the code that runs
+ * inside a generic source like the X event filter; returns the
+ * previous label */
+const gchar *xfsettings_watchdog_set_label (const gchar *label);
+
+void         xfsettings_watchdog_dump      (void);
+
+#endif /* !__WATCHDOG_H__ */
@@ -31,15 +31,28 @@
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <gdk/gdkx.h>
+#ifdef HAVE_XFIXES
+#include <X11/extensions/Xfixes.h>
+#include <glib-unix.h>
+#endif
 #endif
 
 #include "debug.h"
+#include "event-dispatch.h"
+#include "replay.h"
+#include "trace.h"
 #include "workspaces.h"
 
 #define WORKSPACES_CHANNEL    "xfwm4"
 #define WORKSPACE_NAMES_PROP  "/general/workspace_names"
 #define WORKSPACE_COUNT_PROP  "/general/workspace_count"
 
+/* time to collect changes before they are written to xfconf and x */
+#define WORKSPACES_SETTLE_TIME 100
+
+/* maximum number of our own xfconf writes waiting for their echo */
+#define WORKSPACES_MAX_PENDING 8
+
 
 
 static void             xfce_workspaces_helper_finalize     (GObject              *object);
@@ -47,14 +60,20 @@ static guint            xfce_workspaces_helper_get_count    (void);
 static GdkFilterReturn  xfce_workspaces_helper_filter_func  (GdkXEvent            *gdkxevent,
                                                              GdkEvent             *event,
                                                              gpointer              user_data);
-static GPtrArray       *xfce_workspaces_helper_get_names    (void);
+static gchar          **xfce_workspaces_helper_get_names    (void);
 static void             xfce_workspaces_helper_set_names    (XfceWorkspacesHelper *helper,
                                                              gboolean              disable_wm_check);
-static void             xfce_workspaces_helper_save_names   (XfceWorkspacesHelper *helper);
 static void             xfce_workspaces_helper_prop_changed (XfconfChannel        *channel,
                                                              const gchar          *property,
                                                              const GValue         *value,
                                                              XfceWorkspacesHelper *helper);
+static void             xfce_workspaces_helper_set_names_real (XfceWorkspacesHelper *helper);
+#ifdef GDK_WINDOWING_X11
+static void             xfce_workspaces_helper_count_changed   (XfceWorkspacesHelper *helper);
+static void             xfce_workspaces_helper_x_names_changed (XfceWorkspacesHelper *helper,
+                                                                gulong                serial);
+static void             xfce_workspaces_helper_wait_for_window_manager_free (gpointer data);
+#endif
 
 
 
@@ -64,10 +83,27 @@ struct _XfceWorkspacesHelper
 
     XfconfChannel *channel;
 
-    gint64         timestamp;
+    /* names in xfconf, at least one for each workspace */
+    gchar        **names;
+
+    /* last known contents of _NET_DESKTOP_NAMES */
+    gchar        **x_names;
+
+    guint          n_workspaces;
+    gint           xfconf_count;
+
+    /* our own writes, the echoes of these are ignored */
+    guint          generation;
+    GQueue         x_writes;
+    GQueue         xfconf_writes;
+
+    /* pending writes for the current settle window */
+    guint          settle_timeout_id;
+    guint          names_dirty : 1;
+    guint          x_names_dirty : 1;
 
 #ifdef GDK_WINDOWING_X11
-    guint          wait_for_wm_timeout_id;
+    gpointer       wait_for_wm;
 #endif
 };
 
@@ -76,6 +112,18 @@ struct _XfceWorkspacesHelperClass
     GObjectClass parent;
 };
 
+typedef struct
+{
+    guint    generation;
+
+    /* request serial of the x property change */
+    gulong   serial;
+
+    /* names array stored in xfconf */
+    gchar  **names;
+}
+WorkspacesWrite;
+
 #ifdef GDK_WINDOWING_X11
 static Atom atom_net_number_of_desktops = 0;
 static Atom atom_net_desktop_names = 0;
@@ -90,6 +138,13 @@ typedef struct
   guint                 atom_count;
   guint                 have_wm : 1;
   guint                 counter;
+  gint64                start_time;
+
+  guint                 timeout_id;
+#ifdef HAVE_XFIXES
+  guint                 watch_id;
+  gint                  xfixes_event_base;
+#endif
 }
 WaitForWM;
 #endif
@@ -114,6 +169,7 @@ xfce_workspaces_helper_class_init(XfceWorkspacesHelperClass *klass)
 }
 
 
+
 static void
 xfce_workspaces_helper_init (XfceWorkspacesHelper *helper)
 {
@@ -121,12 +177,17 @@ xfce_workspaces_helper_init (XfceWorkspacesHelper *helper)
     GdkEventMask  events;
 
     helper->channel = xfconf_channel_get(WORKSPACES_CHANNEL);
+    helper->xfconf_count = -1;
+
+    g_queue_init (&helper->x_writes);
+    g_queue_init (&helper->xfconf_writes);
 
     /* monitor root window property changes */
     root_window = gdk_get_default_root_window ();
     events = gdk_window_get_events (root_window);
     gdk_window_set_events (root_window, events | GDK_PROPERTY_CHANGE_MASK);
-    gdk_window_add_filter (root_window, xfce_workspaces_helper_filter_func, helper);
+    xfsettings_event_dispatch_add ("workspaces", PropertyNotify, GDK_WINDOW_XID (root_window),
+                                   xfce_workspaces_helper_filter_func, helper);
 
     xfce_workspaces_helper_set_names (helper, FALSE);
 
@@ -137,20 +198,141 @@ xfce_workspaces_helper_init (XfceWorkspacesHelper *helper)
 
 
 
+static void
+xfce_workspaces_helper_write_free (gpointer data)
+{
+    WorkspacesWrite *write = data;
+
+    g_strfreev (write->names);
+    g_slice_free (WorkspacesWrite, write);
+}
+
+
+
 static void
 xfce_workspaces_helper_finalize (GObject *object)
 {
     XfceWorkspacesHelper *helper = XFCE_WORKSPACES_HELPER (object);
 
+#ifdef GDK_WINDOWING_X11
+    /* stop waiting for the window manager */
+    if (helper->wait_for_wm != NULL)
+        xfce_workspaces_helper_wait_for_window_manager_free (helper->wait_for_wm);
+#endif
+
     g_signal_handlers_disconnect_by_func(G_OBJECT (helper->channel),
                                          G_CALLBACK (xfce_workspaces_helper_prop_changed),
                                          helper);
 
+    xfsettings_event_dispatch_remove (xfce_workspaces_helper_filter_func, helper);
+
+    if (helper->settle_timeout_id != 0)
+        g_source_remove (helper->settle_timeout_id);
+
+    g_queue_foreach (&helper->x_writes, (GFunc) xfce_workspaces_helper_write_free, NULL);
+    g_queue_clear (&helper->x_writes);
+    g_queue_foreach (&helper->xfconf_writes, (GFunc) xfce_workspaces_helper_write_free, NULL);
+    g_queue_clear (&helper->xfconf_writes);
+
+    g_strfreev (helper->names);
+    g_strfreev (helper->x_names);
+
     G_OBJECT_CLASS (xfce_workspaces_helper_parent_class)->finalize (object);
 }
 
 
 
+static gchar *
+xfce_workspaces_helper_default_name (guint n)
+{
+    return g_strdup_printf (_("Workspace %d"), n + 1);
+}
+
+
+
+static gboolean
+xfce_workspaces_helper_names_equal (gchar **a,
+                                    gchar **b,
+                                    guint   n)
+{
+    guint i;
+
+    /* compare the first n names, or all names if n is G_MAXUINT */
+    for (i = 0; i < n; i++)
+    {
+        if (a == NULL || a[i] == NULL || b == NULL || b[i] == NULL)
+            return (a == NULL || a[i] == NULL) && (b == NULL || b[i] == NULL);
+
+        if (strcmp (a[i], b[i]) != 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+
+static gchar **
+xfce_workspaces_helper_names_from_value (const GValue *value)
+{
+    GPtrArray  *array = NULL;
+    gchar     **names;
+    GValue     *val;
+    guint       i;
+
+    if (value != NULL && G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY))
+        array = g_value_get_boxed (value);
+
+    if (array == NULL)
+        return g_new0 (gchar *, 1);
+
+    names = g_new0 (gchar *, array->len + 1);
+    for (i = 0; i < array->len; i++)
+    {
+        val = g_ptr_array_index (array, i);
+        if (G_VALUE_HOLDS_STRING (val) && g_value_get_string (val) != NULL)
+            names[i] = g_value_dup_string (val);
+        else
+            /* value in xfconf isn't a string, so make a default one */
+            names[i] = xfce_workspaces_helper_default_name (i);
+    }
+
+    return names;
+}
+
+
+
+static gboolean
+xfce_workspaces_helper_extend_names (XfceWorkspacesHelper *helper)
+{
+    guint        i, len;
+    const gchar *name;
+
+    len = helper->names != NULL ? g_strv_length (helper->names) : 0;
+    if (len >= helper->n_workspaces)
+        return FALSE;
+
+    /* make sure there is a name for each workspace, use the name set
+     * in x if there is one */
+    helper->names = g_renew (gchar *, helper->names, helper->n_workspaces + 1);
+    for (i = len; i < helper->n_workspaces; i++)
+    {
+        name = NULL;
+        if (helper->x_names != NULL && i < g_strv_length (helper->x_names))
+            name = helper->x_names[i];
+
+        if (name != NULL && *name != '\0')
+            helper->names[i] = g_strdup (name);
+        else
+            helper->names[i] = xfce_workspaces_helper_default_name (i);
+    }
+    helper->names[i] = NULL;
+
+    return TRUE;
+}
+
+
+
 static GdkFilterReturn
 xfce_workspaces_helper_filter_func (GdkXEvent  *gdkxevent,
                                     GdkEvent   *event,
@@ -160,27 +342,21 @@ xfce_workspaces_helper_filter_func (GdkXEvent  *gdkxevent,
     XfceWorkspacesHelper  *helper = XFCE_WORKSPACES_HELPER (user_data);
     XEvent                *xevent = gdkxevent;
 
-    if (xevent->type == PropertyNotify)
+    /* the initial start reads the properties itself */
+    if (xevent->type == PropertyNotify && helper->wait_for_wm == NULL)
     {
         if (xevent->xproperty.atom == atom_net_number_of_desktops)
         {
             /* new workspace was added or removed */
-            xfce_workspaces_helper_set_names (helper, TRUE);
-
-            xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "number of desktops changed");
+            if (G_UNLIKELY (helper->names == NULL))
+                xfce_workspaces_helper_set_names_real (helper);
+            else
+                xfce_workspaces_helper_count_changed (helper);
         }
-        else if (xevent->xproperty.atom == atom_net_desktop_names)
+        else if (xevent->xproperty.atom == atom_net_desktop_names
+                 && helper->names != NULL)
         {
-            /* don't respond to our own name changes (1 sec) */
-            if (g_get_real_time () > helper->timestamp)
-            {
-                /* someone changed (possibly another application that does
-                 * not update xfconf) the name of a desktop, store the
-                 * new names in xfconf if different*/
-                xfce_workspaces_helper_save_names (helper);
-
-                xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "someone else changed the desktop names");
-            }
+            xfce_workspaces_helper_x_names_changed (helper, xevent->xproperty.serial);
         }
     }
 #endif
@@ -190,7 +366,7 @@ xfce_workspaces_helper_filter_func (GdkXEvent  *gdkxevent,
 
 
 
-static GPtrArray *
+static gchar **
 xfce_workspaces_helper_get_names (void)
 {
     gboolean     succeed;
@@ -198,7 +374,6 @@ xfce_workspaces_helper_get_names (void)
     gint         i, length, num;
     GPtrArray   *names = NULL;
     gchar       *data = NULL;
-    GValue      *val;
     const gchar *p;
 
     gdk_x11_display_error_trap_push (gdk_display_get_default ());
@@ -217,7 +392,7 @@ xfce_workspaces_helper_get_names (void)
         && data != NULL
         && length > 0)
     {
-        names = g_ptr_array_new ();
+        names = g_ptr_array_new_with_free_func (g_free);
 
         for (i = 0, num = 0; i < length - 1;)
         {
@@ -226,25 +401,24 @@ xfce_workspaces_helper_get_names (void)
             if (!g_utf8_validate (p, -1, NULL))
             {
                 g_warning ("Name of workspace %d is not UTF-8 valid.", num + 1);
-                xfconf_array_free (names);
+                g_ptr_array_free (names, TRUE);
                 g_free (data);
 
                 return NULL;
             }
 
-            val = g_new0 (GValue, 1);
-            g_value_init (val, G_TYPE_STRING);
-            g_value_set_string (val, p);
-            g_ptr_array_add (names, val);
+            g_ptr_array_add (names, g_strdup (p));
 
             i += strlen (p) + 1;
             num++;
         }
+
+        g_ptr_array_add (names, NULL);
     }
 
     g_free (data);
 
-    return names;
+    return names != NULL ? (gchar **) g_ptr_array_free (names, FALSE) : NULL;
 }
 
 
@@ -288,131 +462,295 @@ xfce_workspaces_helper_get_count (void)
 
 
 
+#ifdef GDK_WINDOWING_X11
+static gboolean
+xfce_workspaces_helper_write_x_names (XfceWorkspacesHelper *helper,
+                                      guint                 generation)
+{
+    GString         *names_str;
+    guint            i;
+    Display         *xdisplay;
+    WorkspacesWrite *write;
+
+    /* create nul-separated string of names */
+    names_str = g_string_new (NULL);
+    for (i = 0; i < helper->n_workspaces && helper->names[i] != NULL; i++)
+        g_string_append_len (names_str, helper->names[i], strlen (helper->names[i]) + 1);
+
+    write = g_slice_new0 (WorkspacesWrite);
+    write->generation = generation;
+
+    xdisplay = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+
+    gdk_x11_display_error_trap_push (gdk_display_get_default ());
+
+    /* remember the request serial, the property notify carries it */
+    write->serial = NextRequest (xdisplay);
+    XChangeProperty (xdisplay, gdk_x11_get_default_root_xwindow (),
+                     atom_net_desktop_names,
+                     gdk_x11_get_xatom_by_name ("UTF8_STRING"),
+                     8, PropModeReplace,
+                     (guchar *) names_str->str,
+                     names_str->len + 1);
+
+    g_string_free (names_str, TRUE);
+
+    if (gdk_x11_display_error_trap_pop (gdk_display_get_default ()) != 0)
+    {
+        g_warning ("Failed to change _NET_DESKTOP_NAMES.");
+        xfce_workspaces_helper_write_free (write);
+        return FALSE;
+    }
+
+    g_queue_push_tail (&helper->x_writes, write);
+
+    /* this is what x has now */
+    g_strfreev (helper->x_names);
+    helper->x_names = g_new0 (gchar *, i + 1);
+    for (i = 0; i < helper->n_workspaces && helper->names[i] != NULL; i++)
+        helper->x_names[i] = g_strdup (helper->names[i]);
+
+    return TRUE;
+}
+#endif
+
+
+
+static gboolean
+xfce_workspaces_helper_flush (gpointer data)
+{
+    XfceWorkspacesHelper *helper = XFCE_WORKSPACES_HELPER (data);
+    WorkspacesWrite      *write;
+    guint                 generation;
+    gboolean              names_written = FALSE;
+    gboolean              count_written = FALSE;
+    gboolean              x_written = FALSE;
+
+    helper->settle_timeout_id = 0;
+
+    generation = ++helper->generation;
+
+    if (helper->names_dirty)
+    {
+        helper->names_dirty = FALSE;
+
+        /* tag the write before storing, the echo can arrive at any time */
+        write = g_slice_new0 (WorkspacesWrite);
+        write->generation = generation;
+        write->names = g_strdupv (helper->names);
+        g_queue_push_tail (&helper->xfconf_writes, write);
+
+        /* don't keep tags forever if the echoes never arrive */
+        while (g_queue_get_length (&helper->xfconf_writes) > WORKSPACES_MAX_PENDING)
+            xfce_workspaces_helper_write_free (g_queue_pop_head (&helper->xfconf_writes));
+
+        xfsettings_replay_ignore_push ();
+        if (!xfconf_channel_set_string_list (helper->channel, WORKSPACE_NAMES_PROP,
+                                             (const gchar * const *) helper->names))
+            g_critical ("Failed to save xfconf property %s", WORKSPACE_NAMES_PROP);
+        xfsettings_replay_ignore_pop ();
+
+        names_written = TRUE;
+    }
+
+    if (helper->xfconf_count != (gint) helper->n_workspaces)
+    {
+        /* store this in xfconf (for no really good reason actually) */
+        xfsettings_replay_ignore_push ();
+        xfconf_channel_set_int (helper->channel, WORKSPACE_COUNT_PROP, helper->n_workspaces);
+        xfsettings_replay_ignore_pop ();
+        helper->xfconf_count = helper->n_workspaces;
+
+        count_written = TRUE;
+    }
+
+#ifdef GDK_WINDOWING_X11
+    if (helper->x_names_dirty)
+    {
+        helper->x_names_dirty = FALSE;
+
+        /* only touch the property if the visible names differ */
+        if (!xfce_workspaces_helper_names_equal (helper->x_names, helper->names, helper->n_workspaces))
+            x_written = xfce_workspaces_helper_write_x_names (helper, generation);
+    }
+#endif
+
+    xfsettings_dbg (XFSD_DEBUG_WORKSPACES,
+                    "flushed generation %u (names=%d, count=%d, desktop names=%d)",
+                    generation, names_written, count_written, x_written);
+    xfsettings_trace (XFSD_TRACE_WORKSPACES_SYNC, x_written, names_written, generation);
+
+    return FALSE;
+}
+
+
+
+static void
+xfce_workspaces_helper_schedule_flush (XfceWorkspacesHelper *helper)
+{
+    /* collect all changes in the settle window in a single write */
+    if (helper->settle_timeout_id == 0)
+    {
+        helper->settle_timeout_id = g_timeout_add (WORKSPACES_SETTLE_TIME,
+                                                   xfce_workspaces_helper_flush,
+                                                   helper);
+    }
+}
+
+
+
 static void
 xfce_workspaces_helper_set_names_real (XfceWorkspacesHelper *helper)
 {
-    GString       *names_str;
-    guint          i;
-    guint          n_workspaces;
-    GPtrArray     *names, *existing_names;
-    GValue        *val;
-    gchar         *new_name;
-    const gchar   *name;
+    GPtrArray *array;
+    GValue     value = G_VALUE_INIT;
 
     g_return_if_fail (XFCE_IS_WORKSPACES_HELPER (helper));
 
-    n_workspaces = xfce_workspaces_helper_get_count ();
-    if (n_workspaces < 1)
+    helper->n_workspaces = xfce_workspaces_helper_get_count ();
+    if (helper->n_workspaces < 1)
         return;
 
-    /* check if there are enough names in xfconf, else we save new
-     * names first and set the names the next time property-changed is
-     * triggered on the channel */
-    names = xfconf_channel_get_arrayv (helper->channel, WORKSPACE_NAMES_PROP);
-    if (names != NULL && names->len >= n_workspaces)
+    /* initial state of both sides */
+    array = xfconf_channel_get_arrayv (helper->channel, WORKSPACE_NAMES_PROP);
+    if (array != NULL)
     {
-        /* store this in xfconf (for no really good reason actually) */
-        xfconf_channel_set_int (helper->channel, WORKSPACE_COUNT_PROP, n_workspaces);
+        g_value_init (&value, G_TYPE_PTR_ARRAY);
+        g_value_take_boxed (&value, array);
+    }
 
-        /* create nul-separated string of names */
-        names_str = g_string_new (NULL);
+    g_strfreev (helper->names);
+    helper->names = xfce_workspaces_helper_names_from_value (&value);
 
-        for (i = 0; i < names->len && i < n_workspaces; i++)
-        {
-            val = g_ptr_array_index (names, i);
-            if (G_VALUE_HOLDS_STRING(val))
-            {
-                name = g_value_get_string (val);
+    if (array != NULL)
+        g_value_unset (&value);
 
-                /* insert the name with nul */
-                g_string_append_len (names_str, name, strlen (name) + 1);
-            }
-            else
-            {
-                /* value in xfconf isn't a string, so make a default one */
-                new_name = g_strdup_printf (_("Workspace %d"), i + 1);
-                /* insert the name with nul */
-                g_string_append_len (names_str, new_name, strlen (new_name) + 1);
-                g_free (new_name);
-            }
-        }
+    g_strfreev (helper->x_names);
+    helper->x_names = xfce_workspaces_helper_get_names ();
+
+    /* if there are not enough names in xfconf, store the names set in
+     * x or new default names */
+    if (xfce_workspaces_helper_extend_names (helper))
+        helper->names_dirty = TRUE;
+    helper->x_names_dirty = TRUE;
 
-        /* update stamp so new names is not handled for the next second */
-        helper->timestamp = g_get_real_time () + G_USEC_PER_SEC;
+    xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "%d desktop names set from xfconf", helper->n_workspaces);
 
-        gdk_x11_display_error_trap_push (gdk_display_get_default ());
+    if (helper->settle_timeout_id != 0)
+    {
+        g_source_remove (helper->settle_timeout_id);
+        helper->settle_timeout_id = 0;
+    }
 
-        gdk_property_change (gdk_get_default_root_window (),
-                             gdk_atom_intern_static_string ("_NET_DESKTOP_NAMES"),
-                             gdk_atom_intern_static_string ("UTF8_STRING"),
-                             8, GDK_PROP_MODE_REPLACE,
-                             (guchar *) names_str->str,
-                             names_str->len + 1);
+    xfce_workspaces_helper_flush (helper);
+}
 
-        if (gdk_x11_display_error_trap_pop (gdk_display_get_default ()) != 0)
-            g_warning ("Failed to change _NET_DESKTOP_NAMES.");
 
-        xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "%d desktop names set from xfconf", i);
 
-        g_string_free (names_str, TRUE);
+#ifdef GDK_WINDOWING_X11
+static void
+xfce_workspaces_helper_count_changed (XfceWorkspacesHelper *helper)
+{
+    guint n_workspaces;
+
+    n_workspaces = xfce_workspaces_helper_get_count ();
+    if (n_workspaces < 1 || n_workspaces == helper->n_workspaces)
+        return;
+
+    xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "number of desktops changed from %d to %d",
+                    helper->n_workspaces, n_workspaces);
+
+    helper->n_workspaces = n_workspaces;
+
+    /* new workspaces get a name in xfconf and all of them in x */
+    if (xfce_workspaces_helper_extend_names (helper))
+        helper->names_dirty = TRUE;
+    helper->x_names_dirty = TRUE;
+
+    xfce_workspaces_helper_schedule_flush (helper);
+}
+
+
+
+static void
+xfce_workspaces_helper_x_names_changed (XfceWorkspacesHelper *helper,
+                                        gulong                serial)
+{
+    WorkspacesWrite *write;
+    guint            i, len, n_x_names;
+    guint            changed = 0;
+
+    /* the property notifies arrive in request order, so drop writes
+     * that are older than this event (they failed) and ignore the
+     * event if it is the echo of our own write */
+    while ((write = g_queue_peek_head (&helper->x_writes)) != NULL
+           && write->serial <= serial)
+    {
+        g_queue_pop_head (&helper->x_writes);
+
+        if (write->serial == serial)
+        {
+            xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "ignored desktop names echo of generation %u",
+                            write->generation);
+            xfce_workspaces_helper_write_free (write);
+            return;
+        }
+
+        xfce_workspaces_helper_write_free (write);
     }
-    else
+
+    g_strfreev (helper->x_names);
+    helper->x_names = xfce_workspaces_helper_get_names ();
+    if (helper->x_names == NULL)
     {
-        if (names == NULL)
-            names = g_ptr_array_sized_new (n_workspaces);
+        /* names were removed or invalid, restore them */
+        helper->x_names_dirty = TRUE;
+        xfce_workspaces_helper_schedule_flush (helper);
+        return;
+    }
 
-        /* get current names set in x */
-        existing_names = xfce_workspaces_helper_get_names ();
+    /* someone changed (possibly another application that does not update
+     * xfconf) the name of a desktop, merge the changes in the xfconf names */
+    n_x_names = g_strv_length (helper->x_names);
+    len = g_strv_length (helper->names);
+    if (n_x_names > len)
+    {
+        helper->names = g_renew (gchar *, helper->names, n_x_names + 1);
+        for (i = len; i <= n_x_names; i++)
+            helper->names[i] = NULL;
+    }
 
-        for (i = names->len; i < n_workspaces; i++)
+    for (i = 0; i < n_x_names; i++)
+    {
+        if (g_strcmp0 (helper->names[i], helper->x_names[i]) != 0)
         {
-            if (existing_names != NULL
-                && existing_names->len > i)
-            {
-                val = g_ptr_array_index (existing_names, i);
-                name = g_value_get_string (val);
-
-                if (name != NULL && *name != '\0')
-                {
-                    /* use the existing name */
-                    val = g_new0 (GValue, 1);
-                    g_value_init (val, G_TYPE_STRING);
-                    new_name = g_strdup (name);
-                    g_value_take_string (val, new_name);
-                    g_ptr_array_add (names, val);
-                    continue;
-                }
-            }
-
-            /* no existing name, create a new name */
-            val = g_new0 (GValue, 1);
-            g_value_init (val, G_TYPE_STRING);
-            new_name = g_strdup_printf (_("Workspace %d"), i + 1);
-            g_value_take_string (val, new_name);
-            g_ptr_array_add (names, val);
+            g_free (helper->names[i]);
+            helper->names[i] = g_strdup (helper->x_names[i]);
+            changed++;
         }
+    }
 
-        /* store new array in xfconf */
-        if (!xfconf_channel_set_arrayv (helper->channel, WORKSPACE_NAMES_PROP, names))
-             g_critical ("Failed to save xfconf property %s", WORKSPACE_NAMES_PROP);
+    if (changed > 0)
+        helper->names_dirty = TRUE;
 
-        xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "extended names in xfconf, waiting for property-change");
+    /* the property has to contain a name for each workspace */
+    if (n_x_names < helper->n_workspaces)
+        helper->x_names_dirty = TRUE;
 
-        xfconf_array_free (existing_names);
-    }
+    if (helper->names_dirty || helper->x_names_dirty)
+        xfce_workspaces_helper_schedule_flush (helper);
 
-    xfconf_array_free (names);
+    xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "someone else changed %d desktop names", changed);
 }
+#endif
 
 
 
 #ifdef GDK_WINDOWING_X11
 static gboolean
-xfce_workspaces_helper_wait_for_window_manager (gpointer data)
+xfce_workspaces_helper_have_window_manager (WaitForWM *wfwm)
 {
-  WaitForWM *wfwm = data;
-  guint      i;
-  gboolean   have_wm = TRUE;
+  guint i;
 
   for (i = 0; i < wfwm->atom_count; i++)
     {
@@ -420,44 +758,159 @@ xfce_workspaces_helper_wait_for_window_manager (gpointer data)
         {
           DBG ("window manager not ready on screen %d, waiting...", i);
 
-          have_wm = FALSE;
-          break;
+          return FALSE;
         }
     }
 
-  wfwm->have_wm = have_wm;
+  return TRUE;
+}
 
-  /* abort if a window manager is found or 5 seconds expired */
-  return wfwm->counter++ < 20 * 5 && !wfwm->have_wm;
+
+
+static void
+xfce_workspaces_helper_wait_for_window_manager_free (gpointer data)
+{
+  WaitForWM *wfwm = data;
+
+  wfwm->helper->wait_for_wm = NULL;
+
+  if (wfwm->timeout_id != 0)
+    g_source_remove (wfwm->timeout_id);
+#ifdef HAVE_XFIXES
+  if (wfwm->watch_id != 0)
+    g_source_remove (wfwm->watch_id);
+#endif
+
+  g_free (wfwm->atoms);
+  XCloseDisplay (wfwm->dpy);
+  g_slice_free (WaitForWM, wfwm);
 }
 
 
 
 static void
-xfce_workspaces_helper_wait_for_window_manager_destroyed (gpointer data)
+xfce_workspaces_helper_wait_for_window_manager_finish (WaitForWM *wfwm)
 {
-  WaitForWM            *wfwm = data;
   XfceWorkspacesHelper *helper = wfwm->helper;
 
-  helper->wait_for_wm_timeout_id = 0;
-
   if (!wfwm->have_wm)
+    g_printerr (G_LOG_DOMAIN ": No window manager registered on screen 0.\n");
+
+  xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "waited %.1f ms for the window manager (%s)",
+                  (g_get_monotonic_time () - wfwm->start_time) / 1000.0,
+                  wfwm->have_wm ? "found" : "timeout");
+
+  xfce_workspaces_helper_wait_for_window_manager_free (wfwm);
+
+  /* set the names anyway... */
+  xfce_workspaces_helper_set_names_real (helper);
+}
+
+
+
+static gboolean
+xfce_workspaces_helper_wait_for_window_manager (gpointer data)
+{
+  WaitForWM *wfwm = data;
+
+  wfwm->have_wm = xfce_workspaces_helper_have_window_manager (wfwm);
+
+  /* abort if a window manager is found or 5 seconds expired */
+  if (wfwm->counter++ < 20 * 5 && !wfwm->have_wm)
+    return TRUE;
+
+  wfwm->timeout_id = 0;
+  xfce_workspaces_helper_wait_for_window_manager_finish (wfwm);
+
+  return FALSE;
+}
+
+
+
+#ifdef HAVE_XFIXES
+static gboolean
+xfce_workspaces_helper_wait_for_window_manager_expired (gpointer data)
+{
+  WaitForWM *wfwm = data;
+
+  wfwm->timeout_id = 0;
+  xfce_workspaces_helper_wait_for_window_manager_finish (wfwm);
+
+  return FALSE;
+}
+
+
+
+static gboolean
+xfce_workspaces_helper_wait_for_window_manager_event (gint         fd,
+                                                      GIOCondition condition,
+                                                      gpointer     data)
+{
+  WaitForWM *wfwm = data;
+  XEvent     xevent;
+  gboolean   owner_changed = FALSE;
+
+  while (XPending (wfwm->dpy))
     {
-      g_printerr (G_LOG_DOMAIN ": No window manager registered on screen 0.\n");
+      XNextEvent (wfwm->dpy, &xevent);
+
+      if (xevent.type == wfwm->xfixes_event_base + XFixesSelectionNotify
+          && ((XFixesSelectionNotifyEvent *) &xevent)->owner != None)
+        owner_changed = TRUE;
     }
-  else
+
+  /* a new owner appeared, check if all screens are managed now */
+  if (owner_changed)
+    wfwm->have_wm = xfce_workspaces_helper_have_window_manager (wfwm);
+
+  if (!wfwm->have_wm && (condition & (G_IO_HUP | G_IO_ERR)) == 0)
+    return TRUE;
+
+  wfwm->watch_id = 0;
+  xfce_workspaces_helper_wait_for_window_manager_finish (wfwm);
+
+  return FALSE;
+}
+
+
+
+static gboolean
+xfce_workspaces_helper_wait_for_selection_owner (WaitForWM *wfwm)
+{
+  gint  error_base;
+  gint  major = 5, minor = 0;
+  guint i;
+
+  if (!XFixesQueryExtension (wfwm->dpy, &wfwm->xfixes_event_base, &error_base)
+      || !XFixesQueryVersion (wfwm->dpy, &major, &minor)
+      || major < 1)
+    return FALSE;
+
+  /* get notified when the wm acquires the manager selections */
+  for (i = 0; i < wfwm->atom_count; i++)
     {
-      DBG ("found window manager after %d tries", wfwm->counter);
+      XFixesSelectSelectionInput (wfwm->dpy, RootWindow (wfwm->dpy, i), wfwm->atoms[i],
+                                  XFixesSetSelectionOwnerNotifyMask);
     }
 
-  g_free (wfwm->atoms);
-  XCloseDisplay (wfwm->dpy);
-  g_slice_free (WaitForWM, wfwm);
+  /* check after selecting the input, so no new owner is missed */
+  wfwm->have_wm = xfce_workspaces_helper_have_window_manager (wfwm);
+  if (wfwm->have_wm)
+    {
+      xfce_workspaces_helper_wait_for_window_manager_finish (wfwm);
+      return TRUE;
+    }
 
-  /* set the names anyway... */
-  xfce_workspaces_helper_set_names_real (helper);
+  wfwm->watch_id = g_unix_fd_add (ConnectionNumber (wfwm->dpy), G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                  xfce_workspaces_helper_wait_for_window_manager_event, wfwm);
+
+  /* give up after 5 seconds */
+  wfwm->timeout_id = g_timeout_add_seconds (5, xfce_workspaces_helper_wait_for_window_manager_expired, wfwm);
+
+  return TRUE;
 }
 #endif
+#endif
 
 
 
@@ -469,15 +922,18 @@ xfce_workspaces_helper_set_names (XfceWorkspacesHelper *helper,
     WaitForWM  *wfwm;
     guint       i;
     gchar     **atom_names;
+    Display    *dpy;
 
-    if (!disable_wm_check && !xfsettingsd_disable_wm_check)
+    if (!disable_wm_check && !xfsettingsd_disable_wm_check
+        && (dpy = XOpenDisplay (NULL)) != NULL)
     {
         /* setup data for wm checking */
         wfwm = g_slice_new0 (WaitForWM);
         wfwm->helper = helper;
-        wfwm->dpy = XOpenDisplay (NULL);
+        wfwm->dpy = dpy;
         wfwm->have_wm = FALSE;
         wfwm->counter = 0;
+        wfwm->start_time = g_get_monotonic_time ();
 
         /* preload wm atoms for all screens */
         wfwm->atom_count = XScreenCount (wfwm->dpy);
@@ -492,10 +948,18 @@ xfce_workspaces_helper_set_names (XfceWorkspacesHelper *helper,
 
         g_strfreev (atom_names);
 
+        helper->wait_for_wm = wfwm;
+
+#ifdef HAVE_XFIXES
+        /* wait for the selection owner notify */
+        if (xfce_workspaces_helper_wait_for_selection_owner (wfwm))
+            return;
+#endif
+
         /* setup timeout to check for a window manager */
-        helper->wait_for_wm_timeout_id =
+        wfwm->timeout_id =
           g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE, 50, xfce_workspaces_helper_wait_for_window_manager,
-                              wfwm, xfce_workspaces_helper_wait_for_window_manager_destroyed);
+                              wfwm, NULL);
     }
     else
 #endif
@@ -508,83 +972,59 @@ xfce_workspaces_helper_set_names (XfceWorkspacesHelper *helper,
 
 
 static void
-xfce_workspaces_helper_save_names (XfceWorkspacesHelper *helper)
+xfce_workspaces_helper_prop_changed (XfconfChannel        *channel,
+                                     const gchar          *property,
+                                     const GValue         *value,
+                                     XfceWorkspacesHelper *helper)
 {
-    GPtrArray   *xfconf_names, *new_names;
-    GValue      *val_b;
-    const gchar *name_a, *name_b;
-    gboolean     save_array = FALSE;
-    guint        i;
+    gchar           **names;
+    GList            *li;
+    WorkspacesWrite  *write;
 
     g_return_if_fail (XFCE_IS_WORKSPACES_HELPER (helper));
 
-    new_names = xfce_workspaces_helper_get_names ();
-    if (new_names == NULL)
+#ifdef GDK_WINDOWING_X11
+    /* the initial start reads the names itself */
+    if (helper->wait_for_wm != NULL)
         return;
+#endif
 
-    xfconf_names = xfconf_channel_get_arrayv (helper->channel, WORKSPACE_NAMES_PROP);
-
-    if (xfconf_names == NULL
-       || xfconf_names->len < new_names->len)
-    {
-        /* store the new names in xfconf, should not append often because
-         * we probably saved (and set) a name when the workspace count
-         * was changed */
-        xfconf_channel_set_arrayv (helper->channel, WORKSPACE_NAMES_PROP, new_names);
+    names = xfce_workspaces_helper_names_from_value (value);
 
-        xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "storing %d names in xfconf", new_names->len);
-    }
-    else if (xfconf_names != NULL
-             && xfconf_names->len >= new_names->len)
+    /* check if this is the echo of one of our own writes, in that case
+     * the tags of that and older writes are dropped */
+    for (li = helper->xfconf_writes.head; li != NULL; li = li->next)
     {
-        /* update the new names in the xfconf array */
-        for (i = 0; i < new_names->len; i++)
+        write = li->data;
+        if (xfce_workspaces_helper_names_equal (write->names, names, G_MAXUINT))
         {
-             name_a = g_value_get_string (g_ptr_array_index (new_names, i));
+            while (g_queue_peek_head (&helper->xfconf_writes) != write)
+                xfce_workspaces_helper_write_free (g_queue_pop_head (&helper->xfconf_writes));
+            g_queue_pop_head (&helper->xfconf_writes);
 
-             val_b = g_ptr_array_index (xfconf_names, i);
-             name_b = g_value_get_string (val_b);
+            xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "ignored xfconf echo of generation %u",
+                            write->generation);
 
-             if (g_strcmp0 (name_a, name_b) != 0)
-             {
-                 /* set the old xfconf name to the new name */
-                 g_value_unset (val_b);
-                 g_value_init (val_b, G_TYPE_STRING);
-                 g_value_set_string (val_b, name_a);
+            xfce_workspaces_helper_write_free (write);
+            g_strfreev (names);
 
-                 save_array = TRUE;
-             }
-        }
-
-        if (save_array)
-        {
-            xfconf_channel_set_arrayv (helper->channel, WORKSPACE_NAMES_PROP, xfconf_names);
-
-            xfsettings_dbg (XFSD_DEBUG_WORKSPACES, "merged %d xfconf and %d desktop names",
-                            xfconf_names->len, new_names->len);
+            return;
         }
     }
 
-    if (xfconf_names != NULL)
-        xfconf_array_free (xfconf_names);
-    xfconf_array_free (new_names);
-}
-
+    /* only update x if a visible name changed */
+    if (!xfce_workspaces_helper_names_equal (helper->names, names, helper->n_workspaces))
+        helper->x_names_dirty = TRUE;
 
+    g_strfreev (helper->names);
+    helper->names = names;
 
-static void
-xfce_workspaces_helper_prop_changed (XfconfChannel        *channel,
-                                     const gchar          *property,
-                                     const GValue         *value,
-                                     XfceWorkspacesHelper *helper)
-{
-    g_return_if_fail (XFCE_IS_WORKSPACES_HELPER (helper));
+    /* names were removed from xfconf, store the missing ones again */
+    if (xfce_workspaces_helper_extend_names (helper))
+        helper->names_dirty = TRUE;
 
-    if (helper->wait_for_wm_timeout_id == 0)
-    {
-        /* only set the names if the initial start is not running anymore */
-        xfce_workspaces_helper_set_names (helper, TRUE);
-    }
+    if (helper->names_dirty || helper->x_names_dirty)
+        xfce_workspaces_helper_schedule_flush (helper);
 }
 
 
@@ -51,6 +51,9 @@
 
 #include "xsettings.h"
 #include "debug.h"
+#include "event-dispatch.h"
+#include "metrics.h"
+#include "trace.h"
 
 #define XSettingsTypeInteger 0
 #define XSettingsTypeString  1
@@ -966,6 +969,12 @@ xfce_xsettings_helper_notify (XfceXSettingsHelper *helper)
         g_critical ("Failed to set properties");
     }
 
+    xfsettings_metrics_count (XFSD_DEBUG_XSETTINGS, "notify", 1);
+    xfsettings_metrics_count (XFSD_DEBUG_XSETTINGS, "notify-bytes",
+                              notify->buf_len * g_slist_length (helper->screens));
+    xfsettings_trace (XFSD_TRACE_XSETTINGS_NOTIFY, helper->serial - 1,
+                      notify->n_settings, notify->buf_len);
+
     xfsettings_dbg (XFSD_DEBUG_XSETTINGS,
                     "%d settings changed (serial=%lu, len=%"G_GSIZE_FORMAT")",
                     notify->n_settings, helper->serial - 1, notify->buf_len);
@@ -1016,7 +1025,7 @@ xfce_xsettings_helper_event_filter (GdkXEvent *gdkxevent,
 
                 /* remove this filter if there are no screens */
                 if (helper->screens == NULL)
-                    gdk_window_remove_filter (NULL, xfce_xsettings_helper_event_filter, data);
+                    xfsettings_event_dispatch_remove (xfce_xsettings_helper_event_filter, data);
 
                 return GDK_FILTER_REMOVE;
             }
@@ -1175,7 +1184,8 @@ xfce_xsettings_helper_register (XfceXSettingsHelper *helper,
     if (helper->screens != NULL)
     {
         /* watch for selection changes */
-        gdk_window_add_filter (NULL, xfce_xsettings_helper_event_filter, helper);
+        xfsettings_event_dispatch_add ("xsettings", SelectionClear, None,
+                                       xfce_xsettings_helper_event_filter, helper);
 
         /* send notifications */
         xfce_xsettings_helper_notify (helper);